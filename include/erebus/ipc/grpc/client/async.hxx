@@ -0,0 +1,283 @@
+#pragma once
+
+#include <grpcpp/grpcpp.h>
+
+#include <erebus/ipc/grpc/client/iclient.hxx>
+#include <erebus/ipc/grpc/client/isystem_info_client.hxx>
+#include <erebus/rtl/format.hxx>
+#include <erebus/rtl/util/unknown_base.hxx>
+
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <optional>
+
+
+namespace Er::Ipc::Grpc::Async
+{
+
+//
+// Awaitable and std::future flavors of the client calls.
+//
+// A call starts right away, so any number of them can be issued from a single thread
+// before the first one is awaited. There are no per-call locks: the reply and the waiter
+// meet through a single atomic flag, and whoever comes second runs the continuation.
+//
+// Without an executor the continuation runs inline on the thread that completes the call,
+// which is a gRPC thread unless the reply was already there. Such a continuation should
+// neither block nor drop the last reference to the client, whose destructor would wait for
+// the very callback it is running in; pass an executor for anything else. Should the
+// executor throw, the waiter is resumed in place with that exception instead of the result.
+//
+
+using Executor = std::function<void(std::function<void()>&&)>;
+
+
+template <typename T>
+class State final
+{
+public:
+    State(Executor executor) noexcept
+        : m_executor(std::move(executor))
+    {
+    }
+
+    // the first result wins
+    void setValue(T&& value) noexcept
+    {
+        if (!m_set.exchange(true, std::memory_order_relaxed))
+        {
+            m_value.emplace(std::move(value));
+            arrive();
+        }
+    }
+
+    void setError(std::exception_ptr error) noexcept
+    {
+        if (!m_set.exchange(true, std::memory_order_relaxed))
+        {
+            m_error = error;
+            arrive();
+        }
+    }
+
+    // false if the result is already there and the caller should go on by itself
+    bool suspend(std::function<void()>&& continuation) noexcept
+    {
+        m_continuation = std::move(continuation);
+        return !m_rendezvous.exchange(true, std::memory_order_acq_rel);
+    }
+
+    bool ready() const noexcept
+    {
+        return m_rendezvous.load(std::memory_order_acquire);
+    }
+
+    T take()
+    {
+        if (m_error)
+            std::rethrow_exception(m_error);
+
+        return std::move(*m_value);
+    }
+
+private:
+    void arrive() noexcept
+    {
+        if (!m_rendezvous.exchange(true, std::memory_order_acq_rel))
+            return; // nobody's waiting yet
+
+        if (!m_executor)
+        {
+            m_continuation();
+            return;
+        }
+
+        try
+        {
+            m_executor(std::function<void()>(m_continuation));
+        }
+        catch (...)
+        {
+            // the continuation hasn't been posted, so it's still ours to run
+            m_value.reset();
+            m_error = std::current_exception();
+            m_continuation();
+        }
+    }
+
+    Executor m_executor;
+    std::atomic<bool> m_set = false;
+    std::atomic<bool> m_rendezvous = false;
+    std::optional<T> m_value;
+    std::exception_ptr m_error;
+    std::function<void()> m_continuation;
+};
+
+
+template <typename T>
+class [[nodiscard]] Call final
+{
+public:
+    using StatePtr = std::shared_ptr<State<T>>;
+
+    explicit Call(StatePtr state) noexcept
+        : m_state(std::move(state))
+    {
+    }
+
+    bool await_ready() const noexcept
+    {
+        return m_state->ready();
+    }
+
+    bool await_suspend(std::coroutine_handle<> h) noexcept
+    {
+        return m_state->suspend([h]() { h.resume(); });
+    }
+
+    T await_resume()
+    {
+        return m_state->take();
+    }
+
+    // the call cannot be awaited after that
+    std::future<T> future() &&
+    {
+        auto promise = std::make_shared<std::promise<T>>();
+        auto f = promise->get_future();
+
+        auto state = std::move(m_state);
+        auto resolve = [state, promise]()
+        {
+            try
+            {
+                promise->set_value(state->take());
+            }
+            catch (...)
+            {
+                promise->set_exception(std::current_exception());
+            }
+        };
+
+        if (!state->suspend(resolve))
+            resolve();
+
+        return f;
+    }
+
+private:
+    StatePtr m_state;
+};
+
+
+inline std::exception_ptr makeRpcError(const grpc::Status& status)
+{
+    return std::make_exception_ptr(Exception(
+        std::source_location::current(),
+        Error(Result::Internal, GenericError),
+        Exception::Message(Er::format("RPC failed with status {}: {}", int(status.error_code()), status.error_message()))
+    ));
+}
+
+
+// the bridge from a completion interface to the shared state; the result is set from the
+// callbacks only, so that the continuation never runs inside whatever lets go of the completion
+template <class Interface, typename T>
+class Completion
+    : public Util::ReferenceCountedBase<Util::ObjectBase<Interface>>
+{
+public:
+    explicit Completion(std::shared_ptr<State<T>> state) noexcept
+        : m_state(std::move(state))
+    {
+    }
+
+    void onError(grpc::Status const& status) noexcept override
+    {
+        m_state->setError(makeRpcError(status));
+    }
+
+    void onException(Exception&& e) noexcept override
+    {
+        m_state->setError(std::make_exception_ptr(std::move(e)));
+    }
+
+protected:
+    std::shared_ptr<State<T>> m_state;
+};
+
+
+template <class CompletionT, typename T, typename Issue>
+Call<T> launch(Executor executor, Issue&& issue)
+{
+    auto state = std::make_shared<State<T>>(std::move(executor));
+    issue(ReferenceCountedPtr<typename CompletionT::Interface>{ new CompletionT(state) });
+    return Call<T>(state);
+}
+
+
+namespace Private
+{
+
+class PingCompletion final
+    : public Completion<ISystemInfoClient::IPingCompletion, ISystemInfoClient::PingMessage>
+{
+public:
+    using Interface = ISystemInfoClient::IPingCompletion;
+    using Completion::Completion;
+
+    void onReply(ISystemInfoClient::PingMessage&&, ISystemInfoClient::PingMessage&& reply) override
+    {
+        m_state->setValue(std::move(reply));
+    }
+};
+
+class SystemInfoCompletion final
+    : public Completion<ISystemInfoClient::ISystemInfoCompletion, PropertyBag>
+{
+public:
+    using Interface = ISystemInfoClient::ISystemInfoCompletion;
+    using Completion::Completion;
+
+    CallbackResult onProperty(Property&& prop) override
+    {
+        m_bag.push_back(std::move(prop));
+        return CallbackResult::Continue;
+    }
+
+    void onComplete() override
+    {
+        m_state->setValue(std::move(m_bag));
+    }
+
+private:
+    PropertyBag m_bag;
+};
+
+} // namespace Private {}
+
+
+// the reply to the ping
+inline Call<ISystemInfoClient::PingMessage> ping(ISystemInfoClient* client, ISystemInfoClient::PingMessage&& message, Executor executor = {})
+{
+    return launch<Private::PingCompletion, ISystemInfoClient::PingMessage>(std::move(executor), [client, &message](auto&& completion)
+    {
+        client->ping(std::move(message), std::move(completion));
+    });
+}
+
+// every matching property, once the stream is over
+inline Call<PropertyBag> getSystemInfo(ISystemInfoClient* client, const std::string& pattern, Executor executor = {})
+{
+    return launch<Private::SystemInfoCompletion, PropertyBag>(std::move(executor), [client, &pattern](auto&& completion)
+    {
+        client->getSystemInfo(pattern, std::move(completion));
+    });
+}
+
+
+} // namespace Er::Ipc::Grpc::Async {}
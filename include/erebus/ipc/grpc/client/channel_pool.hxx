@@ -0,0 +1,160 @@
+#pragma once
+
+#include <erebus/rtl/assert.hxx>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+
+namespace grpc
+{
+
+class Channel;
+
+} // namespace grpc {}
+
+
+namespace Er::Ipc::Grpc
+{
+
+//
+// Several channels to the same server, each with a connection of its own, so that parallel
+// calls aren't squeezed through a single HTTP/2 connection and its stream limit.
+// Every call goes to the channel with the fewest calls in flight.
+//
+
+class ChannelPool final
+    : public boost::noncopyable
+{
+public:
+    // holds a channel slot for the duration of a call
+    class Lease final
+        : public boost::noncopyable
+    {
+    public:
+        ~Lease()
+        {
+            reset();
+        }
+
+        Lease() noexcept = default;
+
+        Lease(Lease&& other) noexcept
+            : m_pool(other.m_pool)
+            , m_index(other.m_index)
+        {
+            other.m_pool = nullptr;
+        }
+
+        Lease& operator=(Lease&& other) noexcept
+        {
+            if (this != &other)
+            {
+                reset();
+                m_pool = other.m_pool;
+                m_index = other.m_index;
+                other.m_pool = nullptr;
+            }
+
+            return *this;
+        }
+
+        std::size_t index() const noexcept
+        {
+            return m_index;
+        }
+
+        void reset() noexcept
+        {
+            if (m_pool)
+            {
+                m_pool->m_slots[m_index].inFlight.fetch_sub(1, std::memory_order_relaxed);
+                m_pool = nullptr;
+            }
+        }
+
+    private:
+        friend class ChannelPool;
+
+        Lease(ChannelPool* pool, std::size_t index) noexcept
+            : m_pool(pool)
+            , m_index(index)
+        {
+        }
+
+        ChannelPool* m_pool = nullptr;
+        std::size_t m_index = 0;
+    };
+
+    explicit ChannelPool(std::vector<std::shared_ptr<grpc::Channel>>&& channels)
+        : m_channels(std::move(channels))
+        , m_slots(std::make_unique<Slot[]>(m_channels.size()))
+    {
+        ErAssert(!m_channels.empty());
+    }
+
+    std::size_t size() const noexcept
+    {
+        return m_channels.size();
+    }
+
+    const std::shared_ptr<grpc::Channel>& channel(std::size_t index) const noexcept
+    {
+        ErAssert(index < m_channels.size());
+        return m_channels[index];
+    }
+
+    std::uint32_t inFlight(std::size_t index) const noexcept
+    {
+        ErAssert(index < m_channels.size());
+        return m_slots[index].inFlight.load(std::memory_order_relaxed);
+    }
+
+    // the least loaded channel; ties are broken round-robin
+    Lease acquire() noexcept
+    {
+        auto count = m_channels.size();
+        std::size_t best = 0;
+
+        if (count > 1)
+        {
+            auto start = m_next.fetch_add(1, std::memory_order_relaxed) % count;
+            best = start;
+            auto bestLoad = m_slots[start].inFlight.load(std::memory_order_relaxed);
+
+            for (std::size_t i = 1; (i < count) && (bestLoad > 0); ++i)
+            {
+                auto index = (start + i) % count;
+                auto load = m_slots[index].inFlight.load(std::memory_order_relaxed);
+                if (load < bestLoad)
+                {
+                    best = index;
+                    bestLoad = load;
+                }
+            }
+        }
+
+        m_slots[best].inFlight.fetch_add(1, std::memory_order_relaxed);
+        return Lease(this, best);
+    }
+
+private:
+    struct alignas(64) Slot
+    {
+        std::atomic<std::uint32_t> inFlight = 0;
+    };
+
+    const std::vector<std::shared_ptr<grpc::Channel>> m_channels;
+    std::unique_ptr<Slot[]> m_slots;
+    std::atomic<std::size_t> m_next = 0;
+};
+
+
+using ChannelPoolPtr = std::shared_ptr<ChannelPool>;
+
+
+} // namespace Er::Ipc::Grpc {}
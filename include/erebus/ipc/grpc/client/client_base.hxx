@@ -1,7 +1,9 @@
 #pragma once
 
+#include <google/protobuf/arena.h>
 #include <grpcpp/grpcpp.h>
 
+#include <erebus/ipc/grpc/client/grpc_client.hxx>
 #include <erebus/ipc/grpc/client/iclient.hxx>
 #include <erebus/ipc/grpc/protocol.hxx>
 #include <erebus/rtl/log.hxx>
@@ -24,6 +26,8 @@ class ClientBase
     using Base = Util::ReferenceCountedBase<Util::ObjectBase<_Interface>>;
 
 public:
+    // derived classes have to call waitRunningContexts() in their own destructors,
+    // since the calls in flight may use their members; this is just the last resort
     ~ClientBase()
     {
         waitRunningContexts();
@@ -31,10 +35,12 @@ public:
         ::grpc_shutdown();
     }
 
-    ClientBase(ChannelPtr channel, Log::LoggerPtr log)
+    ClientBase(ChannelPoolPtr pool, Log::LoggerPtr log)
         : m_grpcReady(grpcInit())
         , m_log(log)
+        , m_pool(std::move(pool))
     {
+        ErAssert(m_pool);
     }
 
 protected:
@@ -43,21 +49,52 @@ protected:
     {
         ~ContextBase() noexcept
         {
+            // the pool may go away with the client once we're removed
+            m_lease.reset();
             m_owner->removeContext();
         }
 
         ContextBase(ClientBase* owner, Er::Log::ILogger* log) noexcept
             : m_owner(owner)
             , m_log(log)
+            , m_lease(owner->m_pool->acquire())
         {
             owner->addContext();
         }
 
+        // the pool channel this call goes through
+        std::size_t channel() const noexcept
+        {
+            return m_lease.index();
+        }
+
         grpc::ClientContext grpcContext;
 
     protected:
+        // per-call messages live on the context's arena and are freed all at once with it
+        template <typename MessageT>
+        MessageT& make()
+        {
+            return *google::protobuf::Arena::Create<MessageT>(&m_arena);
+        }
+
         ClientBase* const m_owner;
         Er::Log::ILogger* const m_log;
+
+    private:
+        ChannelPool::Lease m_lease;
+
+        static google::protobuf::ArenaOptions arenaOptions(char* block, std::size_t size) noexcept
+        {
+            google::protobuf::ArenaOptions options;
+            options.initial_block = block;
+            options.initial_block_size = size;
+            return options;
+        }
+
+        // small requests and replies need no allocations of their own
+        alignas(std::max_align_t) char m_arenaBlock[1024];
+        google::protobuf::Arena m_arena{ arenaOptions(m_arenaBlock, sizeof(m_arenaBlock)) };
     };
 
     static bool grpcInit() noexcept
@@ -99,8 +136,21 @@ protected:
         }
     }
 
+    // one stub per pool channel
+    template <class StubT, class ServiceT>
+    std::vector<std::unique_ptr<StubT>> makeStubs() const
+    {
+        std::vector<std::unique_ptr<StubT>> stubs;
+        stubs.reserve(m_pool->size());
+        for (std::size_t i = 0; i < m_pool->size(); ++i)
+            stubs.push_back(ServiceT::NewStub(m_pool->channel(i)));
+
+        return stubs;
+    }
+
     const bool m_grpcReady;
     Log::LoggerPtr m_log;
+    const ChannelPoolPtr m_pool;
     
     struct RunningContexts
     {
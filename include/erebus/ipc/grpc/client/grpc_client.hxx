@@ -1,5 +1,6 @@
 #pragma once
 
+#include <erebus/ipc/grpc/client/channel_pool.hxx>
 #include <erebus/ipc/grpc/client/iclient.hxx>
 #include <erebus/ipc/grpc/client/isystem_info_client.hxx>
 
@@ -21,6 +22,10 @@ using ChannelPtr = std::shared_ptr<grpc::Channel>;
 
 ER_GRPC_CLIENT_EXPORT [[nodiscard]] ChannelPtr createChannel(const PropertyMap& parameters);
 
+// 'count' channels with the same parameters but separate connections
+ER_GRPC_CLIENT_EXPORT [[nodiscard]] ChannelPoolPtr createChannelPool(const PropertyMap& parameters, std::size_t count);
+
 ER_GRPC_CLIENT_EXPORT [[nodiscard]] SystemInfoClientPtr createSystemInfoClient(ChannelPtr channel, Log::LoggerPtr log);
+ER_GRPC_CLIENT_EXPORT [[nodiscard]] SystemInfoClientPtr createSystemInfoClient(ChannelPoolPtr pool, Log::LoggerPtr log);
     
 } // namespace Er::Ipc::Grpc {}
\ No newline at end of file
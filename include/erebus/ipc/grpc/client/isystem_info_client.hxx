@@ -4,6 +4,10 @@
 #include <erebus/rtl/log.hxx>
 #include <erebus/rtl/time.hxx>
 
+#include <chrono>
+#include <string>
+#include <vector>
+
 
 namespace Er::Ipc::Grpc
 {
@@ -33,14 +37,29 @@ struct ISystemInfoClient
         : public IClient::ICompletion
     {
         virtual CallbackResult onProperty(Property&& prop) = 0;
+        virtual void onComplete() = 0;                          // the stream is over; errors go to onError() instead
 
     protected:
         virtual ~ISystemInfoCompletion() = default;
     };
+
+    struct ISubscriptionCompletion
+        : public IClient::ICompletion
+    {
+        // the first update carries everything matched, the following ones only what has changed
+        // and the names of the properties that no longer exist
+        virtual CallbackResult onUpdate(Time timestamp, PropertyBag&& changed, std::vector<std::string>&& removed) = 0;
+
+    protected:
+        virtual ~ISubscriptionCompletion() = default;
+    };
     
     virtual void ping(PingMessage&& ping, ReferenceCountedPtr<IPingCompletion> handler) = 0;
     virtual void getSystemInfo(const std::string& pattern, ReferenceCountedPtr<ISystemInfoCompletion> handler) = 0;
 
+    // lasts until the handler returns CallbackResult::Cancel or the connection is lost
+    virtual void subscribe(const std::string& pattern, std::chrono::milliseconds interval, ReferenceCountedPtr<ISubscriptionCompletion> handler) = 0;
+
 protected:
     virtual ~ISystemInfoClient() = default;
 };
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <grpcpp/server_context.h>
+
+#include <optional>
+#include <string_view>
+
+
+namespace Er::Ipc::Grpc
+{
+
+//
+// The server decides whether to admit a call as soon as it arrives, before the handler runs,
+// and leaves its verdict in the client metadata of a rejected call. Handlers are to check it
+// first thing and finish the call with the status returned, without doing any real work.
+//
+
+constexpr std::string_view AdmissionMetadataKey{ "erebus-admission-rejected" };
+
+
+inline std::optional<grpc::Status> admissionRejected(const grpc::ServerContextBase* context)
+{
+    auto& metadata = context->client_metadata();
+    if (metadata.empty()) [[likely]]
+        return std::nullopt;
+
+    auto it = metadata.find(grpc::string_ref(AdmissionMetadataKey.data(), AdmissionMetadataKey.size()));
+    if (it == metadata.end())
+        return std::nullopt;
+
+    return grpc::Status(grpc::StatusCode::RESOURCE_EXHAUSTED, std::string(it->second.data(), it->second.size()));
+}
+
+
+} // namespace Er::Ipc::Grpc {}
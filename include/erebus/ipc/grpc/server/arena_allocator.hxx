@@ -0,0 +1,59 @@
+#pragma once
+
+#include <google/protobuf/arena.h>
+#include <grpcpp/support/message_allocator.h>
+
+#include <cstddef>
+
+
+namespace Er::Ipc::Grpc
+{
+
+//
+// Puts the request and the reply of a unary call, with everything nested in them, onto
+// a per-call protobuf arena that is freed at once when the call is done.
+// Register with CallbackService::SetMessageAllocatorFor_<Method>(); it has to outlive the server.
+//
+
+template <typename RequestT, typename ReplyT, std::size_t InitialBlockSize = 2048>
+class ArenaAllocator final
+    : public grpc::MessageAllocator<RequestT, ReplyT>
+{
+public:
+    grpc::MessageHolder<RequestT, ReplyT>* AllocateMessages() override
+    {
+        return new Holder();
+    }
+
+private:
+    class Holder final
+        : public grpc::MessageHolder<RequestT, ReplyT>
+    {
+    public:
+        Holder()
+        {
+            this->set_request(google::protobuf::Arena::Create<RequestT>(&m_arena));
+            this->set_response(google::protobuf::Arena::Create<ReplyT>(&m_arena));
+        }
+
+        void Release() override
+        {
+            delete this;
+        }
+
+    private:
+        static google::protobuf::ArenaOptions arenaOptions(char* block, std::size_t size) noexcept
+        {
+            google::protobuf::ArenaOptions options;
+            options.initial_block = block;
+            options.initial_block_size = size;
+            return options;
+        }
+
+        alignas(std::max_align_t) char m_block[InitialBlockSize];
+        google::protobuf::Arena m_arena{ arenaOptions(m_block, sizeof(m_block)) };
+    };
+};
+
+
+} // namespace Er::Ipc::Grpc {}
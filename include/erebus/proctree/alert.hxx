@@ -0,0 +1,35 @@
+#pragma once
+
+#include <erebus/proctree/proctree.hxx>
+#include <erebus/rtl/time.hxx>
+
+#include <string>
+
+
+namespace Er::ProcessTree
+{
+
+//
+// An edge-triggered notification produced by the server-side rule engine:
+// Fired once when a rule starts to match a process, Resolved once when it stops
+//
+
+struct Alert
+{
+    enum class State : std::uint32_t
+    {
+        Fired,
+        Resolved
+    };
+
+    State state = State::Fired;
+    std::string rule;
+    Pid pid = InvalidPid;
+    std::string comm;           // may be empty if no rule references it
+    Time timestamp;             // when the transition was detected
+    Time since;                 // when the rule started to match
+    std::string details;        // values of the fields referenced by the rule
+};
+
+
+} // namespace Er::ProcessTree {}
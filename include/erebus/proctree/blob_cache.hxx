@@ -0,0 +1,124 @@
+#pragma once
+
+#include <protobuf/proctree.pb.h>
+
+#include <erebus/proctree/proctree.hxx>
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+
+namespace Er::ProcessTree
+{
+
+//
+// Command lines, environments and executable paths are mostly the same for
+// lots of processes, so a stream sends each of them once (as a Blob) and refers
+// to it by its hash afterwards.
+//
+// BlobCache keeps the most recently used blobs up to a total size. The server
+// has one to answer GetBlobs(), the client has one to resolve references.
+// Thread-safe.
+//
+
+class ER_PROCTREE_EXPORT BlobCache final
+    : public boost::noncopyable
+{
+public:
+    using Hash = std::uint64_t;
+    using Data = std::shared_ptr<const std::string>;
+
+    // shorter strings are cheaper to send inline
+    static constexpr std::size_t MinBlobSize = 32;
+
+    // only the server computes hashes, with a key of its own; the client treats them as opaque ids
+    [[nodiscard]] static Hash hash(std::string_view data) noexcept;
+
+    explicit BlobCache(std::size_t maxBytes);
+
+    // the stored blob; nullptr if a different one has the same hash
+    Data put(Hash hash, std::string_view data);
+
+    // same as put() but replaces a different blob with the same hash; the client takes the server's word for it
+    Data assign(Hash hash, std::string_view data);
+
+    // nullptr if it's not there (anymore)
+    [[nodiscard]] Data find(Hash hash);
+
+    [[nodiscard]] std::size_t bytes() const noexcept;
+
+private:
+    Data store(Hash hash, std::string_view data, bool replace);
+    void evict();
+
+    struct Entry
+    {
+        Data data;
+        std::list<Hash>::iterator lru;
+    };
+
+    const std::size_t m_maxBytes;
+    mutable std::mutex m_mutex;
+    std::unordered_map<Hash, Entry> m_entries;
+    std::list<Hash> m_lru;                      // most recently used first
+    std::size_t m_bytes = 0;
+};
+
+
+//
+// Replaces long strings in outgoing messages with references; one per stream
+//
+
+class ER_PROCTREE_EXPORT BlobEncoder final
+{
+public:
+    // the stream forgets what it has sent beyond that and sends some blobs again
+    static constexpr std::size_t MaxSent = 64 * 1024;
+
+    explicit BlobEncoder(std::shared_ptr<BlobCache> store) noexcept
+        : m_store(std::move(store))
+    {
+    }
+
+    // blobs the client hasn't seen yet on this stream go to 'blobs'
+    void encode(erebus::ProcessProps& props, google::protobuf::RepeatedPtrField<erebus::Blob>& blobs);
+
+private:
+    std::optional<BlobCache::Hash> reference(const std::string& data, google::protobuf::RepeatedPtrField<erebus::Blob>& blobs);
+
+    std::shared_ptr<BlobCache> m_store;
+    std::unordered_map<BlobCache::Hash, std::weak_ptr<const std::string>> m_sent; // what the client has got under that hash
+};
+
+
+// client side: stores the blobs that came with a message
+ER_PROCTREE_EXPORT void storeBlobs(BlobCache& cache, const google::protobuf::RepeatedPtrField<erebus::Blob>& blobs);
+
+//
+// Client side: puts the referenced strings back. The blobs that came with the message
+// are looked up first since the cache may have evicted them already.
+//
+
+class ER_PROCTREE_EXPORT BlobResolver final
+    : public boost::noncopyable
+{
+public:
+    BlobResolver(BlobCache& cache, const google::protobuf::RepeatedPtrField<erebus::Blob>& attached);
+
+    // the hashes found neither in the message nor in the cache are appended to 'missing'
+    void resolve(erebus::ProcessProps& props, std::vector<BlobCache::Hash>* missing);
+
+private:
+    BlobCache& m_cache;
+    std::unordered_map<BlobCache::Hash, const std::string*> m_attached;
+};
+
+
+} // namespace Er::ProcessTree {}
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <erebus/ipc/grpc/client/async.hxx>
+#include <erebus/proctree/client/iprocess_list_client.hxx>
+
+#include <utility>
+
+
+namespace Er::ProcessTree::Async
+{
+
+//
+// Awaitable and std::future flavors of IProcessListClient calls; see Er::Ipc::Grpc::Async
+//
+
+using Ipc::Grpc::Async::Call;
+using Ipc::Grpc::Async::Executor;
+
+
+struct ProcessListing
+{
+    struct Entry
+    {
+        std::string ns;
+        ProcessProperties props;
+    };
+
+    std::vector<Entry> processes;
+    std::vector<std::pair<std::string, Exception>> failedRoots;
+};
+
+
+namespace Private
+{
+
+using Ipc::Grpc::Async::Completion;
+
+class GetProcessPropsCompletion final
+    : public Completion<IProcessListClient::IGetProcessPropsCompletion, ProcessProperties>
+{
+public:
+    using Interface = IProcessListClient::IGetProcessPropsCompletion;
+    using Completion::Completion;
+
+    void onReply(ProcessProperties&& props, IProcessListClient::Timings) override
+    {
+        m_state->setValue(std::move(props));
+    }
+};
+
+class GroupByCompletion final
+    : public Completion<IProcessListClient::IGroupByCompletion, std::vector<GroupStats>>
+{
+public:
+    using Interface = IProcessListClient::IGroupByCompletion;
+    using Completion::Completion;
+
+    void onReply(std::vector<GroupStats>&& groups, IProcessListClient::Timings) override
+    {
+        m_state->setValue(std::move(groups));
+    }
+};
+
+class FindSocketsCompletion final
+    : public Completion<IProcessListClient::IFindSocketsCompletion, std::vector<SocketInfo>>
+{
+public:
+    using Interface = IProcessListClient::IFindSocketsCompletion;
+    using Completion::Completion;
+
+    void onReply(std::vector<SocketInfo>&& sockets, IProcessListClient::Timings) override
+    {
+        m_state->setValue(std::move(sockets));
+    }
+};
+
+class FindOpenFilesCompletion final
+    : public Completion<IProcessListClient::IFindOpenFilesCompletion, OpenFileList>
+{
+public:
+    using Interface = IProcessListClient::IFindOpenFilesCompletion;
+    using Completion::Completion;
+
+    void onReply(OpenFileList&& files, IProcessListClient::Timings) override
+    {
+        m_state->setValue(std::move(files));
+    }
+};
+
+class ListProcessesCompletion final
+    : public Completion<IProcessListClient::IListProcessesCompletion, ProcessListing>
+{
+public:
+    using Interface = IProcessListClient::IListProcessesCompletion;
+    using Completion::Completion;
+
+    CallbackResult onProcess(std::string&& ns, ProcessProperties&& props) override
+    {
+        m_listing.processes.push_back({ std::move(ns), std::move(props) });
+        return CallbackResult::Continue;
+    }
+
+    void onRootFailed(std::string&& ns, Exception&& e) override
+    {
+        m_listing.failedRoots.emplace_back(std::move(ns), std::move(e));
+    }
+
+    void onComplete() override
+    {
+        m_state->setValue(std::move(m_listing));
+    }
+
+private:
+    ProcessListing m_listing;
+};
+
+} // namespace Private {}
+
+
+inline Call<ProcessProperties> getProcessProperties(IProcessListClient* client, Pid pid, const ProcessProperties::Mask& required, Executor executor = {})
+{
+    return Ipc::Grpc::Async::launch<Private::GetProcessPropsCompletion, ProcessProperties>(std::move(executor), [&](auto&& completion)
+    {
+        client->getProcessProperties(pid, required, std::move(completion));
+    });
+}
+
+inline Call<ProcessListing> listProcesses(IProcessListClient* client, const ProcessProperties::Mask& required, Executor executor = {})
+{
+    return Ipc::Grpc::Async::launch<Private::ListProcessesCompletion, ProcessListing>(std::move(executor), [&](auto&& completion)
+    {
+        client->listProcesses(required, std::move(completion));
+    });
+}
+
+inline Call<std::vector<GroupStats>> groupBy(IProcessListClient* client, GroupKey key, const ProcessProperties::Mask& fields, Executor executor = {})
+{
+    return Ipc::Grpc::Async::launch<Private::GroupByCompletion, std::vector<GroupStats>>(std::move(executor), [&](auto&& completion)
+    {
+        client->groupBy(key, fields, std::move(completion));
+    });
+}
+
+inline Call<std::vector<SocketInfo>> findSockets(IProcessListClient* client, const SocketQuery& query, Executor executor = {})
+{
+    return Ipc::Grpc::Async::launch<Private::FindSocketsCompletion, std::vector<SocketInfo>>(std::move(executor), [&](auto&& completion)
+    {
+        client->findSockets(query, std::move(completion));
+    });
+}
+
+inline Call<OpenFileList> findOpenFiles(IProcessListClient* client, std::string_view prefix, std::size_t limit, Executor executor = {})
+{
+    return Ipc::Grpc::Async::launch<Private::FindOpenFilesCompletion, OpenFileList>(std::move(executor), [&](auto&& completion)
+    {
+        client->findOpenFiles(prefix, limit, std::move(completion));
+    });
+}
+
+
+} // namespace Er::ProcessTree::Async {}
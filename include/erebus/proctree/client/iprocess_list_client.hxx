@@ -1,10 +1,19 @@
 #pragma once
 
+#include <erebus/ipc/grpc/client/grpc_client.hxx>
 #include <erebus/ipc/grpc/client/iclient.hxx>
+#include <erebus/proctree/alert.hxx>
+#include <erebus/proctree/group_by.hxx>
+#include <erebus/proctree/open_file.hxx>
+#include <erebus/proctree/pressure.hxx>
+#include <erebus/proctree/process_delta.hxx>
 #include <erebus/proctree/process_props.hxx>
+#include <erebus/proctree/socket.hxx>
 #include <erebus/rtl/log.hxx>
 #include <erebus/rtl/time.hxx>
 
+#include <chrono>
+
 
 namespace Er::ProcessTree
 {
@@ -32,12 +41,152 @@ struct IProcessListClient
 
     using GetProcessPropsCompletionPtr = ReferenceCountedPtr<IGetProcessPropsCompletion>;
 
+    struct IGroupByCompletion
+        : public IClient::ICompletion
+    {
+        virtual void onReply(std::vector<GroupStats>&& groups, Timings timings) = 0;
+
+    protected:
+        virtual ~IGroupByCompletion() = default;
+    };
+
+    using GroupByCompletionPtr = ReferenceCountedPtr<IGroupByCompletion>;
+
+    struct IPressureCompletion
+        : public IClient::ICompletion
+    {
+        virtual CallbackResult onEvent(PressureEvent&& event) = 0;
+
+    protected:
+        virtual ~IPressureCompletion() = default;
+    };
+
+    using PressureCompletionPtr = ReferenceCountedPtr<IPressureCompletion>;
+
+    struct IAlertCompletion
+        : public IClient::ICompletion
+    {
+        virtual CallbackResult onEvent(Alert&& alert) = 0;
+
+    protected:
+        virtual ~IAlertCompletion() = default;
+    };
+
+    using AlertCompletionPtr = ReferenceCountedPtr<IAlertCompletion>;
+
+    struct IListProcessesCompletion
+        : public IClient::ICompletion
+    {
+        // ns is the tag of the procfs root the process was found in
+        virtual CallbackResult onProcess(std::string&& ns, ProcessProperties&& props) = 0;
+        virtual void onRootFailed(std::string&& ns, Exception&& e) = 0;
+        virtual void onComplete() = 0;
+
+    protected:
+        virtual ~IListProcessesCompletion() = default;
+    };
+
+    using ListProcessesCompletionPtr = ReferenceCountedPtr<IListProcessesCompletion>;
+
+    // a server stream in progress
+    struct IStream
+    {
+        // asynchronous; the stream ends with a CANCELLED status some time later
+        virtual void cancel() noexcept = 0;
+
+    protected:
+        virtual ~IStream() = default;
+    };
+
+    struct IProcessDeltaCompletion
+        : public IClient::ICompletion
+    {
+        virtual CallbackResult onEvent(ProcessDelta&& delta) = 0;
+
+        // the stream may be cancelled through 'stream' from any thread until onStreamEnded() is called for it;
+        // onStreamEnded() comes last, after onError() if there has been an error
+        virtual void onStreamStarted([[maybe_unused]] IStream* stream) noexcept {}
+        virtual void onStreamEnded([[maybe_unused]] IStream* stream) noexcept {}
+
+    protected:
+        virtual ~IProcessDeltaCompletion() = default;
+    };
+
+    using ProcessDeltaCompletionPtr = ReferenceCountedPtr<IProcessDeltaCompletion>;
+
+    struct IFindSocketsCompletion
+        : public IClient::ICompletion
+    {
+        virtual void onReply(std::vector<SocketInfo>&& sockets, Timings timings) = 0;
+
+    protected:
+        virtual ~IFindSocketsCompletion() = default;
+    };
+
+    using FindSocketsCompletionPtr = ReferenceCountedPtr<IFindSocketsCompletion>;
+
+    struct IFindOpenFilesCompletion
+        : public IClient::ICompletion
+    {
+        virtual void onReply(OpenFileList&& files, Timings timings) = 0;
+
+    protected:
+        virtual ~IFindOpenFilesCompletion() = default;
+    };
+
+    using FindOpenFilesCompletionPtr = ReferenceCountedPtr<IFindOpenFilesCompletion>;
+
     virtual void getProcessProperties(Pid pid, const ProcessProperties::Mask& required, GetProcessPropsCompletionPtr completion) = 0;
+
+    // every configured procfs root is scanned concurrently; results arrive root by root as the scans complete
+    virtual void listProcesses(const ProcessProperties::Mask& required, ListProcessesCompletionPtr completion) = 0;
+
+    // per-group counts, sums and maxima of the numeric fields (ThreadCount, STime, UTime, CpuUsage, Rss)
+    virtual void groupBy(GroupKey key, const ProcessProperties::Mask& fields, GroupByCompletionPtr completion) = 0;
+
+    // the stream lasts until the completion returns CallbackResult::Cancel or the server goes away
+    virtual void watchPressure(PressureResourceMask resources, PressureCompletionPtr completion) = 0;
+
+    // the first deltas are the whole table: a reset one followed by more chunks of the same until one
+    // comes without 'more'; a client that can't keep up gets DATA_LOSS
+    virtual void subscribe(const ProcessProperties::Mask& fields, ProcessDeltaCompletionPtr completion) = 0;
+
+    // the table as the server has recorded it at 'at', chunked the same way as in subscribe(); NOT_FOUND if nothing was recorded by then, FAILED_PRECONDITION if the recorder is off
+    virtual void replay(Time at, const ProcessProperties::Mask& fields, ProcessDeltaCompletionPtr completion) = 0;
+
+    // active alerts come first, then Fired/Resolved transitions; an empty rule list means 'all rules'
+    virtual void watchAlerts(const std::vector<std::string>& rules, AlertCompletionPtr completion) = 0;
+
+    // TCP and UDP sockets with the processes holding them, from the server's socket index;
+    // FAILED_PRECONDITION if the index is off, INVALID_ARGUMENT for an address that doesn't parse
+    virtual void findSockets(const SocketQuery& query, FindSocketsCompletionPtr completion) = 0;
+
+    // files open under 'prefix' (a directory or a file) with their holders, from the server's open file index;
+    // FAILED_PRECONDITION if the index is off. A zero limit means 'as many as the server allows'
+    virtual void findOpenFiles(std::string_view prefix, std::size_t limit, FindOpenFilesCompletionPtr completion) = 0;
 };
 
 using ProcessListClientPtr = ReferenceCountedPtr<IProcessListClient>;
 
 
-[[nodiscard]] ER_PROCTREE_EXPORT ProcessListClientPtr createProcessListClient(Ipc::Grpc::ChannelPtr channel, Log::LoggerPtr log);
+struct ProcessListClientOptions
+{
+    // getProcessProperties() calls made within this window go out as a single batched RPC;
+    // identical (pid, mask) requests are sent once. Every call waits up to the whole window,
+    // so batching is off by default (zero) and is worth it only for many small calls at once.
+    // Calls still waiting when the client goes away fail with CANCELLED.
+    std::chrono::microseconds batchWindow{ 0 };
+    std::size_t maxBatchSize = 128; // a full batch is sent right away
+
+    // command lines, environments and executable paths come once per stream and are
+    // referred to by their hashes afterwards; this many bytes of them are kept. Zero disables that.
+    std::size_t blobCacheSize = 32 * 1024 * 1024;
+};
+
+
+[[nodiscard]] ER_PROCTREE_EXPORT ProcessListClientPtr createProcessListClient(Ipc::Grpc::ChannelPtr channel, Log::LoggerPtr log, const ProcessListClientOptions& options = {});
+
+// every call goes to the pool channel with the fewest calls in flight
+[[nodiscard]] ER_PROCTREE_EXPORT ProcessListClientPtr createProcessListClient(Ipc::Grpc::ChannelPoolPtr pool, Log::LoggerPtr log, const ProcessListClientOptions& options = {});
 
 } // namespace Er::ProcessTree {}
\ No newline at end of file
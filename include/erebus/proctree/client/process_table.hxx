@@ -0,0 +1,196 @@
+#pragma once
+
+#include <erebus/proctree/client/iprocess_list_client.hxx>
+
+#include <array>
+#include <atomic>
+#include <bitset>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+
+namespace Er::ProcessTree
+{
+
+//
+// A local mirror of the server's process table. It subscribes once and applies
+// the deltas as they arrive. Every delta produces a new immutable snapshot, so
+// readers never wait for the writer: snapshot() is a single atomic load, and
+// the snapshot stays valid for as long as the caller holds it.
+//
+// A snapshot shares everything a delta has not touched with its predecessor.
+// A stream that breaks is reopened after a growing delay, unless the server
+// has refused it for good (an invalid request, no permission, and such).
+//
+
+class ER_PROCTREE_EXPORT ProcessTable final
+    : public boost::noncopyable
+{
+public:
+    using ProcessPtr = std::shared_ptr<const ProcessProperties>;
+    using PidList = std::vector<Pid>;
+
+    class ER_PROCTREE_EXPORT Snapshot final
+    {
+    public:
+        [[nodiscard]] Time timestamp() const noexcept
+        {
+            return m_timestamp;
+        }
+
+        // incremented with every delta applied
+        [[nodiscard]] std::uint64_t version() const noexcept
+        {
+            return m_version;
+        }
+
+        // false until the first full table has arrived and after the subscription has failed
+        [[nodiscard]] bool synchronized() const noexcept
+        {
+            return m_synchronized;
+        }
+
+        [[nodiscard]] std::size_t size() const noexcept
+        {
+            return m_size;
+        }
+
+        [[nodiscard]] ProcessPtr find(Pid pid) const noexcept;
+        [[nodiscard]] const PidList& children(Pid ppid) const noexcept;
+        [[nodiscard]] const PidList& byUser(std::uint64_t ruid) const noexcept;
+
+        template <typename VisitorT>
+        void forEach(VisitorT&& visitor) const
+        {
+            for (auto& shard : m_processes.shards())
+            {
+                if (!shard)
+                    continue;
+
+                for (auto& entry : *shard)
+                    visitor(*entry.second);
+            }
+        }
+
+    private:
+        friend class ProcessTable;
+
+        // split by key, so that a delta copies only the shards it writes to
+        template <typename KeyT, typename ValueT>
+        class ShardedMap final
+        {
+        public:
+            using Map = std::unordered_map<KeyT, ValueT>;
+            static constexpr std::size_t Shards = 64;
+
+            const auto& shards() const noexcept
+            {
+                return m_shards;
+            }
+
+            const ValueT* find(const KeyT& key) const noexcept
+            {
+                auto& shard = m_shards[index(key)];
+                if (!shard)
+                    return nullptr;
+
+                auto it = shard->find(key);
+                if (it == shard->end())
+                    return nullptr;
+
+                return &it->second;
+            }
+
+            // the shards are shared until written to
+            ShardedMap share() const noexcept
+            {
+                ShardedMap m;
+                m.m_shards = m_shards;
+                return m;
+            }
+
+            // a shard shared with another snapshot is copied on the first write
+            Map& write(const KeyT& key)
+            {
+                auto i = index(key);
+                if (!m_owned[i])
+                {
+                    m_shards[i] = m_shards[i] ? std::make_shared<Map>(*m_shards[i]) : std::make_shared<Map>();
+                    m_owned.set(i);
+                }
+
+                return *m_shards[i];
+            }
+
+        private:
+            static std::size_t index(const KeyT& key) noexcept
+            {
+                return std::hash<KeyT>{}(key) % Shards;
+            }
+
+            std::array<std::shared_ptr<Map>, Shards> m_shards;
+            std::bitset<Shards> m_owned;
+        };
+
+        void index(Pid pid, const ProcessProperties& p);
+        void unindex(Pid pid, const ProcessProperties& p);
+        void reindex(Pid pid, const ProcessProperties& before, const ProcessProperties& after);
+
+        Time m_timestamp;
+        std::uint64_t m_version = 0;
+        bool m_synchronized = false;
+        std::size_t m_size = 0;
+        ShardedMap<Pid, ProcessPtr> m_processes;
+        ShardedMap<Pid, PidList> m_children;
+        ShardedMap<std::uint64_t, PidList> m_users;
+    };
+
+    using SnapshotPtr = std::shared_ptr<const Snapshot>;
+
+    ~ProcessTable();
+
+    // PPid and Ruid are always mirrored since the indexes are built on them
+    ProcessTable(ProcessListClientPtr client, const ProcessProperties::Mask& fields, Log::LoggerPtr log);
+
+    [[nodiscard]] SnapshotPtr snapshot() const noexcept
+    {
+        return m_snapshot.load(std::memory_order_acquire);
+    }
+
+private:
+    class Subscription;
+
+    static constexpr std::chrono::milliseconds MinRetryDelay{ 500 };
+    static constexpr std::chrono::milliseconds MaxRetryDelay{ 30000 };
+
+    void apply(ProcessDelta&& delta);
+    void streamEnded(const grpc::Status* failure); // null if the stream has ended without an error
+    void subscribe();
+    void retry(std::stop_token stop);
+
+    Log::LoggerPtr m_log;
+    ProcessListClientPtr m_client;
+    ProcessProperties::Mask m_fields;
+    Subscription* m_subscription; // owned by m_completion
+    IProcessListClient::ProcessDeltaCompletionPtr m_completion;
+    std::atomic<SnapshotPtr> m_snapshot;
+    std::chrono::milliseconds m_retryDelay = MinRetryDelay; // the subscription's own
+    bool m_loading = false; // the subscription's own too: the table is arriving in chunks
+
+    // resubscribing
+    std::mutex m_retryMutex;
+    std::condition_variable_any m_retryCv;
+    std::optional<std::chrono::steady_clock::time_point> m_retryAt;
+    std::jthread m_retrier;
+};
+
+
+} // namespace Er::ProcessTree {}
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <erebus/proctree/shm_table.hxx>
+#include <erebus/rtl/error.hxx>
+
+#include <algorithm>
+#include <expected>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+
+namespace Er::ProcessTree
+{
+
+//
+// Read-only access to the process table a local server publishes in shared memory.
+// No RPCs and no copies: View reads the columns right where the server has written them.
+//
+// Sample:
+//
+//     auto table = ShmProcessTable::open();
+//     auto r = table.value()->read([](const ShmProcessTable::View& v)
+//     {
+//         if (auto row = v.find(pid))
+//             rss = v.number(*row, ProcessProperties::Rss);
+//     });
+//
+
+class ER_PROCTREE_EXPORT ShmProcessTable final
+    : public boost::noncopyable
+{
+public:
+    //
+    // A snapshot of the table; only valid within the read() callback, and
+    // what it has read counts only if read() then succeeds
+    //
+    class View
+    {
+    public:
+        std::uint32_t count() const noexcept
+        {
+            return m_count;
+        }
+
+        Time timestamp() const noexcept
+        {
+            return Time(static_cast<Time::ValueType>(m_header->timestamp));
+        }
+
+        bool truncated() const noexcept
+        {
+            return (m_header->flags & Shm::Truncated) != 0;
+        }
+
+        Pid pid(std::uint32_t row) const noexcept
+        {
+            return cell(row, Shm::fieldColumn(ProcessProperties::Pid));
+        }
+
+        // rows are sorted by pid
+        std::optional<std::uint32_t> find(Pid pid) const noexcept
+        {
+            std::uint32_t lo = 0;
+            std::uint32_t hi = m_count;
+            while (lo < hi)
+            {
+                auto mid = lo + (hi - lo) / 2;
+                auto p = this->pid(mid);
+                if (p == pid)
+                    return mid;
+
+                if (p < pid)
+                    lo = mid + 1;
+                else
+                    hi = mid;
+            }
+
+            return std::nullopt;
+        }
+
+        bool valid(std::uint32_t row, FieldId field) const noexcept
+        {
+            return (cell(row, Shm::ValidColumn) & (std::uint64_t(1) << field)) != 0;
+        }
+
+        // integers and times as they are; CpuUsage is a double
+        std::uint64_t number(std::uint32_t row, FieldId field) const noexcept
+        {
+            return cell(row, Shm::fieldColumn(field));
+        }
+
+        double cpuUsage(std::uint32_t row) const noexcept
+        {
+            return std::bit_cast<double>(number(row, ProcessProperties::CpuUsage));
+        }
+
+        std::string_view string(std::uint32_t row, FieldId field) const noexcept
+        {
+            auto c = cell(row, Shm::fieldColumn(field));
+            auto offset = c >> 32;
+            auto length = c & 0xffffffff;
+
+            // a torn read may have anything in it
+            if (offset + length > m_header->arenaSize)
+                return {};
+
+            return std::string_view(m_arena + offset, length);
+        }
+
+        ProcessProperties get(std::uint32_t row) const;
+
+    private:
+        friend class ShmProcessTable;
+
+        View(const Shm::Header* header, const std::uint64_t* columns, const char* arena) noexcept
+            : m_header(header)
+            , m_columns(columns)
+            , m_arena(arena)
+            , m_count(std::min(header->count, header->capacity))
+        {
+        }
+
+        std::uint64_t cell(std::uint32_t row, std::size_t column) const noexcept
+        {
+            return m_columns[column * m_header->capacity + row];
+        }
+
+        const Shm::Header* m_header;
+        const std::uint64_t* m_columns;
+        const char* m_arena;
+        std::uint32_t m_count;
+    };
+
+    ~ShmProcessTable();
+
+    [[nodiscard]] static std::expected<std::unique_ptr<ShmProcessTable>, Error> open(std::string_view name = Shm::DefaultName);
+
+    // the server has gone or restarted; open() the table again
+    [[nodiscard]] bool closed() const noexcept;
+
+    // published ProcessProperties fields
+    [[nodiscard]] ProcessProperties::Mask fields() const noexcept;
+
+    // calls f(const View&) until it has seen a consistent table (so possibly more than once);
+    // fails if the table is closed or the server keeps writing it for too long
+    template <typename F>
+    std::expected<void, Error> read(F&& f) const
+    {
+        for (unsigned attempt = 0; ; ++attempt)
+        {
+            auto s = begin(attempt);
+            if (!s)
+                return std::unexpected(s.error());
+
+            f(View(m_header, m_columns, m_arena));
+
+            if (validate(*s))
+                return {};
+        }
+    }
+
+    // copies of all the processes
+    std::expected<std::vector<ProcessProperties>, Error> snapshot() const;
+
+    // nullopt if there's no such process
+    std::expected<std::optional<ProcessProperties>, Error> find(Pid pid) const;
+
+private:
+    ShmProcessTable(const void* base, std::size_t size) noexcept;
+
+    std::expected<std::uint64_t, Error> begin(unsigned attempt) const;
+    bool validate(std::uint64_t sequence) const noexcept;
+
+    const void* m_base;
+    std::size_t m_size;
+    const Shm::Header* m_header;
+    const std::uint64_t* m_columns;
+    const char* m_arena;
+};
+
+
+} // namespace Er::ProcessTree {}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <erebus/proctree/process_props.hxx>
+
+#include <string>
+#include <vector>
+
+
+namespace Er::ProcessTree
+{
+
+enum class GroupKey : std::uint32_t
+{
+    Ruid,
+    UserName,       // same as Ruid, but the server resolves the user name
+    Session,
+    PGrp,
+    Tty
+};
+
+
+struct GroupStats
+{
+    struct Aggregate
+    {
+        ProcessProperties::Field field;
+        double sum = 0.0;
+        double max = 0.0;
+    };
+
+    std::int64_t key = 0;
+    std::string name;                       // user name for GroupKey::UserName
+    std::uint64_t count = 0;                // number of processes in the group
+    std::vector<Aggregate> aggregates;      // in the order of field IDs
+};
+
+
+} // namespace Er::ProcessTree {}
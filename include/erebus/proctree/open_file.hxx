@@ -0,0 +1,37 @@
+#pragma once
+
+#include <erebus/proctree/proctree.hxx>
+
+#include <string>
+#include <vector>
+
+
+namespace Er::ProcessTree
+{
+
+//
+// Files and the processes holding them open, lsof-style
+//
+
+struct OpenFile
+{
+    struct Owner
+    {
+        Pid pid = InvalidPid;
+        std::int32_t fd = -1;
+    };
+
+    std::string path;                   // as /proc/<pid>/fd has it, " (deleted)" suffix included
+    std::vector<Owner> owners;
+};
+
+
+struct OpenFileList
+{
+    std::vector<OpenFile> files;        // sorted by path
+    bool truncated = false;             // there are more than the limit asked for
+    bool partial = false;               // the index is over its memory budget, so some (short-lived) processes are missing
+};
+
+
+} // namespace Er::ProcessTree {}
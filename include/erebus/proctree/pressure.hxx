@@ -0,0 +1,62 @@
+#pragma once
+
+#include <erebus/proctree/proctree.hxx>
+#include <erebus/rtl/time.hxx>
+
+#include <string>
+#include <vector>
+
+
+namespace Er::ProcessTree
+{
+
+//
+// Pressure Stall Information (see Documentation/accounting/psi.rst)
+//
+
+enum class PressureResource : std::uint32_t
+{
+    Cpu,
+    Memory,
+    Io,
+    _Count
+};
+
+enum class PressureKind : std::uint32_t
+{
+    Some,
+    Full
+};
+
+using PressureResourceMask = std::uint32_t;
+
+constexpr PressureResourceMask pressureResourceBit(PressureResource r) noexcept
+{
+    return PressureResourceMask(1) << static_cast<std::uint32_t>(r);
+}
+
+constexpr PressureResourceMask AllPressureResources = (PressureResourceMask(1) << static_cast<std::uint32_t>(PressureResource::_Count)) - 1;
+
+
+struct PressureEvent
+{
+    struct Consumer
+    {
+        Pid pid = InvalidPid;
+        std::string comm;
+        std::uint64_t value = 0;     // CPU time (us) for Cpu, RSS (bytes) for Memory, block I/O delay (us) for Io;
+                                     // the times are what has been used since the previous event
+    };
+
+    PressureResource resource = PressureResource::Cpu;
+    PressureKind kind = PressureKind::Some;
+    std::uint32_t stallUs = 0;       // trigger threshold
+    std::uint32_t windowUs = 0;      // trigger window
+    Time timestamp;
+    double avg10 = 0.0;              // % of time stalled over the last 10 seconds
+    std::uint64_t total = 0;         // total stall time (us)
+    std::vector<Consumer> top;       // top consumers of the resource at the moment the trigger fired
+};
+
+
+} // namespace Er::ProcessTree {}
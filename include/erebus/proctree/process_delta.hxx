@@ -0,0 +1,25 @@
+#pragma once
+
+#include <erebus/proctree/process_props.hxx>
+
+#include <vector>
+
+
+namespace Er::ProcessTree
+{
+
+//
+// A change to the server's process table as seen by a subscriber
+//
+
+struct ProcessDelta
+{
+    Time timestamp;
+    bool reset = false;                     // 'changed' is the whole table, or its first chunk if 'more' is set
+    bool more = false;                      // the table continues in the next delta
+    std::vector<ProcessProperties> changed; // new processes are complete, the rest carry only the changed fields
+    std::vector<Pid> removed;
+};
+
+
+} // namespace Er::ProcessTree {}
@@ -9,7 +9,7 @@ namespace Er::ProcessTree
 {
 
 struct ProcessProperties
-    : public Reflectable<ProcessProperties, 18>
+    : public Reflectable<ProcessProperties, 19>
 {
     enum Field : FieldId
     {
@@ -31,6 +31,7 @@ struct ProcessProperties
         CpuUsage,
         Tty,
         Env,
+        Rss,
         _FieldCount
     };
     
@@ -53,9 +54,10 @@ struct ProcessProperties
     std::uint32_t threadCount;
     Time sTime;
     Time uTime;
-    double cpuUsage;
+    double cpuUsage;            // % since the previous sample; over the lifetime for a process seen for the first time
     std::int32_t tty;
     MultiStringZ env;
+    std::uint64_t rss;          // bytes
 
     ER_REFLECTABLE_FILEDS_BEGIN(ProcessProperties)
         ER_REFLECTABLE_FIELD(ProcessProperties, Pid, Semantics::Default, pid),
@@ -75,7 +77,8 @@ struct ProcessProperties
         ER_REFLECTABLE_FIELD(ProcessProperties, UTime, Semantics::Duration, uTime),
         ER_REFLECTABLE_FIELD(ProcessProperties, CpuUsage, Semantics::Percent, cpuUsage),
         ER_REFLECTABLE_FIELD(ProcessProperties, Tty, Semantics::Default, tty),
-        ER_REFLECTABLE_FIELD(ProcessProperties, Env, Semantics::Default, env)
+        ER_REFLECTABLE_FIELD(ProcessProperties, Env, Semantics::Default, env),
+        ER_REFLECTABLE_FIELD(ProcessProperties, Rss, Semantics::Size, rss)
     ER_REFLECTABLE_FILEDS_END()
 };
 
@@ -3,16 +3,43 @@
 #include <protobuf/proctree.pb.h>
 
 #include <erebus/ipc/grpc/protocol.hxx>
+#include <erebus/proctree/alert.hxx>
+#include <erebus/proctree/group_by.hxx>
+#include <erebus/proctree/open_file.hxx>
+#include <erebus/proctree/pressure.hxx>
+#include <erebus/proctree/process_delta.hxx>
 #include <erebus/proctree/process_props.hxx>
+#include <erebus/proctree/socket.hxx>
 
 
 namespace Er::ProcessTree
 {
 
 void marshalProcessProperties(const ProcessProperties& source, erebus::ProcessProps& dest);
+void marshalProcessProperties(const ProcessProperties& source, const ProcessProperties::Mask& fields, erebus::ProcessProps& dest);
 ProcessProperties unmarshalProcessProperties(const erebus::ProcessProps& src);
 
+std::uint64_t packProcessPropertyMask(const ProcessProperties::Mask& mask) noexcept;
+ProcessProperties::Mask unpackProcessPropertyMask(std::uint64_t bits) noexcept;
+
 void marshalProcessPropertyMsk(erebus::ProcessPropsRequest& dest, const ProcessProperties::Mask& required);
 ProcessProperties::Mask unmarshalProcessPropertyMask(const erebus::ProcessPropsRequest& req);
 
+void marshalPressureEvent(const PressureEvent& source, erebus::PressureEvent& dest);
+PressureEvent unmarshalPressureEvent(const erebus::PressureEvent& src);
+
+void marshalAlert(const Alert& source, erebus::Alert& dest);
+Alert unmarshalAlert(const erebus::Alert& src);
+
+void marshalProcessGroup(const GroupStats& source, erebus::ProcessGroup& dest);
+GroupStats unmarshalProcessGroup(const erebus::ProcessGroup& src);
+
+ProcessDelta unmarshalProcessDelta(const erebus::ProcessDelta& src);
+
+void marshalSocketInfo(const SocketInfo& source, erebus::Socket& dest);
+SocketInfo unmarshalSocketInfo(const erebus::Socket& src);
+
+void marshalOpenFile(const OpenFile& source, erebus::OpenFile& dest);
+OpenFile unmarshalOpenFile(const erebus::OpenFile& src);
+
 } // namespace Er::ProcessTree {}
\ No newline at end of file
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <erebus/proctree/alert.hxx>
+#include <erebus/proctree/server/snapshot.hxx>
+#include <erebus/rtl/property_bag.hxx>
+
+#include <optional>
+#include <unordered_map>
+
+#include <boost/noncopyable.hpp>
+
+
+namespace Er::ProcessTree
+{
+
+//
+// Alert rules are compiled once into a flat list of field comparisons; each rule
+// is a conjunction over a contiguous slice of that list. Only the processes whose
+// referenced fields have changed since the previous snapshot are re-evaluated,
+// so the cost is proportional to the churn rather than to the process count.
+//
+// Config is a vector of maps:
+//   { "name": "rss", "when": [ { "field": "rss", "op": ">", "value": 8589934592 } ], "for_ms": 0 }
+//
+// 'for_ms' makes the rule fire only after its condition has held for that long. Such a
+// condition can come due while nothing changes, so the caller has to evaluate an empty
+// delta by nextDue() at the latest.
+//
+
+class ER_PROCTREE_EXPORT AlertRules final
+    : public boost::noncopyable
+{
+public:
+    explicit AlertRules(const PropertyVector& config);
+
+    [[nodiscard]] const ProcessProperties::Mask& requiredFields() const noexcept
+    {
+        return m_required;
+    }
+
+    [[nodiscard]] std::size_t size() const noexcept
+    {
+        return m_rules.size();
+    }
+
+    [[nodiscard]] std::string_view name(std::size_t index) const noexcept
+    {
+        ErAssert(index < m_rules.size());
+        return m_rules[index].name;
+    }
+
+    void evaluate(const SnapshotDelta& delta, std::vector<Alert>& out);
+    void active(std::vector<Alert>& out) const;
+
+    // when the earliest condition still being held is due to fire
+    [[nodiscard]] std::optional<Time> nextDue() const noexcept;
+
+private:
+    enum class Op : std::uint8_t
+    {
+        Eq,
+        Ne,
+        Lt,
+        Le,
+        Gt,
+        Ge,
+        Contains
+    };
+
+    enum class OperandType : std::uint8_t
+    {
+        Integer,
+        Real,
+        String
+    };
+
+    struct Instruction
+    {
+        ProcessProperties::Field field;
+        Op op;
+        OperandType type;
+        std::int64_t integer = 0;
+        double real = 0.0;
+        std::string string;
+    };
+
+    struct Rule
+    {
+        std::string name;
+        std::uint32_t first = 0;
+        std::uint32_t count = 0;
+        ProcessProperties::Mask fields;
+        Time::ValueType holdUs = 0;
+    };
+
+    struct Key
+    {
+        std::uint32_t rule;
+        Pid pid;
+
+        bool operator==(const Key&) const noexcept = default;
+    };
+
+    struct KeyHash
+    {
+        std::size_t operator()(const Key& k) const noexcept
+        {
+            return std::hash<Pid>{}(k.pid) ^ (std::size_t(k.rule) << 1);
+        }
+    };
+
+    struct Tracking
+    {
+        Time since;             // the condition has held since
+        Time firedAt;
+        bool fired = false;
+        std::string comm;
+        std::string details;
+    };
+
+    static Instruction compile(const PropertyMap& condition);
+    bool match(const Rule& rule, const ProcessProperties& props) const noexcept;
+    std::string describe(const Rule& rule, const ProcessProperties& props) const;
+    Alert makeAlert(Alert::State state, const Rule& rule, Pid pid, const Tracking& t, Time timestamp) const;
+
+    std::vector<Instruction> m_plan;
+    std::vector<Rule> m_rules;
+    ProcessProperties::Mask m_required;
+    std::unordered_map<Key, Tracking, KeyHash> m_tracking;
+    std::size_t m_pending = 0;  // matching but not yet fired
+};
+
+
+} // namespace Er::ProcessTree {}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <erebus/proctree/group_by.hxx>
+
+#include <array>
+#include <unordered_map>
+
+#include <boost/noncopyable.hpp>
+
+
+namespace Er::ProcessTree
+{
+
+//
+// One-pass hash aggregation of numeric process properties keyed on
+// Ruid, Session, PGrp or Tty
+//
+
+class ER_PROCTREE_EXPORT GroupAggregator final
+    : public boost::noncopyable
+{
+public:
+    static constexpr std::array<ProcessProperties::Field, 5> Aggregatable =
+    {
+        ProcessProperties::ThreadCount,
+        ProcessProperties::STime,
+        ProcessProperties::UTime,
+        ProcessProperties::CpuUsage,
+        ProcessProperties::Rss
+    };
+
+    [[nodiscard]] static ProcessProperties::Field keyField(GroupKey key) noexcept;
+
+    // fields that cannot be aggregated are ignored
+    GroupAggregator(GroupKey key, const ProcessProperties::Mask& fields, std::size_t expectedGroups = 64);
+
+    // the key field plus the aggregated fields
+    [[nodiscard]] const ProcessProperties::Mask& required() const noexcept
+    {
+        return m_required;
+    }
+
+    void add(const ProcessProperties& props) noexcept;
+
+    [[nodiscard]] std::vector<GroupStats> result() const;
+
+private:
+    struct Accumulator
+    {
+        std::uint64_t count = 0;
+        std::array<double, Aggregatable.size()> sum = {};
+        std::array<double, Aggregatable.size()> max = {};
+    };
+
+    const ProcessProperties::Field m_keyField;
+    std::array<ProcessProperties::Field, Aggregatable.size()> m_fields;
+    std::size_t m_fieldCount = 0;
+    ProcessProperties::Mask m_required;
+    std::unordered_map<std::int64_t, Accumulator> m_groups;
+};
+
+
+} // namespace Er::ProcessTree {}
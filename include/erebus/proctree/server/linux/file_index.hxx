@@ -0,0 +1,109 @@
+#pragma once
+
+#include <erebus/proctree/open_file.hxx>
+#include <erebus/proctree/server/linux/procfs.hxx>
+#include <erebus/rtl/log.hxx>
+
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <set>
+#include <shared_mutex>
+#include <thread>
+#include <unordered_map>
+
+#include <boost/noncopyable.hpp>
+
+
+namespace Er::ProcessTree::Linux
+{
+
+//
+// A path -> (pid, fd) index of the files open by every process, for prefix queries.
+//
+// Like SocketIndex, it only rereads /proc/<pid>/fd for processes that are new or whose
+// descriptor count has changed, plus everything every 'resync' interval. The index is
+// kept within a memory budget: older processes are indexed first and push out younger
+// ones when it's full, so the long-lived daemons that matter in an incident stay covered.
+// The processes left out are retried as soon as there is room for them.
+//
+
+class ER_PROCTREE_EXPORT FileIndex final
+    : public boost::noncopyable
+{
+public:
+    struct Options
+    {
+        std::chrono::milliseconds interval{ 5000 };           // zero means 'only when refresh() is called'
+        std::chrono::seconds resync{ 300 };
+        std::size_t budget = 64 * 1024 * 1024;                // bytes, approximately
+    };
+
+    ~FileIndex();
+
+    FileIndex(ProcFsRootPtr procFsRoot, const Options& options, Log::ILogger* log);
+
+    // called on the indexer thread; must not be called concurrently with itself
+    void refresh();
+
+    // 'prefix' is a directory (everything under it) or a file
+    OpenFileList find(std::string_view prefix, std::size_t limit) const;
+
+    std::size_t memoryUsage() const noexcept;
+
+private:
+    using Paths = std::map<std::string, std::vector<OpenFile::Owner>, std::less<>>;
+
+    struct ProcessFile
+    {
+        std::int32_t fd;
+        Paths::iterator path;
+    };
+
+    struct Process
+    {
+        std::size_t fdCount = 0;
+        Time startTime;
+        bool indexed = false;
+        bool dirty = false;                                   // didn't fit into the budget; to be retried
+        std::vector<ProcessFile> files;
+        std::size_t cost = 0;
+        std::size_t wanted = 0;                               // what it would have cost when it didn't fit
+        std::uint64_t generation = 0;
+    };
+
+    struct Rescanned
+    {
+        Pid pid;
+        std::size_t fdCount;
+        Time startTime;
+        std::vector<ProcFs::FdLink> files;
+        std::size_t cost;
+    };
+
+    void run(std::stop_token stop);
+    void drop(Pid pid, Process& process);
+    void insert(Pid pid, Process& process, Rescanned& r);
+    bool fits(Time startTime, Pid pid, std::size_t cost) const;
+    bool makeRoom(const Rescanned& r);
+    bool collect(Paths::const_iterator it, std::size_t limit, OpenFileList& result) const;
+
+    Log::ILogger* const m_log;
+    const Options m_options;
+    ProcFs m_procFs;                                                        // used by refresh() only
+    std::uint64_t m_generation = 0;
+    std::chrono::steady_clock::time_point m_lastResync;
+    mutable std::shared_mutex m_mutex;
+    Paths m_paths;
+    std::unordered_map<Pid, Process> m_processes;                           // only refresh() modifies it
+    std::set<std::pair<Time::ValueType, Pid>> m_byAge;                      // the indexed ones, oldest first
+    std::size_t m_usage = 0;
+    std::size_t m_skipped = 0;                                              // processes left out
+    std::mutex m_sleepMutex;
+    std::condition_variable_any m_sleep;
+    std::jthread m_worker;
+};
+
+
+} // namespace Er::ProcessTree::Linux {}
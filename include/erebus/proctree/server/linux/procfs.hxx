@@ -5,16 +5,87 @@
 #include <erebus/rtl/log.hxx>
 #include <erebus/rtl/multi_string.hxx>
 #include <erebus/rtl/time.hxx>
+#include <erebus/rtl/util/generic_handle.hxx>
 
+#include <array>
 #include <expected>
+#include <memory>
+#include <optional>
+#include <span>
+#include <unordered_map>
 #include <vector>
 
 #include <boost/noncopyable.hpp>
 
+#include <dirent.h>
+
 
 namespace Er::ProcessTree::Linux
 {
 
+//
+// The immutable part of a procfs mount; it is created once and shared
+// between any number of ProcFs readers on any number of threads
+//
+
+class ER_PROCTREE_EXPORT ProcFsRoot final
+    : public boost::noncopyable
+{
+public:
+    ~ProcFsRoot() = default;
+
+    explicit ProcFsRoot(std::string_view path = std::string_view("/proc"));
+
+    const std::string& path() const noexcept
+    {
+        return m_path;
+    }
+
+    int fd() const noexcept // O_PATH descriptor for the *at() calls
+    {
+        return m_fd.get();
+    }
+
+    std::uint64_t bootTime() const noexcept // seconds
+    {
+        return m_bootTime;
+    }
+
+    long ticksPerSecond() const noexcept
+    {
+        return m_ticksPerSecond;
+    }
+
+    int cpuCount() const noexcept
+    {
+        return m_cpusMax;
+    }
+
+private:
+    std::uint64_t getBootTimeImpl();
+
+    const std::string m_path;
+    Util::FileHandle m_fd;
+    const std::uint64_t m_bootTime; // seconds
+    const long m_ticksPerSecond;
+    const int m_cpusMax;
+};
+
+using ProcFsRootPtr = std::shared_ptr<const ProcFsRoot>;
+
+class UringReader;
+
+
+//
+// A procfs reader; it owns its read buffer and cached descriptors and is
+// meant to be used by a single thread. Create one reader per worker
+// from a shared ProcFsRoot to read the same mount concurrently.
+//
+// With the io_uring backend enabled, prefetch() reads a whole batch of files
+// with a single syscall; otherwise (or if io_uring is not available) every
+// file is read synchronously when asked for
+//
+
 class ER_PROCTREE_EXPORT ProcFs final
     : public boost::noncopyable
 {
@@ -80,31 +151,103 @@ public:
         Stat() noexcept = default;
     };
 
-    ~ProcFs() = default;
+    struct FdLink
+    {
+        int fd = -1;
+        std::string target;                                   // "socket:[1234]", "pipe:[5678]", a file path etc
+    };
+
+    // a line of /proc/net/{tcp,tcp6,udp,udp6}
+    struct NetSocket
+    {
+        std::uint64_t inode = 0;                              // zero for sockets no process holds (TIME_WAIT etc)
+        std::array<std::uint8_t, 16> localAddress = {};       // network byte order; IPv4 goes IPv4-mapped (::ffff:a.b.c.d)
+        std::array<std::uint8_t, 16> remoteAddress = {};
+        std::uint16_t localPort = 0;
+        std::uint16_t remotePort = 0;
+        std::uint8_t state = 0;
+        std::uint32_t uid = 0;
+    };
+
+    enum PrefetchFile : unsigned
+    {
+        PrefetchStat = 0x01,                                  // /proc/<pid>/stat
+        PrefetchOwner = 0x02,                                 // statx(/proc/<pid>)
+        PrefetchComm = 0x04,
+        PrefetchCmdLine = 0x08,
+        PrefetchEnv = 0x10
+    };
+
+    ~ProcFs();
 
     explicit ProcFs(std::string_view procFsRoot = std::string_view("/proc"));
+    explicit ProcFs(ProcFsRootPtr root, bool ioUring = false);
+
+    const std::string& root() const noexcept
+    {
+        return m_root->path();
+    }
 
-    constexpr Time bootTime() noexcept
+    const ProcFsRootPtr& shared() const noexcept
     {
-        return Time::fromSeconds(m_bootTime);
+        return m_root;
+    }
+
+    Time bootTime() const noexcept
+    {
+        return Time::fromSeconds(m_root->bootTime());
     }
 
     static Time timeFromTicks(std::uint64_t ticks) noexcept;
 
+    bool batched() const noexcept
+    {
+        return !!m_uring;
+    }
+
+    // how many PIDs a single prefetch() can take for the given set of files
+    std::size_t prefetchCapacity(unsigned files) const noexcept;
+
+    // loads the files of these processes in one go; the read*() calls below are served from
+    // the prefetched data until the next prefetch(); an empty 'pids' just drops the data
+    void prefetch(std::span<const Pid> pids, unsigned files);
+
     std::expected<std::vector<Pid>, Error> enumeratePids();
-    std::expected<Stat, Error> readStat(Pid pid);
+    std::expected<Stat, Error> readStat(Pid pid);                 // also fills Stat::ruid
+    std::expected<std::uint64_t, Error> readRuid(Pid pid);        // a single stat() call
     std::expected<std::string, Error> readComm(Pid pid);
     std::expected<std::string, Error> readExePath(Pid pid);
     std::expected<MultiStringZ, Error> readCmdLine(Pid pid);
     std::expected<MultiStringZ, Error> readEnv(Pid pid);
 
+    // the number of open descriptors; zero if the kernel doesn't tell (before 6.2)
+    std::expected<std::size_t, Error> readFdCount(Pid pid);
+    std::expected<std::vector<FdLink>, Error> readFds(Pid pid);
+
+    // 'table' is one of "tcp", "tcp6", "udp", "udp6"; the network namespace is the server's
+    std::expected<std::vector<NetSocket>, Error> readNetSockets(std::string_view table);
+
 private:
-    std::uint64_t getBootTimeImpl();
-    
-    const std::string m_procFsRoot;
-    const std::uint64_t m_bootTime; // seconds
-    const int m_cpusMax;
+    struct DirCloser
+    {
+        void operator()(DIR* d) const noexcept
+        {
+            ::closedir(d);
+        }
+    };
+
+    const char* makePath(Pid pid, std::string_view file) noexcept;
+    std::expected<std::string_view, Error> load(const char* path);
+    std::expected<std::string_view, Error> load(Pid pid, PrefetchFile file, std::string_view name);
+    std::optional<unsigned> prefetched(Pid pid, PrefetchFile file) const noexcept;
+
+    const ProcFsRootPtr m_root;
+    char m_path[64];                           // "<pid>/<file>" relative to the root fd
+    std::vector<char> m_buffer;                // reused by every read; grows to the largest file seen
+    std::unique_ptr<DIR, DirCloser> m_dir;     // opened lazily, rewound for each enumeration
     std::size_t m_pidCountMax = 0;
+    std::unique_ptr<UringReader> m_uring;
+    std::unordered_map<std::uint64_t, unsigned> m_prefetched;   // (pid, file) -> slot
 };
 
 } // namespace Er::ProcessTree::Linux {}
\ No newline at end of file
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <erebus/proctree/server/linux/procfs.hxx>
+#include <erebus/proctree/socket.hxx>
+#include <erebus/rtl/log.hxx>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <boost/noncopyable.hpp>
+
+
+namespace Er::ProcessTree::Linux
+{
+
+//
+// Maps the sockets in /proc/net/{tcp,tcp6,udp,udp6} to the (pid, fd) pairs holding them.
+//
+// The socket tables are reread on every refresh, but the fd directories only of the
+// processes that are new or whose descriptor count has changed. Processes that have
+// swapped one socket for another are caught by a full pass every 'resync' interval, or
+// sooner if the kernel doesn't report descriptor counts and an unknown socket shows up.
+//
+
+class ER_PROCTREE_EXPORT SocketIndex final
+    : public boost::noncopyable
+{
+public:
+    struct Options
+    {
+        std::chrono::milliseconds interval{ 1000 };           // zero means 'only when refresh() is called'
+        std::chrono::seconds resync{ 30 };
+    };
+
+    ~SocketIndex();
+
+    SocketIndex(ProcFsRootPtr procFsRoot, const Options& options, Log::ILogger* log);
+
+    // called on the indexer thread; must not be called concurrently with itself
+    void refresh();
+
+    // InvalidInput if the query has an address that doesn't parse
+    std::expected<std::vector<SocketInfo>, Error> find(const SocketQuery& query) const;
+
+private:
+    using Address = std::array<std::uint8_t, 16>;
+
+    struct AddressHash
+    {
+        std::size_t operator()(const Address& a) const noexcept;
+    };
+
+    struct Socket
+    {
+        ProcFs::NetSocket net;
+        SocketProtocol protocol;
+        bool ipv6;
+    };
+
+    struct Tables
+    {
+        std::vector<Socket> sockets;                                        // there are many with inode 0
+        std::unordered_map<std::uint64_t, std::uint32_t> byInode;           // -> sockets
+        std::unordered_multimap<std::uint16_t, std::uint32_t> byLocalPort;
+        std::unordered_multimap<std::uint16_t, std::uint32_t> byRemotePort;   // connected sockets only
+        std::unordered_multimap<Address, std::uint32_t, AddressHash> byRemote;
+    };
+
+    struct ProcessSocket
+    {
+        std::int32_t fd;
+        std::uint64_t inode;
+    };
+
+    struct Process
+    {
+        std::size_t fdCount = 0;
+        std::vector<ProcessSocket> sockets;
+        std::uint64_t generation = 0;
+    };
+
+    void run(std::stop_token stop);
+    Tables readTables();
+    void dropOwners(Pid pid, const Process& process);
+    void addOwners(Pid pid, const Process& process);
+    SocketInfo describe(const Socket& socket) const;
+
+    Log::ILogger* const m_log;
+    const Options m_options;
+    ProcFs m_procFs;                                                        // used by refresh() only
+    std::uint64_t m_generation = 0;
+    std::chrono::steady_clock::time_point m_lastResync;
+    std::unordered_set<std::uint64_t> m_unowned;                            // sockets nobody could be found for; used by refresh() only
+    mutable std::shared_mutex m_mutex;
+    Tables m_tables;
+    std::unordered_map<Pid, Process> m_processes;                           // only refresh() modifies it
+    std::unordered_map<std::uint64_t, std::vector<SocketInfo::Owner>> m_owners;
+    std::mutex m_sleepMutex;
+    std::condition_variable_any m_sleep;
+    std::jthread m_worker;
+};
+
+
+} // namespace Er::ProcessTree::Linux {}
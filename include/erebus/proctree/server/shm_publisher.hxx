@@ -0,0 +1,72 @@
+#pragma once
+
+#include <erebus/proctree/server/snapshot.hxx>
+#include <erebus/proctree/shm_table.hxx>
+#include <erebus/rtl/log.hxx>
+
+#include <map>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include <boost/noncopyable.hpp>
+
+
+namespace Er::ProcessTree
+{
+
+//
+// Mirrors the scanner's table into a shared memory segment (see shm_table.hxx)
+// so that local readers don't have to go through gRPC.
+//
+// The segment is created anew (any stale one is unlinked) and is marked Closed
+// and unlinked on destruction.
+//
+
+class ER_PROCTREE_EXPORT ShmPublisher final
+    : public boost::noncopyable
+{
+public:
+    struct Options
+    {
+        std::string name = std::string(Shm::DefaultName);
+        std::uint32_t capacity = 32768;                       // processes
+        std::uint64_t arenaSize = 16 * 1024 * 1024;           // bytes of strings
+        ProcessProperties::Mask fields = defaultFields();
+        unsigned mode = 0640;                                 // readers need to be in our group
+    };
+
+    // everything but the environment
+    static ProcessProperties::Mask defaultFields() noexcept;
+
+    ~ShmPublisher();
+    ShmPublisher(Options&& options, Log::ILogger* log);
+
+    const ProcessProperties::Mask& fields() const noexcept
+    {
+        return m_options.fields;
+    }
+
+    // must be called from a single thread (the scanner's)
+    void publish(const SnapshotDelta& delta);
+
+private:
+    using Strings = std::unordered_map<std::string_view, std::uint64_t>;
+
+    void write(Time timestamp);
+    std::uint64_t* column(std::size_t index) noexcept;
+    std::uint64_t cell(const ProcessProperties& props, FieldId field, Strings& strings, bool& truncated);
+
+    Log::ILogger* const m_log;
+    const Options m_options;
+    void* m_base = nullptr;
+    std::size_t m_size = 0;
+    Shm::Header* m_header = nullptr;
+    char* m_arena = nullptr;
+    std::uint64_t m_arenaUsed = 0;
+    std::map<Pid, ProcessProperties> m_table;                 // sorted, as the readers expect
+    bool m_truncated = false;
+};
+
+
+} // namespace Er::ProcessTree {}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <erebus/proctree/process_props.hxx>
+
+#include <vector>
+
+
+namespace Er::ProcessTree
+{
+
+//
+// What changed in the process table between two consecutive scans
+//
+
+struct ProcessChange
+{
+    const ProcessProperties* props = nullptr;   // owned by the scanner; valid while the delta is being delivered
+    ProcessProperties::Mask fields;             // fields that differ from the previous scan
+    bool added = false;                         // a new process
+};
+
+struct SnapshotDelta
+{
+    Time timestamp;
+    std::vector<ProcessChange> changed;
+    std::vector<Pid> removed;
+
+    bool empty() const noexcept
+    {
+        return changed.empty() && removed.empty();
+    }
+};
+
+
+} // namespace Er::ProcessTree {}
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <erebus/proctree/server/snapshot.hxx>
+#include <erebus/rtl/error.hxx>
+#include <erebus/rtl/log.hxx>
+#include <erebus/rtl/util/generic_handle.hxx>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <expected>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+
+namespace Er::ProcessTree
+{
+
+//
+// Records the scanner deltas into a rotating set of append-only files so that
+// the process table can be reconstructed for any moment in the past.
+//
+// Every file starts with a keyframe (the whole table) and more keyframes follow
+// periodically; in between there are only the fields that have changed. Numbers
+// are varints, counters are stored as differences against the previous value,
+// strings (comm, exe, command lines etc) are interned: a string is written once
+// after each keyframe and referred to by its index afterwards.
+//
+// record() only encodes the delta; writing, fsync() and rotation happen
+// on a background thread.
+//
+
+class ER_PROCTREE_EXPORT SnapshotRecorder final
+    : public boost::noncopyable
+{
+public:
+    struct Options
+    {
+        std::string directory;
+        ProcessProperties::Mask fields = defaultFields();
+        std::uint64_t maxFileSize = 256 * 1024 * 1024;        // a new file starts with the next keyframe
+        unsigned maxFiles = 16;                               // the oldest file is deleted beyond that
+        std::chrono::seconds keyframeInterval{ 300 };
+        std::chrono::seconds fsyncInterval{ 10 };
+    };
+
+    struct Snapshot
+    {
+        Time timestamp;                                       // of the last record applied
+        std::vector<ProcessProperties> processes;
+    };
+
+    // everything but the environment and the CPU usage (which can be derived from the times)
+    static ProcessProperties::Mask defaultFields() noexcept;
+
+    // flushes and syncs whatever has been recorded
+    ~SnapshotRecorder();
+
+    SnapshotRecorder(Options&& options, Log::ILogger* log);
+
+    const ProcessProperties::Mask& fields() const noexcept
+    {
+        return m_options.fields;
+    }
+
+    // must be called from a single thread (the scanner's)
+    void record(const SnapshotDelta& delta);
+
+    // the table as it was at 'at' (only the recorded fields are valid);
+    // nullopt if nothing had been recorded by then
+    std::expected<std::optional<Snapshot>, Error> replay(Time at);
+
+    // writes out the records queued so far
+    void flush();
+
+private:
+    enum class RecordType : std::uint8_t
+    {
+        Keyframe = 1,
+        Delta = 2
+    };
+
+    struct Keyframe
+    {
+        Time timestamp;
+        std::uint64_t file;                                   // file sequence number
+        std::uint64_t offset;
+    };
+
+    struct Record
+    {
+        RecordType type;
+        Time timestamp;
+        std::string payload;
+    };
+
+    std::string fileName(std::uint64_t file) const;
+    void loadIndex();
+    void indexFile(std::uint64_t file);
+    void encodeKeyframe(std::string& out);
+    void encodeDelta(const SnapshotDelta& delta, std::string& out);
+    void run(std::stop_token stop);
+    void write(Record&& r);
+    void writeBuffer();
+    void rotate();
+    void sync();
+
+    Log::ILogger* const m_log;
+    const Options m_options;
+
+    // the scanner thread only
+    std::unordered_map<Pid, ProcessProperties> m_table;       // as it has been recorded
+    std::unordered_map<std::string, std::uint32_t> m_strings; // interned since the last keyframe
+    Time m_lastKeyframe;
+
+    // shared with the writer thread
+    std::atomic<bool> m_keyframeNeeded = false;               // the writer has dropped some records
+    std::mutex m_mutex;
+    std::condition_variable_any m_queued;
+    std::condition_variable_any m_flushed;
+    std::vector<Record> m_queue;
+    std::uint64_t m_pushed = 0;
+    std::uint64_t m_written = 0;
+    std::vector<std::uint64_t> m_files;                       // sequence numbers on disk, oldest first
+    std::vector<Keyframe> m_keyframes;
+
+    // the writer thread only
+    Util::FileHandle m_file;
+    std::uint64_t m_fileSize = 0;
+    std::string m_buffer;
+    std::uint64_t m_currentFile = 0;
+    std::vector<Keyframe> m_unindexed;                        // keyframes still in m_buffer
+    bool m_dirty = false;
+    bool m_dropping = false;                                  // until a keyframe opens a file again
+    std::chrono::steady_clock::time_point m_lastSync;
+
+    std::jthread m_writer;
+};
+
+
+} // namespace Er::ProcessTree {}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <erebus/proctree/process_props.hxx>
+
+#include <atomic>
+#include <bit>
+#include <cstring>
+#include <string_view>
+
+
+namespace Er::ProcessTree::Shm
+{
+
+//
+// The process table the server publishes into a POSIX shared memory segment
+// for readers on the same host.
+//
+// segment: Header | valid column | one column per ProcessProperties field | string arena
+//
+// Every column has 'capacity' 64-bit cells, one per row; rows are sorted by pid.
+// Cells hold integers and times as is, CpuUsage as the bits of a double, and strings
+// (command lines and environments in their raw NUL-separated form) as
+// (arena offset << 32 | length). The valid column has the ProcessProperties::Mask
+// bits of each row.
+//
+// The whole table is rewritten after every scan under a seqlock: 'sequence' is odd
+// while the server is writing; a reader that sees the same even value before and
+// after reading has got a consistent table.
+//
+
+constexpr std::uint64_t Magic = 0x314d48535450'5245; // "ERPTSHM1"
+constexpr std::uint32_t Version = 1;
+constexpr std::string_view DefaultName = "/erebus-proctree";
+
+enum Flags : std::uint32_t
+{
+    Truncated = 0x1,        // more processes or strings than fit; the rest is missing
+    Closed = 0x2            // the server has gone; the segment won't be updated anymore
+};
+
+struct Header
+{
+    // fixed once the segment has been created
+    std::uint64_t magic;
+    std::uint32_t version;
+    std::uint32_t headerSize;
+    std::uint64_t segmentSize;
+    std::uint32_t capacity;
+    std::uint32_t columnCount;          // the valid column + ProcessProperties::FieldCount
+    std::uint64_t columns;              // offset of the valid column; the rest follow it
+    std::uint64_t arena;
+    std::uint64_t arenaSize;
+    std::uint64_t fields;               // ProcessProperties::Mask bits of what is published
+
+    // changes with every update
+    alignas(64) std::uint64_t sequence;
+    std::uint64_t timestamp;
+    std::uint32_t count;
+    std::uint32_t flags;
+    std::uint64_t arenaUsed;
+};
+
+static_assert(std::is_trivially_copyable_v<Header>);
+static_assert(std::atomic_ref<std::uint64_t>::is_always_lock_free);
+
+constexpr std::size_t ValidColumn = 0;
+
+constexpr std::size_t fieldColumn(FieldId field) noexcept
+{
+    return field + 1;
+}
+
+constexpr std::uint64_t stringCell(std::uint32_t offset, std::uint32_t length) noexcept
+{
+    return (std::uint64_t(offset) << 32) | length;
+}
+
+constexpr bool isString(FieldId field) noexcept
+{
+    switch (field)
+    {
+    case ProcessProperties::Comm:
+    case ProcessProperties::CmdLine:
+    case ProcessProperties::Exe:
+    case ProcessProperties::UserName:
+    case ProcessProperties::Env:
+        return true;
+    default:
+        return false;
+    }
+}
+
+constexpr std::size_t segmentSize(std::uint32_t capacity, std::uint64_t arenaSize) noexcept
+{
+    return sizeof(Header) + std::size_t(ProcessProperties::FieldCount + 1) * capacity * sizeof(std::uint64_t) + arenaSize;
+}
+
+
+} // namespace Er::ProcessTree::Shm {}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <erebus/proctree/proctree.hxx>
+
+#include <string>
+#include <vector>
+
+
+namespace Er::ProcessTree
+{
+
+//
+// Internet sockets and the processes holding them
+//
+
+enum class SocketProtocol : std::uint32_t
+{
+    Tcp,
+    Udp
+};
+
+
+struct SocketInfo
+{
+    struct Owner
+    {
+        Pid pid = InvalidPid;
+        std::int32_t fd = -1;
+    };
+
+    SocketProtocol protocol = SocketProtocol::Tcp;
+    bool ipv6 = false;
+    std::string localAddress;           // textual, as inet_ntop() has it
+    std::uint16_t localPort = 0;
+    std::string remoteAddress;
+    std::uint16_t remotePort = 0;
+    std::uint32_t state = 0;            // TCP_ESTABLISHED etc (include/net/tcp_states.h); UDP sockets use them too
+    std::uint32_t uid = 0;
+    std::uint64_t inode = 0;
+    std::vector<Owner> owners;          // empty if the owner is not visible to the server; several after fork()
+};
+
+
+struct SocketQuery
+{
+    enum class By : std::uint32_t
+    {
+        Port,                           // either the local or the remote port
+        Pid,
+        RemoteAddress,                  // an IPv4 address also matches IPv4-mapped IPv6 peers
+        LocalPort,
+        RemotePort
+    };
+
+    By by = By::Port;
+    std::uint16_t port = 0;
+    Pid pid = InvalidPid;
+    std::string address;
+
+    static SocketQuery byPort(std::uint16_t port)
+    {
+        SocketQuery q;
+        q.by = By::Port;
+        q.port = port;
+        return q;
+    }
+
+    static SocketQuery byLocalPort(std::uint16_t port)
+    {
+        SocketQuery q;
+        q.by = By::LocalPort;
+        q.port = port;
+        return q;
+    }
+
+    static SocketQuery byRemotePort(std::uint16_t port)
+    {
+        SocketQuery q;
+        q.by = By::RemotePort;
+        q.port = port;
+        return q;
+    }
+
+    static SocketQuery byPid(Pid pid)
+    {
+        SocketQuery q;
+        q.by = By::Pid;
+        q.pid = pid;
+        return q;
+    }
+
+    static SocketQuery byRemoteAddress(std::string_view address)
+    {
+        SocketQuery q;
+        q.by = By::RemoteAddress;
+        q.address = address;
+        return q;
+    }
+};
+
+
+} // namespace Er::ProcessTree {}
@@ -113,6 +113,30 @@ public:
         return m_bits != o.m_bits;
     }
 
+    FlagsPack& operator|=(const FlagsPack& o) noexcept
+    {
+        m_bits |= o.m_bits;
+        return *this;
+    }
+
+    FlagsPack& operator&=(const FlagsPack& o) noexcept
+    {
+        m_bits &= o.m_bits;
+        return *this;
+    }
+
+    [[nodiscard]] friend FlagsPack operator|(FlagsPack a, const FlagsPack& b) noexcept
+    {
+        a |= b;
+        return a;
+    }
+
+    [[nodiscard]] friend FlagsPack operator&(FlagsPack a, const FlagsPack& b) noexcept
+    {
+        a &= b;
+        return a;
+    }
+
     [[nodiscard]] constexpr std::size_t size() const noexcept
     {
         return Size;
@@ -416,6 +416,32 @@ struct Reflectable
         return difference;
     }
 
+    // unlike update(), fields missing in 'o' are left as they are
+    void merge(Reflectable&& o)
+    {
+        if (&o == this)
+            return;
+
+        auto& flds = fields();
+
+        auto this_ = static_cast<SelfType*>(this);
+        auto that_ = static_cast<SelfType*>(&o);
+
+        for (auto& f : flds)
+        {
+            if (o._valid[f.id])
+            {
+                f.mover(*this_, static_cast<SelfType&&>(*that_));
+
+                _valid.set(f.id);
+                _hashValid = false;
+            }
+        }
+
+        that_->_valid = FieldSet{};
+        that_->_hashValid = false;
+    }
+
     std::string_view name(unsigned id) const noexcept
     {
         ErAssert(id < FieldCount);
@@ -3,7 +3,11 @@
 #include <erebus/rtl/property_bag.hxx>
 #include <erebus/server/server_lib.hxx>
 
+#include <chrono>
 #include <functional>
+#include <memory>
+#include <string>
+#include <vector>
 
 namespace Er
 {
@@ -27,8 +31,89 @@ namespace SystemInfo
 
 using Source = std::function<Property(std::string_view)>;
 
+
+//
+// How long a value produced by a source stays good. Cached values are served without
+// locking; concurrent misses wait for a single call to the source.
+//
+
+struct CachePolicy
+{
+    enum class Mode
+    {
+        Uncached,               // the source is called every time
+        Static,                 // called once, on first use
+        Ttl,                    // called again once the value is older than the interval
+        Background              // called every interval on a background thread, never on the request path;
+                                // the property is missing until the first value lands
+    };
+
+    Mode mode = Mode::Uncached;
+    std::chrono::milliseconds interval = {};
+
+    static constexpr CachePolicy uncached() noexcept
+    {
+        return {};
+    }
+
+    static constexpr CachePolicy computedOnce() noexcept
+    {
+        return { Mode::Static, {} };
+    }
+
+    static constexpr CachePolicy ttl(std::chrono::milliseconds interval) noexcept
+    {
+        return { Mode::Ttl, interval };
+    }
+
+    static constexpr CachePolicy refreshedEvery(std::chrono::milliseconds interval) noexcept
+    {
+        return { Mode::Background, interval };
+    }
+};
+
+
 ER_SERVER_EXPORT [[nodiscard]] PropertyBag get(std::string_view name);
-ER_SERVER_EXPORT void registerSource(std::string_view name, Source&& src);
+ER_SERVER_EXPORT void registerSource(std::string_view name, Source&& src, CachePolicy policy = CachePolicy::uncached());
+
+// waits for the calls to the source that are already in progress
+ER_SERVER_EXPORT void unregisterSource(std::string_view name);
+
+
+namespace Private
+{
+
+struct Entry;
+struct Registry;
+
+} // namespace Private {}
+
+
+//
+// A name pattern resolved against the registered sources once and again only after
+// sources have come or gone; for callers that evaluate the same pattern over and over
+//
+
+class ER_SERVER_EXPORT Query final
+{
+public:
+    explicit Query(std::string_view pattern);
+
+    const std::string& pattern() const noexcept
+    {
+        return m_pattern;
+    }
+
+    // not thread-safe; a Query belongs to a single caller
+    [[nodiscard]] PropertyBag evaluate();
+
+private:
+    void resolve(std::shared_ptr<const Private::Registry>&& registry);
+
+    const std::string m_pattern;
+    std::shared_ptr<const Private::Registry> m_registry;
+    std::vector<std::shared_ptr<Private::Entry>> m_sources;
+};
 
 
 } // namespace SystemInfo {}
@@ -4,11 +4,16 @@
 #include <erebus/rtl/exception.hxx>
 #include <erebus/rtl/util/file.hxx>
 
+#include <optional>
+
 
 namespace Er::Ipc::Grpc
 {
 
-ChannelPtr createChannel(const PropertyMap& parameters)
+namespace
+{
+
+ChannelPtr makeChannel(const PropertyMap& parameters, std::optional<int> poolIndex)
 {
     auto prop = findProperty(parameters, "endpoint", Property::Type::String);
     if (!prop)
@@ -53,6 +58,13 @@ ChannelPtr createChannel(const PropertyMap& parameters)
 
     grpc::ChannelArguments args;
 
+    if (poolIndex)
+    {
+        // channels with identical arguments would share a single connection
+        args.SetInt(GRPC_ARG_USE_LOCAL_SUBCHANNEL_POOL, 1);
+        args.SetInt("erebus.channel_pool_index", *poolIndex);
+    }
+
     if (keepalive)
     {
         args.SetInt(GRPC_ARG_KEEPALIVE_TIME_MS, 20 * 1000);
@@ -76,4 +88,25 @@ ChannelPtr createChannel(const PropertyMap& parameters)
     }
 }
 
+} // namespace {}
+
+
+ChannelPtr createChannel(const PropertyMap& parameters)
+{
+    return makeChannel(parameters, std::nullopt);
+}
+
+ChannelPoolPtr createChannelPool(const PropertyMap& parameters, std::size_t count)
+{
+    if (!count)
+        throw Exception(std::source_location::current(), Error(Result::InvalidInput, GenericError), Exception::Message("Channel pool cannot be empty"));
+
+    std::vector<ChannelPtr> channels;
+    channels.reserve(count);
+    for (std::size_t i = 0; i < count; ++i)
+        channels.push_back(makeChannel(parameters, static_cast<int>(i)));
+
+    return std::make_shared<ChannelPool>(std::move(channels));
+}
+
 } // namespace Er::Ipc::Grpc {}
\ No newline at end of file
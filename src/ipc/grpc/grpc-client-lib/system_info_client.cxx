@@ -23,11 +23,14 @@ public:
     ~SystemInfoClientImpl()
     {
         ClientTrace2(m_log.get(), "{}.SystemInfoClientImpl::~SystemInfoClientImpl", Er::Format::ptr(this));
+
+        // the calls in flight use our stubs
+        waitRunningContexts();
     }
 
-    SystemInfoClientImpl(ChannelPtr channel, Log::LoggerPtr log)
-        : Base(channel, log)
-        , m_stub(erebus::SystemInfo::NewStub(channel))
+    SystemInfoClientImpl(ChannelPoolPtr pool, Log::LoggerPtr log)
+        : Base(pool, log)
+        , m_stubs(makeStubs<erebus::SystemInfo::Stub, erebus::SystemInfo>())
     {
         ClientTrace2(m_log.get(), "{}.SystemInfoClientImpl::SystemInfoClientImpl", Er::Format::ptr(this));
     }
@@ -38,7 +41,7 @@ public:
 
         auto ctx = std::make_shared<PingContext>(this, m_log.get(), std::move(ping), handler);
 
-        m_stub->async()->Ping(
+        stub(*ctx)->async()->Ping(
             &ctx->grpcContext,
             &ctx->request,
             &ctx->reply,
@@ -52,7 +55,14 @@ public:
     {
         ClientTraceIndent2(m_log.get(), "{}.SystemInfoClientImpl::getSystemInfo(pattern={})", Er::Format::ptr(this), pattern);
 
-        new PropertyStreamReader(this, m_log.get(), m_stub.get(), pattern, handler);
+        new PropertyStreamReader(this, m_log.get(), pattern, handler);
+    }
+
+    void subscribe(const std::string& pattern, std::chrono::milliseconds interval, Er::ReferenceCountedPtr<ISubscriptionCompletion> handler) override
+    {
+        ClientTraceIndent2(m_log.get(), "{}.SystemInfoClientImpl::subscribe(pattern={}, interval={} ms)", Er::Format::ptr(this), pattern, interval.count());
+
+        new SubscriptionReader(this, m_log.get(), pattern, interval, handler);
     }
 
 private:
@@ -78,12 +88,12 @@ private:
 
         Er::ReferenceCountedPtr<IPingCompletion> handler;
         PingMessage ping;
-        erebus::PingMessage request;
-        erebus::PingMessage reply;
+        erebus::PingMessage& request = make<erebus::PingMessage>();
+        erebus::PingMessage& reply = make<erebus::PingMessage>();
     };
 
     struct PropertyStreamReader final
-        : public grpc::ClientReadReactor<erebus::Property>
+        : public grpc::ClientReadReactor<erebus::PropertyChunk>
         , public ContextBase
     {
         ~PropertyStreamReader()
@@ -94,7 +104,6 @@ private:
         PropertyStreamReader(
             SystemInfoClientImpl* owner, 
             Er::Log::ILogger* log,
-            erebus::SystemInfo::Stub* stub,
             const std::string& pattern, 
             Er::ReferenceCountedPtr<ISystemInfoCompletion> handler
         )
@@ -105,7 +114,7 @@ private:
 
             m_request.set_propertynamepattern(pattern);
 
-            stub->async()->GetSystemInfo(&grpcContext, &m_request, this);
+            owner->stub(*this)->async()->GetSystemInfo(&grpcContext, &m_request, this);
             StartRead(&m_reply);
             StartCall();
         }
@@ -122,11 +131,19 @@ private:
 
             try
             {
-                auto prop = unmarshalProperty(m_reply);
-                if (m_handler->onProperty(std::move(prop)) == CallbackResult::Cancel)
+                // the server packs properties into chunks; the handler still gets them one by one
+                for (auto& p : m_reply.properties())
                 {
-                    ErLogWarning2(m_log, "Canceling the request");
-                    grpcContext.TryCancel();
+                    if (m_canceled)
+                        break;
+
+                    auto prop = unmarshalProperty(p);
+                    if (m_handler->onProperty(std::move(prop)) == CallbackResult::Cancel)
+                    {
+                        ErLogWarning2(m_log, "Canceling the request");
+                        m_canceled = true;
+                        grpcContext.TryCancel();
+                    }
                 }
             }
             catch (...)
@@ -147,7 +164,11 @@ private:
 
                 try
                 {
-                    if (!status.ok())
+                    if (status.ok())
+                    {
+                        m_handler->onComplete();
+                    }
+                    else
                     {
                         ErLogError2(m_log, "Stream from terminated with an error: {} ({})", int(status.error_code()), status.error_message());
 
@@ -167,7 +188,113 @@ private:
 
         Er::ReferenceCountedPtr<ISystemInfoCompletion> m_handler;
         erebus::SystemInfoRequest m_request;
-        erebus::Property m_reply;
+        erebus::PropertyChunk m_reply;
+        bool m_canceled = false;
+    };
+
+    struct SubscriptionReader final
+        : public grpc::ClientReadReactor<erebus::PropertyUpdate>
+        , public ContextBase
+    {
+        ~SubscriptionReader()
+        {
+            ClientTrace2(m_log, "{}.SubscriptionReader::~SubscriptionReader()", Er::Format::ptr(this));
+        }
+
+        SubscriptionReader(
+            SystemInfoClientImpl* owner,
+            Er::Log::ILogger* log,
+            const std::string& pattern,
+            std::chrono::milliseconds interval,
+            Er::ReferenceCountedPtr<ISubscriptionCompletion> handler
+        )
+            : ContextBase(owner, log)
+            , m_handler(handler)
+        {
+            ClientTrace2(m_log, "{}.SubscriptionReader::SubscriptionReader()", Er::Format::ptr(this));
+
+            m_request.set_propertynamepattern(pattern);
+            m_request.set_intervalms(static_cast<std::uint32_t>(interval.count()));
+
+            owner->stub(*this)->async()->Subscribe(&grpcContext, &m_request, this);
+            StartRead(&m_reply);
+            StartCall();
+        }
+
+    private:
+        void OnReadDone(bool ok) override
+        {
+            ClientTraceIndent2(m_log, "{}.SubscriptionReader::OnReadDone({})", Er::Format::ptr(this), ok);
+
+            if (!ok)
+                return;
+
+            // the handler has had enough; updates still in flight are only drained
+            if (m_canceled)
+            {
+                StartRead(&m_reply);
+                return;
+            }
+
+            Er::Util::ExceptionLogger xcptLogger(m_log);
+
+            try
+            {
+                PropertyBag changed;
+                changed.reserve(m_reply.properties_size());
+                for (auto& prop : m_reply.properties())
+                    changed.push_back(unmarshalProperty(prop));
+
+                std::vector<std::string> removed(m_reply.removed().begin(), m_reply.removed().end());
+
+                if (m_handler->onUpdate(Time(m_reply.timestamp()), std::move(changed), std::move(removed)) == CallbackResult::Cancel)
+                {
+                    ClientTrace2(m_log, "Canceling the subscription");
+                    m_canceled = true;
+                    grpcContext.TryCancel();
+                }
+            }
+            catch (...)
+            {
+                Er::dispatchException(std::current_exception(), xcptLogger);
+            }
+
+            // we have to drain the completion queue even if we cancel
+            StartRead(&m_reply);
+        }
+
+        void OnDone(const grpc::Status& status) override
+        {
+            {
+                ClientTraceIndent2(m_log, "{}.SubscriptionReader::OnDone({})", Er::Format::ptr(this), int(status.error_code()));
+
+                Er::Util::ExceptionLogger xcptLogger(m_log);
+
+                try
+                {
+                    // canceling is the normal way to unsubscribe, but only when we have done it
+                    if (!status.ok() && !(m_canceled && (status.error_code() == grpc::StatusCode::CANCELLED)))
+                    {
+                        ErLogError2(m_log, "Subscription terminated with an error: {} ({})", int(status.error_code()), status.error_message());
+
+                        m_handler->onError(status);
+                    }
+                }
+                catch (...)
+                {
+                    Er::dispatchException(std::current_exception(), xcptLogger);
+                }
+            }
+
+            m_handler.reset();
+
+            delete this;
+        }
+
+        Er::ReferenceCountedPtr<ISubscriptionCompletion> m_handler;
+        erebus::SystemInfoSubscribeRequest m_request;
+        erebus::PropertyUpdate m_reply;
+        bool m_canceled = false;
     };
 
     void completePing(std::shared_ptr<PingContext> ctx, grpc::Status status)
@@ -201,7 +328,12 @@ private:
         }
     }
 
-    const std::unique_ptr<erebus::SystemInfo::Stub> m_stub;
+    erebus::SystemInfo::Stub* stub(const ContextBase& ctx) const noexcept
+    {
+        return m_stubs[ctx.channel()].get();
+    }
+
+    const std::vector<std::unique_ptr<erebus::SystemInfo::Stub>> m_stubs;
 };
 
 } // namespace {}
@@ -209,7 +341,12 @@ private:
 
 ER_GRPC_CLIENT_EXPORT SystemInfoClientPtr createSystemInfoClient(ChannelPtr channel, Log::LoggerPtr log)
 {
-    return SystemInfoClientPtr{ new SystemInfoClientImpl(channel, log) };
+    return createSystemInfoClient(std::make_shared<ChannelPool>(std::vector<ChannelPtr>{ channel }), log);
+}
+
+ER_GRPC_CLIENT_EXPORT SystemInfoClientPtr createSystemInfoClient(ChannelPoolPtr pool, Log::LoggerPtr log)
+{
+    return SystemInfoClientPtr{ new SystemInfoClientImpl(pool, log) };
 }
 
 
@@ -69,10 +69,9 @@ void marshalMap(const Property& source, erebus::Property_object* dest)
     
     for (auto& sourceProp : sourceMap)
     {
-        erebus::Property destProp;
+        // build the value right in the map node; copying a temporary would duplicate the whole subtree
+        auto& destProp = (*destMap)[std::string(sourceProp.first.data(), sourceProp.first.length())];
         marshalProperty(sourceProp.second, destProp);
-
-        destMap->emplace(std::string(sourceProp.first.data(), sourceProp.first.length()), destProp);
     }
 }
 
@@ -94,13 +93,11 @@ void marshalVector(const Property& source, erebus::Property_array* dest)
 {
     auto& sourceVector = *source.getVector();
     auto destVector = dest->mutable_v_vector();
+    destVector->Reserve(static_cast<int>(sourceVector.size()));
 
     for (auto& sourceProp : sourceVector)
     {
-        erebus::Property destProp;
-        marshalProperty(sourceProp, destProp);
-
-        destVector->Add(std::move(destProp));
+        marshalProperty(sourceProp, *destVector->Add());
     }
 }
 
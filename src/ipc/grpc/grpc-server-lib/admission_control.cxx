@@ -0,0 +1,482 @@
+#include "admission_control.hxx"
+#include "trace.hxx"
+
+#include <grpcpp/security/auth_context.h>
+
+#include <erebus/ipc/grpc/server/admission.hxx>
+#include <erebus/rtl/exception.hxx>
+#include <erebus/rtl/format.hxx>
+#include <erebus/server/system_info.hxx>
+
+#include <chrono>
+#include <limits>
+
+
+namespace Er::Ipc::Grpc
+{
+
+namespace
+{
+
+constexpr std::string_view RejectedProperty{ "erebus/admission/rejected" };
+
+const char* const TooManyCalls = "Too many calls in flight";
+const char* const RateExceeded = "Call rate limit exceeded";
+
+std::int64_t steadyNow() noexcept
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+} // namespace {}
+
+
+class AdmissionControl::Interceptor final
+    : public grpc::experimental::Interceptor
+{
+public:
+    ~Interceptor()
+    {
+        if (!m_reason)
+            m_owner->release(m_peer.get(), m_method);
+    }
+
+    Interceptor(AdmissionControl* owner, PeerPtr&& peer, int method, const char* reason) noexcept
+        : m_owner(owner)
+        , m_peer(std::move(peer))
+        , m_method(method)
+        , m_reason(reason)
+    {
+    }
+
+    void Intercept(grpc::experimental::InterceptorBatchMethods* methods) override
+    {
+        if (methods->QueryInterceptionHookPoint(grpc::experimental::InterceptionHookPoints::POST_RECV_INITIAL_METADATA))
+        {
+            // the verdict is ours to give, not the client's
+            grpc::string_ref key(AdmissionMetadataKey.data(), AdmissionMetadataKey.size());
+            auto metadata = methods->GetRecvInitialMetadata();
+            metadata->erase(key);
+
+            if (m_reason)
+                metadata->emplace(key, grpc::string_ref(m_reason));
+        }
+
+        // in case the handler has not looked
+        if (m_reason && methods->QueryInterceptionHookPoint(grpc::experimental::InterceptionHookPoints::PRE_SEND_STATUS))
+            methods->ModifySendStatus(grpc::Status(grpc::StatusCode::RESOURCE_EXHAUSTED, m_reason));
+
+        methods->Proceed();
+    }
+
+private:
+    AdmissionControl* const m_owner;
+    const PeerPtr m_peer;
+    const int m_method;
+    const char* const m_reason;
+};
+
+
+class AdmissionControl::Factory final
+    : public grpc::experimental::ServerInterceptorFactoryInterface
+{
+public:
+    explicit Factory(AdmissionControl* owner) noexcept
+        : m_owner(owner)
+    {
+    }
+
+    grpc::experimental::Interceptor* CreateServerInterceptor(grpc::experimental::ServerRpcInfo* info) override
+    {
+        auto method = m_owner->findMethod(info->method());
+        if ((method < 0) && m_owner->m_peerLimits.empty())
+            return nullptr;
+
+        auto peer = m_owner->findPeer(peerKey(info->server_context()));
+
+        auto reason = m_owner->admit(peer.get(), method, steadyNow());
+        if (reason)
+        {
+            m_owner->m_rejected.fetch_add(1, std::memory_order_relaxed);
+            ServerTrace2(m_owner->m_log, "{} from {} rejected: {}", info->method(), peer->key, reason);
+        }
+
+        return new Interceptor(m_owner, std::move(peer), method, reason);
+    }
+
+private:
+    AdmissionControl* const m_owner;
+};
+
+
+bool AdmissionControl::Bucket::enter(std::uint32_t limit) noexcept
+{
+    if (!limit)
+        return true;
+
+    if (inFlight.fetch_add(1, std::memory_order_relaxed) >= limit)
+    {
+        inFlight.fetch_sub(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    return true;
+}
+
+void AdmissionControl::Bucket::leave(std::uint32_t limit) noexcept
+{
+    if (limit)
+        inFlight.fetch_sub(1, std::memory_order_relaxed);
+}
+
+bool AdmissionControl::Bucket::conforms(const Limits& limits, std::int64_t now) const noexcept
+{
+    if (!limits.rate)
+        return true;
+
+    const std::int64_t interval = 1000000000LL / limits.rate;
+    const std::int64_t tolerance = interval * limits.burst;
+
+    return std::max(tat.load(std::memory_order_relaxed), now) + interval - now <= tolerance;
+}
+
+bool AdmissionControl::Bucket::take(const Limits& limits, std::int64_t now) noexcept
+{
+    if (!limits.rate)
+        return true;
+
+    // GCRA: every call pushes the theoretical arrival time one interval forward;
+    // a call is allowed as long as that stays within 'burst' intervals from now
+    const std::int64_t interval = 1000000000LL / limits.rate;
+    const std::int64_t tolerance = interval * limits.burst;
+
+    auto current = tat.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        auto next = std::max(current, now) + interval;
+        if (next - now > tolerance)
+            return false;
+
+        if (tat.compare_exchange_weak(current, next, std::memory_order_relaxed))
+            return true;
+    }
+}
+
+void AdmissionControl::Bucket::refund(const Limits& limits) noexcept
+{
+    // a TAT that has been in the past before take() comes back as 'now', which admits just the same
+    if (limits.rate)
+        tat.fetch_sub(1000000000LL / limits.rate, std::memory_order_relaxed);
+}
+
+bool AdmissionControl::Bucket::idle(std::int64_t now) const noexcept
+{
+    return (inFlight.load(std::memory_order_relaxed) == 0) && (tat.load(std::memory_order_relaxed) <= now);
+}
+
+
+AdmissionControl::~AdmissionControl()
+{
+    ServerTrace2(m_log, "{}.AdmissionControl::~AdmissionControl()", Er::Format::ptr(this));
+
+    Server::SystemInfo::unregisterSource(RejectedProperty);
+}
+
+AdmissionControl::AdmissionControl(Log::ILogger* log, const Limits& peerLimits, std::vector<Method>&& methods)
+    : m_log(log)
+    , m_peerLimits(peerLimits)
+    , m_methods(std::move(methods))
+    , m_vacated(makePeer({}))
+    , m_overflow(makePeer("*"))
+{
+    ServerTrace2(m_log, "{}.AdmissionControl::AdmissionControl()", Er::Format::ptr(this));
+
+    Server::SystemInfo::registerSource(RejectedProperty, [this](std::string_view name) { return Property(name, m_rejected.load(std::memory_order_relaxed)); });
+}
+
+std::unique_ptr<AdmissionControl> AdmissionControl::create(const PropertyMap& parameters, Log::ILogger* log)
+{
+    auto admission = findProperty(parameters, "admission", Property::Type::Map);
+    if (!admission)
+        return {};
+
+    Limits peerLimits;
+    auto peer = findProperty(*admission->getMap(), "peer", Property::Type::Map);
+    if (peer)
+        peerLimits = parseLimits(*peer->getMap(), "peer");
+
+    std::vector<Method> methods;
+    auto methodMap = findProperty(*admission->getMap(), "methods", Property::Type::Map);
+    if (methodMap)
+    {
+        for (auto& [key, prop] : *methodMap->getMap())
+        {
+            std::string name(key.data(), key.size());
+
+            // ProcessList.GetProcessProps
+            auto dot = name.find('.');
+            if ((dot == std::string::npos) || (dot == 0) || (dot + 1 == name.size()) || (prop.type() != Property::Type::Map))
+                throw Exception(std::source_location::current(), Error(Result::BadConfiguration, GenericError), Exception::Message(Er::format("Invalid admission limits for method '{}'", name)));
+
+            Method m;
+            m.name = name;
+            m.suffix = name;
+            m.suffix[dot] = '/';
+            m.limits = parseLimits(*prop.getMap(), name);
+
+            if (!m.limits.empty())
+                methods.push_back(std::move(m));
+        }
+    }
+
+    if (peerLimits.empty() && methods.empty())
+        return {};
+
+    ErLogInfo2(log, "Admission limits per peer: {} calls/s (burst {}), {} in flight", peerLimits.rate, peerLimits.burst, peerLimits.concurrency);
+    for (auto& m : methods)
+        ErLogInfo2(log, "Admission limits per peer for {}: {} calls/s (burst {}), {} in flight", m.name, m.limits.rate, m.limits.burst, m.limits.concurrency);
+
+    return std::unique_ptr<AdmissionControl>(new AdmissionControl(log, peerLimits, std::move(methods)));
+}
+
+std::unique_ptr<grpc::experimental::ServerInterceptorFactoryInterface> AdmissionControl::makeInterceptorFactory()
+{
+    return std::make_unique<Factory>(this);
+}
+
+AdmissionControl::Limits AdmissionControl::parseLimits(const PropertyMap& map, std::string_view what)
+{
+    Limits limits;
+
+    auto load = [&map, what](std::string_view name, std::uint32_t& value)
+    {
+        auto prop = findProperty(map, name, Property::Type::Int64);
+        if (!prop)
+            return;
+
+        auto v = *prop->getInt64();
+        if ((v < 0) || (v > std::numeric_limits<std::int32_t>::max()))
+            throw Exception(std::source_location::current(), Error(Result::BadConfiguration, GenericError), Exception::Message(Er::format("Invalid admission parameter '{}' for '{}'", name, what)));
+
+        value = static_cast<std::uint32_t>(v);
+    };
+
+    load("rate", limits.rate);
+    load("burst", limits.burst);
+    load("concurrency", limits.concurrency);
+
+    if (limits.rate && !limits.burst)
+        limits.burst = limits.rate;
+
+    return limits;
+}
+
+std::string AdmissionControl::peerKey(grpc::ServerContextBase* context)
+{
+    auto auth = context->auth_context();
+    if (auth && auth->IsPeerAuthenticated())
+    {
+        auto identity = auth->GetPeerIdentity();
+        if (!identity.empty())
+            return Er::format("id:{}", std::string_view(identity.front().data(), identity.front().size()));
+    }
+
+    // ipv4:10.0.0.1:53412 -> ipv4:10.0.0.1
+    auto peer = context->peer();
+    if (peer.starts_with("ipv4:") || peer.starts_with("ipv6:"))
+    {
+        auto colon = peer.rfind(':');
+        if (colon > 4)
+            peer.resize(colon);
+    }
+
+    return peer;
+}
+
+int AdmissionControl::findMethod(const char* name) const noexcept
+{
+    if (!name || m_methods.empty())
+        return -1;
+
+    // /erebus.ProcessList/GetProcessProps
+    std::string_view n(name);
+    for (std::size_t i = 0; i < m_methods.size(); ++i)
+    {
+        auto& suffix = m_methods[i].suffix;
+        if (n.ends_with(suffix) && (n.size() > suffix.size()))
+        {
+            auto c = n[n.size() - suffix.size() - 1];
+            if ((c == '.') || (c == '/'))
+                return static_cast<int>(i);
+        }
+    }
+
+    return -1;
+}
+
+AdmissionControl::PeerPtr AdmissionControl::findPeer(std::string&& key)
+{
+    auto h = std::hash<std::string>{}(key);
+    for (std::size_t i = 0; i < MaxPeers; ++i)
+    {
+        auto p = m_peers[(h + i) % MaxPeers].load(std::memory_order_acquire);
+        if (!p)
+            break;
+
+        if ((p != m_vacated) && (p->key == key))
+            return p;
+    }
+
+    return addPeer(std::move(key));
+}
+
+AdmissionControl::PeerPtr AdmissionControl::addPeer(std::string&& key)
+{
+    std::lock_guard l(m_addMutex);
+
+    auto h = std::hash<std::string>{}(key);
+    for (int attempt = 0; attempt < 2; ++attempt)
+    {
+        // the whole chain has to be looked through since the peer may have been added meanwhile
+        std::atomic<PeerPtr>* free = nullptr;
+        for (std::size_t i = 0; i < MaxPeers; ++i)
+        {
+            auto& slot = m_peers[(h + i) % MaxPeers];
+            auto p = slot.load(std::memory_order_acquire);
+            if (!p)
+            {
+                if (!free)
+                    free = &slot;
+
+                break;
+            }
+
+            if (p == m_vacated)
+            {
+                if (!free)
+                    free = &slot;
+            }
+            else if (p->key == key)
+            {
+                return p;
+            }
+        }
+
+        if (free)
+        {
+            auto peer = makePeer(std::move(key));
+            free->store(peer, std::memory_order_release);
+            return peer;
+        }
+
+        if (!forgetIdlePeers(steadyNow()))
+            break;
+    }
+
+    ErLogWarning2(m_log, "Too many peers; {} shares its admission limits with the rest", key);
+    return m_overflow;
+}
+
+AdmissionControl::PeerPtr AdmissionControl::makePeer(std::string&& key) const
+{
+    auto peer = std::make_shared<Peer>();
+    peer->key = std::move(key);
+
+    if (!m_methods.empty())
+        peer->methods = std::make_unique<Bucket[]>(m_methods.size());
+
+    return peer;
+}
+
+bool AdmissionControl::idle(const Peer& peer, std::int64_t now) const noexcept
+{
+    if (!peer.total.idle(now))
+        return false;
+
+    for (std::size_t i = 0; i < m_methods.size(); ++i)
+    {
+        if (!peer.methods[i].idle(now))
+            return false;
+    }
+
+    return true;
+}
+
+std::size_t AdmissionControl::forgetIdlePeers(std::int64_t now)
+{
+    // called with m_addMutex held
+    std::size_t forgotten = 0;
+    for (auto& slot : m_peers)
+    {
+        auto p = slot.load(std::memory_order_acquire);
+        if (p && (p != m_vacated) && idle(*p, now))
+        {
+            slot.store(m_vacated, std::memory_order_release);
+            ++forgotten;
+        }
+    }
+
+    // vacated slots right before an empty one end no chain, so they can be emptied too
+    for (std::size_t i = 0; i < MaxPeers; ++i)
+    {
+        if (m_peers[i].load(std::memory_order_acquire))
+            continue;
+
+        for (auto j = (i + MaxPeers - 1) % MaxPeers; m_peers[j].load(std::memory_order_acquire) == m_vacated; j = (j + MaxPeers - 1) % MaxPeers)
+            m_peers[j].store(nullptr, std::memory_order_release);
+    }
+
+    ServerTrace2(m_log, "{} idle peers forgotten", forgotten);
+    return forgotten;
+}
+
+const char* AdmissionControl::admit(Peer* peer, int method, std::int64_t now) noexcept
+{
+    auto methodLimits = (method >= 0) ? &m_methods[method].limits : nullptr;
+    auto methodBucket = (method >= 0) ? &peer->methods[method] : nullptr;
+
+    if (!peer->total.enter(m_peerLimits.concurrency))
+        return TooManyCalls;
+
+    if (methodBucket && !methodBucket->enter(methodLimits->concurrency))
+    {
+        peer->total.leave(m_peerLimits.concurrency);
+        return TooManyCalls;
+    }
+
+    // a call rejected by either limit is charged to neither
+    if ((methodBucket && !methodBucket->conforms(*methodLimits, now)) || !peer->total.conforms(m_peerLimits, now))
+    {
+        release(peer, method);
+        return RateExceeded;
+    }
+
+    if (methodBucket && !methodBucket->take(*methodLimits, now))
+    {
+        release(peer, method);
+        return RateExceeded;
+    }
+
+    if (!peer->total.take(m_peerLimits, now))
+    {
+        // another call of the same peer has taken the last token meanwhile
+        if (methodBucket)
+            methodBucket->refund(*methodLimits);
+
+        release(peer, method);
+        return RateExceeded;
+    }
+
+    return nullptr;
+}
+
+void AdmissionControl::release(Peer* peer, int method) noexcept
+{
+    if (method >= 0)
+        peer->methods[method].leave(m_methods[method].limits.concurrency);
+
+    peer->total.leave(m_peerLimits.concurrency);
+}
+
+
+} // namespace Er::Ipc::Grpc {}
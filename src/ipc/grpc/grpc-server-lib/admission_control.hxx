@@ -0,0 +1,128 @@
+#pragma once
+
+#include <grpcpp/support/server_interceptor.h>
+
+#include <erebus/rtl/log.hxx>
+#include <erebus/rtl/property_bag.hxx>
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+
+namespace Er::Ipc::Grpc
+{
+
+//
+// Token bucket rate limits and concurrency caps for every peer, as a whole and per method,
+// enforced by a server interceptor before the call reaches its handler.
+//
+// A peer is the client certificate identity, if any, or the client address without the port,
+// so that several connections from the same client share the limits.
+//
+// Admission takes no lock of its own: a peer is found in an open addressing table of atomic
+// shared pointers, its token bucket is a single atomic 'theoretical arrival time' (GCRA) and its
+// concurrency is an atomic counter. A lock is taken only when a peer shows up. Once the table is
+// full, the peers with nothing in flight and nothing left to pay off are forgotten to make room;
+// the calls still holding on to a forgotten peer finish against it.
+//
+
+class AdmissionControl final
+    : public boost::noncopyable
+{
+public:
+    struct Limits
+    {
+        std::uint32_t rate = 0;                 // calls per second; 0 means unlimited
+        std::uint32_t burst = 0;                // defaults to the rate
+        std::uint32_t concurrency = 0;          // calls in flight; 0 means unlimited
+
+        bool empty() const noexcept
+        {
+            return !rate && !concurrency;
+        }
+    };
+
+    ~AdmissionControl();
+
+    // nullptr if there are no limits configured
+    static std::unique_ptr<AdmissionControl> create(const PropertyMap& parameters, Log::ILogger* log);
+
+    // to be passed to ServerBuilder::experimental().SetInterceptorCreators()
+    std::unique_ptr<grpc::experimental::ServerInterceptorFactoryInterface> makeInterceptorFactory();
+
+    // what the interceptor does for every call; public for the tests
+    struct Peer;
+    using PeerPtr = std::shared_ptr<Peer>;
+
+    static constexpr std::size_t MaxPeers = 1024;   // open addressing table size; the excess peers share one entry
+
+    [[nodiscard]] int findMethod(const char* name) const noexcept;  // -1 if the method has no limits of its own
+    [[nodiscard]] PeerPtr findPeer(std::string&& key);              // added if it's not there yet
+
+    // a reason if rejected; 'now' is ns of the steady clock
+    const char* admit(Peer* peer, int method, std::int64_t now) noexcept;
+
+    // once an admitted call has completed
+    void release(Peer* peer, int method) noexcept;
+
+private:
+
+    struct Method
+    {
+        std::string name;                       // ProcessList.GetProcessProps
+        std::string suffix;                     // ProcessList/GetProcessProps, as gRPC has it after the package name
+        Limits limits;
+    };
+
+    struct alignas(64) Bucket
+    {
+        std::atomic<std::int64_t> tat = 0;      // ns of the steady clock
+        std::atomic<std::uint32_t> inFlight = 0;
+
+        bool enter(std::uint32_t limit) noexcept;
+        void leave(std::uint32_t limit) noexcept;
+        bool conforms(const Limits& limits, std::int64_t now) const noexcept;
+        bool take(const Limits& limits, std::int64_t now) noexcept;
+        void refund(const Limits& limits) noexcept;
+        bool idle(std::int64_t now) const noexcept;
+    };
+
+    class Interceptor;
+    class Factory;
+
+    AdmissionControl(Log::ILogger* log, const Limits& peerLimits, std::vector<Method>&& methods);
+
+    static Limits parseLimits(const PropertyMap& map, std::string_view what);
+    static std::string peerKey(grpc::ServerContextBase* context);
+
+    PeerPtr addPeer(std::string&& key);
+    PeerPtr makePeer(std::string&& key) const;
+    bool idle(const Peer& peer, std::int64_t now) const noexcept;
+    std::size_t forgetIdlePeers(std::int64_t now);
+
+    Log::ILogger* const m_log;
+    const Limits m_peerLimits;
+    const std::vector<Method> m_methods;
+    std::array<std::atomic<PeerPtr>, MaxPeers> m_peers;
+    std::mutex m_addMutex;
+    const PeerPtr m_vacated;                        // marks a slot a peer has been forgotten from
+    const PeerPtr m_overflow;
+    std::atomic<std::uint64_t> m_rejected = 0;
+};
+
+
+struct AdmissionControl::Peer
+{
+    std::string key;
+    Bucket total;
+    std::unique_ptr<Bucket[]> methods;
+};
+
+
+} // namespace Er::Ipc::Grpc {}
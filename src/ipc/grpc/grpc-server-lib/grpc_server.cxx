@@ -1,11 +1,17 @@
+#include <grpcpp/resource_quota.h>
 #include <grpcpp/server.h>
 #include <grpcpp/server_builder.h>
 
+#include "admission_control.hxx"
+#include "rpc_metrics.hxx"
+
 #include <erebus/ipc/grpc/server/grpc_server.hxx>
 #include <erebus/rtl/exception.hxx>
 #include <erebus/rtl/util/file.hxx>
 #include <erebus/rtl/util/unknown_base.hxx>
 
+#include <limits>
+
 
 namespace Er::Ipc::Grpc
 {
@@ -25,7 +31,8 @@ public:
 
         if (m_server)
         {
-            m_server->Shutdown();
+            // give in-flight calls a chance to complete; endless streams get cancelled
+            m_server->Shutdown(std::chrono::system_clock::now() + std::chrono::seconds(5));
             m_server.reset();
         }
 
@@ -47,6 +54,14 @@ public:
         if (keepalive)
             m_keepalive = *keepalive->getBool();
 
+        m_limits = parseLimits(parameters);
+
+        auto metrics = findProperty(parameters, "metrics", Property::Type::Bool);
+        if (!metrics || *metrics->getBool())
+            m_metrics = std::make_unique<RpcMetrics>(m_log.get());
+
+        m_admission = AdmissionControl::create(parameters, m_log.get());
+
         ::grpc_init();
     }
 
@@ -105,11 +120,41 @@ public:
             builder.AddChannelArgument(GRPC_ARG_HTTP2_MAX_PING_STRIKES, 5);
         }
 
+        // one quota for the whole server; it caps the total memory of all calls but doesn't share it
+        // out between clients, which is what admission control is for. It has no thread limit because
+        // SetMaxThreads() only governs the sync server's thread pool, and all of our services are
+        // callback ones running on gRPC's own executor
+        grpc::ResourceQuota quota("erebus_server");
+        quota.Resize(m_limits.memoryQuota);
+        builder.SetResourceQuota(quota);
+
+        builder.AddChannelArgument(GRPC_ARG_MAX_CONCURRENT_STREAMS, m_limits.maxConcurrentStreams);
+        builder.SetMaxReceiveMessageSize(m_limits.maxReceiveMessageSize);
+        builder.SetMaxSendMessageSize(m_limits.maxSendMessageSize);
+
+        ErLogInfo2(m_log.get(), "Server limits: {} MB memory quota, {} concurrent streams per connection, {} KB max request, {} KB max reply",
+            m_limits.memoryQuota / (1024 * 1024), m_limits.maxConcurrentStreams, m_limits.maxReceiveMessageSize / 1024, m_limits.maxSendMessageSize / 1024);
+
         for (auto svc : m_services)
         {
             builder.RegisterService(svc->grpc());
         }
 
+        // metrics go first so that they see the rejected calls, too
+        std::vector<std::unique_ptr<grpc::experimental::ServerInterceptorFactoryInterface>> interceptors;
+        if (m_metrics)
+        {
+            interceptors.push_back(m_metrics->makeInterceptorFactory());
+
+            ErLogInfo2(m_log.get(), "Per-method RPC metrics are published under erebus/rpc/");
+        }
+
+        if (m_admission)
+            interceptors.push_back(m_admission->makeInterceptorFactory());
+
+        if (!interceptors.empty())
+            builder.experimental().SetInterceptorCreators(std::move(interceptors));
+
         // finally assemble the server
         auto server = builder.BuildAndStart();
         if (!server)
@@ -128,6 +173,50 @@ private:
         std::string rootCertificates;
     };
 
+    struct Limits
+    {
+        std::size_t memoryQuota = 1024 * 1024 * 1024;
+        int maxConcurrentStreams = 256;
+        int maxReceiveMessageSize = 4 * 1024 * 1024;            // requests are small
+        int maxSendMessageSize = 64 * 1024 * 1024;              // process lists and system info dumps are not
+    };
+
+    Limits parseLimits(const PropertyMap& parameters) const
+    {
+        Limits limits;
+
+        auto loadInt = [&parameters](std::string_view name, int& value, std::int64_t scale)
+        {
+            auto prop = findProperty(parameters, name, Property::Type::Int64);
+            if (!prop)
+                return;
+
+            auto v = *prop->getInt64();
+            if ((v <= 0) || (v > std::numeric_limits<int>::max() / scale))
+                throw Exception(std::source_location::current(), Error(Result::BadConfiguration, GenericError), Exception::Message(Er::format("Invalid gRPC server parameter '{}'", name)));
+
+            value = static_cast<int>(v * scale);
+        };
+
+        if (findProperty(parameters, "max_threads"))
+            ErLogWarning2(m_log.get(), "gRPC server parameter 'max_threads' is ignored: callback services do not run on a limited thread pool");
+
+        loadInt("max_concurrent_streams", limits.maxConcurrentStreams, 1);
+        loadInt("max_receive_message_kb", limits.maxReceiveMessageSize, 1024);
+        loadInt("max_send_message_kb", limits.maxSendMessageSize, 1024);
+
+        auto quota = findProperty(parameters, "memory_quota_mb", Property::Type::Int64);
+        if (quota)
+        {
+            if (*quota->getInt64() <= 0)
+                throw Exception(std::source_location::current(), Error(Result::BadConfiguration, GenericError), Exception::Message("Invalid gRPC server parameter 'memory_quota_mb'"));
+
+            limits.memoryQuota = static_cast<std::size_t>(*quota->getInt64()) * 1024 * 1024;
+        }
+
+        return limits;
+    }
+
     static std::vector<Endpoint> parseEndpoints(const PropertyMap& parameters)
     {
         auto endpoints = findProperty(parameters, "endpoints", Property::Type::Vector);
@@ -194,6 +283,9 @@ private:
     Log::LoggerPtr m_log;
     std::vector<Endpoint> m_endpoints;
     bool m_keepalive = false;
+    Limits m_limits;
+    std::unique_ptr<RpcMetrics> m_metrics;                      // these two must outlive m_server
+    std::unique_ptr<AdmissionControl> m_admission;
     std::vector<ServicePtr> m_services;
     std::unique_ptr<::grpc::Server> m_server;
 };
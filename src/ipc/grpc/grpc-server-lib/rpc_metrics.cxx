@@ -0,0 +1,308 @@
+#include "rpc_metrics.hxx"
+#include "trace.hxx"
+
+#include <erebus/rtl/format.hxx>
+#include <erebus/rtl/property_format.hxx>
+#include <erebus/server/system_info.hxx>
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+
+namespace Er::Ipc::Grpc
+{
+
+class RpcMetrics::Interceptor final
+    : public grpc::experimental::Interceptor
+{
+public:
+    ~Interceptor()
+    {
+        // the call has ended without a status, i.e., it was cancelled
+        if (!m_done)
+            complete(false);
+    }
+
+    Interceptor(Method* method) noexcept
+        : m_method(method)
+        , m_started(std::chrono::steady_clock::now())
+    {
+        RpcMetrics::shard(*m_method).inFlight.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void Intercept(grpc::experimental::InterceptorBatchMethods* methods) override
+    {
+        if (!m_done && methods->QueryInterceptionHookPoint(grpc::experimental::InterceptionHookPoints::PRE_SEND_STATUS))
+            complete(methods->GetSendStatus().ok());
+
+        methods->Proceed();
+    }
+
+private:
+    void complete(bool ok) noexcept
+    {
+        m_done = true;
+
+        auto us = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - m_started).count());
+
+        auto& s = RpcMetrics::shard(*m_method);
+        s.inFlight.fetch_sub(1, std::memory_order_relaxed);
+        s.calls.fetch_add(1, std::memory_order_relaxed);
+        if (!ok)
+            s.errors.fetch_add(1, std::memory_order_relaxed);
+
+        s.latency[RpcMetrics::bucket(us)].fetch_add(1, std::memory_order_relaxed);
+
+        auto max = s.maxUs.load(std::memory_order_relaxed);
+        while ((us > max) && !s.maxUs.compare_exchange_weak(max, us, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    Method* const m_method;
+    const std::chrono::steady_clock::time_point m_started;
+    bool m_done = false;
+};
+
+
+class RpcMetrics::Factory final
+    : public grpc::experimental::ServerInterceptorFactoryInterface
+{
+public:
+    explicit Factory(RpcMetrics* owner) noexcept
+        : m_owner(owner)
+    {
+    }
+
+    grpc::experimental::Interceptor* CreateServerInterceptor(grpc::experimental::ServerRpcInfo* info) override
+    {
+        auto name = info->method();
+        if (!name)
+            return nullptr;
+
+        auto method = m_owner->find(name);
+        if (!method)
+            method = m_owner->add(name);
+
+        if (!method)
+            return nullptr; // out of table slots; the call goes unaccounted
+
+        return new Interceptor(method);
+    }
+
+private:
+    RpcMetrics* const m_owner;
+};
+
+
+RpcMetrics::~RpcMetrics()
+{
+    ServerTrace2(m_log, "{}.RpcMetrics::~RpcMetrics()", Er::Format::ptr(this));
+
+    for (auto& name : m_sources)
+        Server::SystemInfo::unregisterSource(name);
+}
+
+RpcMetrics::RpcMetrics(Log::ILogger* log)
+    : m_log(log)
+{
+    ServerTrace2(m_log, "{}.RpcMetrics::RpcMetrics()", Er::Format::ptr(this));
+}
+
+std::unique_ptr<grpc::experimental::ServerInterceptorFactoryInterface> RpcMetrics::makeInterceptorFactory()
+{
+    return std::make_unique<Factory>(this);
+}
+
+std::size_t RpcMetrics::bucket(std::uint64_t us) noexcept
+{
+    if (us < SubBuckets)
+        return static_cast<std::size_t>(us);
+
+    unsigned shift = std::bit_width(us) - SubBucketBits;
+    auto top = us >> shift; // [SubBuckets / 2, SubBuckets)
+    return static_cast<std::size_t>(SubBuckets + (shift - 1) * (SubBuckets / 2) + (top - SubBuckets / 2));
+}
+
+std::uint64_t RpcMetrics::bucketUpperBound(std::size_t index) noexcept
+{
+    if (index < SubBuckets)
+        return index;
+
+    auto k = index - SubBuckets;
+    unsigned shift = static_cast<unsigned>(k / (SubBuckets / 2)) + 1;
+    auto top = (k % (SubBuckets / 2)) + SubBuckets / 2;
+    return ((top + 1) << shift) - 1;
+}
+
+RpcMetrics::Shard& RpcMetrics::shard(Method& m) noexcept
+{
+    // threads are spread over the shards once and for all
+    static std::atomic<unsigned> next = 0;
+    thread_local unsigned index = next.fetch_add(1, std::memory_order_relaxed) % Shards;
+
+    return m.shards[index];
+}
+
+RpcMetrics::Method* RpcMetrics::find(std::string_view key) noexcept
+{
+    auto h = std::hash<std::string_view>{}(key);
+    for (std::size_t i = 0; i < MaxMethods; ++i)
+    {
+        auto m = m_table[(h + i) % MaxMethods].load(std::memory_order_acquire);
+        if (!m)
+            return nullptr;
+
+        if (m->key == key)
+            return m;
+    }
+
+    return nullptr;
+}
+
+RpcMetrics::Method* RpcMetrics::add(std::string_view key)
+{
+    std::lock_guard l(m_addMutex);
+
+    // someone may have beaten us to it
+    auto h = std::hash<std::string_view>{}(key);
+    for (std::size_t i = 0; i < MaxMethods; ++i)
+    {
+        auto& slot = m_table[(h + i) % MaxMethods];
+        auto m = slot.load(std::memory_order_acquire);
+        if (m)
+        {
+            if (m->key == key)
+                return m;
+
+            continue;
+        }
+
+        auto method = std::make_unique<Method>();
+        method->key = key;
+        method->marks.push_back({ std::chrono::steady_clock::now(), {} });
+
+        // "/erebus.ProcessList/GetProcessProps" -> "erebus/rpc/ProcessList/GetProcessProps/"
+        auto name = key;
+        if (name.starts_with('/'))
+            name.remove_prefix(1);
+
+        auto slash = name.find('/');
+        auto service = name.substr(0, slash);
+        auto rpc = (slash != std::string_view::npos) ? name.substr(slash + 1) : std::string_view{};
+
+        auto dot = service.rfind('.');
+        if (dot != std::string_view::npos)
+            service.remove_prefix(dot + 1);
+
+        method->prefix = Er::format("erebus/rpc/{}/{}/", service, rpc);
+
+        m = method.get();
+        m_methods.push_back(std::move(method));
+        publish(*m);
+
+        slot.store(m, std::memory_order_release);
+
+        ServerTrace2(m_log, "Collecting metrics for {} as {}", key, m->prefix);
+        return m;
+    }
+
+    ErLogWarning2(m_log, "Too many RPC methods, {} goes without metrics", key);
+    return nullptr;
+}
+
+void RpcMetrics::publish(Method& m)
+{
+    auto add = [this, &m](std::string_view stat, auto get)
+    {
+        auto name = m.prefix + std::string(stat);
+        Server::SystemInfo::registerSource(name, [this, method = &m, get](std::string_view name) { return get(name, windowed(*method)); }, Server::SystemInfo::CachePolicy::ttl(SourceTtl));
+        m_sources.push_back(std::move(name));
+    };
+
+    add("count", [](std::string_view name, const Snapshot& s) { return Property(name, s.calls); });
+    add("errors", [](std::string_view name, const Snapshot& s) { return Property(name, s.errors); });
+    add("in_flight", [](std::string_view name, const Snapshot& s) { return Property(name, s.inFlight); });
+    add("p50", [](std::string_view name, const Snapshot& s) { return Property(name, s.percentile(50.0), Semantics::Duration); });
+    add("p90", [](std::string_view name, const Snapshot& s) { return Property(name, s.percentile(90.0), Semantics::Duration); });
+    add("p99", [](std::string_view name, const Snapshot& s) { return Property(name, s.percentile(99.0), Semantics::Duration); });
+    add("p999", [](std::string_view name, const Snapshot& s) { return Property(name, s.percentile(99.9), Semantics::Duration); });
+    add("max", [](std::string_view name, const Snapshot& s) { return Property(name, s.maxUs, Semantics::Duration); });
+}
+
+RpcMetrics::Snapshot RpcMetrics::snapshot(const Method& m) const noexcept
+{
+    // shards are read one by one, so the result is only roughly consistent; good enough for a gauge
+    Snapshot result;
+    for (auto& s : m.shards)
+    {
+        result.calls += s.calls.load(std::memory_order_relaxed);
+        result.errors += s.errors.load(std::memory_order_relaxed);
+        result.inFlight += s.inFlight.load(std::memory_order_relaxed);
+        result.maxUs = std::max(result.maxUs, s.maxUs.load(std::memory_order_relaxed));
+
+        for (std::size_t i = 0; i < Buckets; ++i)
+            result.latency[i] += s.latency[i].load(std::memory_order_relaxed);
+    }
+
+    return result;
+}
+
+RpcMetrics::Snapshot RpcMetrics::windowed(Method& m) const
+{
+    // taken under the lock, so that no mark is newer than the snapshot it's subtracted from
+    std::lock_guard l(m.windowMutex);
+
+    auto result = snapshot(m);
+    auto now = std::chrono::steady_clock::now();
+
+    auto& marks = m.marks;
+    if (now - marks.back().at >= WindowSlice)
+        marks.push_back({ now, result.latency });
+
+    // the newest mark that is a window old is where the window starts; the ones before it are of no use
+    while ((marks.size() > 1) && (marks[1].at <= now - Window))
+        marks.pop_front();
+
+    auto& start = marks.front().latency;
+    std::uint64_t maxUs = 0;
+    for (std::size_t i = 0; i < Buckets; ++i)
+    {
+        result.latency[i] -= start[i];
+        if (result.latency[i])
+            maxUs = bucketUpperBound(i);
+    }
+
+    // only the bucket is known for the window; the exact all-time max caps it
+    result.maxUs = std::min(maxUs, result.maxUs);
+
+    return result;
+}
+
+std::uint64_t RpcMetrics::Snapshot::percentile(double p) const noexcept
+{
+    std::uint64_t total = 0;
+    for (auto c : latency)
+        total += c;
+
+    if (!total)
+        return 0;
+
+    auto target = static_cast<std::uint64_t>(std::ceil(p / 100.0 * double(total)));
+    target = std::clamp<std::uint64_t>(target, 1, total);
+
+    // the upper bound of the bucket, so never optimistic
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < Buckets; ++i)
+    {
+        seen += latency[i];
+        if (seen >= target)
+            return std::min(bucketUpperBound(i), maxUs);
+    }
+
+    return maxUs;
+}
+
+
+} // namespace Er::Ipc::Grpc {}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <grpcpp/support/server_interceptor.h>
+
+#include <erebus/rtl/log.hxx>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+
+namespace Er::Ipc::Grpc
+{
+
+//
+// Per-method call counts, errors, in-flight gauges and latency histograms, collected by a
+// server interceptor and published as SystemInfo properties erebus/rpc/<service>/<method>/<stat>.
+//
+// Every counter is split into per-thread shards so that recording is a few relaxed atomic
+// increments on a cache line nobody else is likely to touch; the shards are summed on read.
+// Call and error counts are cumulative since the server start. Latency percentiles and the max
+// cover roughly the last minute: the cumulative histograms are marked as they are read, at most
+// once a slice, and the window is the difference from the newest mark that is a minute old.
+//
+
+class RpcMetrics final
+    : public boost::noncopyable
+{
+public:
+    ~RpcMetrics();
+    explicit RpcMetrics(Log::ILogger* log);
+
+    // to be passed to ServerBuilder::experimental().SetInterceptorCreators()
+    std::unique_ptr<grpc::experimental::ServerInterceptorFactoryInterface> makeInterceptorFactory();
+
+private:
+    static constexpr std::size_t Shards = 16;
+    static constexpr unsigned SubBucketBits = 3;                            // ~12% wide buckets
+    static constexpr std::size_t SubBuckets = std::size_t(1) << SubBucketBits;
+    static constexpr std::size_t Buckets = SubBuckets + (64 - SubBucketBits) * (SubBuckets / 2);
+    static constexpr std::size_t MaxMethods = 256;                          // open addressing table size
+    static constexpr std::chrono::seconds WindowSlice{ 10 };
+    static constexpr std::chrono::seconds Window{ 60 };
+    static constexpr std::chrono::milliseconds SourceTtl{ 500 };           // every read sums all the shards
+
+    struct alignas(64) Shard
+    {
+        std::atomic<std::uint64_t> calls = 0;
+        std::atomic<std::uint64_t> errors = 0;
+        std::atomic<std::int64_t> inFlight = 0;                             // the sum over the shards is what counts
+        std::atomic<std::uint64_t> maxUs = 0;
+        std::array<std::atomic<std::uint64_t>, Buckets> latency = {};
+    };
+
+    struct Mark
+    {
+        std::chrono::steady_clock::time_point at;
+        std::array<std::uint64_t, Buckets> latency;
+    };
+
+    struct Method
+    {
+        std::string key;                                                    // /erebus.ProcessList/GetProcessProps
+        std::string prefix;                                                 // erebus/rpc/<service>/<method>/
+        std::array<Shard, Shards> shards;
+        std::mutex windowMutex;
+        std::deque<Mark> marks;                                             // oldest first; never empty
+    };
+
+    struct Snapshot
+    {
+        std::uint64_t calls = 0;
+        std::uint64_t errors = 0;
+        std::int64_t inFlight = 0;
+        std::uint64_t maxUs = 0;
+        std::array<std::uint64_t, Buckets> latency = {};
+
+        std::uint64_t percentile(double p) const noexcept;
+    };
+
+    class Interceptor;
+    class Factory;
+
+    static std::size_t bucket(std::uint64_t us) noexcept;
+    static std::uint64_t bucketUpperBound(std::size_t index) noexcept;
+    static Shard& shard(Method& m) noexcept;
+
+    Method* find(std::string_view key) noexcept;
+    Method* add(std::string_view key);
+    void publish(Method& m);
+    Snapshot snapshot(const Method& m) const noexcept;
+    Snapshot windowed(Method& m) const;
+
+    Log::ILogger* const m_log;
+    std::array<std::atomic<Method*>, MaxMethods> m_table = {};
+    std::mutex m_addMutex;
+    std::vector<std::unique_ptr<Method>> m_methods;
+    std::vector<std::string> m_sources;
+};
+
+
+} // namespace Er::Ipc::Grpc {}
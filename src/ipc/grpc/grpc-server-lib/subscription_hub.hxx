@@ -0,0 +1,272 @@
+#pragma once
+
+#include <erebus/rtl/log.hxx>
+#include <erebus/rtl/property_bag.hxx>
+#include <erebus/rtl/system/thread.hxx>
+#include <erebus/rtl/util/exception_util.hxx>
+#include <erebus/server/system_info.hxx>
+
+#include "trace.hxx"
+
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+
+namespace Er::Ipc::Grpc
+{
+
+//
+// Every distinct (pattern, interval) pair is evaluated once per interval on a single thread,
+// however many subscribers share it; only the properties that have changed or gone get pushed.
+// The sources are called with the hub unlocked, so a slow one holds up neither subscribing
+// nor unsubscribing
+//
+
+class SubscriptionHub final
+    : public boost::noncopyable
+{
+public:
+    struct ISubscriber
+    {
+        // called with the hub locked; must not block
+        virtual void push(Time timestamp, const PropertyBag& changed, const std::vector<std::string>& removed) = 0;
+
+    protected:
+        virtual ~ISubscriber() = default;
+    };
+
+    ~SubscriptionHub()
+    {
+        m_worker.request_stop();
+        m_worker.join();
+    }
+
+    SubscriptionHub(Log::LoggerPtr log)
+        : m_log(log)
+        , m_worker([this](std::stop_token stop) { run(stop); })
+    {
+    }
+
+    void subscribe(std::string_view pattern, std::chrono::milliseconds interval, ISubscriber* subscriber)
+    {
+        std::lock_guard l(m_mutex);
+
+        Key key{ std::string(pattern), interval.count() };
+        auto it = m_groups.find(key);
+        if (it == m_groups.end())
+        {
+            ServerTrace2(m_log.get(), "New subscription group [{}] every {} ms", pattern, interval.count());
+
+            it = m_groups.try_emplace(key, std::make_shared<Group>(pattern, interval)).first;
+            m_wakeup.notify_one();
+        }
+        else if (it->second->evaluated)
+        {
+            // catch up with the others
+            auto& group = *it->second;
+            PropertyBag all;
+            all.reserve(group.last.size());
+            for (auto& [_, prop] : group.last)
+                all.push_back(prop);
+
+            subscriber->push(group.timestamp, all, {});
+        }
+
+        it->second->subscribers.push_back(subscriber);
+        m_subscribers.insert({ subscriber, std::move(key) });
+    }
+
+    // blocks while the subscriber is being pushed to
+    void unsubscribe(ISubscriber* subscriber) noexcept
+    {
+        std::lock_guard l(m_mutex);
+
+        auto s = m_subscribers.find(subscriber);
+        if (s == m_subscribers.end())
+            return;
+
+        auto g = m_groups.find(s->second);
+        if (g != m_groups.end())
+        {
+            // a group being evaluated right now lives on until the worker lets it go
+            std::erase(g->second->subscribers, subscriber);
+            if (g->second->subscribers.empty())
+                m_groups.erase(g);
+        }
+
+        m_subscribers.erase(s);
+    }
+
+private:
+    struct Key
+    {
+        std::string pattern;
+        std::chrono::milliseconds::rep interval;
+
+        auto operator<=>(const Key&) const = default;
+    };
+
+    struct Group
+    {
+        Server::SystemInfo::Query query;                                    // the worker's own; used unlocked
+        std::chrono::milliseconds interval;
+        std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+        std::map<std::string, Property, std::less<>> last;
+        Time timestamp;
+        bool evaluated = false;
+        std::vector<ISubscriber*> subscribers;
+
+        Group(std::string_view pattern, std::chrono::milliseconds interval)
+            : query(pattern)
+            , interval(interval)
+        {
+        }
+    };
+
+    void run(std::stop_token stop)
+    {
+        System::CurrentThread::setName("sysinfo_subscr");
+
+        std::vector<std::shared_ptr<Group>> due;
+
+        std::unique_lock l(m_mutex);
+        while (!stop.stop_requested())
+        {
+            auto now = std::chrono::steady_clock::now();
+            auto wakeup = std::chrono::steady_clock::time_point::max();
+
+            for (auto& [_, group] : m_groups)
+            {
+                if (group->next <= now)
+                {
+                    due.push_back(group);
+
+                    // skip the ticks we've missed rather than catch up
+                    group->next += group->interval;
+                    if (group->next <= now)
+                        group->next = now + group->interval;
+                }
+
+                wakeup = std::min(wakeup, group->next);
+            }
+
+            if (!due.empty())
+            {
+                for (auto& group : due)
+                {
+                    l.unlock();
+                    auto bag = evaluate(*group);
+                    l.lock();
+
+                    // nobody to publish to if the last subscriber has gone meanwhile
+                    if (bag && !group->subscribers.empty())
+                        publish(*group, std::move(*bag));
+                }
+
+                due.clear();
+
+                // the sources took their time; see what's due now
+                continue;
+            }
+
+            if (wakeup == std::chrono::steady_clock::time_point::max())
+                m_wakeup.wait(l, stop, [this]() { return !m_groups.empty(); });
+            else
+                m_wakeup.wait_until(l, stop, wakeup, []() { return false; });
+        }
+    }
+
+    std::optional<PropertyBag> evaluate(Group& group)
+    {
+        Er::Util::ExceptionLogger xcptHandler(m_log.get());
+        try
+        {
+            return group.query.evaluate();
+        }
+        catch (...)
+        {
+            Er::dispatchException(std::current_exception(), xcptHandler);
+        }
+
+        return std::nullopt;
+    }
+
+    void publish(Group& group, PropertyBag&& bag)
+    {
+        PropertyBag changed;
+        std::unordered_set<std::string_view> seen;
+        bool failed = false;
+        for (auto& prop : bag)
+        {
+            auto name = std::string_view(prop.name());
+            if (name.empty())
+            {
+                // the source has failed; its last value stays
+                failed = true;
+                continue;
+            }
+
+            auto it = group.last.find(name);
+            if (it == group.last.end())
+            {
+                it = group.last.insert({ std::string(name), prop }).first;
+                changed.push_back(std::move(prop));
+            }
+            else if (!(it->second == prop))
+            {
+                it->second = prop;
+                changed.push_back(std::move(prop));
+            }
+
+            seen.insert(std::string_view(it->first));
+        }
+
+        // a failed source can't be told from a removed one, so nothing counts as gone this time
+        std::vector<std::string> removed;
+        if (!failed && (seen.size() < group.last.size()))
+        {
+            for (auto it = group.last.begin(); it != group.last.end();)
+            {
+                if (seen.contains(std::string_view(it->first)))
+                {
+                    ++it;
+                }
+                else
+                {
+                    removed.push_back(it->first);
+                    it = group.last.erase(it);
+                }
+            }
+        }
+
+        group.timestamp = Time(Time::now());
+        group.evaluated = true;
+
+        if (changed.empty() && removed.empty())
+            return;
+
+        for (auto s : group.subscribers)
+            s->push(group.timestamp, changed, removed);
+    }
+
+    Log::LoggerPtr m_log;
+    std::mutex m_mutex;
+    std::condition_variable_any m_wakeup;
+    std::map<Key, std::shared_ptr<Group>> m_groups;
+    std::unordered_map<ISubscriber*, Key> m_subscribers;
+    std::jthread m_worker;
+};
+
+
+} // namespace Er::Ipc::Grpc {}
@@ -1,14 +1,29 @@
 #include <protobuf/system_info.grpc.pb.h>
 
 #include <erebus/ipc/grpc/protocol.hxx>
+#include <erebus/ipc/grpc/server/admission.hxx>
+#include <erebus/ipc/grpc/server/arena_allocator.hxx>
 #include <erebus/ipc/grpc/server/grpc_server.hxx>
 #include <erebus/ipc/grpc/server/iservice.hxx>
 #include <erebus/rtl/util/exception_util.hxx>
 #include <erebus/rtl/util/unknown_base.hxx>
 #include <erebus/server/system_info.hxx>
 
+#include "subscription_hub.hxx"
 #include "trace.hxx"
 
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
 
 namespace Er::Ipc::Grpc
 {
@@ -16,6 +31,10 @@ namespace Er::Ipc::Grpc
 namespace
 {
 
+constexpr std::chrono::milliseconds MinSubscriptionInterval{ 100 };
+constexpr std::chrono::milliseconds MaxSubscriptionInterval{ 24 * 60 * 60 * 1000 };
+
+
 class SystemInfoImpl final
     : public Util::ReferenceCountedBase<Util::ObjectBase<IService>>
     , public erebus::SystemInfo::CallbackService
@@ -30,8 +49,11 @@ public:
 
     SystemInfoImpl(Log::LoggerPtr log)
         : m_log(log)
+        , m_hub(std::make_shared<SubscriptionHub>(log))
     {
         ServerTrace2(m_log.get(), "{}.SystemInfoImpl::SystemInfoImpl", Er::Format::ptr(this));
+
+        SetMessageAllocatorFor_Ping(&m_pingAllocator);
     }
 
     ::grpc::Service* grpc() noexcept override
@@ -44,7 +66,7 @@ public:
         return "SystemInfo";
     }
 
-    grpc::ServerWriteReactor<erebus::Property>* GetSystemInfo(grpc::CallbackServerContext* context, const erebus::SystemInfoRequest* request) override
+    grpc::ServerWriteReactor<erebus::PropertyChunk>* GetSystemInfo(grpc::CallbackServerContext* context, const erebus::SystemInfoRequest* request) override
     {
         ServerTraceIndent2(m_log.get(), "{}.SystemInfoImpl::GetSystemInfo", Er::Format::ptr(this));
 
@@ -56,6 +78,12 @@ public:
             return reactor.release();
         }
 
+        if (auto rejected = admissionRejected(context)) [[unlikely]]
+        {
+            reactor->Finish(*rejected);
+            return reactor.release();
+        }
+
         auto& pattern = request->propertynamepattern();
         ErLogInfo2(m_log.get(), "GetSystemInfo(pattern={}) from {}", pattern, context->peer());
 
@@ -101,6 +129,39 @@ public:
         return reactor.release();
     }
 
+    grpc::ServerWriteReactor<erebus::PropertyUpdate>* Subscribe(grpc::CallbackServerContext* context, const erebus::SystemInfoSubscribeRequest* request) override
+    {
+        ServerTraceIndent2(m_log.get(), "{}.SystemInfoImpl::Subscribe", Er::Format::ptr(this));
+
+        auto reactor = std::make_unique<SubscriptionReactor>(m_log, m_hub);
+        if (context->IsCancelled()) [[unlikely]]
+        {
+            ErLogWarning2(m_log.get(), "Subscribe canceled");
+            reactor->Finish(grpc::Status::CANCELLED);
+            return reactor.release();
+        }
+
+        if (auto rejected = admissionRejected(context)) [[unlikely]]
+        {
+            reactor->Finish(*rejected);
+            return reactor.release();
+        }
+
+        auto& pattern = request->propertynamepattern();
+        std::chrono::milliseconds interval(request->intervalms());
+        ErLogInfo2(m_log.get(), "Subscribe(pattern={}, interval={} ms) from {}", pattern, interval.count(), context->peer());
+
+        if ((interval < MinSubscriptionInterval) || (interval > MaxSubscriptionInterval))
+        {
+            reactor->Finish(grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, Er::format("Interval must be within {}..{} ms", MinSubscriptionInterval.count(), MaxSubscriptionInterval.count())));
+            return reactor.release();
+        }
+
+        // updates arrive on the hub thread
+        reactor->start(pattern, interval);
+        return reactor.release();
+    }
+
 private:
     class PingReplyReactor
         : public grpc::ServerUnaryReactor
@@ -134,7 +195,7 @@ private:
     };
 
     class SystemInfoReplyReactor
-        : public grpc::ServerWriteReactor<erebus::Property>
+        : public grpc::ServerWriteReactor<erebus::PropertyChunk>
     {
     public:
         ~SystemInfoReplyReactor()
@@ -154,17 +215,26 @@ private:
         {
             ServerTraceIndent2(m_log.get(), "{}.SystemInfoReplyReactor::Begin(count={})", Er::Format::ptr(this), reply.size());
 
+            std::lock_guard l(m_mutex);
+
             m_bag = std::move(reply);
             m_next = m_bag.begin();
 
+            fill(m_chunks[m_current]);
             Continue();
         }
 
     private:
+        // a soft limit: a chunk can go over it by a single property
+        static constexpr std::size_t ChunkBudget = 64 * 1024;
+
         void OnWriteDone(bool ok) override
         {
             ServerTraceIndent2(m_log.get(), "{}.SystemInfoReplyReactor::OnWriteDone", Er::Format::ptr(this));
 
+            // wait for the next chunk if it's still being marshaled
+            std::lock_guard l(m_mutex);
+
             if (!ok)
                 Finish(grpc::Status(grpc::StatusCode::CANCELLED, "Operation canceled"));
             else
@@ -183,16 +253,33 @@ private:
             ServerTrace2(m_log.get(), "{}.SystemInfoReplyReactor::OnCancel", Er::Format::ptr(this));
         }
 
+        void fill(erebus::PropertyChunk& chunk)
+        {
+            chunk.Clear();
+
+            std::size_t bytes = 0;
+            while ((m_next != m_bag.end()) && (bytes < ChunkBudget))
+            {
+                auto prop = chunk.add_properties();
+                marshalProperty(*m_next, *prop);
+                ++m_next;
+
+                bytes += prop->ByteSizeLong();
+            }
+        }
+
         void Continue()
         {
             ServerTraceIndent2(m_log.get(), "{}.SystemInfoReplyReactor::Continue", Er::Format::ptr(this));
 
-            if (m_next != m_bag.end())
+            auto& chunk = m_chunks[m_current];
+            if (chunk.properties_size() > 0)
             {
-                marshalProperty(*m_next, m_reply);
-                ++m_next;
+                StartWrite(&chunk);
 
-                StartWrite(&m_reply);
+                // marshal the next chunk while this one is on the wire
+                m_current ^= 1;
+                fill(m_chunks[m_current]);
             }
             else
             {
@@ -202,12 +289,141 @@ private:
         }
 
         Log::LoggerPtr m_log;
+        std::mutex m_mutex;
         PropertyBag m_bag;
         PropertyBag::const_iterator m_next;
-        erebus::Property m_reply;
+        erebus::PropertyChunk m_chunks[2];
+        unsigned m_current = 0;
+    };
+
+    class SubscriptionReactor
+        : public grpc::ServerWriteReactor<erebus::PropertyUpdate>
+        , public SubscriptionHub::ISubscriber
+    {
+    public:
+        ~SubscriptionReactor()
+        {
+            ServerTrace2(m_log.get(), "{}.SubscriptionReactor::~SubscriptionReactor", Er::Format::ptr(this));
+        }
+
+        SubscriptionReactor(Log::LoggerPtr log, std::shared_ptr<SubscriptionHub> hub)
+            : m_log(log)
+            , m_hub(std::move(hub))
+        {
+            ServerTrace2(m_log.get(), "{}.SubscriptionReactor::SubscriptionReactor", Er::Format::ptr(this));
+        }
+
+        void start(std::string_view pattern, std::chrono::milliseconds interval)
+        {
+            m_subscribed = true;
+            m_hub->subscribe(pattern, interval, this);
+        }
+
+        void push(Time timestamp, const PropertyBag& changed, const std::vector<std::string>& removed) override
+        {
+            std::lock_guard l(m_mutex);
+            if (m_finished)
+                return;
+
+            // a slow client gets the latest values rather than a backlog
+            for (auto& prop : changed)
+            {
+                auto name = std::string(std::string_view(prop.name()));
+                m_removed.erase(name);
+                m_pending.insert_or_assign(std::move(name), prop);
+            }
+
+            for (auto& name : removed)
+            {
+                m_pending.erase(name);
+                m_removed.insert(name);
+            }
+
+            m_timestamp = timestamp;
+
+            if (!m_writing)
+                writeNext();
+        }
+
+    private:
+        void writeNext()
+        {
+            if (m_pending.empty() && m_removed.empty())
+                return;
+
+            m_reply.Clear();
+            m_reply.set_timestamp(m_timestamp.value());
+            for (auto& [_, prop] : m_pending)
+                marshalProperty(prop, *m_reply.add_properties());
+
+            for (auto& name : m_removed)
+                m_reply.add_removed(name);
+
+            m_pending.clear();
+            m_removed.clear();
+
+            m_writing = true;
+            StartWrite(&m_reply);
+        }
+
+        void finish(const grpc::Status& status)
+        {
+            if (m_finished)
+                return;
+
+            m_finished = true;
+            m_pending.clear();
+            m_removed.clear();
+            Finish(status);
+        }
+
+        void OnWriteDone(bool ok) override
+        {
+            ServerTraceIndent2(m_log.get(), "{}.SubscriptionReactor::OnWriteDone", Er::Format::ptr(this));
+
+            std::lock_guard l(m_mutex);
+            m_writing = false;
+
+            if (!ok)
+                finish(grpc::Status(grpc::StatusCode::CANCELLED, "Operation canceled"));
+            else if (!m_finished)
+                writeNext();
+        }
+
+        void OnCancel() override
+        {
+            ServerTrace2(m_log.get(), "{}.SubscriptionReactor::OnCancel", Er::Format::ptr(this));
+
+            std::lock_guard l(m_mutex);
+            if (!m_writing)
+                finish(grpc::Status::CANCELLED);
+        }
+
+        void OnDone() override
+        {
+            ServerTraceIndent2(m_log.get(), "{}.SubscriptionReactor::OnDone", Er::Format::ptr(this));
+
+            if (m_subscribed)
+                m_hub->unsubscribe(this);
+
+            delete this;
+        }
+
+        Log::LoggerPtr m_log;
+        std::shared_ptr<SubscriptionHub> m_hub;
+        bool m_subscribed = false;
+        std::mutex m_mutex;
+        std::map<std::string, Property> m_pending;
+        std::set<std::string> m_removed;
+        Time m_timestamp;
+        bool m_writing = false;
+        bool m_finished = false;
+        erebus::PropertyUpdate m_reply;
     };
 
     Log::LoggerPtr m_log;
+    std::shared_ptr<SubscriptionHub> m_hub;
+    ArenaAllocator<erebus::PingMessage, erebus::PingMessage> m_pingAllocator;
 };
 
 
@@ -0,0 +1,165 @@
+#include "common.hpp"
+
+#include "admission_control.hxx"
+
+using namespace Er;
+using namespace Er::Ipc::Grpc;
+
+
+namespace
+{
+
+constexpr std::int64_t Second = 1000000000LL;
+constexpr std::string_view Method{ "/erebus.ProcessList/GetProcessProps" };
+
+
+Property::MapType limits(std::int64_t rate, std::int64_t burst, std::int64_t concurrency)
+{
+    Property::MapType m;
+    if (rate)
+        addProperty(m, Property("rate", rate));
+    if (burst)
+        addProperty(m, Property("burst", burst));
+    if (concurrency)
+        addProperty(m, Property("concurrency", concurrency));
+
+    return m;
+}
+
+std::unique_ptr<AdmissionControl> makeAdmission(const Property::MapType& peer, const Property::MapType& method = {})
+{
+    Property::MapType admission;
+    addProperty(admission, Property("peer", peer));
+
+    if (!method.empty())
+    {
+        Property::MapType methods;
+        addProperty(methods, Property("ProcessList.GetProcessProps", method));
+        addProperty(admission, Property("methods", methods));
+    }
+
+    Property::MapType parameters;
+    addProperty(parameters, Property("admission", admission));
+
+    return AdmissionControl::create(parameters, Log::get());
+}
+
+std::int64_t now() noexcept
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+} // namespace {}
+
+
+TEST(AdmissionControl, burst)
+{
+    auto admission = makeAdmission(limits(10, 5, 0));
+    ASSERT_TRUE(admission);
+
+    auto peer = admission->findPeer("ipv4:10.0.0.1");
+    auto t = now();
+
+    for (int i = 0; i < 5; ++i)
+    {
+        EXPECT_EQ(admission->admit(peer.get(), -1, t), nullptr);
+        admission->release(peer.get(), -1);
+    }
+
+    EXPECT_NE(admission->admit(peer.get(), -1, t), nullptr);
+
+    // somebody else has a bucket of their own
+    auto other = admission->findPeer("ipv4:10.0.0.2");
+    EXPECT_NE(other, peer);
+    EXPECT_EQ(admission->admit(other.get(), -1, t), nullptr);
+    admission->release(other.get(), -1);
+}
+
+TEST(AdmissionControl, steadyRate)
+{
+    auto admission = makeAdmission(limits(10, 1, 0));
+    ASSERT_TRUE(admission);
+
+    auto peer = admission->findPeer("ipv4:10.0.0.1");
+    auto t = now();
+
+    // every 100 ms is fine, any faster is not
+    for (int i = 0; i < 100; ++i)
+    {
+        auto at = t + i * Second / 10;
+        EXPECT_EQ(admission->admit(peer.get(), -1, at), nullptr);
+        admission->release(peer.get(), -1);
+
+        EXPECT_NE(admission->admit(peer.get(), -1, at + Second / 20), nullptr);
+    }
+}
+
+TEST(AdmissionControl, concurrency)
+{
+    auto admission = makeAdmission(limits(0, 0, 2));
+    ASSERT_TRUE(admission);
+
+    auto peer = admission->findPeer("ipv4:10.0.0.1");
+    auto t = now();
+
+    EXPECT_EQ(admission->admit(peer.get(), -1, t), nullptr);
+    EXPECT_EQ(admission->admit(peer.get(), -1, t), nullptr);
+    EXPECT_NE(admission->admit(peer.get(), -1, t), nullptr);
+
+    // a completed call makes room for another one
+    admission->release(peer.get(), -1);
+    EXPECT_EQ(admission->admit(peer.get(), -1, t), nullptr);
+    EXPECT_NE(admission->admit(peer.get(), -1, t), nullptr);
+
+    admission->release(peer.get(), -1);
+    admission->release(peer.get(), -1);
+}
+
+TEST(AdmissionControl, rejectedCallIsNotCharged)
+{
+    // a token every 500 ms for the peer, every second for the method
+    auto admission = makeAdmission(limits(2, 1, 0), limits(1, 1, 0));
+    ASSERT_TRUE(admission);
+
+    auto method = admission->findMethod(Method.data());
+    ASSERT_GE(method, 0);
+    EXPECT_LT(admission->findMethod("/erebus.ProcessList/GetProcessPropsEx"), 0);
+
+    auto peer = admission->findPeer("ipv4:10.0.0.1");
+    auto t = now();
+
+    // the peer's token goes to some other method
+    EXPECT_EQ(admission->admit(peer.get(), -1, t), nullptr);
+    admission->release(peer.get(), -1);
+
+    // so this one is rejected by the peer's limit and must leave the method's token alone
+    EXPECT_NE(admission->admit(peer.get(), method, t), nullptr);
+
+    EXPECT_EQ(admission->admit(peer.get(), method, t + Second / 2), nullptr);
+    admission->release(peer.get(), method);
+}
+
+TEST(AdmissionControl, idlePeersForgotten)
+{
+    auto admission = makeAdmission(limits(0, 0, 1));
+    ASSERT_TRUE(admission);
+
+    // a peer with a call in flight stays
+    auto busy = admission->findPeer("busy");
+    EXPECT_EQ(admission->admit(busy.get(), -1, now()), nullptr);
+
+    for (std::size_t i = 1; i < AdmissionControl::MaxPeers; ++i)
+        EXPECT_EQ(admission->findPeer(Er::format("idle-{}", i))->key, Er::format("idle-{}", i));
+
+    // the table is full now
+    auto late = admission->findPeer("late");
+    EXPECT_EQ(late->key, "late");
+    EXPECT_EQ(admission->findPeer("late"), late);
+    EXPECT_EQ(admission->findPeer("busy"), busy);
+
+    // still holding its concurrency slot
+    EXPECT_NE(admission->admit(busy.get(), -1, now()), nullptr);
+    admission->release(busy.get(), -1);
+    EXPECT_EQ(admission->admit(busy.get(), -1, now()), nullptr);
+    admission->release(busy.get(), -1);
+}
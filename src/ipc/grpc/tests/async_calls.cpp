@@ -0,0 +1,199 @@
+#include "common.hpp"
+
+#include <erebus/ipc/grpc/client/async.hxx>
+
+#include <future>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace Er;
+using namespace Er::Ipc::Grpc;
+
+
+namespace
+{
+
+// replies from threads of its own, the way gRPC does, once the test lets it
+class FakeClient final
+    : public Util::ReferenceCountedBase<Util::ObjectBase<ISystemInfoClient>>
+{
+public:
+    ~FakeClient()
+    {
+        letReply();
+
+        for (auto& t : m_threads)
+            t.join();
+    }
+
+    FakeClient()
+        : m_go(m_release.get_future().share())
+    {
+    }
+
+    void letReply()
+    {
+        if (!m_released)
+        {
+            m_released = true;
+            m_release.set_value();
+        }
+    }
+
+    void ping(PingMessage&& ping, ReferenceCountedPtr<IPingCompletion> handler) override
+    {
+        m_threads.emplace_back([this, ping = std::move(ping), handler]() mutable
+        {
+            m_go.wait();
+            setReplier();
+
+            PingMessage reply{ ping.timestamp, ping.sequence + 1, ping.payload };
+            handler->onReply(std::move(ping), std::move(reply));
+        });
+    }
+
+    void getSystemInfo(const std::string& pattern, ReferenceCountedPtr<ISystemInfoCompletion> handler) override
+    {
+        m_threads.emplace_back([this, pattern, handler]()
+        {
+            m_go.wait();
+            setReplier();
+
+            if (pattern == "fail")
+            {
+                handler->onError(grpc::Status(grpc::StatusCode::UNAVAILABLE, "No server"));
+                return;
+            }
+
+            handler->onProperty(Property("a", std::uint64_t(1)));
+            handler->onProperty(Property("b", std::uint64_t(2)));
+            handler->onComplete();
+        });
+    }
+
+    void subscribe(const std::string&, std::chrono::milliseconds, ReferenceCountedPtr<ISubscriptionCompletion>) override
+    {
+    }
+
+    std::thread::id replier()
+    {
+        std::lock_guard l(m_mutex);
+        return m_replier;
+    }
+
+private:
+    void setReplier()
+    {
+        std::lock_guard l(m_mutex);
+        m_replier = std::this_thread::get_id();
+    }
+
+    std::promise<void> m_release;
+    std::shared_future<void> m_go;
+    bool m_released = false;
+    std::vector<std::thread> m_threads;
+    std::mutex m_mutex;
+    std::thread::id m_replier;
+};
+
+
+// just enough of a coroutine type to await a call
+struct Task
+{
+    struct promise_type
+    {
+        Task get_return_object() noexcept { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept { std::terminate(); }
+    };
+};
+
+struct Fetched
+{
+    PropertyBag bag;
+    std::thread::id resumedOn;
+};
+
+Task fetch(ISystemInfoClient* client, std::promise<Fetched>& done)
+{
+    auto bag = co_await Async::getSystemInfo(client, "*");
+    done.set_value({ std::move(bag), std::this_thread::get_id() });
+}
+
+} // namespace {}
+
+
+TEST(AsyncCall, awaitable)
+{
+    FakeClient client;
+
+    std::promise<Fetched> done;
+    auto f = done.get_future();
+    fetch(&client, done);
+    client.letReply();
+
+    ASSERT_EQ(f.wait_for(std::chrono::seconds(10)), std::future_status::ready);
+    auto result = f.get();
+
+    ASSERT_EQ(result.bag.size(), 2);
+    EXPECT_EQ(std::string_view(result.bag[0].name()), "a");
+    EXPECT_EQ(std::string_view(result.bag[1].name()), "b");
+
+    // resumed right on the thread that has completed the call
+    EXPECT_EQ(result.resumedOn, client.replier());
+    EXPECT_NE(result.resumedOn, std::this_thread::get_id());
+}
+
+TEST(AsyncCall, future)
+{
+    FakeClient client;
+    client.letReply();
+
+    auto reply = Async::ping(&client, ISystemInfoClient::PingMessage{ Time(Time::now()), 41, Binary() }).future();
+    ASSERT_EQ(reply.wait_for(std::chrono::seconds(10)), std::future_status::ready);
+    EXPECT_EQ(reply.get().sequence, 42);
+
+    auto failed = Async::getSystemInfo(&client, "fail").future();
+    ASSERT_EQ(failed.wait_for(std::chrono::seconds(10)), std::future_status::ready);
+    EXPECT_THROW(failed.get(), Exception);
+}
+
+TEST(AsyncCall, executor)
+{
+    FakeClient client;
+
+    std::atomic<int> posted = 0;
+    auto executor = [&posted](std::function<void()>&& f)
+    {
+        ++posted;
+        f();
+    };
+
+    auto bag = Async::getSystemInfo(&client, "*", executor).future();
+    client.letReply();
+
+    ASSERT_EQ(bag.wait_for(std::chrono::seconds(10)), std::future_status::ready);
+    EXPECT_EQ(bag.get().size(), 2);
+    EXPECT_EQ(posted.load(), 1);
+}
+
+TEST(AsyncCall, executorFailure)
+{
+    FakeClient client;
+
+    auto executor = [](std::function<void()>&&)
+    {
+        throw std::runtime_error("Shutting down");
+    };
+
+    auto bag = Async::getSystemInfo(&client, "*", executor).future();
+    client.letReply();
+
+    // the waiter gets the executor's exception instead of the result
+    ASSERT_EQ(bag.wait_for(std::chrono::seconds(10)), std::future_status::ready);
+    EXPECT_THROW(bag.get(), std::runtime_error);
+}
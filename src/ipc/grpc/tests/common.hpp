@@ -0,0 +1,9 @@
+#pragma once
+
+#include <gtest/gtest.h>
+
+
+#include <erebus/rtl/format.hxx>
+#include <erebus/rtl/log.hxx>
+
+#include <iostream>
@@ -0,0 +1,172 @@
+#include "common.hpp"
+
+#include "subscription_hub.hxx"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+using namespace Er;
+using namespace Er::Ipc::Grpc;
+
+
+namespace
+{
+
+constexpr std::string_view CounterName{ "test/hub/counter" };
+constexpr std::chrono::milliseconds Interval{ 20 };
+
+
+// changes every time it's asked
+class CounterSource
+{
+public:
+    ~CounterSource()
+    {
+        Server::SystemInfo::unregisterSource(CounterName);
+    }
+
+    CounterSource()
+    {
+        Server::SystemInfo::registerSource(CounterName, [this](std::string_view name) { return Property(name, ++m_value); });
+    }
+
+private:
+    std::atomic<std::uint64_t> m_value = 0;
+};
+
+
+class Subscriber
+    : public SubscriptionHub::ISubscriber
+{
+public:
+    void push(Time, const PropertyBag& changed, const std::vector<std::string>&) override
+    {
+        {
+            std::lock_guard l(m_mutex);
+            for (auto& prop : changed)
+            {
+                if (std::string_view(prop.name()) == CounterName)
+                    m_last = *prop.getUInt64();
+            }
+
+            ++m_pushes;
+        }
+
+        m_cv.notify_all();
+    }
+
+    // waits for that many pushes in total
+    bool waitFor(std::size_t pushes)
+    {
+        std::unique_lock l(m_mutex);
+        return m_cv.wait_for(l, std::chrono::seconds(10), [this, pushes]() { return m_pushes >= pushes; });
+    }
+
+    std::size_t pushes()
+    {
+        std::lock_guard l(m_mutex);
+        return m_pushes;
+    }
+
+    std::uint64_t last()
+    {
+        std::lock_guard l(m_mutex);
+        return m_last;
+    }
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::size_t m_pushes = 0;
+    std::uint64_t m_last = 0;
+};
+
+
+// takes its time inside push() once told to
+class SlowSubscriber
+    : public Subscriber
+{
+public:
+    void push(Time timestamp, const PropertyBag& changed, const std::vector<std::string>& removed) override
+    {
+        if (m_slow)
+        {
+            m_inside = true;
+            m_inside.notify_all();
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            m_left = std::chrono::steady_clock::now();
+            m_inside = false;
+        }
+
+        Subscriber::push(timestamp, changed, removed);
+    }
+
+    std::atomic<bool> m_slow = false;
+    std::atomic<bool> m_inside = false;
+    std::chrono::steady_clock::time_point m_left;
+};
+
+} // namespace {}
+
+
+TEST(SubscriptionHub, fanOut)
+{
+    CounterSource source;
+    SubscriptionHub hub(Log::global());
+
+    Subscriber a;
+    Subscriber b;
+    hub.subscribe(CounterName, Interval, &a);
+    hub.subscribe(CounterName, Interval, &b);
+
+    // both share a single evaluation
+    ASSERT_TRUE(a.waitFor(3));
+    ASSERT_TRUE(b.waitFor(3));
+
+    // a latecomer gets the current value right away
+    Subscriber c;
+    hub.subscribe(CounterName, Interval, &c);
+    EXPECT_GE(c.pushes(), 1);
+    EXPECT_GT(c.last(), 0);
+
+    ASSERT_TRUE(c.waitFor(3));
+
+    hub.unsubscribe(&a);
+    hub.unsubscribe(&b);
+    hub.unsubscribe(&c);
+
+    // nothing arrives after unsubscribe() has returned
+    auto seen = a.pushes();
+    std::this_thread::sleep_for(Interval * 5);
+    EXPECT_EQ(a.pushes(), seen);
+}
+
+TEST(SubscriptionHub, unsubscribeDuringPush)
+{
+    CounterSource source;
+    SubscriptionHub hub(Log::global());
+
+    SlowSubscriber slow;
+    Subscriber other;
+    hub.subscribe(CounterName, Interval, &slow);
+    hub.subscribe(CounterName, Interval, &other);
+
+    ASSERT_TRUE(slow.waitFor(1));
+    slow.m_slow = true;
+    slow.m_inside.wait(false);
+
+    // waits for the push in progress to complete
+    hub.unsubscribe(&slow);
+    EXPECT_FALSE(slow.m_inside);
+    EXPECT_GE(std::chrono::steady_clock::now(), slow.m_left);
+
+    auto seen = slow.pushes();
+
+    // the rest of the group goes on
+    ASSERT_TRUE(other.waitFor(other.pushes() + 3));
+    EXPECT_EQ(slow.pushes(), seen);
+
+    hub.unsubscribe(&other);
+}
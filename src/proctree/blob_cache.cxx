@@ -0,0 +1,290 @@
+#include <erebus/proctree/blob_cache.hxx>
+
+#include <bit>
+#include <random>
+
+
+namespace Er::ProcessTree
+{
+
+namespace
+{
+
+// SipHash-2-4; anybody can start a process with a command line of their choice,
+// so the hashes must not be predictable enough to collide on purpose
+class SipHash
+{
+public:
+    SipHash()
+    {
+        std::random_device rd;
+        m_k0 = (std::uint64_t(rd()) << 32) | rd();
+        m_k1 = (std::uint64_t(rd()) << 32) | rd();
+    }
+
+    std::uint64_t operator()(std::string_view data) const noexcept
+    {
+        std::uint64_t v0 = m_k0 ^ 0x736f6d6570736575ULL;
+        std::uint64_t v1 = m_k1 ^ 0x646f72616e646f6dULL;
+        std::uint64_t v2 = m_k0 ^ 0x6c7967656e657261ULL;
+        std::uint64_t v3 = m_k1 ^ 0x7465646279746573ULL;
+
+        auto round = [&]()
+        {
+            v0 += v1; v1 = std::rotl(v1, 13); v1 ^= v0; v0 = std::rotl(v0, 32);
+            v2 += v3; v3 = std::rotl(v3, 16); v3 ^= v2;
+            v0 += v3; v3 = std::rotl(v3, 21); v3 ^= v0;
+            v2 += v1; v1 = std::rotl(v1, 17); v1 ^= v2; v2 = std::rotl(v2, 32);
+        };
+
+        auto compress = [&](std::uint64_t m)
+        {
+            v3 ^= m;
+            round();
+            round();
+            v0 ^= m;
+        };
+
+        auto p = data.data();
+        auto size = data.size();
+        for (; size >= 8; p += 8, size -= 8)
+            compress(load(p, 8));
+
+        compress((std::uint64_t(data.size()) << 56) | load(p, size));
+
+        v2 ^= 0xff;
+        round();
+        round();
+        round();
+        round();
+
+        return v0 ^ v1 ^ v2 ^ v3;
+    }
+
+private:
+    // little-endian, whatever the host is
+    static std::uint64_t load(const char* p, std::size_t size) noexcept
+    {
+        std::uint64_t v = 0;
+        for (std::size_t i = 0; i < size; ++i)
+            v |= std::uint64_t(static_cast<unsigned char>(p[i])) << (8 * i);
+
+        return v;
+    }
+
+    std::uint64_t m_k0;
+    std::uint64_t m_k1;
+};
+
+} // namespace {}
+
+
+BlobCache::Hash BlobCache::hash(std::string_view data) noexcept
+{
+    // a key of our own for as long as the server runs
+    static const SipHash h;
+    return h(data);
+}
+
+BlobCache::BlobCache(std::size_t maxBytes)
+    : m_maxBytes(maxBytes)
+{
+}
+
+BlobCache::Data BlobCache::put(Hash hash, std::string_view data)
+{
+    return store(hash, data, false);
+}
+
+BlobCache::Data BlobCache::assign(Hash hash, std::string_view data)
+{
+    return store(hash, data, true);
+}
+
+BlobCache::Data BlobCache::store(Hash hash, std::string_view data, bool replace)
+{
+    std::lock_guard l(m_mutex);
+
+    auto it = m_entries.find(hash);
+    if (it != m_entries.end())
+    {
+        m_lru.splice(m_lru.begin(), m_lru, it->second.lru);
+
+        if (*it->second.data == data)
+            return it->second.data;
+
+        if (!replace)
+            return {};
+
+        m_bytes -= it->second.data->size();
+        it->second.data = std::make_shared<const std::string>(data);
+    }
+    else
+    {
+        m_lru.push_front(hash);
+        it = m_entries.insert({ hash, Entry{ std::make_shared<const std::string>(data), m_lru.begin() } }).first;
+    }
+
+    m_bytes += data.size();
+
+    auto result = it->second.data;
+    evict();
+    return result;
+}
+
+BlobCache::Data BlobCache::find(Hash hash)
+{
+    std::lock_guard l(m_mutex);
+
+    auto it = m_entries.find(hash);
+    if (it == m_entries.end())
+        return {};
+
+    m_lru.splice(m_lru.begin(), m_lru, it->second.lru);
+    return it->second.data;
+}
+
+std::size_t BlobCache::bytes() const noexcept
+{
+    std::lock_guard l(m_mutex);
+    return m_bytes;
+}
+
+void BlobCache::evict()
+{
+    // the newest entry always stays
+    while ((m_bytes > m_maxBytes) && (m_lru.size() > 1))
+    {
+        auto it = m_entries.find(m_lru.back());
+        ErAssert(it != m_entries.end());
+
+        m_bytes -= it->second.data->size();
+        m_entries.erase(it);
+        m_lru.pop_back();
+    }
+}
+
+
+std::optional<BlobCache::Hash> BlobEncoder::reference(const std::string& data, google::protobuf::RepeatedPtrField<erebus::Blob>& blobs)
+{
+    if (data.size() < BlobCache::MinBlobSize)
+        return std::nullopt;
+
+    auto hash = BlobCache::hash(data);
+
+    // the store must have it for as long as anybody refers to it
+    auto stored = m_store->put(hash, data);
+    if (!stored)
+        return std::nullopt; // a collision; let it go inline
+
+    // the client has already got this very blob unless the store has dropped it since, and
+    // maybe taken a different one under the same hash; then it's sent again
+    auto sent = m_sent.find(hash);
+    if (sent != m_sent.end())
+    {
+        if (sent->second.lock() == stored)
+            return hash;
+
+        sent->second = stored;
+    }
+    else
+    {
+        if (m_sent.size() >= MaxSent)
+            m_sent.clear();
+
+        m_sent.insert({ hash, stored });
+    }
+
+    auto blob = blobs.Add();
+    blob->set_hash(hash);
+    blob->set_data(data);
+
+    return hash;
+}
+
+void BlobEncoder::encode(erebus::ProcessProps& props, google::protobuf::RepeatedPtrField<erebus::Blob>& blobs)
+{
+    if (props.has_cmdline())
+    {
+        if (auto hash = reference(props.cmdline(), blobs))
+        {
+            props.clear_cmdline();
+            props.set_cmdlineref(*hash);
+        }
+    }
+
+    if (props.has_exe())
+    {
+        if (auto hash = reference(props.exe(), blobs))
+        {
+            props.clear_exe();
+            props.set_exeref(*hash);
+        }
+    }
+
+    if (props.has_env())
+    {
+        if (auto hash = reference(props.env(), blobs))
+        {
+            props.clear_env();
+            props.set_envref(*hash);
+        }
+    }
+}
+
+
+void storeBlobs(BlobCache& cache, const google::protobuf::RepeatedPtrField<erebus::Blob>& blobs)
+{
+    // whatever we have had under that hash is stale; the server knows better
+    for (auto& b : blobs)
+        cache.assign(b.hash(), b.data());
+}
+
+
+BlobResolver::BlobResolver(BlobCache& cache, const google::protobuf::RepeatedPtrField<erebus::Blob>& attached)
+    : m_cache(cache)
+{
+    m_attached.reserve(attached.size());
+    for (auto& b : attached)
+        m_attached.insert({ b.hash(), &b.data() });
+}
+
+void BlobResolver::resolve(erebus::ProcessProps& props, std::vector<BlobCache::Hash>* missing)
+{
+    auto resolve = [this, missing](bool has, BlobCache::Hash hash, auto set)
+    {
+        if (!has)
+            return false;
+
+        auto attached = m_attached.find(hash);
+        if (attached != m_attached.end())
+        {
+            set(*attached->second);
+            return true;
+        }
+
+        auto data = m_cache.find(hash);
+        if (data)
+        {
+            set(*data);
+            return true;
+        }
+
+        if (missing)
+            missing->push_back(hash);
+
+        return false;
+    };
+
+    if (resolve(props.has_cmdlineref(), props.cmdlineref(), [&props](const std::string& s) { props.set_cmdline(s); }))
+        props.clear_cmdlineref();
+
+    if (resolve(props.has_exeref(), props.exeref(), [&props](const std::string& s) { props.set_exe(s); }))
+        props.clear_exeref();
+
+    if (resolve(props.has_envref(), props.envref(), [&props](const std::string& s) { props.set_env(s); }))
+        props.clear_envref();
+}
+
+
+} // namespace Er::ProcessTree {}
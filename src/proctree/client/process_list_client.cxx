@@ -3,8 +3,19 @@
 #include "../trace.hxx"
 
 #include <erebus/ipc/grpc/client/client_base.hxx>
+#include <erebus/proctree/blob_cache.hxx>
 #include <erebus/proctree/client/iprocess_list_client.hxx>
 #include <erebus/proctree/protocol.hxx>
+#include <erebus/rtl/system/thread.hxx>
+
+#include <condition_variable>
+#include <functional>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <type_traits>
 
 namespace Er::ProcessTree
 {
@@ -21,22 +32,44 @@ public:
     ~ProcessListClientImpl()
     {
         ProctreeTrace2(m_log.get(), "{}.ProcessListClientImpl::~ProcessListClientImpl", Er::Format::ptr(this));
+
+        if (m_flusher.joinable())
+        {
+            m_flusher.request_stop();
+            m_flusher.join();
+        }
+
+        // no new calls from a dying client; whatever has not gone out yet is cancelled
+        cancelPending();
+
+        // the calls in flight use our stubs, the blob cache and the options
+        waitRunningContexts();
     }
 
-    ProcessListClientImpl(Ipc::Grpc::ChannelPtr channel, Log::LoggerPtr log)
-        : Base(channel, log)
-        , m_stub(erebus::ProcessList::NewStub(channel))
+    ProcessListClientImpl(Ipc::Grpc::ChannelPoolPtr pool, Log::LoggerPtr log, const ProcessListClientOptions& options)
+        : Base(pool, log)
+        , m_stubs(makeStubs<erebus::ProcessList::Stub, erebus::ProcessList>())
+        , m_options(options)
     {
         ProctreeTrace2(m_log.get(), "{}.ProcessListClientImpl::ProcessListClientImpl", Er::Format::ptr(this));
+
+        if (m_options.blobCacheSize > 0)
+            m_blobs = std::make_unique<BlobCache>(m_options.blobCacheSize);
+
+        if (batching())
+            m_flusher = std::jthread([this](std::stop_token stop) { runFlusher(stop); });
     }
 
     void getProcessProperties(Pid pid, const ProcessProperties::Mask& required, GetProcessPropsCompletionPtr completion) override
     {
         ProctreeTrace2(m_log.get(), "{}.ProcessListClientImpl::getProcessProperties(pid={})", Er::Format::ptr(this), pid);
 
+        if (batching())
+            return enqueue(pid, required, completion);
+
         auto ctx = std::make_shared<GetProcessPropertiesContext>(this, m_log.get(), pid, required, completion);
         
-        m_stub->async()->GetProcessProps(
+        stub(*ctx)->async()->GetProcessProps(
             &ctx->grpcContext,
             &ctx->request,
             &ctx->reply,
@@ -46,7 +79,371 @@ public:
             });
     }
 
+    void listProcesses(const ProcessProperties::Mask& required, ListProcessesCompletionPtr completion) override
+    {
+        ProctreeTrace2(m_log.get(), "{}.ProcessListClientImpl::listProcesses", Er::Format::ptr(this));
+
+        erebus::ProcessPropsRequest request;
+        marshalProcessPropertyMsk(request, required);
+        request.set_blobs(!!m_blobs);
+
+        auto reader = new ListProcessesReader(this, m_log.get(), std::move(request), completion);
+        stub(*reader)->async()->ListProcesses(&reader->grpcContext, &reader->request, reader);
+        reader->start();
+    }
+
+    void groupBy(GroupKey key, const ProcessProperties::Mask& fields, GroupByCompletionPtr completion) override
+    {
+        ProctreeTrace2(m_log.get(), "{}.ProcessListClientImpl::groupBy(key={})", Er::Format::ptr(this), static_cast<std::uint32_t>(key));
+
+        auto ctx = std::make_shared<GroupByContext>(this, m_log.get(), key, fields, completion);
+
+        stub(*ctx)->async()->GroupBy(
+            &ctx->grpcContext,
+            &ctx->request,
+            &ctx->reply,
+            [this, ctx](grpc::Status status)
+            {
+                completeGroupBy(ctx, status);
+            });
+    }
+
+    void findSockets(const SocketQuery& query, FindSocketsCompletionPtr completion) override
+    {
+        ProctreeTrace2(m_log.get(), "{}.ProcessListClientImpl::findSockets(by={})", Er::Format::ptr(this), static_cast<std::uint32_t>(query.by));
+
+        auto ctx = std::make_shared<FindSocketsContext>(this, m_log.get(), query, completion);
+
+        stub(*ctx)->async()->FindSockets(
+            &ctx->grpcContext,
+            &ctx->request,
+            &ctx->reply,
+            [this, ctx](grpc::Status status)
+            {
+                completeFindSockets(ctx, status);
+            });
+    }
+
+    void findOpenFiles(std::string_view prefix, std::size_t limit, FindOpenFilesCompletionPtr completion) override
+    {
+        ProctreeTrace2(m_log.get(), "{}.ProcessListClientImpl::findOpenFiles({})", Er::Format::ptr(this), prefix);
+
+        auto ctx = std::make_shared<FindOpenFilesContext>(this, m_log.get(), prefix, limit, completion);
+
+        stub(*ctx)->async()->FindOpenFiles(
+            &ctx->grpcContext,
+            &ctx->request,
+            &ctx->reply,
+            [this, ctx](grpc::Status status)
+            {
+                completeFindOpenFiles(ctx, status);
+            });
+    }
+
+    void watchPressure(PressureResourceMask resources, PressureCompletionPtr completion) override
+    {
+        ProctreeTrace2(m_log.get(), "{}.ProcessListClientImpl::watchPressure(resources={:#x})", Er::Format::ptr(this), resources);
+
+        erebus::PressureRequest request;
+        request.set_resources(resources);
+
+        auto reader = new PressureStreamReader(this, m_log.get(), std::move(request), completion);
+        stub(*reader)->async()->WatchPressure(&reader->grpcContext, &reader->request, reader);
+        reader->start();
+    }
+
+    void watchAlerts(const std::vector<std::string>& rules, AlertCompletionPtr completion) override
+    {
+        ProctreeTrace2(m_log.get(), "{}.ProcessListClientImpl::watchAlerts(rules={})", Er::Format::ptr(this), rules.size());
+
+        erebus::AlertRequest request;
+        for (auto& r : rules)
+            request.add_rules(r);
+
+        auto reader = new AlertStreamReader(this, m_log.get(), std::move(request), completion);
+        stub(*reader)->async()->WatchAlerts(&reader->grpcContext, &reader->request, reader);
+        reader->start();
+    }
+
+    void subscribe(const ProcessProperties::Mask& fields, ProcessDeltaCompletionPtr completion) override
+    {
+        ProctreeTrace2(m_log.get(), "{}.ProcessListClientImpl::subscribe", Er::Format::ptr(this));
+
+        erebus::SubscribeRequest request;
+        request.mutable_header()->set_timestamp(Time::now());
+        request.set_fields(packProcessPropertyMask(fields));
+        request.set_blobs(!!m_blobs);
+
+        auto reader = new ProcessDeltaStreamReader(this, m_log.get(), std::move(request), completion);
+        stub(*reader)->async()->Subscribe(&reader->grpcContext, &reader->request, reader);
+        reader->start();
+    }
+
+    void replay(Time at, const ProcessProperties::Mask& fields, ProcessDeltaCompletionPtr completion) override
+    {
+        ProctreeTrace2(m_log.get(), "{}.ProcessListClientImpl::replay", Er::Format::ptr(this));
+
+        erebus::ReplayRequest request;
+        request.mutable_header()->set_timestamp(Time::now());
+        request.set_timestamp(at.value());
+        request.set_fields(packProcessPropertyMask(fields));
+        request.set_blobs(!!m_blobs);
+
+        auto reader = new ReplayStreamReader(this, m_log.get(), std::move(request), completion);
+        stub(*reader)->async()->Replay(&reader->grpcContext, &reader->request, reader);
+        reader->start();
+    }
+
 private:
+    bool batching() const noexcept
+    {
+        return (m_options.batchWindow.count() > 0) && (m_options.maxBatchSize > 1);
+    }
+
+    // puts the strings back into the message and the blobs that came with it into the cache;
+    // the references that can't be resolved go to 'missing'
+    void expandBlobs(erebus::ProcessDelta& msg, std::vector<BlobCache::Hash>* missing)
+    {
+        if (!m_blobs)
+            return;
+
+        BlobResolver resolver(*m_blobs, msg.blobs());
+        for (auto& props : *msg.mutable_changed())
+            resolver.resolve(props, missing);
+
+        if (missing)
+            storeBlobs(*m_blobs, msg.blobs());
+    }
+
+    void expandBlobs(erebus::ProcessPropsReply& msg, std::vector<BlobCache::Hash>* missing)
+    {
+        if (!m_blobs || !msg.has_props())
+            return;
+
+        BlobResolver resolver(*m_blobs, msg.blobs());
+        resolver.resolve(*msg.mutable_props(), missing);
+
+        if (missing)
+            storeBlobs(*m_blobs, msg.blobs());
+    }
+
+    // fetches the blobs that have been evicted from our cache
+    void fetchBlobs(std::vector<BlobCache::Hash>&& hashes, std::function<void()>&& done)
+    {
+        ProctreeTrace2(m_log.get(), "{}.ProcessListClientImpl::fetchBlobs(count={})", Er::Format::ptr(this), hashes.size());
+
+        auto ctx = std::make_shared<BlobContext>(this, m_log.get(), std::move(hashes), std::move(done));
+
+        stub(*ctx)->async()->GetBlobs(
+            &ctx->grpcContext,
+            &ctx->request,
+            &ctx->reply,
+            [this, ctx](grpc::Status status)
+            {
+                completeFetchBlobs(ctx, status);
+            });
+    }
+
+    struct BlobContext
+        : public ContextBase
+    {
+        ~BlobContext()
+        {
+            ProctreeTrace2(m_log, "{}.BlobContext::~BlobContext()", Er::Format::ptr(this));
+        }
+
+        BlobContext(ProcessListClientImpl* owner, Er::Log::ILogger* log, std::vector<BlobCache::Hash>&& hashes, std::function<void()>&& done)
+            : ContextBase(owner, log)
+            , done(std::move(done))
+        {
+            ProctreeTrace2(m_log, "{}.BlobContext::BlobContext()", Er::Format::ptr(this));
+
+            request.mutable_header()->set_timestamp(Time::now());
+            request.mutable_hashes()->Add(hashes.begin(), hashes.end());
+        }
+
+        std::function<void()> done;
+        erebus::BlobRequest& request = make<erebus::BlobRequest>();
+        erebus::BlobReply& reply = make<erebus::BlobReply>();
+    };
+
+    void completeFetchBlobs(std::shared_ptr<BlobContext> ctx, grpc::Status status)
+    {
+        ProctreeTraceIndent2(m_log.get(), "{}.ProcessListClientImpl::completeFetchBlobs", Er::Format::ptr(this));
+
+        if (!status.ok())
+        {
+            ErLogError2(m_log.get(), "GetBlobs() failed for {}: {} ({})", ctx->grpcContext.peer(), int(status.error_code()), status.error_message());
+        }
+        else
+        {
+            if (ctx->reply.blobs_size() < ctx->request.hashes_size())
+                ErLogWarning2(m_log.get(), "The server no longer has {} blob(s); the corresponding fields are left out", ctx->request.hashes_size() - ctx->reply.blobs_size());
+
+            storeBlobs(*m_blobs, ctx->reply.blobs());
+        }
+
+        // the message goes on with whatever could be resolved
+        ctx->done();
+    }
+
+    struct PendingRequest
+    {
+        Pid pid;
+        ProcessProperties::Mask mask;
+        std::vector<GetProcessPropsCompletionPtr> completions; // everyone who asked for the same thing
+    };
+
+    using PendingKey = std::pair<Pid, std::uint64_t>;
+    using PendingBatch = std::vector<PendingRequest>;
+
+    void enqueue(Pid pid, const ProcessProperties::Mask& required, GetProcessPropsCompletionPtr completion)
+    {
+        PendingBatch full;
+
+        {
+            std::lock_guard l(m_batch.mutex);
+
+            PendingKey key{ pid, required.pack<std::uint64_t>() };
+            auto it = m_batch.index.find(key);
+            if (it != m_batch.index.end())
+            {
+                m_batch.requests[it->second].completions.push_back(completion);
+                return;
+            }
+
+            if (m_batch.requests.empty())
+                m_batch.deadline = std::chrono::steady_clock::now() + m_options.batchWindow;
+
+            m_batch.index.insert({ key, m_batch.requests.size() });
+            m_batch.requests.push_back(PendingRequest{ pid, required, { completion } });
+
+            if (m_batch.requests.size() < m_options.maxBatchSize)
+            {
+                if (m_batch.requests.size() == 1)
+                    m_batch.cv.notify_one();
+
+                return;
+            }
+
+            full = takeBatch();
+        }
+
+        sendBatch(std::move(full));
+    }
+
+    PendingBatch takeBatch()
+    {
+        PendingBatch batch;
+        batch.swap(m_batch.requests);
+        m_batch.index.clear();
+        return batch;
+    }
+
+    void cancelPending()
+    {
+        PendingBatch batch;
+        {
+            std::lock_guard l(m_batch.mutex);
+            batch = takeBatch();
+        }
+
+        if (batch.empty())
+            return;
+
+        ProctreeTrace2(m_log.get(), "{}.ProcessListClientImpl::cancelPending(count={})", Er::Format::ptr(this), batch.size());
+
+        Er::Util::ExceptionLogger xcptLogger(m_log.get());
+        grpc::Status status(grpc::StatusCode::CANCELLED, "The client is shutting down");
+
+        for (auto& r : batch)
+        {
+            for (auto& c : r.completions)
+            {
+                try
+                {
+                    c->onError(status);
+                }
+                catch (...)
+                {
+                    Er::dispatchException(std::current_exception(), xcptLogger);
+                }
+            }
+        }
+    }
+
+    void runFlusher(std::stop_token stop)
+    {
+        System::CurrentThread::setName("proctree_batch");
+
+        while (!stop.stop_requested())
+        {
+            PendingBatch batch;
+
+            {
+                std::unique_lock l(m_batch.mutex);
+                if (!m_batch.cv.wait(l, stop, [this]() { return !m_batch.requests.empty(); }))
+                    break;
+
+                // a batch that fills up meanwhile is sent by enqueue() itself
+                auto deadline = m_batch.deadline;
+                m_batch.cv.wait_until(l, stop, deadline, []() { return false; });
+
+                if (m_batch.requests.empty() || (std::chrono::steady_clock::now() < m_batch.deadline))
+                    continue;
+
+                batch = takeBatch();
+            }
+
+            sendBatch(std::move(batch));
+        }
+    }
+
+    void sendBatch(PendingBatch&& batch)
+    {
+        ProctreeTrace2(m_log.get(), "{}.ProcessListClientImpl::sendBatch(count={})", Er::Format::ptr(this), batch.size());
+
+        auto ctx = std::make_shared<BatchContext>(this, m_log.get(), std::move(batch));
+
+        stub(*ctx)->async()->GetProcessPropsBatch(
+            &ctx->grpcContext,
+            &ctx->request,
+            &ctx->reply,
+            [this, ctx](grpc::Status status)
+            {
+                completeBatch(ctx, status);
+            });
+    }
+
+    struct BatchContext
+        : public ContextBase
+    {
+        ~BatchContext()
+        {
+            ProctreeTrace2(m_log, "{}.BatchContext::~BatchContext()", Er::Format::ptr(this));
+        }
+
+        BatchContext(ProcessListClientImpl* owner, Er::Log::ILogger* log, PendingBatch&& batch)
+            : ContextBase(owner, log)
+            , batch(std::move(batch))
+        {
+            ProctreeTrace2(m_log, "{}.BatchContext::BatchContext()", Er::Format::ptr(this));
+
+            request.mutable_header()->set_timestamp(Time::now());
+            request.mutable_requests()->Reserve(static_cast<int>(this->batch.size()));
+            for (auto& r : this->batch)
+            {
+                auto req = request.add_requests();
+                req->set_pid(r.pid);
+                marshalProcessPropertyMsk(*req, r.mask);
+            }
+        }
+
+        PendingBatch batch;
+        erebus::ProcessPropsBatchRequest& request = make<erebus::ProcessPropsBatchRequest>();
+        erebus::ProcessPropsBatchReply& reply = make<erebus::ProcessPropsBatchReply>();
+    };
+
     struct GetProcessPropertiesContext
         : public ContextBase
     {
@@ -72,10 +469,368 @@ private:
         }
 
         Er::ReferenceCountedPtr<IGetProcessPropsCompletion> handler;
+        erebus::ProcessPropsRequest& request = make<erebus::ProcessPropsRequest>();
+        erebus::ProcessPropsReply& reply = make<erebus::ProcessPropsReply>();
+    };
+
+    struct GroupByContext
+        : public ContextBase
+    {
+        ~GroupByContext()
+        {
+            ProctreeTrace2(m_log, "{}.GroupByContext::~GroupByContext()", Er::Format::ptr(this));
+        }
+
+        GroupByContext(
+            ProcessListClientImpl* owner,
+            Er::Log::ILogger* log,
+            GroupKey key,
+            const ProcessProperties::Mask& fields,
+            Er::ReferenceCountedPtr<IGroupByCompletion> handler
+        )
+            : ContextBase(owner, log)
+            , handler(handler)
+        {
+            ProctreeTrace2(m_log, "{}.GroupByContext::GroupByContext()", Er::Format::ptr(this));
+
+            request.mutable_header()->set_timestamp(Time::now());
+            request.set_key(static_cast<std::uint32_t>(key));
+            request.set_fields(packProcessPropertyMask(fields));
+        }
+
+        Er::ReferenceCountedPtr<IGroupByCompletion> handler;
+        erebus::GroupByRequest& request = make<erebus::GroupByRequest>();
+        erebus::GroupByReply& reply = make<erebus::GroupByReply>();
+    };
+
+    struct FindSocketsContext
+        : public ContextBase
+    {
+        ~FindSocketsContext()
+        {
+            ProctreeTrace2(m_log, "{}.FindSocketsContext::~FindSocketsContext()", Er::Format::ptr(this));
+        }
+
+        FindSocketsContext(
+            ProcessListClientImpl* owner,
+            Er::Log::ILogger* log,
+            const SocketQuery& query,
+            Er::ReferenceCountedPtr<IFindSocketsCompletion> handler
+        )
+            : ContextBase(owner, log)
+            , handler(handler)
+        {
+            ProctreeTrace2(m_log, "{}.FindSocketsContext::FindSocketsContext()", Er::Format::ptr(this));
+
+            request.mutable_header()->set_timestamp(Time::now());
+            request.set_by(static_cast<std::uint32_t>(query.by));
+            request.set_port(query.port);
+            request.set_pid(query.pid);
+            request.set_address(query.address);
+        }
+
+        Er::ReferenceCountedPtr<IFindSocketsCompletion> handler;
+        erebus::SocketRequest& request = make<erebus::SocketRequest>();
+        erebus::SocketReply& reply = make<erebus::SocketReply>();
+    };
+
+    struct FindOpenFilesContext
+        : public ContextBase
+    {
+        ~FindOpenFilesContext()
+        {
+            ProctreeTrace2(m_log, "{}.FindOpenFilesContext::~FindOpenFilesContext()", Er::Format::ptr(this));
+        }
+
+        FindOpenFilesContext(
+            ProcessListClientImpl* owner,
+            Er::Log::ILogger* log,
+            std::string_view prefix,
+            std::size_t limit,
+            Er::ReferenceCountedPtr<IFindOpenFilesCompletion> handler
+        )
+            : ContextBase(owner, log)
+            , handler(handler)
+        {
+            ProctreeTrace2(m_log, "{}.FindOpenFilesContext::FindOpenFilesContext()", Er::Format::ptr(this));
+
+            request.mutable_header()->set_timestamp(Time::now());
+            request.set_prefix(std::string(prefix));
+            request.set_limit(static_cast<std::uint32_t>(std::min<std::size_t>(limit, std::numeric_limits<std::uint32_t>::max())));
+        }
+
+        Er::ReferenceCountedPtr<IFindOpenFilesCompletion> handler;
+        erebus::OpenFileRequest& request = make<erebus::OpenFileRequest>();
+        erebus::OpenFileReply& reply = make<erebus::OpenFileReply>();
+    };
+
+    template <typename RequestT, typename MessageT, typename EventT, typename CompletionT, EventT (*Unmarshal)(const MessageT&)>
+    struct EventStreamReader final
+        : public grpc::ClientReadReactor<MessageT>
+        , public IStream
+        , public ContextBase
+    {
+        ~EventStreamReader()
+        {
+            ProctreeTrace2(m_log, "{}.EventStreamReader::~EventStreamReader()", Er::Format::ptr(this));
+        }
+
+        EventStreamReader(
+            ProcessListClientImpl* owner,
+            Er::Log::ILogger* log,
+            RequestT&& request,
+            Er::ReferenceCountedPtr<CompletionT> handler
+        )
+            : ContextBase(owner, log)
+            , request(std::move(request))
+            , m_client(owner)
+            , m_handler(handler)
+        {
+            ProctreeTrace2(m_log, "{}.EventStreamReader::EventStreamReader()", Er::Format::ptr(this));
+        }
+
+        void start()
+        {
+            if constexpr (HasStreamHooks)
+                m_handler->onStreamStarted(this);
+
+            this->StartRead(&m_reply);
+            this->StartCall();
+        }
+
+        void cancel() noexcept override
+        {
+            grpcContext.TryCancel();
+        }
+
+        RequestT request;
+
+    private:
+        static constexpr bool HasStreamHooks = std::is_base_of_v<IProcessDeltaCompletion, CompletionT>;
+
+        void OnReadDone(bool ok) override
+        {
+            ProctreeTraceIndent2(m_log, "{}.EventStreamReader::OnReadDone({})", Er::Format::ptr(this), ok);
+
+            if (!ok)
+                return;
+
+            if constexpr (std::is_same_v<MessageT, erebus::ProcessDelta>)
+            {
+                std::vector<BlobCache::Hash> missing;
+                m_client->expandBlobs(m_reply, &missing);
+
+                if (!missing.empty())
+                {
+                    // the next read waits for the blobs, so the events stay in order
+                    this->AddHold();
+                    m_client->fetchBlobs(std::move(missing), [this]()
+                    {
+                        m_client->expandBlobs(m_reply, nullptr);
+                        deliver();
+                        this->RemoveHold();
+                    });
+
+                    return;
+                }
+            }
+
+            deliver();
+        }
+
+        void deliver()
+        {
+            Er::Util::ExceptionLogger xcptLogger(m_log);
+
+            try
+            {
+                if (m_handler->onEvent(Unmarshal(m_reply)) == CallbackResult::Cancel)
+                {
+                    ErLogDebug2(m_log, "Canceling the event stream");
+                    grpcContext.TryCancel();
+                }
+            }
+            catch (...)
+            {
+                Er::dispatchException(std::current_exception(), xcptLogger);
+            }
+
+            // we have to drain the completion queue even if we cancel
+            this->StartRead(&m_reply);
+        }
+
+        void OnDone(const grpc::Status& status) override
+        {
+            {
+                ProctreeTraceIndent2(m_log, "{}.EventStreamReader::OnDone({})", Er::Format::ptr(this), int(status.error_code()));
+
+                Er::Util::ExceptionLogger xcptLogger(m_log);
+
+                try
+                {
+                    if (!status.ok() && (status.error_code() != grpc::StatusCode::CANCELLED))
+                    {
+                        ErLogError2(m_log, "Event stream terminated with an error: {} ({})", int(status.error_code()), status.error_message());
+
+                        m_handler->onError(status);
+                    }
+                }
+                catch (...)
+                {
+                    Er::dispatchException(std::current_exception(), xcptLogger);
+                }
+            }
+
+            if constexpr (HasStreamHooks)
+                m_handler->onStreamEnded(this);
+
+            m_handler.reset();
+
+            delete this;
+        }
+
+        ProcessListClientImpl* const m_client;
+        Er::ReferenceCountedPtr<CompletionT> m_handler;
+        MessageT m_reply;
+    };
+
+    struct ListProcessesReader final
+        : public grpc::ClientReadReactor<erebus::ProcessPropsReply>
+        , public ContextBase
+    {
+        ~ListProcessesReader()
+        {
+            ProctreeTrace2(m_log, "{}.ListProcessesReader::~ListProcessesReader()", Er::Format::ptr(this));
+        }
+
+        ListProcessesReader(
+            ProcessListClientImpl* owner,
+            Er::Log::ILogger* log,
+            erebus::ProcessPropsRequest&& request,
+            Er::ReferenceCountedPtr<IListProcessesCompletion> handler
+        )
+            : ContextBase(owner, log)
+            , request(std::move(request))
+            , m_client(owner)
+            , m_handler(handler)
+        {
+            ProctreeTrace2(m_log, "{}.ListProcessesReader::ListProcessesReader()", Er::Format::ptr(this));
+        }
+
+        void start()
+        {
+            StartRead(&m_reply);
+            StartCall();
+        }
+
         erebus::ProcessPropsRequest request;
-        erebus::ProcessPropsReply reply;
+
+    private:
+        void OnReadDone(bool ok) override
+        {
+            ProctreeTraceIndent2(m_log, "{}.ListProcessesReader::OnReadDone({})", Er::Format::ptr(this), ok);
+
+            if (!ok)
+                return;
+
+            std::vector<BlobCache::Hash> missing;
+            m_client->expandBlobs(m_reply, &missing);
+
+            if (!missing.empty())
+            {
+                AddHold();
+                m_client->fetchBlobs(std::move(missing), [this]()
+                {
+                    m_client->expandBlobs(m_reply, nullptr);
+                    deliver();
+                    RemoveHold();
+                });
+
+                return;
+            }
+
+            deliver();
+        }
+
+        void deliver()
+        {
+            Er::Util::ExceptionLogger xcptLogger(m_log);
+
+            try
+            {
+                std::string ns = m_reply.has_ns() ? std::move(*m_reply.mutable_ns()) : std::string{};
+
+                if (m_reply.has_header() && m_reply.header().has_exception())
+                {
+                    auto e = Ipc::Grpc::unmarshalException(m_reply.header().exception());
+                    ProctreeTrace2(m_log, "Scanning [{}] failed: {}", ns, e.message());
+                    m_handler->onRootFailed(std::move(ns), std::move(e));
+                }
+                else if (m_reply.has_props() && !m_cancelled)
+                {
+                    if (m_handler->onProcess(std::move(ns), unmarshalProcessProperties(m_reply.props())) == CallbackResult::Cancel)
+                    {
+                        ErLogDebug2(m_log, "Canceling the process list");
+                        m_cancelled = true;
+                        grpcContext.TryCancel();
+                    }
+                }
+            }
+            catch (...)
+            {
+                Er::dispatchException(std::current_exception(), xcptLogger);
+            }
+
+            StartRead(&m_reply);
+        }
+
+        void OnDone(const grpc::Status& status) override
+        {
+            {
+                ProctreeTraceIndent2(m_log, "{}.ListProcessesReader::OnDone({})", Er::Format::ptr(this), int(status.error_code()));
+
+                Er::Util::ExceptionLogger xcptLogger(m_log);
+
+                try
+                {
+                    if (status.ok())
+                    {
+                        m_handler->onComplete();
+                    }
+                    else if (status.error_code() != grpc::StatusCode::CANCELLED)
+                    {
+                        ErLogError2(m_log, "ListProcesses() failed: {} ({})", int(status.error_code()), status.error_message());
+
+                        m_handler->onError(status);
+                    }
+                    else if (!m_cancelled)
+                    {
+                        // somebody else has cancelled it; the handler still has to hear how it ended
+                        m_handler->onError(status);
+                    }
+                }
+                catch (...)
+                {
+                    Er::dispatchException(std::current_exception(), xcptLogger);
+                }
+            }
+
+            m_handler.reset();
+
+            delete this;
+        }
+
+        ProcessListClientImpl* const m_client;
+        Er::ReferenceCountedPtr<IListProcessesCompletion> m_handler;
+        erebus::ProcessPropsReply m_reply;
+        bool m_cancelled = false;
     };
 
+    using PressureStreamReader = EventStreamReader<erebus::PressureRequest, erebus::PressureEvent, PressureEvent, IPressureCompletion, &unmarshalPressureEvent>;
+    using AlertStreamReader = EventStreamReader<erebus::AlertRequest, erebus::Alert, Alert, IAlertCompletion, &unmarshalAlert>;
+    using ProcessDeltaStreamReader = EventStreamReader<erebus::SubscribeRequest, erebus::ProcessDelta, ProcessDelta, IProcessDeltaCompletion, &unmarshalProcessDelta>;
+    using ReplayStreamReader = EventStreamReader<erebus::ReplayRequest, erebus::ProcessDelta, ProcessDelta, IProcessDeltaCompletion, &unmarshalProcessDelta>;
+
     void completeGetProcessProperties(std::shared_ptr<GetProcessPropertiesContext> ctx, grpc::Status status)
     {
         ProctreeTraceIndent2(m_log.get(), "{}.ProcessListClientImpl::completeGetProcessProperties", Er::Format::ptr(this));
@@ -91,41 +846,255 @@ private:
 
                 return ctx->handler->onError(status);
             }
-            else
+
+            Timings timings;
+            if (ctx->reply.has_header())
             {
-                Timings timings;
+                auto& hdr = ctx->reply.header();
+                if (hdr.has_timestamp())
+                    timings.rtt = Time::now() - hdr.timestamp();
+
+                if (hdr.has_duration())
+                    timings.processing = hdr.duration();
+            }
+
+            deliverProcessProps(ctx->reply, timings, std::span(&ctx->handler, 1));
+        }
+        catch (...)
+        {
+            Er::dispatchException(std::current_exception(), xcptLogger);
+        }
+    }
+
+    void completeBatch(std::shared_ptr<BatchContext> ctx, grpc::Status status)
+    {
+        ProctreeTraceIndent2(m_log.get(), "{}.ProcessListClientImpl::completeBatch", Er::Format::ptr(this));
+
+        Er::Util::ExceptionLogger xcptLogger(m_log.get());
+
+        if (!status.ok())
+        {
+            ErLogError2(m_log.get(), "GetProcessPropsBatch() failed for {}: {} ({})", ctx->grpcContext.peer(), int(status.error_code()), status.error_message());
 
-                if (ctx->reply.has_header())
+            for (auto& r : ctx->batch)
+            {
+                for (auto& c : r.completions)
                 {
-                    auto& hdr = ctx->reply.header();
-                    if (hdr.has_exception())
+                    try
                     {
-                        auto e = Ipc::Grpc::unmarshalException(hdr.exception());
-                        ProctreeTrace2(m_log.get(), "GetProcessProperties() returned an error: {}", e.message());
-                        return ctx->handler->onException(std::move(e));
+                        c->onError(status);
                     }
-
-                    if (hdr.has_timestamp())
+                    catch (...)
                     {
-                        auto now = Time::now();
-                        timings.rtt = now - hdr.timestamp();
+                        Er::dispatchException(std::current_exception(), xcptLogger);
                     }
+                }
+            }
 
-                    if (hdr.has_duration())
-                    {
-                        timings.processing = hdr.duration();
-                    }
+            return;
+        }
+
+        // every request in the batch shares the same timings
+        Timings timings;
+        if (ctx->reply.has_header())
+        {
+            auto& hdr = ctx->reply.header();
+            if (hdr.has_timestamp())
+                timings.rtt = Time::now() - hdr.timestamp();
+
+            if (hdr.has_duration())
+                timings.processing = hdr.duration();
+        }
+
+        auto count = std::min<std::size_t>(ctx->batch.size(), ctx->reply.replies_size());
+        for (std::size_t i = 0; i < ctx->batch.size(); ++i)
+        {
+            try
+            {
+                if (i < count)
+                {
+                    deliverProcessProps(ctx->reply.replies(static_cast<int>(i)), timings, ctx->batch[i].completions);
+                }
+                else
+                {
+                    // the server has sent fewer replies than expected
+                    for (auto& c : ctx->batch[i].completions)
+                        c->onError(grpc::Status(grpc::StatusCode::INTERNAL, "Missing reply in a batch"));
+                }
+            }
+            catch (...)
+            {
+                Er::dispatchException(std::current_exception(), xcptLogger);
+            }
+        }
+    }
+
+    void deliverProcessProps(const erebus::ProcessPropsReply& reply, Timings timings, std::span<GetProcessPropsCompletionPtr> completions)
+    {
+        if (reply.has_header() && reply.header().has_exception())
+        {
+            auto e = Ipc::Grpc::unmarshalException(reply.header().exception());
+            ProctreeTrace2(m_log.get(), "GetProcessProperties() returned an error: {}", e.message());
+
+            for (std::size_t i = 0; i < completions.size(); ++i)
+            {
+                if (i + 1 == completions.size())
+                    completions[i]->onException(std::move(e));
+                else
+                    completions[i]->onException(Exception(e));
+            }
+
+            return;
+        }
+
+        // an empty reply is still a reply
+        auto props = reply.has_props() ? unmarshalProcessProperties(reply.props()) : ProcessProperties{};
+
+        for (std::size_t i = 0; i < completions.size(); ++i)
+        {
+            if (i + 1 == completions.size())
+                completions[i]->onReply(std::move(props), timings);
+            else
+                completions[i]->onReply(ProcessProperties(props), timings);
+        }
+    }
+
+    void completeGroupBy(std::shared_ptr<GroupByContext> ctx, grpc::Status status)
+    {
+        ProctreeTraceIndent2(m_log.get(), "{}.ProcessListClientImpl::completeGroupBy", Er::Format::ptr(this));
+
+        Er::Util::ExceptionLogger xcptLogger(m_log.get());
+
+        try
+        {
+            if (!status.ok())
+            {
+                ErLogError2(m_log.get(), "GroupBy() failed for {}: {} ({})", ctx->grpcContext.peer(), int(status.error_code()), status.error_message());
+
+                return ctx->handler->onError(status);
+            }
+
+            Timings timings;
+
+            if (ctx->reply.has_header())
+            {
+                auto& hdr = ctx->reply.header();
+                if (hdr.has_exception())
+                {
+                    auto e = Ipc::Grpc::unmarshalException(hdr.exception());
+                    ProctreeTrace2(m_log.get(), "GroupBy() returned an error: {}", e.message());
+                    return ctx->handler->onException(std::move(e));
+                }
+
+                if (hdr.has_timestamp())
+                    timings.rtt = Time::now() - hdr.timestamp();
+
+                if (hdr.has_duration())
+                    timings.processing = hdr.duration();
+            }
+
+            std::vector<GroupStats> groups;
+            groups.reserve(ctx->reply.groups_size());
+            for (auto& g : ctx->reply.groups())
+                groups.push_back(unmarshalProcessGroup(g));
+
+            ctx->handler->onReply(std::move(groups), timings);
+        }
+        catch (...)
+        {
+            Er::dispatchException(std::current_exception(), xcptLogger);
+        }
+    }
+
+    void completeFindSockets(std::shared_ptr<FindSocketsContext> ctx, grpc::Status status)
+    {
+        ProctreeTraceIndent2(m_log.get(), "{}.ProcessListClientImpl::completeFindSockets", Er::Format::ptr(this));
+
+        Er::Util::ExceptionLogger xcptLogger(m_log.get());
+
+        try
+        {
+            if (!status.ok())
+            {
+                ErLogError2(m_log.get(), "FindSockets() failed for {}: {} ({})", ctx->grpcContext.peer(), int(status.error_code()), status.error_message());
+
+                return ctx->handler->onError(status);
+            }
+
+            Timings timings;
+
+            if (ctx->reply.has_header())
+            {
+                auto& hdr = ctx->reply.header();
+                if (hdr.has_exception())
+                {
+                    auto e = Ipc::Grpc::unmarshalException(hdr.exception());
+                    ProctreeTrace2(m_log.get(), "FindSockets() returned an error: {}", e.message());
+                    return ctx->handler->onException(std::move(e));
                 }
 
-                if (ctx->reply.has_props())
+                if (hdr.has_timestamp())
+                    timings.rtt = Time::now() - hdr.timestamp();
+
+                if (hdr.has_duration())
+                    timings.processing = hdr.duration();
+            }
+
+            std::vector<SocketInfo> sockets;
+            sockets.reserve(ctx->reply.sockets_size());
+            for (auto& s : ctx->reply.sockets())
+                sockets.push_back(unmarshalSocketInfo(s));
+
+            ctx->handler->onReply(std::move(sockets), timings);
+        }
+        catch (...)
+        {
+            Er::dispatchException(std::current_exception(), xcptLogger);
+        }
+    }
+
+    void completeFindOpenFiles(std::shared_ptr<FindOpenFilesContext> ctx, grpc::Status status)
+    {
+        ProctreeTraceIndent2(m_log.get(), "{}.ProcessListClientImpl::completeFindOpenFiles", Er::Format::ptr(this));
+
+        Er::Util::ExceptionLogger xcptLogger(m_log.get());
+
+        try
+        {
+            if (!status.ok())
+            {
+                ErLogError2(m_log.get(), "FindOpenFiles() failed for {}: {} ({})", ctx->grpcContext.peer(), int(status.error_code()), status.error_message());
+
+                return ctx->handler->onError(status);
+            }
+
+            Timings timings;
+
+            if (ctx->reply.has_header())
+            {
+                auto& hdr = ctx->reply.header();
+                if (hdr.has_exception())
                 {
-                    auto props = unmarshalProcessProperties(ctx->reply.props());
-                    return ctx->handler->onReply(std::move(props), timings);
+                    auto e = Ipc::Grpc::unmarshalException(hdr.exception());
+                    ProctreeTrace2(m_log.get(), "FindOpenFiles() returned an error: {}", e.message());
+                    return ctx->handler->onException(std::move(e));
                 }
-                
-                // looks like an empty reply
-                ctx->handler->onReply(ProcessProperties{}, timings);
+
+                if (hdr.has_timestamp())
+                    timings.rtt = Time::now() - hdr.timestamp();
+
+                if (hdr.has_duration())
+                    timings.processing = hdr.duration();
             }
+
+            OpenFileList files;
+            files.truncated = ctx->reply.truncated();
+            files.partial = ctx->reply.partial();
+            files.files.reserve(ctx->reply.files_size());
+            for (auto& f : ctx->reply.files())
+                files.files.push_back(unmarshalOpenFile(f));
+
+            ctx->handler->onReply(std::move(files), timings);
         }
         catch (...)
         {
@@ -133,15 +1102,38 @@ private:
         }
     }
 
-    const std::unique_ptr<erebus::ProcessList::Stub> m_stub;
+    erebus::ProcessList::Stub* stub(const ContextBase& ctx) const noexcept
+    {
+        return m_stubs[ctx.channel()].get();
+    }
+
+    const std::vector<std::unique_ptr<erebus::ProcessList::Stub>> m_stubs;
+    const ProcessListClientOptions m_options;
+    std::unique_ptr<BlobCache> m_blobs;
+
+    struct
+    {
+        std::mutex mutex;
+        std::condition_variable_any cv;
+        std::chrono::steady_clock::time_point deadline;
+        PendingBatch requests;
+        std::map<PendingKey, std::size_t> index; // -> requests
+    } m_batch;
+
+    std::jthread m_flusher;
 };
 
 } // namespace {}
 
 
-ER_PROCTREE_EXPORT ProcessListClientPtr createProcessListClient(Ipc::Grpc::ChannelPtr channel, Log::LoggerPtr log)
+ER_PROCTREE_EXPORT ProcessListClientPtr createProcessListClient(Ipc::Grpc::ChannelPtr channel, Log::LoggerPtr log, const ProcessListClientOptions& options)
+{
+    return createProcessListClient(std::make_shared<Ipc::Grpc::ChannelPool>(std::vector<Ipc::Grpc::ChannelPtr>{ channel }), log, options);
+}
+
+ER_PROCTREE_EXPORT ProcessListClientPtr createProcessListClient(Ipc::Grpc::ChannelPoolPtr pool, Log::LoggerPtr log, const ProcessListClientOptions& options)
 {
-    return ProcessListClientPtr{ new ProcessListClientImpl(channel, log) };
+    return ProcessListClientPtr{ new ProcessListClientImpl(pool, log, options) };
 }
 
 
@@ -0,0 +1,408 @@
+#include <grpcpp/grpcpp.h>
+
+#include "../trace.hxx"
+
+#include <erebus/proctree/client/process_table.hxx>
+#include <erebus/rtl/util/exception_util.hxx>
+#include <erebus/rtl/util/unknown_base.hxx>
+
+#include <algorithm>
+
+
+namespace Er::ProcessTree
+{
+
+//
+// Outlives the table if the stream is still open when the table goes away;
+// the table cancels the stream then, and the stream ends on its own time
+//
+
+class ProcessTable::Subscription final
+    : public Util::ReferenceCountedBase<Util::ObjectBase<IProcessListClient::IProcessDeltaCompletion>>
+{
+public:
+    explicit Subscription(ProcessTable* owner) noexcept
+        : m_owner(owner)
+    {
+    }
+
+    void cancel() noexcept
+    {
+        std::lock_guard l(m_mutex);
+        m_owner = nullptr;
+
+        if (m_stream)
+            m_stream->cancel();
+    }
+
+    void onStreamStarted(IProcessListClient::IStream* stream) noexcept override
+    {
+        std::lock_guard l(m_mutex);
+        m_stream = stream;
+        m_failure.reset();
+    }
+
+    void onStreamEnded(IProcessListClient::IStream* stream) noexcept override
+    {
+        std::lock_guard l(m_mutex);
+        if (m_stream != stream)
+            return;
+
+        m_stream = nullptr;
+
+        if (m_owner)
+            m_owner->streamEnded(m_failure ? &*m_failure : nullptr);
+    }
+
+    CallbackResult onEvent(ProcessDelta&& delta) override
+    {
+        std::lock_guard l(m_mutex);
+        if (!m_owner)
+            return CallbackResult::Cancel;
+
+        m_owner->apply(std::move(delta));
+        return CallbackResult::Continue;
+    }
+
+    void onError(const grpc::Status& status) noexcept override
+    {
+        // onStreamEnded() follows
+        std::lock_guard l(m_mutex);
+        m_failure = status;
+    }
+
+    void onException(Exception&& e) noexcept override
+    {
+        std::lock_guard l(m_mutex);
+        if (m_owner)
+            ErLogError2(m_owner->m_log.get(), "Process table subscription failed: {}", e.message());
+    }
+
+private:
+    std::mutex m_mutex;
+    ProcessTable* m_owner;
+    IProcessListClient::IStream* m_stream = nullptr;
+    std::optional<grpc::Status> m_failure;
+};
+
+
+namespace
+{
+
+template <typename MapT, typename KeyT>
+void addToIndex(MapT& index, KeyT key, Pid pid)
+{
+    index.write(key)[key].push_back(pid);
+}
+
+template <typename MapT, typename KeyT>
+void removeFromIndex(MapT& index, KeyT key, Pid pid)
+{
+    if (!index.find(key))
+        return;
+
+    auto& shard = index.write(key);
+    auto it = shard.find(key);
+    auto& list = it->second;
+
+    auto pos = std::find(list.begin(), list.end(), pid);
+    if (pos != list.end())
+    {
+        *pos = list.back();
+        list.pop_back();
+    }
+
+    if (list.empty())
+        shard.erase(it);
+}
+
+// the server refuses these for good; asking again won't help
+bool permanentFailure(grpc::StatusCode code) noexcept
+{
+    switch (code)
+    {
+    case grpc::StatusCode::INVALID_ARGUMENT:
+    case grpc::StatusCode::NOT_FOUND:
+    case grpc::StatusCode::ALREADY_EXISTS:
+    case grpc::StatusCode::PERMISSION_DENIED:
+    case grpc::StatusCode::FAILED_PRECONDITION:
+    case grpc::StatusCode::OUT_OF_RANGE:
+    case grpc::StatusCode::UNIMPLEMENTED:
+    case grpc::StatusCode::UNAUTHENTICATED:
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+} // namespace {}
+
+
+ProcessTable::ProcessPtr ProcessTable::Snapshot::find(Pid pid) const noexcept
+{
+    auto p = m_processes.find(pid);
+    if (!p)
+        return {};
+
+    return *p;
+}
+
+const ProcessTable::PidList& ProcessTable::Snapshot::children(Pid ppid) const noexcept
+{
+    static const PidList empty;
+
+    auto list = m_children.find(ppid);
+    if (!list)
+        return empty;
+
+    return *list;
+}
+
+const ProcessTable::PidList& ProcessTable::Snapshot::byUser(std::uint64_t ruid) const noexcept
+{
+    static const PidList empty;
+
+    auto list = m_users.find(ruid);
+    if (!list)
+        return empty;
+
+    return *list;
+}
+
+void ProcessTable::Snapshot::index(Pid pid, const ProcessProperties& p)
+{
+    if (p.valid(ProcessProperties::PPid))
+        addToIndex(m_children, p.ppid, pid);
+
+    if (p.valid(ProcessProperties::Ruid))
+        addToIndex(m_users, p.ruid, pid);
+}
+
+void ProcessTable::Snapshot::unindex(Pid pid, const ProcessProperties& p)
+{
+    if (p.valid(ProcessProperties::PPid))
+        removeFromIndex(m_children, p.ppid, pid);
+
+    if (p.valid(ProcessProperties::Ruid))
+        removeFromIndex(m_users, p.ruid, pid);
+}
+
+void ProcessTable::Snapshot::reindex(Pid pid, const ProcessProperties& before, const ProcessProperties& after)
+{
+    // most deltas leave the parent and the owner alone
+    bool ppidValid = before.valid(ProcessProperties::PPid);
+    if ((ppidValid != after.valid(ProcessProperties::PPid)) || (ppidValid && (before.ppid != after.ppid)))
+    {
+        if (ppidValid)
+            removeFromIndex(m_children, before.ppid, pid);
+
+        if (after.valid(ProcessProperties::PPid))
+            addToIndex(m_children, after.ppid, pid);
+    }
+
+    bool ruidValid = before.valid(ProcessProperties::Ruid);
+    if ((ruidValid != after.valid(ProcessProperties::Ruid)) || (ruidValid && (before.ruid != after.ruid)))
+    {
+        if (ruidValid)
+            removeFromIndex(m_users, before.ruid, pid);
+
+        if (after.valid(ProcessProperties::Ruid))
+            addToIndex(m_users, after.ruid, pid);
+    }
+}
+
+
+ProcessTable::~ProcessTable()
+{
+    ProctreeTrace2(m_log.get(), "{}.ProcessTable::~ProcessTable()", Er::Format::ptr(this));
+
+    // no new streams from now on
+    m_retrier.request_stop();
+    m_retrier.join();
+
+    // the stream may stay quiet for a long time; don't make the client wait for it
+    m_subscription->cancel();
+}
+
+ProcessTable::ProcessTable(ProcessListClientPtr client, const ProcessProperties::Mask& fields, Log::LoggerPtr log)
+    : m_log(log)
+    , m_client(client)
+    , m_fields(fields)
+    , m_subscription(new Subscription(this))
+    , m_completion(m_subscription)
+    , m_snapshot(std::make_shared<const Snapshot>())
+{
+    ProctreeTrace2(m_log.get(), "{}.ProcessTable::ProcessTable()", Er::Format::ptr(this));
+
+    m_fields.set(ProcessProperties::Pid);
+    m_fields.set(ProcessProperties::PPid);
+    m_fields.set(ProcessProperties::Ruid);
+
+    m_retrier = std::jthread([this](std::stop_token stop) { retry(stop); });
+
+    subscribe();
+}
+
+void ProcessTable::subscribe()
+{
+    m_client->subscribe(m_fields, m_completion);
+}
+
+void ProcessTable::apply(ProcessDelta&& delta)
+{
+    // only the subscription calls this, one delta at a time; readers keep using the old snapshot meanwhile
+    auto current = m_snapshot.load(std::memory_order_acquire);
+
+    auto next = std::make_shared<Snapshot>();
+    next->m_timestamp = delta.timestamp;
+    next->m_version = current->m_version + 1;
+
+    if (delta.reset)
+    {
+        // the stream works again
+        m_retryDelay = MinRetryDelay;
+    }
+    else
+    {
+        // deltas on top of an incomplete table make no sense, the rest of the table does
+        if (!current->m_synchronized && !m_loading)
+            return;
+
+        // shares the whole table; only the shards written to below get copied
+        next->m_size = current->m_size;
+        next->m_processes = current->m_processes.share();
+        next->m_children = current->m_children.share();
+        next->m_users = current->m_users.share();
+    }
+
+    // a reused PID comes as removed + added
+    for (auto pid : delta.removed)
+    {
+        auto existing = next->m_processes.find(pid);
+        if (!existing)
+            continue;
+
+        next->unindex(pid, **existing);
+        next->m_processes.write(pid).erase(pid);
+        --next->m_size;
+    }
+
+    for (auto& p : delta.changed)
+    {
+        Pid pid = p.pid;
+        auto& shard = next->m_processes.write(pid);
+        auto it = shard.find(pid);
+        if (it == shard.end())
+        {
+            auto added = std::make_shared<const ProcessProperties>(std::move(p));
+            next->index(pid, *added);
+            shard.emplace(pid, std::move(added));
+            ++next->m_size;
+        }
+        else
+        {
+            // processes are shared with older snapshots and are never modified in place
+            auto merged = std::make_shared<ProcessProperties>(*it->second);
+            merged->merge(std::move(p));
+            next->reindex(pid, *it->second, *merged);
+            it->second = std::move(merged);
+        }
+    }
+
+    // the readers see a table that is still arriving as not synchronized
+    m_loading = delta.more;
+    next->m_synchronized = !m_loading;
+
+    ProctreeTrace2(m_log.get(), "Process table v.{}: {} processes (+/-{} -{})", next->m_version, next->m_size, delta.changed.size(), delta.removed.size());
+
+    m_snapshot.store(std::move(next), std::memory_order_release);
+}
+
+void ProcessTable::streamEnded(const grpc::Status* failure)
+{
+    // keep serving the last known table but let the readers know it's stale
+    auto current = m_snapshot.load(std::memory_order_acquire);
+    auto next = std::make_shared<Snapshot>();
+    next->m_timestamp = current->m_timestamp;
+    next->m_version = current->m_version;
+    next->m_synchronized = false;
+    next->m_size = current->m_size;
+    next->m_processes = current->m_processes.share();
+    next->m_children = current->m_children.share();
+    next->m_users = current->m_users.share();
+    m_snapshot.store(std::move(next), std::memory_order_release);
+    m_loading = false;
+
+    auto delay = m_retryDelay;
+    if (failure)
+    {
+        if (permanentFailure(failure->error_code()))
+        {
+            ErLogError2(m_log.get(), "Process table subscription failed: {} ({})", int(failure->error_code()), failure->error_message());
+            return;
+        }
+
+        if (failure->error_code() == grpc::StatusCode::DATA_LOSS)
+        {
+            // we've been too slow and have missed some deltas; start over with a fresh table right away
+            ErLogWarning2(m_log.get(), "Process table is out of sync; resubscribing");
+            delay = std::chrono::milliseconds::zero();
+        }
+        else
+        {
+            ErLogWarning2(m_log.get(), "Process table subscription failed: {} ({}); resubscribing in {} ms", int(failure->error_code()), failure->error_message(), delay.count());
+        }
+    }
+    else
+    {
+        // the server went away or has cancelled us
+        ErLogWarning2(m_log.get(), "Process table subscription has ended; resubscribing in {} ms", delay.count());
+    }
+
+    if (delay.count() > 0)
+        m_retryDelay = std::min(m_retryDelay * 2, MaxRetryDelay);
+
+    {
+        std::lock_guard l(m_retryMutex);
+        m_retryAt = std::chrono::steady_clock::now() + delay;
+    }
+
+    m_retryCv.notify_one();
+}
+
+void ProcessTable::retry(std::stop_token stop)
+{
+    std::unique_lock l(m_retryMutex);
+
+    while (!stop.stop_requested())
+    {
+        if (!m_retryCv.wait(l, stop, [this]() { return m_retryAt.has_value(); }))
+            return;
+
+        // nothing else can reschedule until the new stream has ended
+        auto at = *m_retryAt;
+        if (m_retryCv.wait_until(l, stop, at, []() { return false; }) || stop.stop_requested())
+            return;
+
+        m_retryAt.reset();
+
+        // the stream callbacks may take the lock
+        l.unlock();
+
+        try
+        {
+            subscribe();
+        }
+        catch (...)
+        {
+            Er::Util::ExceptionLogger xcptHandler(m_log.get());
+            Er::dispatchException(std::current_exception(), xcptHandler);
+        }
+
+        l.lock();
+    }
+}
+
+
+} // namespace Er::ProcessTree {}
@@ -0,0 +1,202 @@
+#include <erebus/proctree/client/shm_process_table.hxx>
+#include <erebus/rtl/util/generic_handle.hxx>
+
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+namespace Er::ProcessTree
+{
+
+namespace
+{
+
+// a table is rewritten in about a millisecond
+constexpr unsigned SpinAttempts = 64;
+constexpr unsigned MaxAttempts = 64 + 100;
+
+} // namespace {}
+
+
+ProcessProperties ShmProcessTable::View::get(std::uint32_t row) const
+{
+    ProcessProperties p;
+
+    for (FieldId f = 0; f < ProcessProperties::FieldCount; ++f)
+    {
+        if (!valid(row, f))
+            continue;
+
+        switch (f)
+        {
+        case ProcessProperties::Pid: ErSet(ProcessProperties, Pid, p, pid, number(row, f)); break;
+        case ProcessProperties::PPid: ErSet(ProcessProperties, PPid, p, ppid, number(row, f)); break;
+        case ProcessProperties::PGrp: ErSet(ProcessProperties, PGrp, p, pgrp, number(row, f)); break;
+        case ProcessProperties::Tpgid: ErSet(ProcessProperties, Tpgid, p, tpgid, number(row, f)); break;
+        case ProcessProperties::Session: ErSet(ProcessProperties, Session, p, session, number(row, f)); break;
+        case ProcessProperties::Ruid: ErSet(ProcessProperties, Ruid, p, ruid, number(row, f)); break;
+        case ProcessProperties::Comm: ErSet(ProcessProperties, Comm, p, comm, std::string(string(row, f))); break;
+        case ProcessProperties::CmdLine: ErSet(ProcessProperties, CmdLine, p, cmdLine, std::string(string(row, f))); break;
+        case ProcessProperties::Exe: ErSet(ProcessProperties, Exe, p, exe, std::string(string(row, f))); break;
+        case ProcessProperties::StartTime: ErSet(ProcessProperties, StartTime, p, startTime, static_cast<Time::ValueType>(number(row, f))); break;
+        case ProcessProperties::State: ErSet(ProcessProperties, State, p, state, static_cast<std::uint32_t>(number(row, f))); break;
+        case ProcessProperties::UserName: ErSet(ProcessProperties, UserName, p, userName, std::string(string(row, f))); break;
+        case ProcessProperties::ThreadCount: ErSet(ProcessProperties, ThreadCount, p, threadCount, static_cast<std::uint32_t>(number(row, f))); break;
+        case ProcessProperties::STime: ErSet(ProcessProperties, STime, p, sTime, static_cast<Time::ValueType>(number(row, f))); break;
+        case ProcessProperties::UTime: ErSet(ProcessProperties, UTime, p, uTime, static_cast<Time::ValueType>(number(row, f))); break;
+        case ProcessProperties::CpuUsage: ErSet(ProcessProperties, CpuUsage, p, cpuUsage, cpuUsage(row)); break;
+        case ProcessProperties::Tty: ErSet(ProcessProperties, Tty, p, tty, static_cast<std::int32_t>(number(row, f))); break;
+        case ProcessProperties::Env: ErSet(ProcessProperties, Env, p, env, std::string(string(row, f))); break;
+        case ProcessProperties::Rss: ErSet(ProcessProperties, Rss, p, rss, number(row, f)); break;
+        default: break;
+        }
+    }
+
+    return p;
+}
+
+ShmProcessTable::~ShmProcessTable()
+{
+    ::munmap(const_cast<void*>(m_base), m_size);
+}
+
+ShmProcessTable::ShmProcessTable(const void* base, std::size_t size) noexcept
+    : m_base(base)
+    , m_size(size)
+    , m_header(static_cast<const Shm::Header*>(base))
+    , m_columns(reinterpret_cast<const std::uint64_t*>(static_cast<const char*>(base) + m_header->columns))
+    , m_arena(static_cast<const char*>(base) + m_header->arena)
+{
+}
+
+std::expected<std::unique_ptr<ShmProcessTable>, Error> ShmProcessTable::open(std::string_view name)
+{
+    std::string path(name);
+    Util::FileHandle fd(::shm_open(path.c_str(), O_RDONLY | O_CLOEXEC, 0));
+    if (!fd.valid())
+        return std::unexpected(Error(errno, PosixError));
+
+    struct stat st = {};
+    if (::fstat(fd.get(), &st) < 0)
+        return std::unexpected(Error(errno, PosixError));
+
+    auto size = static_cast<std::size_t>(st.st_size);
+    if (size < sizeof(Shm::Header))
+        return std::unexpected(Error(Result::InvalidInput, GenericError));
+
+    auto base = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd.get(), 0);
+    if (base == MAP_FAILED)
+        return std::unexpected(Error(errno, PosixError));
+
+    // the fixed part of the header never changes after the segment has been sized
+    auto header = static_cast<const Shm::Header*>(base);
+    bool ok = (header->magic == Shm::Magic)
+        && (header->version == Shm::Version)
+        && (header->headerSize == sizeof(Shm::Header))
+        && (header->segmentSize == size)
+        && (header->columnCount == ProcessProperties::FieldCount + 1)
+        && (header->columns + std::uint64_t(header->columnCount) * header->capacity * sizeof(std::uint64_t) <= header->arena)
+        && (header->arena + header->arenaSize <= size);
+
+    if (!ok)
+    {
+        ::munmap(base, size);
+        return std::unexpected(Error(Result::InvalidInput, GenericError));
+    }
+
+    return std::unique_ptr<ShmProcessTable>(new ShmProcessTable(base, size));
+}
+
+bool ShmProcessTable::closed() const noexcept
+{
+    auto flags = std::atomic_ref<std::uint32_t>(const_cast<std::uint32_t&>(m_header->flags)).load(std::memory_order_acquire);
+    return (flags & Shm::Closed) != 0;
+}
+
+ProcessProperties::Mask ShmProcessTable::fields() const noexcept
+{
+    ProcessProperties::Mask mask;
+    for (FieldId f = 0; f < ProcessProperties::FieldCount; ++f)
+    {
+        if (m_header->fields & (std::uint64_t(1) << f))
+            mask.set(f);
+    }
+
+    return mask;
+}
+
+std::expected<std::uint64_t, Error> ShmProcessTable::begin(unsigned attempt) const
+{
+    std::atomic_ref<std::uint64_t> sequence(const_cast<std::uint64_t&>(m_header->sequence));
+
+    for (;; ++attempt)
+    {
+        if (attempt >= MaxAttempts)
+            return std::unexpected(Error(EAGAIN, PosixError));
+
+        auto s = sequence.load(std::memory_order_acquire);
+        if (!(s & 1))
+        {
+            if (m_header->flags & Shm::Closed)
+                return std::unexpected(Error(Result::FailedPrecondition, GenericError));
+
+            return s;
+        }
+
+        // the server is writing; spin for a bit, then back off
+        if (attempt < SpinAttempts)
+            std::this_thread::yield();
+        else
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+}
+
+bool ShmProcessTable::validate(std::uint64_t s) const noexcept
+{
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    std::atomic_ref<std::uint64_t> sequence(const_cast<std::uint64_t&>(m_header->sequence));
+    return sequence.load(std::memory_order_relaxed) == s;
+}
+
+std::expected<std::vector<ProcessProperties>, Error> ShmProcessTable::snapshot() const
+{
+    std::vector<ProcessProperties> result;
+
+    auto r = read([&result](const View& v)
+    {
+        result.clear();
+        result.reserve(v.count());
+        for (std::uint32_t row = 0; row < v.count(); ++row)
+            result.push_back(v.get(row));
+    });
+
+    if (!r)
+        return std::unexpected(r.error());
+
+    return result;
+}
+
+std::expected<std::optional<ProcessProperties>, Error> ShmProcessTable::find(Pid pid) const
+{
+    std::optional<ProcessProperties> result;
+
+    auto r = read([&result, pid](const View& v)
+    {
+        result.reset();
+        if (auto row = v.find(pid))
+            result = v.get(*row);
+    });
+
+    if (!r)
+        return std::unexpected(r.error());
+
+    return result;
+}
+
+
+} // namespace Er::ProcessTree {}
@@ -5,61 +5,72 @@ namespace Er::ProcessTree
 {
 
 void marshalProcessProperties(const ProcessProperties& source, erebus::ProcessProps& dest)
+{
+    marshalProcessProperties(source, source.validMask(), dest);
+}
+
+void marshalProcessProperties(const ProcessProperties& source, const ProcessProperties::Mask& fields, erebus::ProcessProps& dest)
 {
     ErAssert(source.valid(ProcessProperties::Pid));
 
+    // Pid identifies the process and always goes out
     dest.set_pid(source.pid);
 
-    if (source.valid(ProcessProperties::PPid))
+    auto valid = source.validMask() & fields;
+
+    if (valid[ProcessProperties::PPid])
         dest.set_ppid(source.ppid);
 
-    if (source.valid(ProcessProperties::PGrp))
+    if (valid[ProcessProperties::PGrp])
         dest.set_pgrp(source.pgrp);
 
-    if (source.valid(ProcessProperties::Tpgid))
+    if (valid[ProcessProperties::Tpgid])
         dest.set_tpgid(source.tpgid);
 
-    if (source.valid(ProcessProperties::Session))
+    if (valid[ProcessProperties::Session])
         dest.set_session(source.session);
 
-    if (source.valid(ProcessProperties::Ruid))
+    if (valid[ProcessProperties::Ruid])
         dest.set_ruid(source.ruid);
 
-    if (source.valid(ProcessProperties::Comm))
+    if (valid[ProcessProperties::Comm])
         dest.set_comm(source.comm);
 
-    if (source.valid(ProcessProperties::CmdLine))
+    if (valid[ProcessProperties::CmdLine])
         dest.set_cmdline(source.cmdLine.raw);
 
-    if (source.valid(ProcessProperties::Exe))
+    if (valid[ProcessProperties::Exe])
         dest.set_exe(source.exe);
 
-    if (source.valid(ProcessProperties::StartTime))
+    if (valid[ProcessProperties::StartTime])
         dest.set_starttime(source.startTime.value());
 
-    if (source.valid(ProcessProperties::State))
+    if (valid[ProcessProperties::State])
         dest.set_state(source.state);
 
-    if (source.valid(ProcessProperties::UserName))
+    if (valid[ProcessProperties::UserName])
         dest.set_username(source.userName);
 
-    if (source.valid(ProcessProperties::ThreadCount))
+    if (valid[ProcessProperties::ThreadCount])
         dest.set_threadcount(source.threadCount);
 
-    if (source.valid(ProcessProperties::STime))
+    if (valid[ProcessProperties::STime])
         dest.set_stime(source.sTime.value());
 
-    if (source.valid(ProcessProperties::UTime))
+    if (valid[ProcessProperties::UTime])
         dest.set_utime(source.uTime.value());
 
-    if (source.valid(ProcessProperties::CpuUsage))
+    if (valid[ProcessProperties::CpuUsage])
         dest.set_cpuusage(source.cpuUsage);
 
-    if (source.valid(ProcessProperties::Tty))
+    if (valid[ProcessProperties::Tty])
         dest.set_tty(source.tty);
 
-    if (source.valid(ProcessProperties::Env))
+    if (valid[ProcessProperties::Env])
         dest.set_env(source.env.raw);
+
+    if (valid[ProcessProperties::Rss])
+        dest.set_rss(source.rss);
 }
 
 ProcessProperties unmarshalProcessProperties(const erebus::ProcessProps& src)
@@ -119,35 +130,238 @@ ProcessProperties unmarshalProcessProperties(const erebus::ProcessProps& src)
     if (src.has_env())
         ErSet(ProcessProperties, Env, dest, env, src.env());
 
+    if (src.has_rss())
+        ErSet(ProcessProperties, Rss, dest, rss, src.rss());
+
     return dest;
 }
 
+std::uint64_t packProcessPropertyMask(const ProcessProperties::Mask& mask) noexcept
+{
+    static_assert(ProcessProperties::FieldCount <= 64);
+    return mask.pack<std::uint64_t>();
+}
+
+ProcessProperties::Mask unpackProcessPropertyMask(std::uint64_t bits) noexcept
+{
+    ProcessProperties::Mask mask;
+    for (FieldId f = 0; f < ProcessProperties::FieldCount; ++f)
+    {
+        if (bits & (std::uint64_t(1) << f))
+            mask.set(f);
+    }
+
+    return mask;
+}
+
 void marshalProcessPropertyMsk(erebus::ProcessPropsRequest& dest, const ProcessProperties::Mask& required)
 {
-    for (std::uint32_t i = 0; i < required.Size; ++i)
-        dest.add_fields(i);
+    dest.set_fields(packProcessPropertyMask(required));
 }
 
 ProcessProperties::Mask unmarshalProcessPropertyMask(const erebus::ProcessPropsRequest& req)
 {
-    ProcessProperties::Mask mask;
-    
-    auto count = req.fields_size();
-    if (count == 0)
+    if (!req.has_fields())
     {
         // if no fields explicitly specified, assume 'everything'
+        ProcessProperties::Mask mask;
         mask.set();
+        return mask;
+    }
+
+    return unpackProcessPropertyMask(req.fields());
+}
+
+void marshalPressureEvent(const PressureEvent& source, erebus::PressureEvent& dest)
+{
+    dest.set_resource(static_cast<std::uint32_t>(source.resource));
+    dest.set_kind(static_cast<std::uint32_t>(source.kind));
+    dest.set_stall(source.stallUs);
+    dest.set_window(source.windowUs);
+    dest.set_timestamp(source.timestamp.value());
+    dest.set_avg10(source.avg10);
+    dest.set_total(source.total);
+
+    auto top = dest.mutable_top();
+    top->Reserve(static_cast<int>(source.top.size()));
+    for (auto& c : source.top)
+    {
+        auto out = top->Add();
+        out->set_pid(c.pid);
+        out->set_comm(c.comm);
+        out->set_value(c.value);
     }
-    else
+}
+
+PressureEvent unmarshalPressureEvent(const erebus::PressureEvent& src)
+{
+    PressureEvent dest;
+
+    dest.resource = static_cast<PressureResource>(src.resource());
+    dest.kind = static_cast<PressureKind>(src.kind());
+    dest.stallUs = src.stall();
+    dest.windowUs = src.window();
+    dest.timestamp = src.timestamp();
+    dest.avg10 = src.avg10();
+    dest.total = src.total();
+
+    dest.top.reserve(src.top_size());
+    for (auto& c : src.top())
     {
-        for (decltype(count) i = 0; i < count; ++i)
-        {
-            auto f = req.fields()[i];
-            mask.set(f);
-        }
+        dest.top.push_back({ c.pid(), c.comm(), c.value() });
     }
 
-    return mask;
+    return dest;
+}
+
+void marshalAlert(const Alert& source, erebus::Alert& dest)
+{
+    dest.set_state(static_cast<std::uint32_t>(source.state));
+    dest.set_rule(source.rule);
+    dest.set_pid(source.pid);
+    dest.set_comm(source.comm);
+    dest.set_timestamp(source.timestamp.value());
+    dest.set_since(source.since.value());
+    dest.set_details(source.details);
+}
+
+Alert unmarshalAlert(const erebus::Alert& src)
+{
+    Alert dest;
+
+    dest.state = static_cast<Alert::State>(src.state());
+    dest.rule = src.rule();
+    dest.pid = src.pid();
+    dest.comm = src.comm();
+    dest.timestamp = src.timestamp();
+    dest.since = src.since();
+    dest.details = src.details();
+
+    return dest;
+}
+
+void marshalProcessGroup(const GroupStats& source, erebus::ProcessGroup& dest)
+{
+    dest.set_key(source.key);
+    
+    if (!source.name.empty())
+        dest.set_name(source.name);
+
+    dest.set_count(source.count);
+
+    for (auto& a : source.aggregates)
+    {
+        auto out = dest.add_aggregates();
+        out->set_field(a.field);
+        out->set_sum(a.sum);
+        out->set_max(a.max);
+    }
+}
+
+GroupStats unmarshalProcessGroup(const erebus::ProcessGroup& src)
+{
+    GroupStats dest;
+
+    dest.key = src.key();
+    
+    if (src.has_name())
+        dest.name = src.name();
+
+    dest.count = src.count();
+
+    dest.aggregates.reserve(src.aggregates_size());
+    for (auto& a : src.aggregates())
+    {
+        if (a.field() < ProcessProperties::FieldCount)
+            dest.aggregates.push_back({ static_cast<ProcessProperties::Field>(a.field()), a.sum(), a.max() });
+    }
+
+    return dest;
+}
+
+ProcessDelta unmarshalProcessDelta(const erebus::ProcessDelta& src)
+{
+    ProcessDelta dest;
+
+    dest.timestamp = src.timestamp();
+    dest.reset = src.reset();
+    dest.more = src.more();
+
+    dest.changed.reserve(src.changed_size());
+    for (auto& p : src.changed())
+        dest.changed.push_back(unmarshalProcessProperties(p));
+
+    dest.removed.reserve(src.removed_size());
+    for (auto pid : src.removed())
+        dest.removed.push_back(pid);
+
+    return dest;
+}
+
+void marshalSocketInfo(const SocketInfo& source, erebus::Socket& dest)
+{
+    dest.set_protocol(static_cast<std::uint32_t>(source.protocol));
+    dest.set_ipv6(source.ipv6);
+    dest.set_localaddress(source.localAddress);
+    dest.set_localport(source.localPort);
+    dest.set_remoteaddress(source.remoteAddress);
+    dest.set_remoteport(source.remotePort);
+    dest.set_state(source.state);
+    dest.set_uid(source.uid);
+    dest.set_inode(source.inode);
+
+    for (auto& o : source.owners)
+    {
+        auto out = dest.add_owners();
+        out->set_pid(o.pid);
+        out->set_fd(o.fd);
+    }
+}
+
+SocketInfo unmarshalSocketInfo(const erebus::Socket& src)
+{
+    SocketInfo dest;
+
+    dest.protocol = static_cast<SocketProtocol>(src.protocol());
+    dest.ipv6 = src.ipv6();
+    dest.localAddress = src.localaddress();
+    dest.localPort = static_cast<std::uint16_t>(src.localport());
+    dest.remoteAddress = src.remoteaddress();
+    dest.remotePort = static_cast<std::uint16_t>(src.remoteport());
+    dest.state = src.state();
+    dest.uid = src.uid();
+    dest.inode = src.inode();
+
+    dest.owners.reserve(src.owners_size());
+    for (auto& o : src.owners())
+        dest.owners.push_back({ o.pid(), o.fd() });
+
+    return dest;
+}
+
+void marshalOpenFile(const OpenFile& source, erebus::OpenFile& dest)
+{
+    dest.set_path(source.path);
+
+    for (auto& o : source.owners)
+    {
+        auto out = dest.add_owners();
+        out->set_pid(o.pid);
+        out->set_fd(o.fd);
+    }
+}
+
+OpenFile unmarshalOpenFile(const erebus::OpenFile& src)
+{
+    OpenFile dest;
+
+    dest.path = src.path();
+
+    dest.owners.reserve(src.owners_size());
+    for (auto& o : src.owners())
+        dest.owners.push_back({ o.pid(), o.fd() });
+
+    return dest;
 }
 
 } // namespace Er::ProcessTree {}
\ No newline at end of file
@@ -0,0 +1,135 @@
+#include "alert_monitor.hxx"
+
+#include <erebus/rtl/system/thread.hxx>
+#include <erebus/rtl/util/exception_util.hxx>
+
+#include <algorithm>
+
+
+namespace Er::ProcessTree::Private
+{
+
+AlertMonitor::~AlertMonitor()
+{
+    ErLogDebug2(m_log, "{}.AlertMonitor::~AlertMonitor()", Er::Format::ptr(this));
+
+    m_scanner.removeListener(m_listener);
+
+    m_holdTimer.request_stop();
+    m_holdTimer.join();
+}
+
+AlertMonitor::AlertMonitor(Linux::Scanner& scanner, const PropertyVector& rules, Log::ILogger* log)
+    : m_log(log)
+    , m_scanner(scanner)
+    , m_rules(rules)
+{
+    ErLogDebug2(m_log, "{}.AlertMonitor::AlertMonitor()", Er::Format::ptr(this));
+
+    for (std::size_t i = 0; i < m_rules.size(); ++i)
+        ErLogInfo2(m_log, "Loaded alert rule [{}]", m_rules.name(i));
+
+    m_holdTimer = std::jthread([this](std::stop_token stop) { holdTimer(stop); });
+    m_listener = m_scanner.addListener(m_rules.requiredFields(), [this](const SnapshotDelta& delta) { onDelta(delta); });
+}
+
+bool AlertMonitor::Subscriber::wants(const Alert& a) const noexcept
+{
+    return rules.empty() || (std::find(rules.begin(), rules.end(), a.rule) != rules.end());
+}
+
+AlertMonitor::SubscriptionId AlertMonitor::subscribe(std::vector<std::string>&& rules, Handler&& handler)
+{
+    std::lock_guard l(m_mutex);
+
+    Subscriber s{ std::move(rules), std::move(handler) };
+
+    std::vector<Alert> active;
+    m_rules.active(active);
+    for (auto& a : active)
+    {
+        if (s.wants(a))
+            s.handler(a);
+    }
+
+    auto id = m_nextId++;
+    m_subscribers.insert({ id, std::move(s) });
+    return id;
+}
+
+void AlertMonitor::unsubscribe(SubscriptionId id) noexcept
+{
+    std::lock_guard l(m_mutex);
+    m_subscribers.erase(id);
+}
+
+void AlertMonitor::onDelta(const SnapshotDelta& delta)
+{
+    {
+        std::lock_guard l(m_mutex);
+
+        evaluate(delta);
+        m_holdsKicked = true;
+    }
+
+    // there may be a new condition to time
+    m_holdsChanged.notify_one();
+}
+
+void AlertMonitor::holdTimer(std::stop_token stop)
+{
+    System::CurrentThread::setName("alert_holds");
+
+    std::unique_lock l(m_mutex);
+    while (!stop.stop_requested())
+    {
+        m_holdsKicked = false;
+
+        auto due = m_rules.nextDue();
+        if (!due)
+        {
+            m_holdsChanged.wait(l, stop, [this]() { return m_holdsKicked; });
+            continue;
+        }
+
+        auto now = Time::now();
+        if (due->value() > now)
+        {
+            m_holdsChanged.wait_for(l, stop, std::chrono::microseconds(due->value() - now), [this]() { return m_holdsKicked; });
+            continue;
+        }
+
+        // nothing has changed since the last scan, but some conditions have held long enough
+        SnapshotDelta tick;
+        tick.timestamp = Time(now);
+
+        Er::Util::ExceptionLogger xcptHandler(m_log);
+        try
+        {
+            evaluate(tick);
+        }
+        catch (...)
+        {
+            Er::dispatchException(std::current_exception(), xcptHandler);
+        }
+    }
+}
+
+void AlertMonitor::evaluate(const SnapshotDelta& delta)
+{
+    m_alerts.clear();
+    m_rules.evaluate(delta, m_alerts);
+
+    for (auto& a : m_alerts)
+    {
+        ErLogInfo2(m_log, "Alert [{}] {} for {} ({}): {}", a.rule, (a.state == Alert::State::Fired) ? "fired" : "resolved", a.pid, a.comm, a.details);
+
+        for (auto& s : m_subscribers)
+        {
+            if (s.second.wants(a))
+                s.second.handler(a);
+        }
+    }
+}
+
+} // namespace Er::ProcessTree::Private {}
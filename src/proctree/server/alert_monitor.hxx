@@ -0,0 +1,67 @@
+#pragma once
+
+#include <erebus/proctree/server/alert_rules.hxx>
+#include <erebus/rtl/log.hxx>
+
+#include "linux/scanner.hxx"
+
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+
+
+namespace Er::ProcessTree::Private
+{
+
+//
+// Feeds the scanner deltas into the alert rules and fans the resulting
+// alerts out to the subscribers. The scanner is silent while nothing changes,
+// so the conditions that have to hold for a while are timed here.
+//
+
+class AlertMonitor final
+    : public boost::noncopyable
+{
+public:
+    using Handler = std::function<void(const Alert&)>;
+    using SubscriptionId = std::uint64_t;
+
+    ~AlertMonitor();
+
+    AlertMonitor(Linux::Scanner& scanner, const PropertyVector& rules, Log::ILogger* log);
+
+    // currently active alerts are delivered to the handler before this returns;
+    // an empty rule list means 'all rules'
+    [[nodiscard]] SubscriptionId subscribe(std::vector<std::string>&& rules, Handler&& handler);
+    void unsubscribe(SubscriptionId id) noexcept;
+
+private:
+    struct Subscriber
+    {
+        std::vector<std::string> rules;
+        Handler handler;
+
+        bool wants(const Alert& a) const noexcept;
+    };
+
+    void onDelta(const SnapshotDelta& delta);
+    void evaluate(const SnapshotDelta& delta);
+    void holdTimer(std::stop_token stop);
+
+    Log::ILogger* const m_log;
+    Linux::Scanner& m_scanner;
+    std::mutex m_mutex;
+    AlertRules m_rules;
+    std::vector<Alert> m_alerts; // scratch buffer
+    SubscriptionId m_nextId = 1;
+    std::map<SubscriptionId, Subscriber> m_subscribers;
+    Linux::Scanner::ListenerId m_listener = 0;
+    std::condition_variable_any m_holdsChanged;
+    bool m_holdsKicked = false;
+    std::jthread m_holdTimer;
+};
+
+
+} // namespace Er::ProcessTree::Private {}
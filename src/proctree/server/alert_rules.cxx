@@ -0,0 +1,436 @@
+#include <erebus/proctree/server/alert_rules.hxx>
+#include <erebus/rtl/exception.hxx>
+#include <erebus/rtl/format.hxx>
+
+
+namespace Er::ProcessTree
+{
+
+namespace
+{
+
+enum class FieldKind
+{
+    Integer,
+    Real,
+    String
+};
+
+FieldKind fieldKind(ProcessProperties::Field f) noexcept
+{
+    switch (f)
+    {
+    case ProcessProperties::CpuUsage:
+        return FieldKind::Real;
+
+    case ProcessProperties::Comm:
+    case ProcessProperties::CmdLine:
+    case ProcessProperties::Exe:
+    case ProcessProperties::UserName:
+    case ProcessProperties::Env:
+        return FieldKind::String;
+
+    default:
+        break;
+    }
+
+    return FieldKind::Integer;
+}
+
+std::int64_t loadInteger(const ProcessProperties& p, ProcessProperties::Field f) noexcept
+{
+    switch (f)
+    {
+    case ProcessProperties::Pid: return static_cast<std::int64_t>(p.pid);
+    case ProcessProperties::PPid: return static_cast<std::int64_t>(p.ppid);
+    case ProcessProperties::PGrp: return static_cast<std::int64_t>(p.pgrp);
+    case ProcessProperties::Tpgid: return static_cast<std::int64_t>(p.tpgid);
+    case ProcessProperties::Session: return static_cast<std::int64_t>(p.session);
+    case ProcessProperties::Ruid: return static_cast<std::int64_t>(p.ruid);
+    case ProcessProperties::StartTime: return static_cast<std::int64_t>(p.startTime.value());
+    case ProcessProperties::State: return static_cast<std::int64_t>(p.state);
+    case ProcessProperties::ThreadCount: return static_cast<std::int64_t>(p.threadCount);
+    case ProcessProperties::STime: return static_cast<std::int64_t>(p.sTime.value());
+    case ProcessProperties::UTime: return static_cast<std::int64_t>(p.uTime.value());
+    case ProcessProperties::Tty: return static_cast<std::int64_t>(p.tty);
+    case ProcessProperties::Rss: return static_cast<std::int64_t>(p.rss);
+    default: break;
+    }
+
+    ErAssert(!"Not an integer field");
+    return 0;
+}
+
+std::string_view loadString(const ProcessProperties& p, ProcessProperties::Field f) noexcept
+{
+    switch (f)
+    {
+    case ProcessProperties::Comm: return p.comm;
+    case ProcessProperties::CmdLine: return p.cmdLine.raw;
+    case ProcessProperties::Exe: return p.exe;
+    case ProcessProperties::UserName: return p.userName;
+    case ProcessProperties::Env: return p.env.raw;
+    default: break;
+    }
+
+    ErAssert(!"Not a string field");
+    return {};
+}
+
+template <typename T>
+bool compare(const T& a, const T& b, auto op) noexcept
+{
+    using Op = decltype(op);
+
+    switch (op)
+    {
+    case Op::Eq: return a == b;
+    case Op::Ne: return a != b;
+    case Op::Lt: return a < b;
+    case Op::Le: return a <= b;
+    case Op::Gt: return a > b;
+    case Op::Ge: return a >= b;
+    default: break;
+    }
+
+    return false;
+}
+
+} // namespace {}
+
+
+AlertRules::AlertRules(const PropertyVector& config)
+{
+    for (auto& entry : config)
+    {
+        auto m = entry.getMap();
+        if (!m)
+            throw Exception(std::source_location::current(), Error(Result::BadConfiguration, GenericError), Exception::Message("Alert rule is not an object"));
+
+        Rule rule;
+
+        auto name = findProperty(*m, "name", Property::Type::String);
+        if (!name)
+            throw Exception(std::source_location::current(), Error(Result::BadConfiguration, GenericError), Exception::Message("Alert rule name expected"));
+
+        rule.name = *name->getString();
+
+        auto when = findProperty(*m, "when", Property::Type::Vector);
+        if (!when || when->getVector()->empty())
+            throw Exception(std::source_location::current(), Error(Result::BadConfiguration, GenericError), Exception::Message("Alert rule has no conditions"), ExceptionProperties::ObjectName(rule.name));
+
+        rule.first = static_cast<std::uint32_t>(m_plan.size());
+
+        for (auto& c : *when->getVector())
+        {
+            auto cm = c.getMap();
+            if (!cm)
+                throw Exception(std::source_location::current(), Error(Result::BadConfiguration, GenericError), Exception::Message("Alert rule condition is not an object"), ExceptionProperties::ObjectName(rule.name));
+
+            auto instruction = compile(*cm);
+            rule.fields.set(instruction.field);
+            m_plan.push_back(std::move(instruction));
+        }
+
+        rule.count = static_cast<std::uint32_t>(m_plan.size()) - rule.first;
+
+        auto hold = findProperty(*m, "for_ms", Property::Type::Int64);
+        if (hold)
+            rule.holdUs = Time::fromMilliseconds(*hold->getInt64()).value();
+
+        m_required |= rule.fields;
+        m_rules.push_back(std::move(rule));
+    }
+}
+
+AlertRules::Instruction AlertRules::compile(const PropertyMap& condition)
+{
+    Instruction instruction;
+
+    auto field = findProperty(condition, "field", Property::Type::String);
+    if (!field)
+        throw Exception(std::source_location::current(), Error(Result::BadConfiguration, GenericError), Exception::Message("Condition field expected"));
+
+    auto& fieldName = *field->getString();
+    auto& fields = ProcessProperties::fields();
+    auto fi = std::find_if(fields.begin(), fields.end(), [&fieldName](auto& f) { return f.name == fieldName; });
+    if (fi == fields.end())
+        throw Exception(std::source_location::current(), Error(Result::BadConfiguration, GenericError), Exception::Message("Unknown process property"), ExceptionProperties::ObjectName(fieldName));
+
+    instruction.field = static_cast<ProcessProperties::Field>(fi->id);
+
+    auto op = findProperty(condition, "op", Property::Type::String);
+    if (!op)
+        throw Exception(std::source_location::current(), Error(Result::BadConfiguration, GenericError), Exception::Message("Condition operator expected"), ExceptionProperties::ObjectName(fieldName));
+
+    auto& o = *op->getString();
+    if (o == "==")
+        instruction.op = Op::Eq;
+    else if (o == "!=")
+        instruction.op = Op::Ne;
+    else if (o == "<")
+        instruction.op = Op::Lt;
+    else if (o == "<=")
+        instruction.op = Op::Le;
+    else if (o == ">")
+        instruction.op = Op::Gt;
+    else if (o == ">=")
+        instruction.op = Op::Ge;
+    else if (o == "contains")
+        instruction.op = Op::Contains;
+    else
+        throw Exception(std::source_location::current(), Error(Result::BadConfiguration, GenericError), Exception::Message("Unknown condition operator"), ExceptionProperties::ObjectName(o));
+
+    auto value = findProperty(condition, "value");
+    if (!value)
+        throw Exception(std::source_location::current(), Error(Result::BadConfiguration, GenericError), Exception::Message("Condition value expected"), ExceptionProperties::ObjectName(fieldName));
+
+    auto kind = fieldKind(instruction.field);
+    if (kind == FieldKind::String)
+    {
+        if (value->type() != Property::Type::String)
+            throw Exception(std::source_location::current(), Error(Result::BadConfiguration, GenericError), Exception::Message("String value expected"), ExceptionProperties::ObjectName(fieldName));
+
+        instruction.type = OperandType::String;
+        instruction.string = *value->getString();
+    }
+    else
+    {
+        if (instruction.op == Op::Contains)
+            throw Exception(std::source_location::current(), Error(Result::BadConfiguration, GenericError), Exception::Message("'contains' applies to strings only"), ExceptionProperties::ObjectName(fieldName));
+
+        instruction.type = (kind == FieldKind::Real) ? OperandType::Real : OperandType::Integer;
+
+        if (value->type() == Property::Type::Int64)
+        {
+            instruction.integer = *value->getInt64();
+            instruction.real = static_cast<double>(instruction.integer);
+        }
+        else if (value->type() == Property::Type::Double)
+        {
+            instruction.real = *value->getDouble();
+            instruction.integer = static_cast<std::int64_t>(instruction.real);
+        }
+        else if ((instruction.field == ProcessProperties::State) && (value->type() == Property::Type::String) && (value->getString()->length() == 1))
+        {
+            // process state is a letter, e.g. "D"
+            instruction.integer = (*value->getString())[0];
+        }
+        else
+        {
+            throw Exception(std::source_location::current(), Error(Result::BadConfiguration, GenericError), Exception::Message("Numeric value expected"), ExceptionProperties::ObjectName(fieldName));
+        }
+    }
+
+    return instruction;
+}
+
+bool AlertRules::match(const Rule& rule, const ProcessProperties& props) const noexcept
+{
+    auto end = rule.first + rule.count;
+    for (auto i = rule.first; i < end; ++i)
+    {
+        auto& in = m_plan[i];
+
+        if (!props.valid(in.field))
+            return false;
+
+        bool result = false;
+        switch (in.type)
+        {
+        case OperandType::Integer:
+            result = compare(loadInteger(props, in.field), in.integer, in.op);
+            break;
+
+        case OperandType::Real:
+            result = compare(props.cpuUsage, in.real, in.op);
+            break;
+
+        case OperandType::String:
+        {
+            auto s = loadString(props, in.field);
+            if (in.op == Op::Contains)
+                result = (s.find(in.string) != s.npos);
+            else
+                result = compare(s, std::string_view(in.string), in.op);
+            break;
+        }
+        }
+
+        if (!result)
+            return false;
+    }
+
+    return true;
+}
+
+std::string AlertRules::describe(const Rule& rule, const ProcessProperties& props) const
+{
+    std::string out;
+
+    auto end = rule.first + rule.count;
+    for (auto i = rule.first; i < end; ++i)
+    {
+        auto& in = m_plan[i];
+
+        if (!out.empty())
+            out.append(", ");
+
+        out.append(props.name(in.field));
+        out.append("=");
+
+        if (in.field == ProcessProperties::State)
+            out.push_back(static_cast<char>(props.state));
+        else if (in.type == OperandType::Integer)
+            out.append(Er::format("{}", loadInteger(props, in.field)));
+        else if (in.type == OperandType::Real)
+            out.append(Er::format("{:.2f}", props.cpuUsage));
+        else if ((in.field == ProcessProperties::CmdLine) || (in.field == ProcessProperties::Env))
+            out.append("..."); // too long and not necessarily printable
+        else
+            out.append(loadString(props, in.field));
+    }
+
+    return out;
+}
+
+Alert AlertRules::makeAlert(Alert::State state, const Rule& rule, Pid pid, const Tracking& t, Time timestamp) const
+{
+    Alert a;
+    a.state = state;
+    a.rule = rule.name;
+    a.pid = pid;
+    a.comm = t.comm;
+    a.timestamp = timestamp;
+    a.since = t.since;
+    a.details = t.details;
+    return a;
+}
+
+void AlertRules::evaluate(const SnapshotDelta& delta, std::vector<Alert>& out)
+{
+    auto now = delta.timestamp;
+    auto ruleCount = static_cast<std::uint32_t>(m_rules.size());
+
+    for (auto pid : delta.removed)
+    {
+        for (std::uint32_t r = 0; r < ruleCount; ++r)
+        {
+            auto it = m_tracking.find(Key{ r, pid });
+            if (it == m_tracking.end())
+                continue;
+
+            if (it->second.fired)
+                out.push_back(makeAlert(Alert::State::Resolved, m_rules[r], pid, it->second, now));
+            else
+                --m_pending;
+
+            m_tracking.erase(it);
+        }
+    }
+
+    for (auto& change : delta.changed)
+    {
+        auto& props = *change.props;
+        auto pid = props.pid;
+
+        for (std::uint32_t r = 0; r < ruleCount; ++r)
+        {
+            auto& rule = m_rules[r];
+
+            // nothing this rule looks at has changed
+            if (!change.added && (change.fields & rule.fields).none())
+                continue;
+
+            Key key{ r, pid };
+            auto it = m_tracking.find(key);
+
+            if (match(rule, props))
+            {
+                if (it != m_tracking.end())
+                    continue; // still matching
+
+                Tracking t;
+                t.since = now;
+                if (props.valid(ProcessProperties::Comm))
+                    t.comm = props.comm;
+                t.details = describe(rule, props);
+
+                if (rule.holdUs == 0)
+                {
+                    t.fired = true;
+                    t.firedAt = now;
+                    out.push_back(makeAlert(Alert::State::Fired, rule, pid, t, now));
+                }
+                else
+                {
+                    ++m_pending;
+                }
+
+                m_tracking.emplace(key, std::move(t));
+            }
+            else if (it != m_tracking.end())
+            {
+                if (it->second.fired)
+                    out.push_back(makeAlert(Alert::State::Resolved, rule, pid, it->second, now));
+                else
+                    --m_pending;
+
+                m_tracking.erase(it);
+            }
+        }
+    }
+
+    if (!m_pending)
+        return;
+
+    // conditions that have held long enough fire even if nothing has changed
+    for (auto& [key, t] : m_tracking)
+    {
+        if (t.fired)
+            continue;
+
+        auto& rule = m_rules[key.rule];
+        if (now.value() - t.since.value() >= rule.holdUs)
+        {
+            t.fired = true;
+            t.firedAt = now;
+            --m_pending;
+
+            out.push_back(makeAlert(Alert::State::Fired, rule, key.pid, t, now));
+        }
+    }
+}
+
+std::optional<Time> AlertRules::nextDue() const noexcept
+{
+    if (!m_pending)
+        return std::nullopt;
+
+    std::optional<Time::ValueType> due;
+    for (auto& [key, t] : m_tracking)
+    {
+        if (t.fired)
+            continue;
+
+        auto at = t.since.value() + m_rules[key.rule].holdUs;
+        if (!due || (at < *due))
+            due = at;
+    }
+
+    if (!due)
+        return std::nullopt;
+
+    return Time(*due);
+}
+
+void AlertRules::active(std::vector<Alert>& out) const
+{
+    for (auto& [key, t] : m_tracking)
+    {
+        if (t.fired)
+            out.push_back(makeAlert(Alert::State::Fired, m_rules[key.rule], key.pid, t, t.firedAt));
+    }
+}
+
+} // namespace Er::ProcessTree {}
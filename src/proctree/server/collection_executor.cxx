@@ -0,0 +1,80 @@
+#include "collection_executor.hxx"
+
+#include <erebus/rtl/system/thread.hxx>
+#include <erebus/rtl/util/exception_util.hxx>
+
+
+namespace Er::ProcessTree::Private
+{
+
+CollectionExecutor::~CollectionExecutor()
+{
+    ErLogDebug2(m_log, "{}.CollectionExecutor::~CollectionExecutor()", Er::Format::ptr(this));
+
+    for (auto& w : m_workers)
+        w.request_stop();
+
+    m_workers.clear(); // joins
+}
+
+CollectionExecutor::CollectionExecutor(Linux::ProcFsRootPtr root, unsigned threads, std::size_t maxQueueSize, Log::ILogger* log)
+    : m_log(log)
+    , m_root(std::move(root))
+    , m_maxQueueSize(maxQueueSize)
+{
+    ErLogDebug2(m_log, "{}.CollectionExecutor::CollectionExecutor(threads={}, queue={})", Er::Format::ptr(this), threads, maxQueueSize);
+
+    ErAssert(threads > 0);
+
+    m_workers.reserve(threads);
+    for (unsigned i = 0; i < threads; ++i)
+        m_workers.emplace_back([this](std::stop_token stop) { run(stop); });
+}
+
+bool CollectionExecutor::trySubmit(Task&& task)
+{
+    {
+        std::lock_guard l(m_mutex);
+        if (m_tasks.size() >= m_maxQueueSize)
+            return false;
+
+        m_tasks.push_back(std::move(task));
+    }
+
+    m_taskAdded.notify_one();
+    return true;
+}
+
+void CollectionExecutor::run(std::stop_token stop)
+{
+    System::CurrentThread::setName("proctree_exec");
+
+    Linux::ProcFs procFs(m_root); // this thread's own reader
+
+    // queued tasks still run after a stop request since they own RPC reactors
+    for (;;)
+    {
+        Task task;
+        {
+            std::unique_lock l(m_mutex);
+            if (!m_taskAdded.wait(l, stop, [this]() { return !m_tasks.empty(); }))
+                break;
+
+            task = std::move(m_tasks.front());
+            m_tasks.pop_front();
+        }
+
+        Er::Util::ExceptionLogger xcptHandler(m_log);
+        try
+        {
+            task(procFs);
+        }
+        catch (...)
+        {
+            Er::dispatchException(std::current_exception(), xcptHandler);
+        }
+    }
+}
+
+
+} // namespace Er::ProcessTree::Private {}
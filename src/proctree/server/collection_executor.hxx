@@ -0,0 +1,63 @@
+#pragma once
+
+#include <erebus/proctree/server/linux/procfs.hxx>
+#include <erebus/rtl/log.hxx>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+
+namespace Er::ProcessTree::Private
+{
+
+//
+// A fixed pool of threads that do the blocking procfs I/O on behalf of the RPC
+// handlers, so that a slow /proc read never stalls the gRPC callback threads.
+// The queue is bounded; a full queue makes trySubmit() fail and the caller
+// is expected to reject the request. Each thread has its own procfs reader
+// over the shared root, so the tasks never contend for one.
+//
+
+class CollectionExecutor final
+    : public boost::noncopyable
+{
+public:
+    using Task = std::function<void(Linux::ProcFs&)>;
+
+    // runs whatever is still queued before returning
+    ~CollectionExecutor();
+
+    CollectionExecutor(Linux::ProcFsRootPtr root, unsigned threads, std::size_t maxQueueSize, Log::ILogger* log);
+
+    [[nodiscard]] bool trySubmit(Task&& task);
+
+    std::size_t threads() const noexcept
+    {
+        return m_workers.size();
+    }
+
+    std::size_t maxQueueSize() const noexcept
+    {
+        return m_maxQueueSize;
+    }
+
+private:
+    void run(std::stop_token stop);
+
+    Log::ILogger* const m_log;
+    const Linux::ProcFsRootPtr m_root;
+    const std::size_t m_maxQueueSize;
+    std::mutex m_mutex;
+    std::condition_variable_any m_taskAdded;
+    std::deque<Task> m_tasks;
+    std::vector<std::jthread> m_workers;
+};
+
+
+} // namespace Er::ProcessTree::Private {}
@@ -0,0 +1,217 @@
+#pragma once
+
+#include <grpcpp/grpcpp.h>
+
+#include <erebus/rtl/log.hxx>
+
+#include "../trace.hxx"
+
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+
+namespace Er::ProcessTree::Private
+{
+
+//
+// Server-side stream of events produced by some background source (PSI monitor,
+// alert rules, etc.). The source calls push() from its own thread; the events are
+// queued and written one at a time. A slow client either loses the oldest events
+// or, where every event matters (deltas), gets the stream closed with DATA_LOSS.
+//
+
+template <typename EventT, typename MessageT>
+class EventStreamReactor
+    : public grpc::ServerWriteReactor<MessageT>
+{
+public:
+    using Marshaller = void(*)(const EventT&, MessageT&);
+    using Unsubscriber = std::function<void()>;
+
+    enum class Overflow
+    {
+        DropOldest,
+        Abort
+    };
+
+    ~EventStreamReactor()
+    {
+        ProctreeTrace2(m_log, "{}.EventStreamReactor::~EventStreamReactor", Er::Format::ptr(this));
+    }
+
+    EventStreamReactor(Log::ILogger* log, Marshaller marshaller, std::size_t maxQueueSize = 64, Overflow overflow = Overflow::DropOldest) noexcept
+        : m_log(log)
+        , m_marshaller(marshaller)
+        , m_maxQueueSize(maxQueueSize)
+        , m_overflow(overflow)
+    {
+        ProctreeTrace2(m_log, "{}.EventStreamReactor::EventStreamReactor", Er::Format::ptr(this));
+    }
+
+    // must be called once the reactor has been subscribed to the source
+    void setUnsubscriber(Unsubscriber&& unsubscriber)
+    {
+        m_unsubscriber = std::move(unsubscriber);
+    }
+
+    void push(const EventT& ev)
+    {
+        std::lock_guard l(m_mutex);
+
+        if (m_finished || m_overflowed)
+            return;
+
+        if (m_queue.size() >= m_maxQueueSize + m_burst)
+        {
+            if (m_overflow == Overflow::Abort)
+            {
+                ErLogWarning2(m_log, "Event stream queue overflow; closing the stream");
+
+                m_overflowed = true;
+                m_queue.clear();
+                if (!m_writing)
+                    finish(overflowStatus());
+
+                return;
+            }
+
+            m_queue.pop_front();
+        }
+
+        m_queue.push_back(ev);
+
+        if (!m_writing)
+            writeNext();
+    }
+
+    // events that go out together (a table sent in chunks) and don't count as the client falling behind
+    void pushAll(std::vector<EventT>&& events)
+    {
+        std::lock_guard l(m_mutex);
+
+        if (m_finished || m_overflowed)
+            return;
+
+        m_burst += events.size();
+        for (auto& ev : events)
+            m_queue.push_back(std::move(ev));
+
+        if (!m_writing)
+            writeNext();
+    }
+
+    // no more events; the stream is finished with 'status' once the queue has been written out
+    void close(const grpc::Status& status)
+    {
+        std::lock_guard l(m_mutex);
+
+        if (m_finished || m_overflowed)
+            return;
+
+        m_closeStatus = status;
+        if (!m_writing && m_queue.empty())
+            finish(status);
+    }
+
+private:
+    void writeNext()
+    {
+        ErAssert(!m_writing);
+
+        if (m_queue.empty())
+        {
+            if (m_closeStatus)
+                finish(*m_closeStatus);
+
+            return;
+        }
+
+        m_reply.Clear();
+        m_marshaller(m_queue.front(), m_reply);
+        m_queue.pop_front();
+
+        if (m_burst > 0)
+            --m_burst;
+
+        m_writing = true;
+        this->StartWrite(&m_reply);
+    }
+
+    static grpc::Status overflowStatus()
+    {
+        return grpc::Status(grpc::StatusCode::DATA_LOSS, "The client is too slow to keep up with the events");
+    }
+
+    void finish(const grpc::Status& status)
+    {
+        if (m_finished)
+            return;
+
+        m_finished = true;
+        m_queue.clear();
+        this->Finish(status);
+    }
+
+    void unsubscribe() noexcept
+    {
+        if (m_unsubscriber)
+        {
+            m_unsubscriber();
+            m_unsubscriber = {};
+        }
+    }
+
+    void OnWriteDone(bool ok) override
+    {
+        ProctreeTraceIndent2(m_log, "{}.EventStreamReactor::OnWriteDone", Er::Format::ptr(this));
+
+        std::lock_guard l(m_mutex);
+        m_writing = false;
+
+        if (!ok)
+            finish(grpc::Status(grpc::StatusCode::CANCELLED, "Operation canceled"));
+        else if (m_overflowed)
+            finish(overflowStatus());
+        else if (!m_finished)
+            writeNext();
+    }
+
+    void OnDone() override
+    {
+        ProctreeTraceIndent2(m_log, "{}.EventStreamReactor::OnDone", Er::Format::ptr(this));
+
+        unsubscribe();
+        delete this;
+    }
+
+    void OnCancel() override
+    {
+        ProctreeTrace2(m_log, "{}.EventStreamReactor::OnCancel", Er::Format::ptr(this));
+
+        // must not hold m_mutex here: the source may be inside push()
+        unsubscribe();
+
+        std::lock_guard l(m_mutex);
+        finish(grpc::Status::CANCELLED);
+    }
+
+    Log::ILogger* m_log;
+    const Marshaller m_marshaller;
+    const std::size_t m_maxQueueSize;
+    const Overflow m_overflow;
+    Unsubscriber m_unsubscriber;
+    std::mutex m_mutex;
+    std::deque<EventT> m_queue;
+    std::size_t m_burst = 0; // pushAll() events yet to be written
+    bool m_writing = false;
+    bool m_finished = false;
+    bool m_overflowed = false;
+    std::optional<grpc::Status> m_closeStatus;
+    MessageT m_reply;
+};
+
+
+} // namespace Er::ProcessTree::Private {}
@@ -0,0 +1,115 @@
+#include <erebus/proctree/server/group_aggregator.hxx>
+
+#include <algorithm>
+
+
+namespace Er::ProcessTree
+{
+
+namespace
+{
+
+std::int64_t loadKey(const ProcessProperties& p, ProcessProperties::Field f) noexcept
+{
+    switch (f)
+    {
+    case ProcessProperties::Ruid: return static_cast<std::int64_t>(p.ruid);
+    case ProcessProperties::Session: return static_cast<std::int64_t>(p.session);
+    case ProcessProperties::PGrp: return static_cast<std::int64_t>(p.pgrp);
+    case ProcessProperties::Tty: return static_cast<std::int64_t>(p.tty);
+    default: break;
+    }
+
+    ErAssert(!"Not a group key");
+    return 0;
+}
+
+double loadValue(const ProcessProperties& p, ProcessProperties::Field f) noexcept
+{
+    switch (f)
+    {
+    case ProcessProperties::ThreadCount: return static_cast<double>(p.threadCount);
+    case ProcessProperties::STime: return static_cast<double>(p.sTime.value());
+    case ProcessProperties::UTime: return static_cast<double>(p.uTime.value());
+    case ProcessProperties::CpuUsage: return p.cpuUsage;
+    case ProcessProperties::Rss: return static_cast<double>(p.rss);
+    default: break;
+    }
+
+    ErAssert(!"Not an aggregatable field");
+    return 0.0;
+}
+
+} // namespace {}
+
+
+ProcessProperties::Field GroupAggregator::keyField(GroupKey key) noexcept
+{
+    switch (key)
+    {
+    case GroupKey::Session: return ProcessProperties::Session;
+    case GroupKey::PGrp: return ProcessProperties::PGrp;
+    case GroupKey::Tty: return ProcessProperties::Tty;
+    default: break;
+    }
+
+    return ProcessProperties::Ruid;
+}
+
+GroupAggregator::GroupAggregator(GroupKey key, const ProcessProperties::Mask& fields, std::size_t expectedGroups)
+    : m_keyField(keyField(key))
+{
+    m_required.set(m_keyField);
+
+    for (auto f : Aggregatable)
+    {
+        if (fields[f])
+        {
+            m_fields[m_fieldCount++] = f;
+            m_required.set(f);
+        }
+    }
+
+    m_groups.reserve(expectedGroups);
+}
+
+void GroupAggregator::add(const ProcessProperties& props) noexcept
+{
+    if (!props.valid(m_keyField))
+        return;
+
+    auto& acc = m_groups[loadKey(props, m_keyField)];
+    ++acc.count;
+
+    for (std::size_t i = 0; i < m_fieldCount; ++i)
+    {
+        auto f = m_fields[i];
+        if (!props.valid(f))
+            continue;
+
+        auto v = loadValue(props, f);
+        acc.sum[i] += v;
+        acc.max[i] = std::max(acc.max[i], v);
+    }
+}
+
+std::vector<GroupStats> GroupAggregator::result() const
+{
+    std::vector<GroupStats> out;
+    out.reserve(m_groups.size());
+
+    for (auto& [key, acc] : m_groups)
+    {
+        auto& g = out.emplace_back();
+        g.key = key;
+        g.count = acc.count;
+
+        g.aggregates.reserve(m_fieldCount);
+        for (std::size_t i = 0; i < m_fieldCount; ++i)
+            g.aggregates.push_back({ m_fields[i], acc.sum[i], acc.max[i] });
+    }
+
+    return out;
+}
+
+} // namespace Er::ProcessTree {}
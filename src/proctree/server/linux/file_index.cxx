@@ -0,0 +1,327 @@
+#include <erebus/proctree/server/linux/file_index.hxx>
+#include <erebus/rtl/system/thread.hxx>
+#include <erebus/rtl/util/exception_util.hxx>
+
+#include <algorithm>
+
+
+namespace Er::ProcessTree::Linux
+{
+
+namespace
+{
+
+// a map node, an owner record and a ProcessFile per descriptor; only a rough estimate
+constexpr std::size_t EntryOverhead = 128;
+
+} // namespace {}
+
+
+FileIndex::~FileIndex()
+{
+    ErLogDebug2(m_log, "{}.FileIndex::~FileIndex()", Er::Format::ptr(this));
+
+    if (m_worker.joinable())
+    {
+        m_worker.request_stop();
+        m_worker.join();
+    }
+}
+
+FileIndex::FileIndex(ProcFsRootPtr procFsRoot, const Options& options, Log::ILogger* log)
+    : m_log(log)
+    , m_options(options)
+    , m_procFs(std::move(procFsRoot))
+{
+    ErLogDebug2(m_log, "{}.FileIndex::FileIndex(interval={} ms, resync={} s, budget={} KB)", Er::Format::ptr(this), m_options.interval.count(), m_options.resync.count(), m_options.budget / 1024);
+
+    if (m_options.interval.count() > 0)
+        m_worker = std::jthread([this](std::stop_token stop) { run(stop); });
+}
+
+void FileIndex::run(std::stop_token stop)
+{
+    System::CurrentThread::setName("file_index");
+
+    while (!stop.stop_requested())
+    {
+        Er::Util::ExceptionLogger xcptHandler(m_log);
+        try
+        {
+            refresh();
+        }
+        catch (...)
+        {
+            Er::dispatchException(std::current_exception(), xcptHandler);
+        }
+
+        std::unique_lock l(m_sleepMutex);
+        m_sleep.wait_for(l, stop, m_options.interval, []() { return false; });
+    }
+}
+
+void FileIndex::drop(Pid pid, Process& process)
+{
+    if (!process.indexed)
+        return;
+
+    for (auto& f : process.files)
+    {
+        auto& owners = f.path->second;
+        std::erase_if(owners, [pid, fd = f.fd](const OpenFile::Owner& o) { return (o.pid == pid) && (o.fd == fd); });
+        if (owners.empty())
+            m_paths.erase(f.path);
+    }
+
+    m_usage -= process.cost;
+    m_byAge.erase({ process.startTime.value(), pid });
+
+    process.files.clear();
+    process.cost = 0;
+    process.indexed = false;
+}
+
+void FileIndex::insert(Pid pid, Process& process, Rescanned& r)
+{
+    ErAssert(!process.indexed);
+
+    process.files.reserve(r.files.size());
+    for (auto& link : r.files)
+    {
+        auto it = m_paths.try_emplace(std::move(link.target)).first;
+        it->second.push_back(OpenFile::Owner{ pid, link.fd });
+        process.files.push_back(ProcessFile{ link.fd, it });
+    }
+
+    process.cost = r.cost;
+    process.indexed = true;
+    m_usage += r.cost;
+    m_byAge.insert({ process.startTime.value(), pid });
+}
+
+bool FileIndex::fits(Time startTime, Pid pid, std::size_t cost) const
+{
+    if (m_usage + cost <= m_options.budget)
+        return true;
+
+    if (cost > m_options.budget)
+        return false;
+
+    // only younger processes can be pushed out
+    auto key = std::make_pair(startTime.value(), pid);
+    std::size_t reclaimable = 0;
+    for (auto it = m_byAge.rbegin(); (it != m_byAge.rend()) && (key < *it); ++it)
+    {
+        auto younger = m_processes.find(it->second);
+        ErAssert(younger != m_processes.end());
+
+        reclaimable += younger->second.cost;
+        if (m_usage - reclaimable + cost <= m_options.budget)
+            return true;
+    }
+
+    return false;
+}
+
+bool FileIndex::makeRoom(const Rescanned& r)
+{
+    // see whether that would be enough before touching anything
+    if (!fits(r.startTime, r.pid, r.cost))
+        return false;
+
+    while (m_usage + r.cost > m_options.budget)
+    {
+        // pushed out, so it counts as left out and gets another chance later
+        auto youngest = std::prev(m_byAge.end())->second;
+        auto& p = m_processes[youngest];
+        auto cost = p.cost;
+        drop(youngest, p);
+
+        p.dirty = true;
+        p.wanted = cost;
+    }
+
+    return true;
+}
+
+void FileIndex::refresh()
+{
+    auto started = Time::now();
+
+    auto pids = m_procFs.enumeratePids();
+    if (!pids.has_value())
+    {
+        ErLogError2(m_log, "Failed to enumerate processes: {}", pids.error().message());
+        return;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    bool resync = (now - m_lastResync >= m_options.resync);
+    if (resync)
+        m_lastResync = now;
+
+    ++m_generation;
+
+    std::vector<Rescanned> rescanned;
+
+    for (auto pid : pids.value())
+    {
+        auto fdCount = m_procFs.readFdCount(pid);
+        if (!fdCount.has_value())
+            continue; // gone
+
+        auto stat = m_procFs.readStat(pid);
+        if (!stat.has_value())
+            continue;
+
+        auto startTime = stat.value().startTime;
+
+        auto it = m_processes.find(pid);
+        if (it != m_processes.end())
+        {
+            auto& p = it->second;
+            p.generation = m_generation;
+
+            // a PID reused since the last refresh belongs to a different process, which is indexed afresh
+            bool reused = (p.startTime.value() != startTime.value());
+
+            // left out last time; there may be room for it now that others have gone or grown smaller
+            bool retry = p.dirty && fits(startTime, pid, p.wanted);
+
+            // without fd counts (before 6.2) only a resync picks up the changes
+            if (!resync && !reused && !retry && (fdCount.value() == p.fdCount))
+                continue;
+        }
+
+        rescanned.push_back(Rescanned{ pid, fdCount.value(), startTime, {}, 0 });
+    }
+
+    // the oldest get the budget first
+    std::sort(rescanned.begin(), rescanned.end(), [](const Rescanned& a, const Rescanned& b)
+    {
+        return std::make_pair(a.startTime.value(), a.pid) < std::make_pair(b.startTime.value(), b.pid);
+    });
+
+    // the slow part goes without the lock; queries see the previous state meanwhile
+    for (auto& r : rescanned)
+    {
+        auto fds = m_procFs.readFds(r.pid);
+        if (!fds.has_value())
+            continue;
+
+        r.files = std::move(fds.value());
+
+        // sockets, pipes, anon inodes etc don't live in the file system
+        std::erase_if(r.files, [](const ProcFs::FdLink& link) { return !link.target.starts_with('/'); });
+
+        for (auto& link : r.files)
+            r.cost += link.target.size() + EntryOverhead;
+    }
+
+    std::size_t skipped = 0;
+    {
+        std::unique_lock l(m_mutex);
+
+        // the dead go first to free their share of the budget
+        for (auto it = m_processes.begin(); it != m_processes.end();)
+        {
+            if (it->second.generation != m_generation)
+            {
+                drop(it->first, it->second);
+                it = m_processes.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+
+        for (auto& r : rescanned)
+        {
+            auto& p = m_processes[r.pid];
+            drop(r.pid, p);
+
+            p.fdCount = r.fdCount;
+            p.startTime = r.startTime;
+            p.generation = m_generation;
+
+            if (makeRoom(r))
+            {
+                insert(r.pid, p, r);
+                p.dirty = false;
+                p.wanted = 0;
+            }
+            else
+            {
+                p.dirty = true;
+                p.wanted = r.cost;
+            }
+        }
+
+        for (auto& [pid, p] : m_processes)
+        {
+            if (p.dirty)
+                ++skipped;
+        }
+
+        if (skipped && !m_skipped)
+            ErLogWarning2(m_log, "The open file index is over its budget of {} KB; {} processes are left out", m_options.budget / 1024, skipped);
+
+        m_skipped = skipped;
+    }
+
+    ErLogDebug2(m_log, "File index: {} paths, {} KB, {} of {} processes rescanned in {} us", m_paths.size(), m_usage / 1024, rescanned.size(), m_processes.size(), Time::now() - started);
+}
+
+std::size_t FileIndex::memoryUsage() const noexcept
+{
+    std::shared_lock l(m_mutex);
+    return m_usage;
+}
+
+bool FileIndex::collect(Paths::const_iterator it, std::size_t limit, OpenFileList& result) const
+{
+    if (result.files.size() >= limit)
+    {
+        result.truncated = true;
+        return false;
+    }
+
+    result.files.push_back(OpenFile{ it->first, it->second });
+    return true;
+}
+
+OpenFileList FileIndex::find(std::string_view prefix, std::size_t limit) const
+{
+    while ((prefix.size() > 1) && prefix.ends_with('/'))
+        prefix.remove_suffix(1);
+
+    // "/mnt/data" is matched by itself and "/mnt/data/..." but not by "/mnt/database"
+    std::string dir(prefix);
+    if (!dir.ends_with('/'))
+        dir.push_back('/');
+
+    OpenFileList result;
+
+    std::shared_lock l(m_mutex);
+
+    result.partial = (m_skipped > 0);
+
+    if (dir.size() > prefix.size())
+    {
+        auto exact = m_paths.find(prefix);
+        if ((exact != m_paths.end()) && !collect(exact, limit, result))
+            return result;
+    }
+
+    for (auto it = m_paths.lower_bound(dir); (it != m_paths.end()) && it->first.starts_with(dir); ++it)
+    {
+        if (!collect(it, limit, result))
+            break;
+    }
+
+    return result;
+}
+
+
+} // namespace Er::ProcessTree::Linux {}
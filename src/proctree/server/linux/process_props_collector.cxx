@@ -2,6 +2,10 @@
 
 #include <erebus/rtl/system/user.hxx>
 
+#include <algorithm>
+
+#include <unistd.h>
+
 
 namespace Er::ProcessTree::Linux
 {
@@ -27,20 +31,85 @@ std::string lookupUserName(std::uint64_t uid)
 } // namespace {}
 
 
+ReadPlan planReads(const ProcessProperties::Mask& mask) noexcept
+{
+    static const ProcessProperties::Mask StatFields =
+    {
+        ProcessProperties::PPid,
+        ProcessProperties::PGrp,
+        ProcessProperties::Tpgid,
+        ProcessProperties::Session,
+        ProcessProperties::StartTime,
+        ProcessProperties::State,
+        ProcessProperties::ThreadCount,
+        ProcessProperties::STime,
+        ProcessProperties::UTime,
+        ProcessProperties::Tty,
+        ProcessProperties::Rss
+    };
+
+    static const ProcessProperties::Mask OwnerFields =
+    {
+        ProcessProperties::Ruid,
+        ProcessProperties::UserName
+    };
+
+    ReadPlan plan;
+    plan.stat = (mask & StatFields).any();
+    plan.owner = !plan.stat && (mask & OwnerFields).any(); // readStat() gets the owner anyway
+    plan.comm = mask[ProcessProperties::Comm];
+    plan.cmdLine = mask[ProcessProperties::CmdLine];
+    plan.exe = mask[ProcessProperties::Exe];
+    plan.env = mask[ProcessProperties::Env];
+
+    // something has to tell us the process exists
+    if (!plan.stat && !plan.owner && !plan.comm && !plan.cmdLine && !plan.exe && !plan.env)
+        plan.owner = true;
+
+    return plan;
+}
+
 std::expected<ProcessProperties, Error> collectProcessProps(Linux::ProcFs& procFs, Pid pid, const ProcessProperties::Mask& mask, Log::ILogger* log)
 {
+    auto plan = planReads(mask);
+
     ProcessProperties out;
+    ErSet(ProcessProperties, Pid, out, pid, pid);
+
+    ProcFs::Stat stat;
+    if (plan.stat)
+    {
+        auto stat_ = procFs.readStat(pid);
+        if (!stat_.has_value())
+        {
+            ErLogWarning2(log, "Could not read /proc/{}/stat: {}", pid, stat_.error().message());
+            return std::unexpected(stat_.error());
+        }
 
-    auto stat_ = procFs.readStat(pid);
-    if (!stat_.has_value())
+        stat = std::move(stat_.value());
+    }
+    else if (plan.owner)
     {
-        ErLogWarning2(log, "Could not read /proc/{}/stat: {}", pid, stat_.error().message());
-        return std::unexpected(stat_.error());
+        auto ruid_ = procFs.readRuid(pid);
+        if (!ruid_.has_value())
+            return std::unexpected(ruid_.error());
+
+        stat.ruid = ruid_.value();
     }
 
-    auto& stat = stat_.value();
+    // without stat or owner reads, a failed read may just mean the process is gone
+    auto exists = [&procFs, &plan, pid]() -> std::expected<void, Error>
+    {
+        if (plan.stat || plan.owner)
+            return {};
 
-    ErSet(ProcessProperties, Pid, out, pid, stat.pid);
+        auto probe = procFs.readRuid(pid);
+        if (!probe.has_value())
+            return std::unexpected(probe.error());
+
+        plan.owner = true; // don't probe twice
+        return {};
+    };
     
     if (mask[ProcessProperties::PPid])
         ErSet(ProcessProperties, PPid, out, ppid, stat.ppid);
@@ -57,13 +126,18 @@ std::expected<ProcessProperties, Error> collectProcessProps(Linux::ProcFs& procF
     if (mask[ProcessProperties::Ruid])
         ErSet(ProcessProperties, Ruid, out, ruid, stat.ruid);
 
-    if (mask[ProcessProperties::Comm])
+    if (plan.comm)
     {
         auto comm_ = procFs.readComm(pid);
         if (!comm_.has_value())
         {
+            auto e = exists();
+            if (!e)
+                return std::unexpected(e.error());
+
             ErLogWarning2(log, "Could not read /proc/{}/comm: {}", pid, comm_.error().message());
-            ErSet(ProcessProperties, Comm, out, comm, std::move(stat.comm));
+            if (plan.stat)
+                ErSet(ProcessProperties, Comm, out, comm, std::move(stat.comm));
         }
         else
         {
@@ -71,11 +145,15 @@ std::expected<ProcessProperties, Error> collectProcessProps(Linux::ProcFs& procF
         }
     }
 
-    if (mask[ProcessProperties::CmdLine])
+    if (plan.cmdLine)
     {
         auto cmd_ = procFs.readCmdLine(pid);
         if (!cmd_.has_value())
         {
+            auto e = exists();
+            if (!e)
+                return std::unexpected(e.error());
+
             ErLogWarning2(log, "Could not read /proc/{}/cmdline: {}", pid, cmd_.error().message());
         }
         else
@@ -84,11 +162,15 @@ std::expected<ProcessProperties, Error> collectProcessProps(Linux::ProcFs& procF
         }
     }
 
-    if (mask[ProcessProperties::Exe])
+    if (plan.exe)
     {
         auto exe_ = procFs.readExePath(pid);
         if (!exe_.has_value())
         {
+            auto e = exists();
+            if (!e)
+                return std::unexpected(e.error());
+
             ErLogWarning2(log, "Could not read /proc/{}/exe: {}", pid, exe_.error().message());
         }
         else if (!exe_.value().empty())
@@ -121,12 +203,22 @@ std::expected<ProcessProperties, Error> collectProcessProps(Linux::ProcFs& procF
 
     if (mask[ProcessProperties::Tty])
         ErSet(ProcessProperties, Tty, out, tty, stat.tty_nr);
+
+    if (mask[ProcessProperties::Rss])
+    {
+        static const auto PageSize = static_cast<std::uint64_t>(::sysconf(_SC_PAGESIZE));
+        ErSet(ProcessProperties, Rss, out, rss, static_cast<std::uint64_t>(std::max<std::int64_t>(stat.rss, 0)) * PageSize);
+    }
         
-    if (mask[ProcessProperties::Env])
+    if (plan.env)
     {
         auto env_ = procFs.readEnv(pid);
         if (!env_.has_value())
         {
+            auto e = exists();
+            if (!e)
+                return std::unexpected(e.error());
+
             ErLogWarning2(log, "Could not read /proc/{}/env: {}", pid, env_.error().message());
         }
         else if (!env_.value().raw.empty())
@@ -138,4 +230,48 @@ std::expected<ProcessProperties, Error> collectProcessProps(Linux::ProcFs& procF
     return { std::move(out) };
 }
 
+std::vector<ProcessProperties> collectProcessProps(Linux::ProcFs& procFs, std::span<const Pid> pids, const ProcessProperties::Mask& mask, Log::ILogger* log)
+{
+    std::vector<ProcessProperties> result;
+    result.reserve(pids.size());
+
+    // /proc/<pid>/exe is a symlink and io_uring has no readlink
+    auto plan = planReads(mask);
+    unsigned files = 0;
+    if (plan.stat)
+        files |= ProcFs::PrefetchStat | ProcFs::PrefetchOwner;
+    if (plan.owner)
+        files |= ProcFs::PrefetchOwner;
+    if (plan.comm)
+        files |= ProcFs::PrefetchComm;
+    if (plan.cmdLine)
+        files |= ProcFs::PrefetchCmdLine;
+    if (plan.env)
+        files |= ProcFs::PrefetchEnv;
+
+    auto batch = procFs.prefetchCapacity(files);
+    if (!batch)
+        batch = pids.size();
+
+    while (!pids.empty())
+    {
+        auto chunk = pids.first(std::min(batch, pids.size()));
+        procFs.prefetch(chunk, files);
+
+        for (auto pid : chunk)
+        {
+            auto props = collectProcessProps(procFs, pid, mask, log);
+            if (props.has_value())
+                result.push_back(std::move(props.value()));
+        }
+
+        pids = pids.subspan(chunk.size());
+    }
+
+    // don't let stale data outlive the batch
+    procFs.prefetch({}, 0);
+
+    return result;
+}
+
 } // namespace Er::ProcessTree::Linux {}
\ No newline at end of file
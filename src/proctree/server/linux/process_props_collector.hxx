@@ -5,9 +5,32 @@
 
 #include <erebus/rtl/log.hxx>
 
+#include <span>
+#include <vector>
+
 namespace Er::ProcessTree::Linux
 {
 
+//
+// Which procfs files a mask needs; e.g. Comm and Exe alone don't need /proc/<pid>/stat
+//
+
+struct ReadPlan
+{
+    bool stat = false;      // /proc/<pid>/stat (+ owner)
+    bool owner = false;     // stat() on /proc/<pid>
+    bool comm = false;
+    bool cmdLine = false;
+    bool exe = false;
+    bool env = false;
+};
+
+ReadPlan planReads(const ProcessProperties::Mask& mask) noexcept;
+
 std::expected<ProcessProperties, Error> collectProcessProps(Linux::ProcFs& procFs, Pid pid, const ProcessProperties::Mask& mask, Log::ILogger* log);
 
+// the same for many processes; prefetches their files in batches if the reader can do that
+// and skips the processes that have gone
+std::vector<ProcessProperties> collectProcessProps(Linux::ProcFs& procFs, std::span<const Pid> pids, const ProcessProperties::Mask& mask, Log::ILogger* log);
+
 } // namespace Er::ProcessTree::Linux {}
\ No newline at end of file
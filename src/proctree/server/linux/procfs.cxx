@@ -1,39 +1,218 @@
+#include "uring_reader.hxx"
+
 #include <erebus/proctree/server/linux/procfs.hxx>
 #include <erebus/rtl/exception.hxx>
 #include <erebus/rtl/format.hxx>
-#include <erebus/rtl/util/auto_ptr.hxx>
-#include <erebus/rtl/util/file.hxx>
 #include <erebus/rtl/util/string_util.hxx>
 
+#include <bit>
+#include <charconv>
+#include <climits>
+#include <cstring>
 #include <fstream>
-#include <sstream>
 
-#include <dirent.h>
+#include <fcntl.h>
 #include <sys/stat.h>
 #include <sys/sysinfo.h>
+#include <unistd.h>
 
 namespace Er::ProcessTree::Linux
 {
 
-namespace 
+ProcFsRoot::ProcFsRoot(std::string_view path)
+    : m_path(path)
+    , m_fd(::open(m_path.c_str(), O_PATH | O_DIRECTORY | O_CLOEXEC))
+    , m_bootTime(getBootTimeImpl())
+    , m_ticksPerSecond(::sysconf(_SC_CLK_TCK))
+    , m_cpusMax(::get_nprocs_conf())
+{
+    ErAssert(m_cpusMax > 0);
+    ErAssert(m_ticksPerSecond > 0);
+
+    if (!m_fd.valid() || (::access(m_path.c_str(), R_OK) == -1))
+    {
+        throw Exception(std::source_location::current(), Error(int(errno), PosixError), ExceptionProperties::ObjectName(m_path));
+    }
+}
+
+std::uint64_t ProcFsRoot::getBootTimeImpl()
 {
+    auto path = m_path;
+    path.append("/stat");
+
+    std::ifstream stream(path);
+    if (!stream.good())
+    {
+        throw Exception(std::source_location::current(), Error(int(errno), PosixError), ExceptionProperties::ObjectName(path));
+    }
+
+    std::string s;
+    while (std::getline(stream, s))
+    {
+        if (s.find("btime") == 0)
+        {
+            auto remainder = s.substr(6);
+            if (!remainder.empty())
+            {
+                return std::strtoull(remainder.c_str(), nullptr, 10);
+            }
+
+            break;
+        }
+    }
+
+    throw Exception(std::source_location::current(), Error(Result::InvalidInput, GenericError), Exception::Message("No \'btime\' field in /proc/stat"), ExceptionProperties::ObjectName(path));
+}
+
+
+namespace
+{
+
+constexpr unsigned UringSlots = 128;
+constexpr std::size_t UringSlotSize = 4096;
+
+constexpr std::uint64_t prefetchKey(Pid pid, ProcFs::PrefetchFile file) noexcept
+{
+    return (std::uint64_t(pid) << 8) | file;
+}
+
+std::string_view nextToken(std::string_view& s) noexcept
+{
+    auto begin = s.find_first_not_of(" \t");
+    if (begin == std::string_view::npos)
+    {
+        s = {};
+        return {};
+    }
+
+    auto end = s.find_first_of(" \t", begin);
+    if (end == std::string_view::npos)
+        end = s.size();
+
+    auto token = s.substr(begin, end - begin);
+    s.remove_prefix(end);
+    return token;
+}
+
+// "0100007F:0035" or "00000000000000000000000001000000:0035"; the kernel prints
+// every 32-bit word of the address as a native integer
+bool parseNetEndpoint(std::string_view s, std::array<std::uint8_t, 16>& address, std::uint16_t& port) noexcept
+{
+    auto colon = s.find(':');
+    if ((colon != 8) && (colon != 32))
+        return false;
+
+    auto words = colon / 8;
+    auto dest = address.data() + (16 - words * 4);
+    for (std::size_t i = 0; i < words; ++i)
+    {
+        std::uint32_t word = 0;
+        auto first = s.data() + i * 8;
+        if (std::from_chars(first, first + 8, word, 16).ec != std::errc())
+            return false;
+
+        std::memcpy(dest + i * 4, &word, sizeof(word));
+    }
 
-using DirHolder = Er::Util::AutoPtr<DIR, decltype([](DIR* d) { ::closedir(d); })>;
+    if (words == 1)
+    {
+        // IPv4-mapped
+        std::fill(address.begin(), address.begin() + 10, 0);
+        address[10] = 0xff;
+        address[11] = 0xff;
+    }
+
+    auto p = s.substr(colon + 1);
+    return std::from_chars(p.data(), p.data() + p.size(), port, 16).ec == std::errc();
+}
 
 } // namespace {}
 
 
+ProcFs::~ProcFs() = default;
+
 ProcFs::ProcFs(std::string_view procFsRoot)
-    : m_procFsRoot(procFsRoot)
-    , m_bootTime(getBootTimeImpl())
-    , m_cpusMax(::get_nprocs_conf())
+    : ProcFs(std::make_shared<const ProcFsRoot>(procFsRoot))
 {
-    ErAssert(m_cpusMax > 0);
+}
+
+ProcFs::ProcFs(ProcFsRootPtr root, bool ioUring)
+    : m_root(std::move(root))
+    , m_buffer(4096)
+{
+    ErAssert(m_root);
+
+    if (ioUring)
+        m_uring = UringReader::tryCreate(m_root->fd(), UringSlots, UringSlotSize);
+}
+
+std::size_t ProcFs::prefetchCapacity(unsigned files) const noexcept
+{
+    auto perPid = std::popcount(files);
+    if (!m_uring || !perPid)
+        return 0;
+
+    return m_uring->slots() / perPid;
+}
+
+void ProcFs::prefetch(std::span<const Pid> pids, unsigned files)
+{
+    m_prefetched.clear();
+
+    if (!m_uring || pids.empty() || !files)
+        return;
+
+    ErAssert(pids.size() <= prefetchCapacity(files));
 
-    if (::access(m_procFsRoot.c_str(), R_OK) == -1)
+    static constexpr struct
     {
-        throw Exception(std::source_location::current(), Error(int(errno), PosixError), ExceptionProperties::ObjectName(m_procFsRoot));
+        PrefetchFile file;
+        std::string_view name;
+    } Files[] =
+    {
+        { PrefetchStat, "stat" },
+        { PrefetchOwner, {} },
+        { PrefetchComm, "comm" },
+        { PrefetchCmdLine, "cmdline" },
+        { PrefetchEnv, "environ" },
+    };
+
+    unsigned slot = 0;
+    for (auto pid : pids)
+    {
+        for (auto& f : Files)
+        {
+            if (!(files & f.file))
+                continue;
+
+            if (f.file == PrefetchOwner)
+                m_uring->queueStat(slot, makePath(pid, f.name));
+            else
+                m_uring->queueRead(slot, makePath(pid, f.name));
+
+            m_prefetched.insert({ prefetchKey(pid, f.file), slot });
+            ++slot;
+        }
     }
+
+    if (!m_uring->run())
+    {
+        // the ring is in an unknown state; go synchronous from now on
+        m_prefetched.clear();
+        m_uring.reset();
+    }
+}
+
+std::optional<unsigned> ProcFs::prefetched(Pid pid, PrefetchFile file) const noexcept
+{
+    if (m_prefetched.empty())
+        return std::nullopt;
+
+    auto it = m_prefetched.find(prefetchKey(pid, file));
+    if (it == m_prefetched.end())
+        return std::nullopt;
+
+    return it->second;
 }
 
 Time ProcFs::timeFromTicks(std::uint64_t ticks) noexcept
@@ -44,6 +223,83 @@ Time ProcFs::timeFromTicks(std::uint64_t ticks) noexcept
     return Time::fromMilliseconds(ticks * 1000 / TicksPerSecond);
 }
 
+const char* ProcFs::makePath(Pid pid, std::string_view file) noexcept
+{
+    // no allocations here: "<pid>/<file>" always fits
+    auto p = m_path;
+    auto end = m_path + sizeof(m_path) - 1;
+
+    if (pid != KernelPid)
+    {
+        p = std::to_chars(p, end, pid).ptr;
+        if (!file.empty())
+            *p++ = '/';
+    }
+    else if (file.empty())
+    {
+        *p++ = '.';
+    }
+
+    ErAssert(std::size_t(end - p) > file.length());
+    p = std::copy(file.begin(), file.end(), p);
+    *p = '\0';
+
+    return m_path;
+}
+
+std::expected<std::string_view, Error> ProcFs::load(const char* path)
+{
+    Util::FileHandle file(::openat(m_root->fd(), path, O_RDONLY | O_CLOEXEC));
+    if (!file.valid())
+    {
+        return std::unexpected(Error(errno, PosixError));
+    }
+
+    // procfs files report zero size so there's no point in fstat()
+    std::size_t length = 0;
+    for (;;)
+    {
+        if (length + 1 >= m_buffer.size())
+            m_buffer.resize(m_buffer.size() * 2);
+
+        auto rd = ::read(file.get(), m_buffer.data() + length, m_buffer.size() - length - 1);
+        if (rd < 0)
+        {
+            if (errno == EINTR)
+                continue;
+
+            return std::unexpected(Error(errno, PosixError));
+        }
+
+        if (rd == 0)
+            break;
+
+        length += rd;
+    }
+
+    // keep the C string functions within bounds
+    m_buffer[length] = '\0';
+
+    return std::string_view(m_buffer.data(), length);
+}
+
+std::expected<std::string_view, Error> ProcFs::load(Pid pid, PrefetchFile file, std::string_view name)
+{
+    auto slot = prefetched(pid, file);
+    if (slot)
+    {
+        auto r = m_uring->result(*slot);
+        if (r < 0)
+            return std::unexpected(Error(-r, PosixError));
+
+        // too large for a slot; read it the usual way
+        if (!m_uring->truncated(*slot))
+            return m_uring->data(*slot);
+    }
+
+    return load(makePath(pid, name));
+}
+
 std::expected<std::vector<Pid>, Error> ProcFs::enumeratePids()
 {
     std::vector<Pid> result;
@@ -53,13 +309,29 @@ std::expected<std::vector<Pid>, Error> ProcFs::enumeratePids()
         reserve = 512;
     result.reserve(reserve);
 
-    DirHolder dir(::opendir(m_procFsRoot.c_str()));
-    if (!dir)
+    if (!m_dir)
     {
-        return std::unexpected(Error(errno, PosixError));
+        auto fd = ::openat(m_root->fd(), ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd == -1)
+        {
+            return std::unexpected(Error(errno, PosixError));
+        }
+
+        m_dir.reset(::fdopendir(fd));
+        if (!m_dir)
+        {
+            auto e = errno;
+            ::close(fd);
+            return std::unexpected(Error(e, PosixError));
+        }
+    }
+    else
+    {
+        // procfs regenerates the listing on rewind
+        ::rewinddir(m_dir.get());
     }
 
-    for (auto ent = ::readdir(dir); ent != nullptr; ent = ::readdir(dir))
+    for (auto ent = ::readdir(m_dir.get()); ent != nullptr; ent = ::readdir(m_dir.get()))
     {
         if (!std::isdigit(ent->d_name[0]))
             continue;
@@ -81,30 +353,24 @@ std::expected<ProcFs::Stat, Error> ProcFs::readStat(Pid pid)
     Stat result;
     result.pid = pid; // Stat::pid is always valid
 
-    auto path = m_procFsRoot;
-    path.append("/");
-    path.append(std::to_string(pid));
-    
     // get process real UID
-    struct ::stat64 fileStat;
-    if (::stat64(path.c_str(), &fileStat) == -1)
+    auto ruid = readRuid(pid);
+    if (!ruid.has_value())
     {
-        return std::unexpected(Error(errno, PosixError));
+        return std::unexpected(ruid.error());
     }
 
-    result.ruid = fileStat.st_uid;
+    result.ruid = ruid.value();
 
-    path.append("/stat");
-
-    auto rd = Util::tryLoadFile(path);
+    auto rd = load(pid, PrefetchStat, "stat");
     if (!rd.has_value())
     {
         return std::unexpected(rd.error());
     }
 
-    auto& s = rd.value().bytes();
+    auto s = rd.value();
 
-    auto start = s.c_str();
+    auto start = s.data();
     auto pEnd = start + s.length();
     auto end = start;
     size_t index = 0;
@@ -294,38 +560,31 @@ std::expected<ProcFs::Stat, Error> ProcFs::readStat(Pid pid)
         ++end;
     }
 
-    result.startTime = Time::fromSeconds(m_bootTime + timeFromTicks(result.starttime).toSeconds());
+    result.startTime = Time::fromSeconds(m_root->bootTime() + timeFromTicks(result.starttime).toSeconds());
 
     return {std::move(result)};
 }
 
-std::uint64_t ProcFs::getBootTimeImpl()
+std::expected<std::uint64_t, Error> ProcFs::readRuid(Pid pid)
 {
-    auto path = m_procFsRoot;
-    path.append("/stat");
-
-    std::ifstream stream(path);
-    if (!stream.good())
+    // /proc/<pid> is owned by the process's real UID
+    auto slot = prefetched(pid, PrefetchOwner);
+    if (slot)
     {
-        throw Exception(std::source_location::current(), Error(int(errno), PosixError), ExceptionProperties::ObjectName(path));
+        auto r = m_uring->result(*slot);
+        if (r < 0)
+            return std::unexpected(Error(-r, PosixError));
+
+        return m_uring->stat(*slot).stx_uid;
     }
 
-    std::string s;
-    while (std::getline(stream, s))
+    struct ::stat64 fileStat;
+    if (::fstatat64(m_root->fd(), makePath(pid, {}), &fileStat, 0) == -1)
     {
-        if (s.find("btime") == 0)
-        {
-            auto remainder = s.substr(6);
-            if (!remainder.empty())
-            {
-                return std::strtoull(remainder.c_str(), nullptr, 10);
-            }
-
-            break;
-        }
+        return std::unexpected(Error(errno, PosixError));
     }
 
-    throw Exception(std::source_location::current(), Error(Result::InvalidInput, GenericError), Exception::Message("No \'btime\' field in /proc/stat"), ExceptionProperties::ObjectName(path));
+    return fileStat.st_uid;
 }
 
 std::expected<std::string, Error> ProcFs::readComm(Pid pid)
@@ -333,19 +592,13 @@ std::expected<std::string, Error> ProcFs::readComm(Pid pid)
     if (pid == KernelPid)
         return std::string();
 
-    auto path = m_procFsRoot;
-    path.append("/");
-    path.append(std::to_string(pid));
-    path.append("/comm");
-
-    auto loaded = Er::Util::tryLoadFile(path);
+    auto loaded = load(pid, PrefetchComm, "comm");
     if (!loaded.has_value())
     {
         return std::unexpected(loaded.error());
     }
 
-    auto& comm = loaded.value();
-    return Er::Util::rtrim(comm.bytes());
+    return Er::Util::rtrim(std::string(loaded.value()));
 }
 
 std::expected<std::string, Error> ProcFs::readExePath(Pid pid)
@@ -353,51 +606,145 @@ std::expected<std::string, Error> ProcFs::readExePath(Pid pid)
     if (pid == KernelPid || pid == KThreadDPid)
         return std::string();
 
-    auto path = m_procFsRoot;
-    path.append("/");
-    path.append(std::to_string(pid));
-    path.append("/exe");
+    // the kernel already resolves the whole chain for /proc/<pid>/exe
+    char target[PATH_MAX];
+    auto length = ::readlinkat(m_root->fd(), makePath(pid, "exe"), target, sizeof(target));
+    if (length < 0)
+    {
+        return std::unexpected(Error(errno, PosixError));
+    }
 
-    return Util::tryResolveSymlink(path);
+    return std::string(target, length);
 }
 
 std::expected<MultiStringZ, Error> ProcFs::readCmdLine(Pid pid)
 {
-    auto path = m_procFsRoot;
-    if (pid != KernelPid)
+    auto loaded = load(pid, PrefetchCmdLine, "cmdline");
+    if (!loaded.has_value())
     {
-        path.append("/");
-        path.append(std::to_string(pid));
+        return std::unexpected(loaded.error());
     }
 
-    path.append("/cmdline");
+    return MultiStringZ(std::string(loaded.value()));
+}
+
+std::expected<MultiStringZ, Error> ProcFs::readEnv(Pid pid)
+{
+    if (pid == KernelPid)
+        return MultiStringZ{};
 
-    auto loaded = Er::Util::tryLoadFile(path);
+    auto loaded = load(pid, PrefetchEnv, "environ");
     if (!loaded.has_value())
     {
         return std::unexpected(loaded.error());
     }
 
-    return loaded.value().release();
+    return MultiStringZ(std::string(loaded.value()));
 }
 
-std::expected<MultiStringZ, Error> ProcFs::readEnv(Pid pid)
+std::expected<std::size_t, Error> ProcFs::readFdCount(Pid pid)
 {
-    if (pid == KernelPid)
-        return MultiStringZ{};
+    // since 6.2 the size of /proc/<pid>/fd is the number of descriptors
+    struct ::stat64 fileStat;
+    if (::fstatat64(m_root->fd(), makePath(pid, "fd"), &fileStat, 0) == -1)
+    {
+        return std::unexpected(Error(errno, PosixError));
+    }
+
+    return static_cast<std::size_t>(fileStat.st_size);
+}
+
+std::expected<std::vector<ProcFs::FdLink>, Error> ProcFs::readFds(Pid pid)
+{
+    auto fd = ::openat(m_root->fd(), makePath(pid, "fd"), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd == -1)
+    {
+        return std::unexpected(Error(errno, PosixError));
+    }
 
-    auto path = m_procFsRoot;
-    path.append("/");
-    path.append(std::to_string(pid));
-    path.append("/environ");
+    std::unique_ptr<DIR, DirCloser> dir(::fdopendir(fd));
+    if (!dir)
+    {
+        auto e = errno;
+        ::close(fd);
+        return std::unexpected(Error(e, PosixError));
+    }
 
-    auto loaded = Er::Util::tryLoadFile(path);
+    std::vector<FdLink> result;
+
+    char target[PATH_MAX];
+    for (auto ent = ::readdir(dir.get()); ent != nullptr; ent = ::readdir(dir.get()))
+    {
+        if (!std::isdigit(ent->d_name[0]))
+            continue;
+
+        // the descriptor may have been closed since readdir()
+        auto length = ::readlinkat(::dirfd(dir.get()), ent->d_name, target, sizeof(target));
+        if (length < 0)
+            continue;
+
+        result.push_back(FdLink{ static_cast<int>(std::strtol(ent->d_name, nullptr, 10)), std::string(target, length) });
+    }
+
+    return {std::move(result)};
+}
+
+std::expected<std::vector<ProcFs::NetSocket>, Error> ProcFs::readNetSockets(std::string_view table)
+{
+    std::string path("net/");
+    path.append(table);
+
+    auto loaded = load(path.c_str());
     if (!loaded.has_value())
     {
         return std::unexpected(loaded.error());
     }
 
-    return loaded.value().release();
+    std::vector<NetSocket> result;
+
+    auto s = loaded.value();
+    result.reserve(s.size() / 150);
+
+    bool header = true;
+    while (!s.empty())
+    {
+        auto eol = s.find('\n');
+        auto line = s.substr(0, eol);
+        s.remove_prefix((eol == std::string_view::npos) ? s.size() : eol + 1);
+
+        if (header)
+        {
+            header = false;
+            continue;
+        }
+
+        //   sl  local_address rem_address   st tx_queue:rx_queue tr:tm->when retrnsmt   uid  timeout inode
+        nextToken(line);
+        auto local = nextToken(line);
+        auto remote = nextToken(line);
+        auto state = nextToken(line);
+        nextToken(line);
+        nextToken(line);
+        nextToken(line);
+        auto uid = nextToken(line);
+        nextToken(line);
+        auto inode = nextToken(line);
+
+        if (inode.empty())
+            continue;
+
+        NetSocket socket;
+        if (!parseNetEndpoint(local, socket.localAddress, socket.localPort) || !parseNetEndpoint(remote, socket.remoteAddress, socket.remotePort))
+            continue;
+
+        std::from_chars(state.data(), state.data() + state.size(), socket.state, 16);
+        std::from_chars(uid.data(), uid.data() + uid.size(), socket.uid);
+        std::from_chars(inode.data(), inode.data() + inode.size(), socket.inode);
+
+        result.push_back(socket);
+    }
+
+    return {std::move(result)};
 }
 
-} // namespace Er::ProcessTree::Linux {}
+} // namespace Er::ProcessTree::Linux {}
\ No newline at end of file
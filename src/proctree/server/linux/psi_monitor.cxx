@@ -0,0 +1,410 @@
+#include "psi_monitor.hxx"
+
+#include <erebus/rtl/exception.hxx>
+#include <erebus/rtl/system/thread.hxx>
+#include <erebus/rtl/util/exception_util.hxx>
+#include <erebus/rtl/util/file.hxx>
+
+#include <algorithm>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+
+namespace Er::ProcessTree::Linux
+{
+
+namespace
+{
+
+std::string_view resourceName(PressureResource r) noexcept
+{
+    switch (r)
+    {
+    case PressureResource::Cpu:
+        return "cpu";
+    case PressureResource::Memory:
+        return "memory";
+    case PressureResource::Io:
+        return "io";
+    default:
+        break;
+    }
+
+    ErAssert(!"Unknown pressure resource");
+    return {};
+}
+
+std::string_view kindName(PressureKind k) noexcept
+{
+    return (k == PressureKind::Full) ? "full" : "some";
+}
+
+std::uint64_t parseField(std::string_view line, std::string_view key) noexcept
+{
+    auto pos = line.find(key);
+    if (pos == line.npos)
+        return 0;
+
+    return std::strtoull(line.data() + pos + key.length(), nullptr, 10);
+}
+
+double parseDouble(std::string_view line, std::string_view key) noexcept
+{
+    auto pos = line.find(key);
+    if (pos == line.npos)
+        return 0.0;
+
+    return std::strtod(line.data() + pos + key.length(), nullptr);
+}
+
+} // namespace {}
+
+
+PsiMonitor::~PsiMonitor()
+{
+    ErLogDebug2(m_log, "{}.PsiMonitor::~PsiMonitor()", Er::Format::ptr(this));
+
+    if (m_worker.joinable())
+    {
+        m_worker.request_stop();
+
+        std::uint64_t one = 1;
+        [[maybe_unused]] auto _ = ::write(m_wakeup, &one, sizeof(one));
+
+        m_worker.join();
+    }
+}
+
+PsiMonitor::PsiMonitor(ProcFsRootPtr procFsRoot, std::vector<Trigger>&& triggers, unsigned topCount, Log::ILogger* log)
+    : m_log(log)
+    , m_procFsRoot(procFsRoot->path())
+    , m_topCount(topCount)
+    , m_triggers(std::move(triggers))
+    , m_procFs(std::move(procFsRoot))
+    , m_wakeup(::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK))
+{
+    ErLogDebug2(m_log, "{}.PsiMonitor::PsiMonitor()", Er::Format::ptr(this));
+
+    if (!m_wakeup.valid())
+        throw Exception(std::source_location::current(), Error(errno, PosixError), Exception::Message("Failed to create an eventfd"));
+
+    arm();
+
+    if (m_armed.empty())
+    {
+        ErLogWarning2(m_log, "No PSI triggers could be registered; pressure monitoring is disabled");
+        return;
+    }
+
+    m_worker = std::jthread([this](std::stop_token stop) { run(stop); });
+}
+
+std::vector<PsiMonitor::Trigger> PsiMonitor::parseTriggers(const PropertyMap& config)
+{
+    std::vector<Trigger> result;
+
+    auto triggers = findProperty(config, "triggers", Property::Type::Vector);
+    if (!triggers)
+    {
+        // reasonable defaults: 500ms of CPU stall and 150ms of memory or IO stall within a 1s window
+        result.push_back({ PressureResource::Cpu, PressureKind::Some, 500 * 1000, 1000 * 1000 });
+        result.push_back({ PressureResource::Memory, PressureKind::Some, 150 * 1000, 1000 * 1000 });
+        result.push_back({ PressureResource::Io, PressureKind::Some, 150 * 1000, 1000 * 1000 });
+        return result;
+    }
+
+    for (auto& entry : *triggers->getVector())
+    {
+        auto m = entry.getMap();
+        if (!m)
+            throw Exception(std::source_location::current(), Error(Result::BadConfiguration, GenericError), Exception::Message("PSI trigger entry is not an object"));
+
+        Trigger t;
+
+        auto resource = findProperty(*m, "resource", Property::Type::String);
+        if (!resource)
+            throw Exception(std::source_location::current(), Error(Result::BadConfiguration, GenericError), Exception::Message("PSI trigger resource expected"));
+
+        auto& r = *resource->getString();
+        if (r == "cpu")
+            t.resource = PressureResource::Cpu;
+        else if (r == "memory")
+            t.resource = PressureResource::Memory;
+        else if (r == "io")
+            t.resource = PressureResource::Io;
+        else
+            throw Exception(std::source_location::current(), Error(Result::BadConfiguration, GenericError), Exception::Message("Unknown PSI resource"), ExceptionProperties::ObjectName(r));
+
+        auto kind = findProperty(*m, "kind", Property::Type::String);
+        if (kind && (*kind->getString() == "full"))
+            t.kind = PressureKind::Full;
+
+        auto stall = findProperty(*m, "stall_us", Property::Type::Int64);
+        if (stall)
+            t.stallUs = static_cast<std::uint32_t>(*stall->getInt64());
+
+        auto window = findProperty(*m, "window_us", Property::Type::Int64);
+        if (window)
+            t.windowUs = static_cast<std::uint32_t>(*window->getInt64());
+
+        result.push_back(t);
+    }
+
+    return result;
+}
+
+PsiMonitor::SubscriptionId PsiMonitor::subscribe(PressureResourceMask resources, Handler&& handler)
+{
+    if (!resources)
+        resources = AllPressureResources;
+
+    std::lock_guard l(m_mutex);
+    auto id = m_nextId++;
+    m_subscribers.insert({ id, Subscriber{ resources, std::move(handler) } });
+    return id;
+}
+
+void PsiMonitor::unsubscribe(SubscriptionId id) noexcept
+{
+    // blocks until any handler invocation in progress has completed
+    std::lock_guard l(m_mutex);
+    m_subscribers.erase(id);
+}
+
+void PsiMonitor::arm()
+{
+    for (auto& t : m_triggers)
+    {
+        auto path = m_procFsRoot;
+        path.append("/pressure/");
+        path.append(resourceName(t.resource));
+
+        Util::FileHandle fd(::open(path.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC));
+        if (!fd.valid())
+        {
+            auto e = Error(errno, PosixError);
+            ErLogWarning2(m_log, "Could not open {}: {}", path, e.message());
+            continue;
+        }
+
+        auto trigger = Er::format("{} {} {}", kindName(t.kind), t.stallUs, t.windowUs);
+
+        // the kernel expects the terminating NUL too
+        if (::write(fd, trigger.c_str(), trigger.length() + 1) < 0)
+        {
+            auto e = Error(errno, PosixError);
+            ErLogWarning2(m_log, "Could not register PSI trigger [{}] on {}: {}", trigger, path, e.message());
+            continue;
+        }
+
+        ErLogInfo2(m_log, "Registered PSI trigger [{}] on {}", trigger, path);
+
+        m_armed.push_back({ t, std::move(fd) });
+    }
+}
+
+void PsiMonitor::run(std::stop_token stop) noexcept
+{
+    System::CurrentThread::setName("psi_monitor");
+
+    std::vector<pollfd> fds;
+    fds.reserve(m_armed.size() + 1);
+
+    fds.push_back({ m_wakeup.get(), POLLIN, 0 });
+    for (auto& a : m_armed)
+        fds.push_back({ a.fd.get(), POLLPRI, 0 });
+
+    {
+        // the first event needs something to compare CPU time and I/O delay with
+        Er::Util::ExceptionLogger xcptHandler(m_log);
+        try
+        {
+            PressureEvent baseline;
+            collectTopConsumers(baseline);
+        }
+        catch (...)
+        {
+            Er::dispatchException(std::current_exception(), xcptHandler);
+        }
+    }
+
+    while (!stop.stop_requested())
+    {
+        auto n = ::poll(fds.data(), fds.size(), -1);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+
+            auto e = Error(errno, PosixError);
+            ErLogError2(m_log, "PSI poll() failed: {}", e.message());
+            break;
+        }
+
+        if (stop.stop_requested())
+            break;
+
+        for (std::size_t i = 1; i < fds.size(); ++i)
+        {
+            auto& pfd = fds[i];
+            if (pfd.revents & POLLERR)
+            {
+                ErLogError2(m_log, "PSI trigger on {} is no longer available", resourceName(m_armed[i - 1].trigger.resource));
+                pfd.fd = -1; // poll() ignores negative descriptors
+            }
+            else if (pfd.revents & POLLPRI)
+            {
+                fire(m_armed[i - 1].trigger);
+            }
+
+            pfd.revents = 0;
+        }
+    }
+}
+
+void PsiMonitor::fire(const Trigger& trigger)
+{
+    PressureEvent ev;
+    ev.resource = trigger.resource;
+    ev.kind = trigger.kind;
+    ev.stallUs = trigger.stallUs;
+    ev.windowUs = trigger.windowUs;
+    ev.timestamp = Time::now();
+
+    Er::Util::ExceptionLogger xcptHandler(m_log);
+    try
+    {
+        // don't bother scanning processes if nobody listens
+        auto mask = pressureResourceBit(trigger.resource);
+        {
+            std::lock_guard l(m_mutex);
+            if (std::none_of(m_subscribers.begin(), m_subscribers.end(), [mask](auto& s) { return (s.second.resources & mask) != 0; }))
+                return;
+        }
+
+        // walking /proc takes a while; subscribe() and unsubscribe() needn't wait for it
+        readAverages(ev);
+        collectTopConsumers(ev);
+
+        ErLogDebug2(m_log, "PSI {} {} trigger fired: avg10={:.2f}", resourceName(ev.resource), kindName(ev.kind), ev.avg10);
+
+        std::lock_guard l(m_mutex);
+        for (auto& s : m_subscribers)
+        {
+            if (s.second.resources & mask)
+                s.second.handler(ev);
+        }
+    }
+    catch (...)
+    {
+        Er::dispatchException(std::current_exception(), xcptHandler);
+    }
+}
+
+void PsiMonitor::readAverages(PressureEvent& ev)
+{
+    auto path = m_procFsRoot;
+    path.append("/pressure/");
+    path.append(resourceName(ev.resource));
+
+    auto loaded = Util::tryLoadFile(path);
+    if (!loaded.has_value())
+        return;
+
+    std::string_view text(loaded.value().bytes());
+    auto prefix = kindName(ev.kind);
+
+    while (!text.empty())
+    {
+        auto eol = text.find('\n');
+        auto line = text.substr(0, eol);
+
+        if (line.starts_with(prefix))
+        {
+            ev.avg10 = parseDouble(line, "avg10=");
+            ev.total = parseField(line, "total=");
+            break;
+        }
+
+        if (eol == text.npos)
+            break;
+
+        text.remove_prefix(eol + 1);
+    }
+}
+
+void PsiMonitor::collectTopConsumers(PressureEvent& ev)
+{
+    if (!m_topCount)
+        return;
+
+    auto pids = m_procFs.enumeratePids();
+    if (!pids.has_value())
+        return;
+
+    static const long PageSize = ::sysconf(_SC_PAGESIZE);
+
+    auto less = [](const PressureEvent::Consumer& a, const PressureEvent::Consumer& b) { return a.value > b.value; };
+
+    auto& top = ev.top;
+    top.reserve(m_topCount + 1);
+
+    // the processes that have gone are forgotten
+    std::unordered_map<Pid, Sample> samples;
+    samples.reserve(m_samples.size());
+
+    for (auto pid : pids.value())
+    {
+        auto stat = m_procFs.readStat(pid);
+        if (!stat.has_value())
+            continue; // the process has probably gone
+
+        auto& s = stat.value();
+
+        Sample current{ s.startTime.value(), ProcFs::timeFromTicks(s.utime + s.stime).value(), ProcFs::timeFromTicks(s.delayacct_blkio_ticks).value() };
+        samples.insert({ pid, current });
+
+        // a process started since the previous sample has used all of its time since then;
+        // the lifetime totals would rank long-running processes first whatever they are doing now
+        Sample previous{};
+        auto it = m_samples.find(pid);
+        if ((it != m_samples.end()) && (it->second.startTime == current.startTime))
+            previous = it->second;
+
+        std::uint64_t value = 0;
+        switch (ev.resource)
+        {
+        case PressureResource::Cpu:
+            value = (current.cpu > previous.cpu) ? (current.cpu - previous.cpu) : 0;
+            break;
+        case PressureResource::Memory:
+            value = static_cast<std::uint64_t>(std::max<std::int64_t>(s.rss, 0)) * PageSize;
+            break;
+        case PressureResource::Io:
+            value = (current.blkio > previous.blkio) ? (current.blkio - previous.blkio) : 0;
+            break;
+        default:
+            break;
+        }
+
+        if (!value)
+            continue;
+
+        if ((top.size() == m_topCount) && (top.back().value >= value))
+            continue;
+
+        // keep the list sorted; it's tiny so a linear insert is fine
+        PressureEvent::Consumer c{ pid, std::move(s.comm), value };
+        top.insert(std::upper_bound(top.begin(), top.end(), c, less), std::move(c));
+
+        if (top.size() > m_topCount)
+            top.pop_back();
+    }
+
+    m_samples.swap(samples);
+}
+
+} // namespace Er::ProcessTree::Linux {}
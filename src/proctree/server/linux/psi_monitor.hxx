@@ -0,0 +1,93 @@
+#pragma once
+
+#include <erebus/proctree/pressure.hxx>
+#include <erebus/proctree/server/linux/procfs.hxx>
+#include <erebus/rtl/log.hxx>
+#include <erebus/rtl/property_bag.hxx>
+#include <erebus/rtl/util/generic_handle.hxx>
+
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#include <boost/noncopyable.hpp>
+
+
+namespace Er::ProcessTree::Linux
+{
+
+//
+// Registers PSI triggers on /proc/pressure/{cpu,memory,io} and waits for them
+// to fire (POLLPRI) on a dedicated thread; every event is pushed to subscribers
+// together with a snapshot of the top resource consumers
+//
+
+class PsiMonitor final
+    : public boost::noncopyable
+{
+public:
+    struct Trigger
+    {
+        PressureResource resource = PressureResource::Memory;
+        PressureKind kind = PressureKind::Some;
+        std::uint32_t stallUs = 150 * 1000;
+        std::uint32_t windowUs = 1000 * 1000;
+    };
+
+    using Handler = std::function<void(const PressureEvent&)>;
+    using SubscriptionId = std::uint64_t;
+
+    ~PsiMonitor();
+
+    PsiMonitor(ProcFsRootPtr procFsRoot, std::vector<Trigger>&& triggers, unsigned topCount, Log::ILogger* log);
+
+    static std::vector<Trigger> parseTriggers(const PropertyMap& config);
+
+    [[nodiscard]] SubscriptionId subscribe(PressureResourceMask resources, Handler&& handler);
+    void unsubscribe(SubscriptionId id) noexcept;
+
+private:
+    struct Armed
+    {
+        Trigger trigger;
+        Util::FileHandle fd;
+    };
+
+    struct Subscriber
+    {
+        PressureResourceMask resources;
+        Handler handler;
+    };
+
+    // what a process had used when the monitor last looked
+    struct Sample
+    {
+        Time::ValueType startTime; // tells a reused PID apart
+        Time::ValueType cpu;       // utime + stime
+        Time::ValueType blkio;
+    };
+
+    void arm();
+    void run(std::stop_token stop) noexcept;
+    void fire(const Trigger& trigger);
+    void readAverages(PressureEvent& ev);
+    void collectTopConsumers(PressureEvent& ev);
+
+    Log::ILogger* const m_log;
+    const std::string m_procFsRoot;
+    const unsigned m_topCount;
+    const std::vector<Trigger> m_triggers;
+    ProcFs m_procFs; // used by the monitor thread only
+    std::unordered_map<Pid, Sample> m_samples; // same
+    std::vector<Armed> m_armed;
+    Util::FileHandle m_wakeup;
+    std::mutex m_mutex;
+    SubscriptionId m_nextId = 1;
+    std::map<SubscriptionId, Subscriber> m_subscribers;
+    std::jthread m_worker;
+};
+
+
+} // namespace Er::ProcessTree::Linux {}
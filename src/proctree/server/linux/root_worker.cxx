@@ -0,0 +1,110 @@
+#include "process_props_collector.hxx"
+#include "root_worker.hxx"
+
+#include <erebus/rtl/system/thread.hxx>
+#include <erebus/rtl/util/exception_util.hxx>
+
+
+namespace Er::ProcessTree::Linux
+{
+
+RootWorker::~RootWorker()
+{
+    ErLogDebug2(m_log, "{}.RootWorker::~RootWorker({})", Er::Format::ptr(this), m_root);
+
+    m_worker.request_stop();
+    m_worker.join();
+}
+
+RootWorker::RootWorker(std::string_view root, std::string_view tag, bool ioUring, Log::ILogger* log)
+    : m_log(log)
+    , m_root(root)
+    , m_tag(tag)
+    , m_procFs(std::make_shared<const ProcFsRoot>(root), ioUring)
+    , m_worker([this](std::stop_token stop) { run(stop); })
+{
+    ErLogDebug2(m_log, "{}.RootWorker::RootWorker({}, tag={}, io_uring={})", Er::Format::ptr(this), m_root, m_tag, m_procFs.batched());
+
+    if (ioUring && !m_procFs.batched())
+        ErLogWarning2(m_log, "io_uring is not available; reading {} synchronously", m_procFs.root());
+}
+
+bool RootWorker::trySubmit(Job&& job)
+{
+    {
+        std::lock_guard l(m_mutex);
+        if (m_jobs.size() >= MaxPendingJobs)
+            return false;
+
+        m_jobs.push_back(std::move(job));
+    }
+
+    m_jobAdded.notify_one();
+    return true;
+}
+
+void RootWorker::run(std::stop_token stop)
+{
+    System::CurrentThread::setName("procfs_root");
+
+    // pending jobs still run after a stop request since they may own resources, e.g. RPC reactors
+    for (;;)
+    {
+        Job job;
+        {
+            std::unique_lock l(m_mutex);
+            if (!m_jobAdded.wait(l, stop, [this]() { return !m_jobs.empty(); }))
+                break;
+
+            job = std::move(m_jobs.front());
+            m_jobs.pop_front();
+        }
+
+        Er::Util::ExceptionLogger xcptHandler(m_log);
+        try
+        {
+            job(*this);
+        }
+        catch (...)
+        {
+            Er::dispatchException(std::current_exception(), xcptHandler);
+        }
+    }
+}
+
+std::expected<std::vector<ProcessProperties>, Error> RootWorker::scan(const ProcessProperties::Mask& mask)
+{
+    auto started = Time::now();
+
+    ++m_scans;
+
+    auto pids = m_procFs.enumeratePids();
+    if (!pids.has_value())
+    {
+        ++m_failures;
+        ErLogError2(m_log, "Failed to enumerate processes in {}: {}", m_root, pids.error().message());
+        return std::unexpected(pids.error());
+    }
+
+    auto result = collectProcessProps(m_procFs, pids.value(), mask, m_log);
+
+    auto elapsed = Time::now() - started;
+    m_lastScanUs = elapsed;
+    m_totalScanUs += elapsed;
+    m_processes = result.size();
+
+    return result;
+}
+
+RootWorker::Stats RootWorker::stats() const noexcept
+{
+    Stats s;
+    s.scans = m_scans.load(std::memory_order_relaxed);
+    s.failures = m_failures.load(std::memory_order_relaxed);
+    s.processes = m_processes.load(std::memory_order_relaxed);
+    s.lastScanUs = m_lastScanUs.load(std::memory_order_relaxed);
+    s.totalScanUs = m_totalScanUs.load(std::memory_order_relaxed);
+    return s;
+}
+
+} // namespace Er::ProcessTree::Linux {}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <erebus/proctree/process_props.hxx>
+#include <erebus/proctree/server/linux/procfs.hxx>
+#include <erebus/rtl/log.hxx>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include <boost/noncopyable.hpp>
+
+
+namespace Er::ProcessTree::Linux
+{
+
+//
+// Owns a procfs mount (e.g. a container's /proc or a procfs from another
+// PID namespace) and runs the jobs against it on a dedicated thread
+//
+
+class RootWorker final
+    : public boost::noncopyable
+{
+public:
+    struct Stats
+    {
+        std::uint64_t scans = 0;
+        std::uint64_t failures = 0;
+        std::uint64_t processes = 0;     // found by the last successful scan
+        std::uint64_t lastScanUs = 0;
+        std::uint64_t totalScanUs = 0;
+    };
+
+    using Job = std::function<void(RootWorker&)>;
+
+    // every job is a full scan, so there is no point in queueing up more than a few
+    static constexpr std::size_t MaxPendingJobs = 16;
+
+    ~RootWorker();
+
+    RootWorker(std::string_view root, std::string_view tag, bool ioUring, Log::ILogger* log);
+
+    const std::string& root() const noexcept
+    {
+        return m_root;
+    }
+
+    const ProcFsRootPtr& procFsRoot() const noexcept
+    {
+        return m_procFs.shared();
+    }
+
+    const std::string& tag() const noexcept
+    {
+        return m_tag;
+    }
+
+    // false if the queue is full
+    [[nodiscard]] bool trySubmit(Job&& job);
+
+    // must be called from a job
+    std::expected<std::vector<ProcessProperties>, Error> scan(const ProcessProperties::Mask& mask);
+
+    Stats stats() const noexcept;
+
+private:
+    void run(std::stop_token stop);
+
+    Log::ILogger* const m_log;
+    const std::string m_root;
+    const std::string m_tag;
+    ProcFs m_procFs; // used by the worker thread only
+    std::mutex m_mutex;
+    std::condition_variable_any m_jobAdded;
+    std::deque<Job> m_jobs;
+    std::atomic<std::uint64_t> m_scans = 0;
+    std::atomic<std::uint64_t> m_failures = 0;
+    std::atomic<std::uint64_t> m_processes = 0;
+    std::atomic<std::uint64_t> m_lastScanUs = 0;
+    std::atomic<std::uint64_t> m_totalScanUs = 0;
+    std::jthread m_worker;
+};
+
+
+} // namespace Er::ProcessTree::Linux {}
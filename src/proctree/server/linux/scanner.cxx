@@ -0,0 +1,224 @@
+#include "process_props_collector.hxx"
+#include "scanner.hxx"
+
+#include <erebus/rtl/system/thread.hxx>
+#include <erebus/rtl/util/exception_util.hxx>
+
+
+namespace Er::ProcessTree::Linux
+{
+
+Scanner::~Scanner()
+{
+    ErLogDebug2(m_log, "{}.Scanner::~Scanner()", Er::Format::ptr(this));
+
+    m_worker.request_stop();
+    m_worker.join();
+}
+
+Scanner::Scanner(ProcFsRootPtr procFsRoot, std::chrono::milliseconds interval, bool ioUring, Log::ILogger* log)
+    : m_log(log)
+    , m_interval(interval)
+    , m_procFs(std::move(procFsRoot), ioUring)
+    , m_worker([this](std::stop_token stop) { run(stop); })
+{
+    ErLogDebug2(m_log, "{}.Scanner::Scanner(interval={} ms, io_uring={})", Er::Format::ptr(this), m_interval.count(), m_procFs.batched());
+
+    if (ioUring && !m_procFs.batched())
+        ErLogWarning2(m_log, "io_uring is not available; reading {} synchronously", m_procFs.root());
+}
+
+Scanner::ListenerId Scanner::addListener(const ProcessProperties::Mask& fields, Listener&& listener, bool replay)
+{
+    ListenerId id;
+    {
+        std::lock_guard l(m_listenersMutex);
+
+        if (replay)
+        {
+            // no delta can be delivered while we hold m_listenersMutex; if the table has already been
+            // updated by a scan whose delta is still pending, the listener will see it twice, which is harmless
+            std::shared_lock lt(m_tableMutex);
+
+            SnapshotDelta delta;
+            delta.timestamp = m_lastScan;
+            delta.changed.reserve(m_table.size());
+            for (auto& entry : m_table)
+                delta.changed.push_back(ProcessChange{ &entry.second.props, entry.second.props.validMask(), true });
+
+            listener(delta);
+        }
+
+        id = m_nextId++;
+        m_listeners.insert({ id, ListenerEntry{ fields, std::move(listener) } });
+        updateMask();
+    }
+
+    m_listenerAdded.notify_one();
+    return id;
+}
+
+void Scanner::removeListener(ListenerId id) noexcept
+{
+    // blocks until the listener has returned if it's being invoked
+    std::lock_guard l(m_listenersMutex);
+    m_listeners.erase(id);
+    updateMask();
+}
+
+void Scanner::updateMask() noexcept
+{
+    m_fields = ProcessProperties::Mask{};
+    for (auto& l : m_listeners)
+        m_fields |= l.second.fields;
+}
+
+void Scanner::run(std::stop_token stop)
+{
+    System::CurrentThread::setName("proc_scanner");
+
+    while (!stop.stop_requested())
+    {
+        ProcessProperties::Mask fields;
+        {
+            std::unique_lock l(m_listenersMutex);
+            if (!m_listenerAdded.wait(l, stop, [this]() { return !m_listeners.empty(); }))
+                break;
+
+            fields = m_fields;
+        }
+
+        Er::Util::ExceptionLogger xcptHandler(m_log);
+        try
+        {
+            scan(fields);
+        }
+        catch (...)
+        {
+            Er::dispatchException(std::current_exception(), xcptHandler);
+        }
+
+        std::unique_lock l(m_listenersMutex);
+        m_listenerAdded.wait_for(l, stop, m_interval, []() { return false; });
+    }
+}
+
+void Scanner::scan(const ProcessProperties::Mask& fields)
+{
+    auto pids = m_procFs.enumeratePids();
+    if (!pids.has_value())
+    {
+        ErLogError2(m_log, "Failed to enumerate processes: {}", pids.error().message());
+        return;
+    }
+
+    // StartTime tells a reused PID from the original process; it comes with /proc/<pid>/stat anyway
+    auto mask = fields;
+    mask.set(ProcessProperties::Pid);
+    mask.set(ProcessProperties::StartTime);
+
+    bool wantCpu = mask[ProcessProperties::CpuUsage];
+    if (wantCpu)
+    {
+        mask.set(ProcessProperties::STime);
+        mask.set(ProcessProperties::UTime);
+    }
+
+    auto fresh = collectProcessProps(m_procFs, pids.value(), mask, m_log);
+
+    Time now(Time::now());
+
+    SnapshotDelta delta;
+    delta.timestamp = now;
+
+    ++m_generation;
+
+    {
+        std::unique_lock l(m_tableMutex);
+
+        for (auto& p : fresh)
+        {
+            auto pid = p.pid;
+            auto it = m_table.find(pid);
+            if ((it != m_table.end()) && (it->second.props.startTime != p.startTime))
+            {
+                // PID has been reused
+                delta.removed.push_back(pid);
+                m_table.erase(it);
+                it = m_table.end();
+            }
+
+            if (wantCpu)
+            {
+                // CPU usage since the previous scan, or over the whole lifetime for new processes
+                auto cpu = p.uTime.value() + p.sTime.value();
+                auto prevCpu = std::uint64_t(0);
+                auto since = p.startTime.value();
+                if (it != m_table.end())
+                {
+                    prevCpu = it->second.props.uTime.value() + it->second.props.sTime.value();
+                    since = m_lastScan.value();
+                }
+
+                double usage = 0.0;
+                if ((now.value() > since) && (cpu >= prevCpu))
+                    usage = double(cpu - prevCpu) * 100.0 / double(now.value() - since);
+
+                ErSet(ProcessProperties, CpuUsage, p, cpuUsage, usage);
+            }
+
+            if (it == m_table.end())
+            {
+                auto& e = m_table[pid];
+                e.props = std::move(p);
+                e.generation = m_generation;
+
+                delta.changed.push_back(ProcessChange{ &e.props, e.props.validMask(), true });
+            }
+            else
+            {
+                auto& e = it->second;
+                auto diff = e.props.update(std::move(p));
+                e.generation = m_generation;
+
+                if (diff.differences)
+                {
+                    ProcessProperties::Mask changed;
+                    for (FieldId id = 0; id < ProcessProperties::FieldCount; ++id)
+                    {
+                        if (diff.map[id] != ProcessProperties::Diff::Type::Unchanged)
+                            changed.set(id);
+                    }
+
+                    delta.changed.push_back(ProcessChange{ &e.props, changed, false });
+                }
+            }
+        }
+
+        m_tableFields = mask;
+        m_lastScan = now;
+
+        for (auto it = m_table.begin(); it != m_table.end();)
+        {
+            if (it->second.generation != m_generation)
+            {
+                delta.removed.push_back(it->first);
+                it = m_table.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+
+    if (delta.empty())
+        return;
+
+    // the table is only modified by this thread, so the pointers in the delta stay valid
+    std::lock_guard l(m_listenersMutex);
+    for (auto& entry : m_listeners)
+        entry.second.listener(delta);
+}
+
+} // namespace Er::ProcessTree::Linux {}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <erebus/proctree/server/linux/procfs.hxx>
+#include <erebus/proctree/server/snapshot.hxx>
+#include <erebus/rtl/log.hxx>
+
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <unordered_map>
+
+#include <boost/noncopyable.hpp>
+
+
+namespace Er::ProcessTree::Linux
+{
+
+//
+// Periodically rescans /proc and keeps the latest process table; after each scan
+// the listeners get the delta against the previous one. Only the union of the
+// fields the listeners have asked for is collected. Nothing is scanned while
+// there are no listeners.
+//
+
+class Scanner final
+    : public boost::noncopyable
+{
+public:
+    using Listener = std::function<void(const SnapshotDelta&)>;
+    using ListenerId = std::uint64_t;
+
+    ~Scanner();
+
+    Scanner(ProcFsRootPtr procFsRoot, std::chrono::milliseconds interval, bool ioUring, Log::ILogger* log);
+
+    // listeners are invoked on the scanner thread; with 'replay' set the listener is first called
+    // right here with the whole current table as a delta of added processes (possibly an empty one)
+    [[nodiscard]] ListenerId addListener(const ProcessProperties::Mask& fields, Listener&& listener, bool replay = false);
+    void removeListener(ListenerId id) noexcept;
+
+    // visits the latest snapshot under a shared lock
+    template <typename VisitorT>
+    void forEach(VisitorT&& visitor) const
+    {
+        std::shared_lock l(m_tableMutex);
+        for (auto& entry : m_table)
+            visitor(entry.second.props);
+    }
+
+    // same as forEach() but only if the latest snapshot is recent and has all the fields required;
+    // saves a pass over /proc for the callers that would otherwise collect their own
+    template <typename VisitorT>
+    bool forEachIfCovers(const ProcessProperties::Mask& fields, VisitorT&& visitor) const
+    {
+        std::shared_lock l(m_tableMutex);
+
+        if (m_table.empty() || ((m_tableFields & fields) != fields))
+            return false;
+
+        auto age = Time::now() - m_lastScan.value();
+        if (age > 2 * Time::ValueType(std::chrono::duration_cast<std::chrono::microseconds>(m_interval).count()))
+            return false;
+
+        for (auto& entry : m_table)
+            visitor(entry.second.props);
+
+        return true;
+    }
+
+private:
+    struct Entry
+    {
+        ProcessProperties props;
+        std::uint64_t generation = 0;
+    };
+
+    struct ListenerEntry
+    {
+        ProcessProperties::Mask fields;
+        Listener listener;
+    };
+
+    void run(std::stop_token stop);
+    void scan(const ProcessProperties::Mask& fields);
+    void updateMask() noexcept;
+
+    Log::ILogger* const m_log;
+    const std::chrono::milliseconds m_interval;
+    ProcFs m_procFs; // used by the scanner thread only
+    std::mutex m_listenersMutex;
+    std::condition_variable_any m_listenerAdded;
+    ListenerId m_nextId = 1;
+    std::map<ListenerId, ListenerEntry> m_listeners;
+    ProcessProperties::Mask m_fields;
+    mutable std::shared_mutex m_tableMutex;
+    std::unordered_map<Pid, Entry> m_table;
+    ProcessProperties::Mask m_tableFields;
+    std::uint64_t m_generation = 0;
+    Time m_lastScan;
+    std::jthread m_worker;
+};
+
+
+} // namespace Er::ProcessTree::Linux {}
@@ -0,0 +1,424 @@
+#include <erebus/proctree/server/linux/socket_index.hxx>
+#include <erebus/rtl/system/thread.hxx>
+#include <erebus/rtl/util/exception_util.hxx>
+
+#include <charconv>
+#include <cstring>
+
+#include <arpa/inet.h>
+
+
+namespace Er::ProcessTree::Linux
+{
+
+namespace
+{
+
+constexpr struct
+{
+    std::string_view name;
+    SocketProtocol protocol;
+    bool ipv6;
+} NetTables[] =
+{
+    { "tcp", SocketProtocol::Tcp, false },
+    { "tcp6", SocketProtocol::Tcp, true },
+    { "udp", SocketProtocol::Udp, false },
+    { "udp6", SocketProtocol::Udp, true },
+};
+
+// "socket:[12345]"
+std::optional<std::uint64_t> socketInode(std::string_view link) noexcept
+{
+    constexpr std::string_view Prefix("socket:[");
+    if (!link.starts_with(Prefix) || !link.ends_with(']'))
+        return std::nullopt;
+
+    std::uint64_t inode = 0;
+    auto first = link.data() + Prefix.size();
+    auto last = link.data() + link.size() - 1;
+    if (std::from_chars(first, last, inode).ec != std::errc())
+        return std::nullopt;
+
+    return inode;
+}
+
+bool isV4Mapped(const std::array<std::uint8_t, 16>& a) noexcept
+{
+    static constexpr std::uint8_t Prefix[12] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff };
+    return std::memcmp(a.data(), Prefix, sizeof(Prefix)) == 0;
+}
+
+std::string formatAddress(const std::array<std::uint8_t, 16>& a, bool ipv6)
+{
+    char buffer[INET6_ADDRSTRLEN];
+
+    if (!ipv6 || isV4Mapped(a))
+    {
+        if (::inet_ntop(AF_INET, a.data() + 12, buffer, sizeof(buffer)))
+            return buffer;
+    }
+    else if (::inet_ntop(AF_INET6, a.data(), buffer, sizeof(buffer)))
+    {
+        return buffer;
+    }
+
+    return {};
+}
+
+std::optional<std::array<std::uint8_t, 16>> parseAddress(const std::string& s) noexcept
+{
+    std::array<std::uint8_t, 16> a = {};
+
+    if (::inet_pton(AF_INET, s.c_str(), a.data() + 12) == 1)
+    {
+        a[10] = 0xff;
+        a[11] = 0xff;
+        return a;
+    }
+
+    if (::inet_pton(AF_INET6, s.c_str(), a.data()) == 1)
+        return a;
+
+    return std::nullopt;
+}
+
+} // namespace {}
+
+
+std::size_t SocketIndex::AddressHash::operator()(const Address& a) const noexcept
+{
+    std::uint64_t hi;
+    std::uint64_t lo;
+    std::memcpy(&hi, a.data(), sizeof(hi));
+    std::memcpy(&lo, a.data() + 8, sizeof(lo));
+
+    return std::hash<std::uint64_t>{}(hi ^ (lo * 0x9e3779b97f4a7c15ull));
+}
+
+SocketIndex::~SocketIndex()
+{
+    ErLogDebug2(m_log, "{}.SocketIndex::~SocketIndex()", Er::Format::ptr(this));
+
+    if (m_worker.joinable())
+    {
+        m_worker.request_stop();
+        m_worker.join();
+    }
+}
+
+SocketIndex::SocketIndex(ProcFsRootPtr procFsRoot, const Options& options, Log::ILogger* log)
+    : m_log(log)
+    , m_options(options)
+    , m_procFs(std::move(procFsRoot))
+{
+    ErLogDebug2(m_log, "{}.SocketIndex::SocketIndex(interval={} ms, resync={} s)", Er::Format::ptr(this), m_options.interval.count(), m_options.resync.count());
+
+    if (m_options.interval.count() > 0)
+        m_worker = std::jthread([this](std::stop_token stop) { run(stop); });
+}
+
+void SocketIndex::run(std::stop_token stop)
+{
+    System::CurrentThread::setName("socket_index");
+
+    while (!stop.stop_requested())
+    {
+        Er::Util::ExceptionLogger xcptHandler(m_log);
+        try
+        {
+            refresh();
+        }
+        catch (...)
+        {
+            Er::dispatchException(std::current_exception(), xcptHandler);
+        }
+
+        std::unique_lock l(m_sleepMutex);
+        m_sleep.wait_for(l, stop, m_options.interval, []() { return false; });
+    }
+}
+
+SocketIndex::Tables SocketIndex::readTables()
+{
+    Tables tables;
+
+    for (auto& t : NetTables)
+    {
+        auto sockets = m_procFs.readNetSockets(t.name);
+        if (!sockets.has_value())
+        {
+            // no IPv6 etc
+            ErLogDebug2(m_log, "Failed to read /proc/net/{}: {}", t.name, sockets.error().message());
+            continue;
+        }
+
+        tables.sockets.reserve(tables.sockets.size() + sockets.value().size());
+        for (auto& net : sockets.value())
+            tables.sockets.push_back(Socket{ net, t.protocol, t.ipv6 });
+    }
+
+    tables.byInode.reserve(tables.sockets.size());
+    tables.byLocalPort.reserve(tables.sockets.size());
+    tables.byRemotePort.reserve(tables.sockets.size());
+    tables.byRemote.reserve(tables.sockets.size());
+
+    for (std::uint32_t i = 0; i < tables.sockets.size(); ++i)
+    {
+        auto& net = tables.sockets[i].net;
+
+        if (net.inode)
+            tables.byInode.insert({ net.inode, i });
+
+        tables.byLocalPort.insert({ net.localPort, i });
+
+        if (net.remotePort)
+        {
+            tables.byRemotePort.insert({ net.remotePort, i });
+            tables.byRemote.insert({ net.remoteAddress, i });
+        }
+    }
+
+    return tables;
+}
+
+void SocketIndex::dropOwners(Pid pid, const Process& process)
+{
+    for (auto& s : process.sockets)
+    {
+        auto it = m_owners.find(s.inode);
+        if (it == m_owners.end())
+            continue;
+
+        std::erase_if(it->second, [pid](const SocketInfo::Owner& o) { return o.pid == pid; });
+        if (it->second.empty())
+            m_owners.erase(it);
+    }
+}
+
+void SocketIndex::addOwners(Pid pid, const Process& process)
+{
+    for (auto& s : process.sockets)
+        m_owners[s.inode].push_back(SocketInfo::Owner{ pid, s.fd });
+}
+
+void SocketIndex::refresh()
+{
+    auto started = Time::now();
+
+    auto tables = readTables();
+
+    auto pids = m_procFs.enumeratePids();
+    if (!pids.has_value())
+    {
+        ErLogError2(m_log, "Failed to enumerate processes: {}", pids.error().message());
+        return;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    bool resync = (now - m_lastResync >= m_options.resync);
+    if (resync)
+        m_lastResync = now;
+
+    // a socket nobody is known to hold; a process may have closed one fd and opened a socket
+    // in its place, so fd counts don't tell who it is and everybody gets looked at
+    bool unresolved = false;
+    for (auto& [inode, _] : tables.byInode)
+    {
+        if (!m_owners.contains(inode) && !m_unowned.contains(inode))
+        {
+            unresolved = true;
+            break;
+        }
+    }
+
+    ++m_generation;
+
+    struct Rescanned
+    {
+        Pid pid;
+        Process process;
+    };
+
+    std::vector<Rescanned> rescanned;
+
+    // the fd directories are read unlocked; find() answers from the previous refresh until the swap below
+    for (auto pid : pids.value())
+    {
+        auto fdCount = m_procFs.readFdCount(pid);
+        if (!fdCount.has_value())
+            continue; // gone
+
+        auto it = m_processes.find(pid);
+        if (it != m_processes.end())
+        {
+            // nobody else reads 'generation'
+            it->second.generation = m_generation;
+
+            auto changed = unresolved || (fdCount.value() != it->second.fdCount);
+            if (!resync && !changed)
+                continue;
+        }
+
+        Rescanned r{ pid, Process{ fdCount.value(), {}, m_generation } };
+
+        auto fds = m_procFs.readFds(pid);
+        if (fds.has_value())
+        {
+            for (auto& link : fds.value())
+            {
+                auto inode = socketInode(link.target);
+                if (inode)
+                    r.process.sockets.push_back(ProcessSocket{ link.fd, *inode });
+            }
+        }
+
+        rescanned.push_back(std::move(r));
+    }
+
+    {
+        std::unique_lock l(m_mutex);
+
+        m_tables = std::move(tables);
+
+        for (auto& r : rescanned)
+        {
+            auto& p = m_processes[r.pid];
+            dropOwners(r.pid, p);
+            p = std::move(r.process);
+            addOwners(r.pid, p);
+        }
+
+        for (auto it = m_processes.begin(); it != m_processes.end();)
+        {
+            if (it->second.generation != m_generation)
+            {
+                dropOwners(it->first, it->second);
+                it = m_processes.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+
+    // what's still unowned after everybody has been looked at is held by nobody we can see (another
+    // network namespace, a socket being torn down) and doesn't cause another full pass by itself
+    if (unresolved || resync)
+    {
+        m_unowned.clear();
+        for (auto& [inode, _] : m_tables.byInode)
+        {
+            if (!m_owners.contains(inode))
+                m_unowned.insert(inode);
+        }
+    }
+
+    ErLogDebug2(m_log, "Socket index: {} sockets, {} of {} processes rescanned in {} us", m_tables.sockets.size(), rescanned.size(), m_processes.size(), Time::now() - started);
+}
+
+SocketInfo SocketIndex::describe(const Socket& socket) const
+{
+    SocketInfo info;
+    info.protocol = socket.protocol;
+    info.ipv6 = socket.ipv6;
+    info.localAddress = formatAddress(socket.net.localAddress, socket.ipv6);
+    info.localPort = socket.net.localPort;
+    info.remoteAddress = formatAddress(socket.net.remoteAddress, socket.ipv6);
+    info.remotePort = socket.net.remotePort;
+    info.state = socket.net.state;
+    info.uid = socket.net.uid;
+    info.inode = socket.net.inode;
+
+    if (socket.net.inode)
+    {
+        auto it = m_owners.find(socket.net.inode);
+        if (it != m_owners.end())
+            info.owners = it->second;
+    }
+
+    return info;
+}
+
+std::expected<std::vector<SocketInfo>, Error> SocketIndex::find(const SocketQuery& query) const
+{
+    std::optional<Address> address;
+    if (query.by == SocketQuery::By::RemoteAddress)
+    {
+        address = parseAddress(query.address);
+        if (!address)
+            return std::unexpected(Error(Result::InvalidInput, GenericError));
+    }
+
+    std::vector<SocketInfo> result;
+
+    std::shared_lock l(m_mutex);
+
+    switch (query.by)
+    {
+    case SocketQuery::By::Port:
+    {
+        auto local = m_tables.byLocalPort.equal_range(query.port);
+        for (auto it = local.first; it != local.second; ++it)
+            result.push_back(describe(m_tables.sockets[it->second]));
+
+        // the ones connected to themselves are there already
+        auto remote = m_tables.byRemotePort.equal_range(query.port);
+        for (auto it = remote.first; it != remote.second; ++it)
+        {
+            auto& socket = m_tables.sockets[it->second];
+            if (socket.net.localPort != query.port)
+                result.push_back(describe(socket));
+        }
+        break;
+    }
+
+    case SocketQuery::By::LocalPort:
+    {
+        auto range = m_tables.byLocalPort.equal_range(query.port);
+        for (auto it = range.first; it != range.second; ++it)
+            result.push_back(describe(m_tables.sockets[it->second]));
+        break;
+    }
+
+    case SocketQuery::By::RemotePort:
+    {
+        auto range = m_tables.byRemotePort.equal_range(query.port);
+        for (auto it = range.first; it != range.second; ++it)
+            result.push_back(describe(m_tables.sockets[it->second]));
+        break;
+    }
+
+    case SocketQuery::By::Pid:
+    {
+        auto process = m_processes.find(query.pid);
+        if (process == m_processes.end())
+            break;
+
+        for (auto& s : process->second.sockets)
+        {
+            auto it = m_tables.byInode.find(s.inode);
+            if (it != m_tables.byInode.end())
+                result.push_back(describe(m_tables.sockets[it->second]));
+        }
+        break;
+    }
+
+    case SocketQuery::By::RemoteAddress:
+    {
+        auto range = m_tables.byRemote.equal_range(*address);
+        for (auto it = range.first; it != range.second; ++it)
+            result.push_back(describe(m_tables.sockets[it->second]));
+        break;
+    }
+
+    default:
+        return std::unexpected(Error(Result::InvalidInput, GenericError));
+    }
+
+    return result;
+}
+
+
+} // namespace Er::ProcessTree::Linux {}
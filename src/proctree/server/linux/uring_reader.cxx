@@ -0,0 +1,317 @@
+#include "uring_reader.hxx"
+
+#include <erebus/rtl/exception.hxx>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+
+namespace Er::ProcessTree::Linux
+{
+
+namespace
+{
+
+int ioUringSetup(unsigned entries, io_uring_params* p) noexcept
+{
+    return static_cast<int>(::syscall(__NR_io_uring_setup, entries, p));
+}
+
+int ioUringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags) noexcept
+{
+    return static_cast<int>(::syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0));
+}
+
+int ioUringRegister(int fd, unsigned opcode, const void* arg, unsigned count) noexcept
+{
+    return static_cast<int>(::syscall(__NR_io_uring_register, fd, opcode, arg, count));
+}
+
+template <typename T>
+T* at(void* base, std::uint32_t offset) noexcept
+{
+    return reinterpret_cast<T*>(static_cast<char*>(base) + offset);
+}
+
+constexpr std::uint64_t userData(unsigned slot, auto op) noexcept
+{
+    return (std::uint64_t(slot) << 2) | static_cast<std::uint64_t>(op);
+}
+
+} // namespace {}
+
+
+UringReader::~UringReader()
+{
+    if (m_sqes)
+        ::munmap(m_sqes, m_sqesSize);
+
+    if (m_cqRing && (m_cqRing != m_sqRing))
+        ::munmap(m_cqRing, m_cqRingSize);
+
+    if (m_sqRing)
+        ::munmap(m_sqRing, m_sqRingSize);
+}
+
+UringReader::UringReader(Util::FileHandle&& ring, const io_uring_params& params, int dirFd, unsigned slots, std::size_t slotSize)
+    : m_ring(std::move(ring))
+    , m_dirFd(dirFd)
+    , m_slots(slots)
+    , m_slotSize(slotSize)
+    , m_sqEntries(params.sq_entries)
+    , m_buffers(new char[slots * slotSize])
+    , m_results(slots, 0)
+    , m_stats(slots)
+    , m_paths(slots)
+{
+}
+
+std::unique_ptr<UringReader> UringReader::tryCreate(int dirFd, unsigned slots, std::size_t slotSize)
+{
+    ErAssert(slots > 0);
+    ErAssert(slotSize > 1);
+
+    // a read is three linked SQEs
+    io_uring_params params = {};
+    Util::FileHandle ring(ioUringSetup(slots * 3, &params));
+    if (!ring.valid())
+        return {};
+
+    if (!(params.features & IORING_FEAT_NODROP))
+        return {}; // older than 5.5
+
+    std::unique_ptr<UringReader> reader(new UringReader(std::move(ring), params, dirFd, slots, slotSize));
+    if (!reader->map(params) || !reader->registerResources())
+        return {};
+
+    // direct descriptors are the newest thing we rely on, so try them out
+    reader->queueRead(0, "stat");
+    if (!reader->run() || (reader->result(0) <= 0))
+        return {};
+
+    return reader;
+}
+
+bool UringReader::map(const io_uring_params& params)
+{
+    m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    m_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+    bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single)
+        m_sqRingSize = m_cqRingSize = std::max(m_sqRingSize, m_cqRingSize);
+
+    m_sqRing = ::mmap(nullptr, m_sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring.get(), IORING_OFF_SQ_RING);
+    if (m_sqRing == MAP_FAILED)
+    {
+        m_sqRing = nullptr;
+        return false;
+    }
+
+    if (single)
+    {
+        m_cqRing = m_sqRing;
+    }
+    else
+    {
+        m_cqRing = ::mmap(nullptr, m_cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring.get(), IORING_OFF_CQ_RING);
+        if (m_cqRing == MAP_FAILED)
+        {
+            m_cqRing = nullptr;
+            return false;
+        }
+    }
+
+    m_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    auto sqes = ::mmap(nullptr, m_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring.get(), IORING_OFF_SQES);
+    if (sqes == MAP_FAILED)
+        return false;
+
+    m_sqes = static_cast<io_uring_sqe*>(sqes);
+
+    m_sqHead = at<unsigned>(m_sqRing, params.sq_off.head);
+    m_sqTail = at<unsigned>(m_sqRing, params.sq_off.tail);
+    m_sqMask = *at<unsigned>(m_sqRing, params.sq_off.ring_mask);
+    m_sqArray = at<unsigned>(m_sqRing, params.sq_off.array);
+    m_cqHead = at<unsigned>(m_cqRing, params.cq_off.head);
+    m_cqTail = at<unsigned>(m_cqRing, params.cq_off.tail);
+    m_cqMask = *at<unsigned>(m_cqRing, params.cq_off.ring_mask);
+    m_cqes = at<io_uring_cqe>(m_cqRing, params.cq_off.cqes);
+
+    return true;
+}
+
+bool UringReader::registerResources()
+{
+    // a sparse table: openat fills the slots, close empties them
+    std::vector<int> files(m_slots, -1);
+    if (ioUringRegister(m_ring.get(), IORING_REGISTER_FILES, files.data(), m_slots) < 0)
+        return false;
+
+    // pinning the buffers may fail on RLIMIT_MEMLOCK (pre-5.12 kernels); plain reads still work then
+    iovec iov = { m_buffers.get(), m_slots * m_slotSize };
+    m_fixedBuffers = (ioUringRegister(m_ring.get(), IORING_REGISTER_BUFFERS, &iov, 1) == 0);
+
+    return true;
+}
+
+io_uring_sqe* UringReader::nextSqe() noexcept
+{
+    auto head = std::atomic_ref<unsigned>(*m_sqHead).load(std::memory_order_acquire);
+    auto tail = *m_sqTail + m_queued;
+    ErAssert(tail - head < m_sqEntries);
+
+    auto index = tail & m_sqMask;
+    m_sqArray[index] = index;
+    ++m_queued;
+
+    auto sqe = &m_sqes[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+const char* UringReader::setPath(unsigned slot, std::string_view path) noexcept
+{
+    ErAssert(path.length() < MaxPath);
+
+    auto& dest = m_paths[slot];
+    auto end = std::copy(path.begin(), path.end(), dest.begin());
+    *end = '\0';
+
+    return dest.data();
+}
+
+void UringReader::queueRead(unsigned slot, std::string_view path)
+{
+    ErAssert(slot < m_slots);
+
+    auto p = setPath(slot, path);
+    m_results[slot] = 0;
+
+    auto open = nextSqe();
+    open->opcode = IORING_OP_OPENAT;
+    open->fd = m_dirFd;
+    open->addr = reinterpret_cast<std::uint64_t>(p);
+    open->open_flags = O_RDONLY; // O_CLOEXEC is meaningless (and rejected) for direct descriptors
+    open->file_index = slot + 1;
+    open->flags = IOSQE_IO_LINK;
+    open->user_data = userData(slot, Op::Open);
+
+    // a short read fails an ordinary link, hence the hard one: the close must always run
+    auto read = nextSqe();
+    read->opcode = m_fixedBuffers ? IORING_OP_READ_FIXED : IORING_OP_READ;
+    read->fd = static_cast<int>(slot);
+    read->addr = reinterpret_cast<std::uint64_t>(m_buffers.get() + slot * m_slotSize);
+    read->len = static_cast<std::uint32_t>(m_slotSize - 1);
+    read->buf_index = 0;
+    read->flags = IOSQE_FIXED_FILE | IOSQE_IO_HARDLINK;
+    read->user_data = userData(slot, Op::Read);
+
+    auto close = nextSqe();
+    close->opcode = IORING_OP_CLOSE;
+    close->file_index = slot + 1;
+    close->user_data = userData(slot, Op::Close);
+
+    m_pending += 3;
+}
+
+void UringReader::queueStat(unsigned slot, std::string_view path)
+{
+    ErAssert(slot < m_slots);
+
+    auto p = setPath(slot, path);
+    m_results[slot] = 0;
+
+    auto sqe = nextSqe();
+    sqe->opcode = IORING_OP_STATX;
+    sqe->fd = m_dirFd;
+    sqe->addr = reinterpret_cast<std::uint64_t>(p);
+    sqe->len = STATX_UID;
+    sqe->off = reinterpret_cast<std::uint64_t>(&m_stats[slot]); // addr2
+    sqe->user_data = userData(slot, Op::Stat);
+
+    m_pending += 1;
+}
+
+void UringReader::complete(const io_uring_cqe& cqe) noexcept
+{
+    auto slot = static_cast<unsigned>(cqe.user_data >> 2);
+    auto op = static_cast<Op>(cqe.user_data & 3);
+    ErAssert(slot < m_slots);
+
+    auto& result = m_results[slot];
+    switch (op)
+    {
+    case Op::Open:
+        if (cqe.res < 0)
+            result = cqe.res;
+        break;
+
+    case Op::Read:
+        // the read is canceled if the open has failed; keep the open error then
+        if (result == 0)
+        {
+            result = cqe.res;
+            if (cqe.res >= 0)
+                m_buffers[slot * m_slotSize + cqe.res] = '\0';
+        }
+        break;
+
+    case Op::Stat:
+        result = cqe.res;
+        break;
+
+    case Op::Close:
+    default:
+        break;
+    }
+}
+
+std::expected<void, Error> UringReader::run()
+{
+    auto toSubmit = m_queued;
+
+    std::atomic_ref<unsigned>(*m_sqTail).store(*m_sqTail + m_queued, std::memory_order_release);
+    m_queued = 0;
+
+    while (m_pending > 0)
+    {
+        ++m_enterCalls;
+        auto r = ioUringEnter(m_ring.get(), toSubmit, m_pending, IORING_ENTER_GETEVENTS);
+        if (r < 0)
+        {
+            if (errno == EINTR)
+                continue;
+
+            // there's no telling what's still in flight; don't reuse this ring
+            auto e = errno;
+            m_pending = 0;
+            return std::unexpected(Error(e, PosixError));
+        }
+
+        toSubmit -= std::min<unsigned>(toSubmit, static_cast<unsigned>(r));
+
+        auto head = *m_cqHead;
+        auto tail = std::atomic_ref<unsigned>(*m_cqTail).load(std::memory_order_acquire);
+        while (head != tail)
+        {
+            complete(m_cqes[head & m_cqMask]);
+            ++head;
+            --m_pending;
+        }
+
+        std::atomic_ref<unsigned>(*m_cqHead).store(head, std::memory_order_release);
+    }
+
+    return {};
+}
+
+
+} // namespace Er::ProcessTree::Linux {}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <erebus/rtl/error.hxx>
+#include <erebus/rtl/util/generic_handle.hxx>
+
+#include <array>
+#include <expected>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+#include <linux/io_uring.h>
+#include <sys/stat.h>
+
+
+namespace Er::ProcessTree::Linux
+{
+
+//
+// Reads lots of small files (relative to a directory fd) with io_uring: every file
+// is an openat -> read -> close chain on a direct descriptor into a registered buffer,
+// and the whole batch goes to the kernel with a single io_uring_enter().
+// Talks to the kernel directly (no liburing); needs Linux 5.15+ for direct descriptors.
+//
+// Each queued operation takes a slot (a buffer, a file table entry and a statx record);
+// results stay valid until the next batch is queued. Not thread-safe.
+//
+
+class UringReader final
+    : public boost::noncopyable
+{
+public:
+    ~UringReader();
+
+    // returns nullptr if io_uring is not usable here (old kernel, seccomp, io_uring_disabled etc)
+    static std::unique_ptr<UringReader> tryCreate(int dirFd, unsigned slots, std::size_t slotSize);
+
+    unsigned slots() const noexcept
+    {
+        return m_slots;
+    }
+
+    std::size_t slotSize() const noexcept
+    {
+        return m_slotSize;
+    }
+
+    void queueRead(unsigned slot, std::string_view path);
+    void queueStat(unsigned slot, std::string_view path);
+
+    // submits everything queued and waits for it to complete
+    std::expected<void, Error> run();
+
+    // bytes read (or 0 for a stat) on success, -errno otherwise
+    int result(unsigned slot) const noexcept
+    {
+        return m_results[slot];
+    }
+
+    // NUL-terminated; truncated if it has filled the whole slot
+    std::string_view data(unsigned slot) const noexcept
+    {
+        auto r = m_results[slot];
+        return std::string_view(m_buffers.get() + slot * m_slotSize, (r > 0) ? std::size_t(r) : 0);
+    }
+
+    bool truncated(unsigned slot) const noexcept
+    {
+        return std::size_t(m_results[slot]) + 1 >= m_slotSize;
+    }
+
+    const struct ::statx& stat(unsigned slot) const noexcept
+    {
+        return m_stats[slot];
+    }
+
+    std::uint64_t enterCalls() const noexcept
+    {
+        return m_enterCalls;
+    }
+
+private:
+    enum class Op : std::uint64_t
+    {
+        Open,
+        Read,
+        Close,
+        Stat
+    };
+
+    static constexpr std::size_t MaxPath = 48;
+
+    UringReader(Util::FileHandle&& ring, const io_uring_params& params, int dirFd, unsigned slots, std::size_t slotSize);
+
+    bool map(const io_uring_params& params);
+    bool registerResources();
+    io_uring_sqe* nextSqe() noexcept;
+    const char* setPath(unsigned slot, std::string_view path) noexcept;
+    void complete(const io_uring_cqe& cqe) noexcept;
+
+    Util::FileHandle m_ring;
+    const int m_dirFd;
+    const unsigned m_slots;
+    const std::size_t m_slotSize;
+    bool m_fixedBuffers = false;
+
+    void* m_sqRing = nullptr;
+    std::size_t m_sqRingSize = 0;
+    void* m_cqRing = nullptr;
+    std::size_t m_cqRingSize = 0;
+    io_uring_sqe* m_sqes = nullptr;
+    std::size_t m_sqesSize = 0;
+
+    unsigned* m_sqHead = nullptr;
+    unsigned* m_sqTail = nullptr;
+    unsigned m_sqMask = 0;
+    unsigned* m_sqArray = nullptr;
+    unsigned m_sqEntries = 0;
+    unsigned* m_cqHead = nullptr;
+    unsigned* m_cqTail = nullptr;
+    unsigned m_cqMask = 0;
+    io_uring_cqe* m_cqes = nullptr;
+
+    unsigned m_queued = 0;           // SQEs not yet submitted
+    unsigned m_pending = 0;          // CQEs still expected
+
+    std::unique_ptr<char[]> m_buffers;
+    std::vector<int> m_results;
+    std::vector<struct ::statx> m_stats;
+    std::vector<std::array<char, MaxPath>> m_paths;
+    std::uint64_t m_enterCalls = 0;
+};
+
+
+} // namespace Er::ProcessTree::Linux {}
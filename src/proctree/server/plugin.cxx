@@ -47,7 +47,7 @@ private:
     {
         auto grpcServer = m_host->server();
 
-        auto proctreeSvc = createProcessListService(m_log.get());
+        auto proctreeSvc = createProcessListService(m_log.get(), m_args);
         grpcServer->addService(proctreeSvc);
     }
 
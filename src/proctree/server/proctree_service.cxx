@@ -1,11 +1,27 @@
 #include <protobuf/proctree.grpc.pb.h>
 
+#include <erebus/ipc/grpc/server/admission.hxx>
+#include <erebus/ipc/grpc/server/arena_allocator.hxx>
+#include <erebus/proctree/blob_cache.hxx>
 #include <erebus/proctree/protocol.hxx>
+#include <erebus/proctree/server/group_aggregator.hxx>
+#include <erebus/proctree/server/linux/file_index.hxx>
+#include <erebus/proctree/server/linux/socket_index.hxx>
+#include <erebus/proctree/server/shm_publisher.hxx>
+#include <erebus/proctree/server/snapshot_recorder.hxx>
+#include <erebus/rtl/system/user.hxx>
 #include <erebus/rtl/time.hxx>
 #include <erebus/rtl/util/exception_util.hxx>
 #include <erebus/rtl/util/unknown_base.hxx>
+#include <erebus/server/system_info.hxx>
 
+#include "alert_monitor.hxx"
+#include "collection_executor.hxx"
+#include "event_stream.hxx"
 #include "linux/process_props_collector.hxx"
+#include "linux/psi_monitor.hxx"
+#include "linux/root_worker.hxx"
+#include "linux/scanner.hxx"
 #include "proctree_service.hxx"
 #include "../trace.hxx"
 
@@ -15,6 +31,11 @@ namespace Er::ProcessTree::Private
 namespace
 {
 
+constexpr std::string_view ScanStatsProperty{ "proctree/scan_stats" };
+
+// FindOpenFiles replies are single messages
+constexpr std::size_t MaxOpenFiles = 10000;
+
 
 class ProctreeService final
     : public Util::ReferenceCountedBase<Util::ObjectBase<Er::Ipc::Grpc::IService>>
@@ -26,13 +47,125 @@ public:
     ~ProctreeService()
     {
         ProctreeTrace2(m_log, "{}.ProctreeService::~ProctreeService", Er::Format::ptr(this));
+
+        Server::SystemInfo::unregisterSource(ScanStatsProperty);
+
+        if (m_recorder)
+            m_scanner->removeListener(m_recorderListener);
+
+        if (m_shm)
+            m_scanner->removeListener(m_shmListener);
     }
 
-    ProctreeService(Log::ILogger* log)
+    ProctreeService(Log::ILogger* log, const PropertyMap& args)
         : m_log(log)
-        , m_procFs()
+        , m_roots(makeRoots(args, log))
+        , m_procFsRoot(m_roots.front()->procFsRoot())
     {
         ProctreeTraceIndent2(m_log, "{}.ProctreeService::ProctreeService", Er::Format::ptr(this));
+
+        Server::SystemInfo::registerSource(ScanStatsProperty, [this](std::string_view name) { return scanStats(name); });
+
+        // unary call messages go onto per-call arenas; the big replies get bigger initial blocks
+        SetMessageAllocatorFor_GetProcessProps(&m_processPropsAllocator);
+        SetMessageAllocatorFor_GetProcessPropsBatch(&m_batchAllocator);
+        SetMessageAllocatorFor_GroupBy(&m_groupByAllocator);
+        SetMessageAllocatorFor_GetBlobs(&m_blobAllocator);
+        SetMessageAllocatorFor_FindSockets(&m_socketAllocator);
+        SetMessageAllocatorFor_FindOpenFiles(&m_openFileAllocator);
+
+        unsigned threads = 4;
+        std::size_t queue = 256;
+        auto executor = findProperty(args, "executor", Property::Type::Map);
+        if (executor)
+        {
+            auto threadsProp = findProperty(*executor->getMap(), "threads", Property::Type::Int64);
+            if (threadsProp)
+                threads = static_cast<unsigned>(*threadsProp->getInt64());
+
+            auto queueProp = findProperty(*executor->getMap(), "queue", Property::Type::Int64);
+            if (queueProp)
+                queue = static_cast<std::size_t>(*queueProp->getInt64());
+        }
+
+        if (!threads || !queue)
+            throw Exception(std::source_location::current(), Error(Result::BadConfiguration, GenericError), Exception::Message("Invalid collection executor configuration"));
+
+        ErLogInfo2(m_log, "Collecting process properties on {} threads, queue size {}", threads, queue);
+        m_executor = std::make_unique<CollectionExecutor>(m_procFsRoot, threads, queue, m_log);
+
+        auto psi = findProperty(args, "psi", Property::Type::Map);
+        if (psi)
+        {
+            auto& config = *psi->getMap();
+
+            unsigned top = 10;
+            auto topProp = findProperty(config, "top", Property::Type::Int64);
+            if (topProp)
+                top = static_cast<unsigned>(*topProp->getInt64());
+
+            m_psi = std::make_unique<Linux::PsiMonitor>(m_procFsRoot, Linux::PsiMonitor::parseTriggers(config), top, m_log);
+        }
+
+        std::chrono::milliseconds interval(1000);
+        auto scan = findProperty(args, "scan", Property::Type::Map);
+        if (scan)
+        {
+            auto intervalProp = findProperty(*scan->getMap(), "interval_ms", Property::Type::Int64);
+            if (intervalProp)
+                interval = std::chrono::milliseconds(*intervalProp->getInt64());
+        }
+
+        m_scanner = std::make_unique<Linux::Scanner>(m_procFsRoot, interval, useIoUring(args), m_log);
+
+        auto sockets = findProperty(args, "sockets", Property::Type::Map);
+        if (sockets)
+        {
+            auto options = socketIndexOptions(*sockets->getMap());
+            ErLogInfo2(m_log, "Indexing sockets every {} ms, full pass every {} s", options.interval.count(), options.resync.count());
+
+            m_sockets = std::make_unique<Linux::SocketIndex>(m_procFsRoot, options, m_log);
+        }
+
+        auto files = findProperty(args, "files", Property::Type::Map);
+        if (files)
+        {
+            auto options = fileIndexOptions(*files->getMap());
+            ErLogInfo2(m_log, "Indexing open files every {} ms, full pass every {} s, budget {} MB", options.interval.count(), options.resync.count(), options.budget / (1024 * 1024));
+
+            m_files = std::make_unique<Linux::FileIndex>(m_procFsRoot, options, m_log);
+        }
+
+        auto alerts = findProperty(args, "alerts", Property::Type::Vector);
+        if (alerts)
+        {
+            m_alerts = std::make_unique<AlertMonitor>(*m_scanner, *alerts->getVector(), m_log);
+        }
+
+        std::size_t blobCacheMb = 64;
+        auto blobCache = findProperty(args, "blob_cache_mb", Property::Type::Int64);
+        if (blobCache)
+            blobCacheMb = static_cast<std::size_t>(*blobCache->getInt64());
+
+        m_blobs = std::make_shared<BlobCache>(blobCacheMb * 1024 * 1024);
+
+        auto recorder = findProperty(args, "recorder", Property::Type::Map);
+        if (recorder)
+        {
+            m_recorder = std::make_unique<SnapshotRecorder>(recorderOptions(*recorder->getMap()), m_log);
+
+            auto r = m_recorder.get();
+            m_recorderListener = m_scanner->addListener(m_recorder->fields(), [r](const SnapshotDelta& delta) { r->record(delta); }, true);
+        }
+
+        auto shm = findProperty(args, "shm", Property::Type::Map);
+        if (shm)
+        {
+            m_shm = std::make_unique<ShmPublisher>(shmOptions(*shm->getMap()), m_log);
+
+            auto p = m_shm.get();
+            m_shmListener = m_scanner->addListener(m_shm->fields(), [p](const SnapshotDelta& delta) { p->publish(delta); }, true);
+        }
     }
 
     ::grpc::Service* grpc() noexcept override
@@ -52,7 +185,7 @@ public:
         auto pid = request->pid();
         ErLogInfo2(m_log, "ProcessList.GetProcessProps(pid={}) from {}", pid, context->peer());
 
-        auto reactor = std::make_unique<ProcessPropsReplyReactor>(m_log);
+        auto reactor = std::make_unique<UnaryReplyReactor>(m_log);
         if (context->IsCancelled()) [[unlikely]]
         {
             ErLogWarning2(m_log, "Ping canceled");
@@ -60,6 +193,12 @@ public:
             return reactor.release();
         }
 
+        if (auto rejected = Er::Ipc::Grpc::admissionRejected(context)) [[unlikely]]
+        {
+            reactor->Finish(*rejected);
+            return reactor.release();
+        }
+
         std::optional<Time::ValueType> timestamp;
         std::optional<Time::ValueType> started;
         if (request->has_header())
@@ -71,74 +210,1253 @@ public:
         
         auto mask = unmarshalProcessPropertyMask(*request);
 
-        auto props_ = Linux::collectProcessProps(m_procFs, pid, mask, m_log);
-        if (!props_.has_value())
+        return offload(context, std::move(reactor), "GetProcessProps", [this, pid, mask, reply, timestamp, started](Linux::ProcFs& procFs)
+        {
+            if (collectOne(procFs, pid, mask, *reply))
+            {
+                if (timestamp)
+                {
+                    reply->mutable_header()->set_timestamp(*timestamp);
+                }
+
+                if (started)
+                {
+                    auto finished = Time::now();
+                    reply->mutable_header()->set_duration(finished - *started);
+                }
+            }
+        });
+    }
+
+    grpc::ServerUnaryReactor* GetProcessPropsBatch(grpc::CallbackServerContext* context, const erebus::ProcessPropsBatchRequest* request, erebus::ProcessPropsBatchReply* reply) override
+    {
+        ProctreeTraceIndent2(m_log, "{}.ProctreeService::GetProcessPropsBatch", Er::Format::ptr(this));
+
+        ErLogInfo2(m_log, "ProcessList.GetProcessPropsBatch(count={}) from {}", request->requests_size(), context->peer());
+
+        auto reactor = std::make_unique<UnaryReplyReactor>(m_log);
+        if (context->IsCancelled()) [[unlikely]]
         {
-            auto& e = props_.error();
-            Er::Ipc::Grpc::marshalError(e, *reply->mutable_header()->mutable_exception());
+            ErLogWarning2(m_log, "GetProcessPropsBatch canceled");
+            reactor->Finish(grpc::Status::CANCELLED);
+            return reactor.release();
         }
-        else
+
+        if (auto rejected = Er::Ipc::Grpc::admissionRejected(context)) [[unlikely]]
+        {
+            reactor->Finish(*rejected);
+            return reactor.release();
+        }
+
+        std::optional<Time::ValueType> started;
+        if (request->has_header())
+        {
+            if (request->header().has_timestamp())
+                reply->mutable_header()->set_timestamp(request->header().timestamp());
+
+            started = Time::now();
+        }
+
+        // errors are per process; the batch as a whole always succeeds
+        return offload(context, std::move(reactor), "GetProcessPropsBatch", [this, request, reply, started](Linux::ProcFs& procFs)
+        {
+            reply->mutable_replies()->Reserve(request->requests_size());
+            for (auto& r : request->requests())
+                collectOne(procFs, r.pid(), unmarshalProcessPropertyMask(r), *reply->add_replies());
+
+            if (started)
+                reply->mutable_header()->set_duration(Time::now() - *started);
+        });
+    }
+
+    grpc::ServerWriteReactor<erebus::ProcessPropsReply>* ListProcesses(grpc::CallbackServerContext* context, const erebus::ProcessPropsRequest* request) override
+    {
+        ProctreeTraceIndent2(m_log, "{}.ProctreeService::ListProcesses", Er::Format::ptr(this));
+
+        ErLogInfo2(m_log, "ProcessList.ListProcesses() from {}", context->peer());
+
+        auto reactor = std::make_unique<ProcessListReactor>(m_log, m_roots.size(), request->blobs() ? m_blobs : nullptr);
+        if (context->IsCancelled()) [[unlikely]]
+        {
+            ErLogWarning2(m_log, "ListProcesses canceled");
+            reactor->abandon(grpc::Status::CANCELLED);
+            return reactor.release();
+        }
+
+        if (auto rejected = Er::Ipc::Grpc::admissionRejected(context)) [[unlikely]]
+        {
+            reactor->abandon(*rejected);
+            return reactor.release();
+        }
+
+        auto mask = unmarshalProcessPropertyMask(*request);
+
+        // every root is scanned on its own worker; whichever finishes first gets streamed first
+        auto r = reactor.release();
+        std::vector<std::string_view> busy;
+        for (auto& root : m_roots)
+        {
+            auto submitted = root->trySubmit([r, mask](Linux::RootWorker& worker)
+            {
+                if (r->cancelled())
+                    r->deliver(worker.tag(), std::vector<ProcessProperties>{});
+                else
+                    r->deliver(worker.tag(), worker.scan(mask));
+            });
+
+            if (!submitted)
+                busy.push_back(root->tag());
+        }
+
+        if (busy.size() == m_roots.size())
         {
-            marshalProcessProperties(props_.value(), *reply->mutable_props());
+            ErLogWarning2(m_log, "ListProcesses rejected: too many scans pending");
+            r->abandon(grpc::Status(grpc::StatusCode::RESOURCE_EXHAUSTED, "Too many pending scans"));
+            return r;
+        }
+
+        // the roots that could take no more scans fail on their own
+        for (auto tag : busy)
+            r->deliver(std::string(tag), std::unexpected(Error(std::make_error_code(std::errc::resource_unavailable_try_again))));
+
+        return r;
+    }
+
+    grpc::ServerUnaryReactor* GroupBy(grpc::CallbackServerContext* context, const erebus::GroupByRequest* request, erebus::GroupByReply* reply) override
+    {
+        ProctreeTraceIndent2(m_log, "{}.ProctreeService::GroupBy", Er::Format::ptr(this));
+
+        auto key = request->key();
+        ErLogInfo2(m_log, "ProcessList.GroupBy(key={}) from {}", key, context->peer());
+
+        auto reactor = std::make_unique<UnaryReplyReactor>(m_log);
+        if (context->IsCancelled()) [[unlikely]]
+        {
+            ErLogWarning2(m_log, "GroupBy canceled");
+            reactor->Finish(grpc::Status::CANCELLED);
+            return reactor.release();
+        }
+
+        if (auto rejected = Er::Ipc::Grpc::admissionRejected(context)) [[unlikely]]
+        {
+            reactor->Finish(*rejected);
+            return reactor.release();
+        }
+
+        if (key > static_cast<std::uint32_t>(GroupKey::Tty))
+        {
+            reactor->Finish(grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, "Unknown group key"));
+            return reactor.release();
+        }
+
+        std::optional<Time::ValueType> started;
+        if (request->has_header())
+        {
+            if (request->header().has_timestamp())
+                reply->mutable_header()->set_timestamp(request->header().timestamp());
+
+            started = Time::now();
+        }
 
-            if (timestamp)
+        auto fields = unpackProcessPropertyMask(request->fields());
+
+        return offload(context, std::move(reactor), "GroupBy", [this, key, fields, reply, started](Linux::ProcFs& procFs)
+        {
+            GroupAggregator aggregator(static_cast<GroupKey>(key), fields);
+
+            if (!m_scanner->forEachIfCovers(aggregator.required(), [&aggregator](const ProcessProperties& props) { aggregator.add(props); }))
             {
-                reply->mutable_header()->set_timestamp(*timestamp);
+                auto e = aggregateFromProcFs(procFs, aggregator);
+                if (e)
+                    Er::Ipc::Grpc::marshalError(*e, *reply->mutable_header()->mutable_exception());
             }
 
-            if (started)
+            auto groups = aggregator.result();
+            for (auto& g : groups)
             {
-                auto finished = Time::now();
-                reply->mutable_header()->set_duration(finished - *started);
+                if (static_cast<GroupKey>(key) == GroupKey::UserName)
+                {
+                    // one lookup per group, not per process
+                    auto info = System::User::lookup(static_cast<uid_t>(g.key));
+                    if (info)
+                        g.name = std::move(info->name);
+                }
+
+                marshalProcessGroup(g, *reply->add_groups());
             }
+
+            if (started)
+                reply->mutable_header()->set_duration(Time::now() - *started);
+        });
+    }
+
+    grpc::ServerWriteReactor<erebus::PressureEvent>* WatchPressure(grpc::CallbackServerContext* context, const erebus::PressureRequest* request) override
+    {
+        ProctreeTraceIndent2(m_log, "{}.ProctreeService::WatchPressure", Er::Format::ptr(this));
+
+        auto resources = request->resources();
+        ErLogInfo2(m_log, "ProcessList.WatchPressure(resources={:#x}) from {}", resources, context->peer());
+
+        auto reactor = std::make_unique<PressureStreamReactor>(m_log, &marshalPressureEvent);
+        if (context->IsCancelled()) [[unlikely]]
+        {
+            ErLogWarning2(m_log, "WatchPressure canceled");
+            reactor->Finish(grpc::Status::CANCELLED);
+            return reactor.release();
+        }
+
+        if (auto rejected = Er::Ipc::Grpc::admissionRejected(context)) [[unlikely]]
+        {
+            reactor->Finish(*rejected);
+            return reactor.release();
         }
 
+        if (!m_psi)
+        {
+            reactor->Finish(grpc::Status(grpc::StatusCode::FAILED_PRECONDITION, "Pressure monitoring is not enabled"));
+            return reactor.release();
+        }
+
+        // events arrive on the monitor thread
+        auto r = reactor.get();
+        auto id = m_psi->subscribe(resources, [r](const PressureEvent& ev) { r->push(ev); });
+        r->setUnsubscriber([psi = m_psi.get(), id]() { psi->unsubscribe(id); });
+
         return reactor.release();
     }
 
-private:
-    class ProcessPropsReplyReactor
-        : public grpc::ServerUnaryReactor
+    grpc::ServerWriteReactor<erebus::Alert>* WatchAlerts(grpc::CallbackServerContext* context, const erebus::AlertRequest* request) override
     {
-    public:
-        ~ProcessPropsReplyReactor()
+        ProctreeTraceIndent2(m_log, "{}.ProctreeService::WatchAlerts", Er::Format::ptr(this));
+
+        ErLogInfo2(m_log, "ProcessList.WatchAlerts(rules={}) from {}", request->rules_size(), context->peer());
+
+        auto reactor = std::make_unique<AlertStreamReactor>(m_log, &marshalAlert);
+        if (context->IsCancelled()) [[unlikely]]
         {
-            ProctreeTrace2(m_log, "{}.ProcessPropsReplyReactor::~ProcessPropsReplyReactor", Er::Format::ptr(this));
+            ErLogWarning2(m_log, "WatchAlerts canceled");
+            reactor->Finish(grpc::Status::CANCELLED);
+            return reactor.release();
         }
 
-        ProcessPropsReplyReactor(Log::ILogger* log) noexcept
-            : m_log(log)
+        if (auto rejected = Er::Ipc::Grpc::admissionRejected(context)) [[unlikely]]
         {
-            ProctreeTrace2(m_log, "{}.ProcessPropsReplyReactor::ProcessPropsReplyReactor", Er::Format::ptr(this));
+            reactor->Finish(*rejected);
+            return reactor.release();
         }
 
-    private:
-        void OnDone() override
+        if (!m_alerts)
         {
-            ProctreeTraceIndent2(m_log, "{}.ProcessPropsReplyReactor::OnDone", Er::Format::ptr(this));
+            reactor->Finish(grpc::Status(grpc::StatusCode::FAILED_PRECONDITION, "No alert rules configured"));
+            return reactor.release();
+        }
 
-            delete this;
+        std::vector<std::string> rules(request->rules().begin(), request->rules().end());
+
+        // alerts arrive on the scanner thread
+        auto r = reactor.get();
+        auto id = m_alerts->subscribe(std::move(rules), [r](const Alert& a) { r->push(a); });
+        r->setUnsubscriber([alerts = m_alerts.get(), id]() { alerts->unsubscribe(id); });
+
+        return reactor.release();
+    }
+
+    grpc::ServerWriteReactor<erebus::ProcessDelta>* Subscribe(grpc::CallbackServerContext* context, const erebus::SubscribeRequest* request) override
+    {
+        ProctreeTraceIndent2(m_log, "{}.ProctreeService::Subscribe", Er::Format::ptr(this));
+
+        ErLogInfo2(m_log, "ProcessList.Subscribe() from {}", context->peer());
+
+        // losing a delta would leave the client out of sync, so a slow client is disconnected instead
+        auto reactor = std::make_unique<DeltaStreamReactor>(m_log, &copyProcessDelta, 64, DeltaStreamReactor::Overflow::Abort);
+        if (context->IsCancelled()) [[unlikely]]
+        {
+            ErLogWarning2(m_log, "Subscribe canceled");
+            reactor->Finish(grpc::Status::CANCELLED);
+            return reactor.release();
         }
 
-        void OnCancel() override
+        if (auto rejected = Er::Ipc::Grpc::admissionRejected(context)) [[unlikely]]
         {
-            ProctreeTrace2(m_log, "{}.ProcessPropsReplyReactor::OnCancel", Er::Format::ptr(this));
+            reactor->Finish(*rejected);
+            return reactor.release();
         }
 
-        Log::ILogger* m_log;
+        ProcessProperties::Mask fields;
+        if (request->has_fields())
+            fields = unpackProcessPropertyMask(request->fields());
+        else
+            fields.set();
+
+        // the first delta is the current table and is delivered right from addListener(), the rest arrive on the scanner thread
+        std::optional<BlobEncoder> blobs;
+        if (request->blobs())
+            blobs.emplace(m_blobs);
+
+        auto r = reactor.get();
+        auto id = m_scanner->addListener(
+            fields,
+            [r, fields, blobs = std::move(blobs), reset = true](const SnapshotDelta& delta) mutable
+            {
+                if (reset)
+                {
+                    // a big table wouldn't fit into a single message
+                    reset = false;
+                    r->pushAll(marshalChunked(
+                        delta.timestamp,
+                        delta.changed,
+                        [&fields](const ProcessChange& change, erebus::ProcessProps& dest) { marshalProcessProperties(*change.props, fields, dest); },
+                        blobs ? &*blobs : nullptr));
+
+                    return;
+                }
+
+                erebus::ProcessDelta msg;
+                if (marshalSnapshotDelta(delta, fields, msg))
+                {
+                    if (blobs)
+                        encodeBlobs(*blobs, msg);
+
+                    r->push(msg);
+                }
+            },
+            true);
+
+        r->setUnsubscriber([scanner = m_scanner.get(), id]() { scanner->removeListener(id); });
+
+        return reactor.release();
+    }
+
+    grpc::ServerWriteReactor<erebus::ProcessDelta>* Replay(grpc::CallbackServerContext* context, const erebus::ReplayRequest* request) override
+    {
+        ProctreeTraceIndent2(m_log, "{}.ProctreeService::Replay", Er::Format::ptr(this));
+
+        ErLogInfo2(m_log, "ProcessList.Replay({}) from {}", request->timestamp(), context->peer());
+
+        auto reactor = new ReplayReactor(m_log);
+        if (context->IsCancelled()) [[unlikely]]
+        {
+            reactor->deliver({}, grpc::Status::CANCELLED);
+            return reactor;
+        }
+
+        if (auto rejected = Er::Ipc::Grpc::admissionRejected(context)) [[unlikely]]
+        {
+            reactor->deliver({}, *rejected);
+            return reactor;
+        }
+
+        if (!m_recorder)
+        {
+            reactor->deliver({}, grpc::Status(grpc::StatusCode::FAILED_PRECONDITION, "Snapshot recording is disabled"));
+            return reactor;
+        }
+
+        auto fields = m_recorder->fields();
+        if (request->has_fields())
+            fields = fields & unpackProcessPropertyMask(request->fields());
+
+        Time at(request->timestamp());
+        auto blobs = request->blobs();
+
+        // replaying reads files, so it's done off the gRPC threads
+        auto submitted = m_executor->trySubmit([this, reactor, at, fields, blobs](Linux::ProcFs&)
+        {
+            auto snapshot = m_recorder->replay(at);
+            if (!snapshot)
+            {
+                reactor->deliver({}, grpc::Status(grpc::StatusCode::INTERNAL, snapshot.error().message()));
+                return;
+            }
+
+            if (!snapshot.value())
+            {
+                reactor->deliver({}, grpc::Status(grpc::StatusCode::NOT_FOUND, "Nothing has been recorded by that time"));
+                return;
+            }
+
+            std::optional<BlobEncoder> encoder;
+            if (blobs)
+                encoder.emplace(m_blobs);
+
+            reactor->deliver(marshalReplay(*snapshot.value(), fields, encoder ? &*encoder : nullptr), grpc::Status::OK);
+        });
+
+        if (!submitted)
+        {
+            ErLogWarning2(m_log, "Replay rejected: the collection queue is full");
+            reactor->deliver({}, grpc::Status(grpc::StatusCode::RESOURCE_EXHAUSTED, "Too many pending requests"));
+        }
+
+        return reactor;
+    }
+
+    grpc::ServerUnaryReactor* GetBlobs(grpc::CallbackServerContext* context, const erebus::BlobRequest* request, erebus::BlobReply* reply) override
+    {
+        ProctreeTraceIndent2(m_log, "{}.ProctreeService::GetBlobs({})", Er::Format::ptr(this), request->hashes_size());
+
+        // clients only get here after evicting something from their own caches, so this is rare and cheap
+        auto reactor = std::make_unique<UnaryReplyReactor>(m_log);
+        if (context->IsCancelled()) [[unlikely]]
+        {
+            reactor->Finish(grpc::Status::CANCELLED);
+            return reactor.release();
+        }
+
+        if (auto rejected = Er::Ipc::Grpc::admissionRejected(context)) [[unlikely]]
+        {
+            reactor->Finish(*rejected);
+            return reactor.release();
+        }
+
+        if (request->has_header() && request->header().has_timestamp())
+            reply->mutable_header()->set_timestamp(request->header().timestamp());
+
+        for (auto hash : request->hashes())
+        {
+            auto data = m_blobs->find(hash);
+            if (!data)
+                continue;
+
+            auto blob = reply->add_blobs();
+            blob->set_hash(hash);
+            blob->set_data(*data);
+        }
+
+        reactor->Finish(grpc::Status::OK);
+        return reactor.release();
+    }
+
+    grpc::ServerUnaryReactor* FindSockets(grpc::CallbackServerContext* context, const erebus::SocketRequest* request, erebus::SocketReply* reply) override
+    {
+        ProctreeTraceIndent2(m_log, "{}.ProctreeService::FindSockets", Er::Format::ptr(this));
+
+        ErLogInfo2(m_log, "ProcessList.FindSockets(by={}) from {}", request->by(), context->peer());
+
+        auto reactor = std::make_unique<UnaryReplyReactor>(m_log);
+        if (context->IsCancelled()) [[unlikely]]
+        {
+            ErLogWarning2(m_log, "FindSockets canceled");
+            reactor->Finish(grpc::Status::CANCELLED);
+            return reactor.release();
+        }
+
+        if (auto rejected = Er::Ipc::Grpc::admissionRejected(context)) [[unlikely]]
+        {
+            reactor->Finish(*rejected);
+            return reactor.release();
+        }
+
+        if (!m_sockets)
+        {
+            reactor->Finish(grpc::Status(grpc::StatusCode::FAILED_PRECONDITION, "Socket index is disabled"));
+            return reactor.release();
+        }
+
+        std::optional<Time::ValueType> started;
+        if (request->has_header())
+        {
+            if (request->header().has_timestamp())
+                reply->mutable_header()->set_timestamp(request->header().timestamp());
+
+            started = Time::now();
+        }
+
+        SocketQuery query;
+        query.by = static_cast<SocketQuery::By>(request->by());
+        query.port = static_cast<std::uint16_t>(request->port());
+        query.pid = request->pid();
+        query.address = request->address();
+
+        // the index is in memory, so this is quick enough for the gRPC thread
+        auto found = m_sockets->find(query);
+        if (!found)
+        {
+            reactor->Finish(grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, "Invalid socket query"));
+            return reactor.release();
+        }
+
+        reply->mutable_sockets()->Reserve(static_cast<int>(found.value().size()));
+        for (auto& s : found.value())
+            marshalSocketInfo(s, *reply->add_sockets());
+
+        if (started)
+            reply->mutable_header()->set_duration(Time::now() - *started);
+
+        reactor->Finish(grpc::Status::OK);
+        return reactor.release();
+    }
+
+    grpc::ServerUnaryReactor* FindOpenFiles(grpc::CallbackServerContext* context, const erebus::OpenFileRequest* request, erebus::OpenFileReply* reply) override
+    {
+        ProctreeTraceIndent2(m_log, "{}.ProctreeService::FindOpenFiles", Er::Format::ptr(this));
+
+        ErLogInfo2(m_log, "ProcessList.FindOpenFiles({}) from {}", request->prefix(), context->peer());
+
+        auto reactor = std::make_unique<UnaryReplyReactor>(m_log);
+        if (context->IsCancelled()) [[unlikely]]
+        {
+            ErLogWarning2(m_log, "FindOpenFiles canceled");
+            reactor->Finish(grpc::Status::CANCELLED);
+            return reactor.release();
+        }
+
+        if (auto rejected = Er::Ipc::Grpc::admissionRejected(context)) [[unlikely]]
+        {
+            reactor->Finish(*rejected);
+            return reactor.release();
+        }
+
+        if (!m_files)
+        {
+            reactor->Finish(grpc::Status(grpc::StatusCode::FAILED_PRECONDITION, "Open file index is disabled"));
+            return reactor.release();
+        }
+
+        if (!request->prefix().starts_with('/'))
+        {
+            reactor->Finish(grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, "Absolute path expected"));
+            return reactor.release();
+        }
+
+        std::optional<Time::ValueType> started;
+        if (request->has_header())
+        {
+            if (request->header().has_timestamp())
+                reply->mutable_header()->set_timestamp(request->header().timestamp());
+
+            started = Time::now();
+        }
+
+        std::size_t limit = MaxOpenFiles;
+        if (request->limit())
+            limit = std::min<std::size_t>(limit, request->limit());
+
+        // answered from memory right here
+        auto found = m_files->find(request->prefix(), limit);
+
+        reply->mutable_files()->Reserve(static_cast<int>(found.files.size()));
+        for (auto& f : found.files)
+            marshalOpenFile(f, *reply->add_files());
+
+        reply->set_truncated(found.truncated);
+        reply->set_partial(found.partial);
+
+        if (started)
+            reply->mutable_header()->set_duration(Time::now() - *started);
+
+        reactor->Finish(grpc::Status::OK);
+        return reactor.release();
+    }
+
+private:
+    // runs the blocking part of a unary call on the collection executor with that thread's procfs
+    // reader; the reactor is finished once it's done, or right away with RESOURCE_EXHAUSTED
+    // if the executor queue is full
+    template <typename ReactorT, typename WorkT>
+    grpc::ServerUnaryReactor* offload(grpc::CallbackServerContext* context, std::unique_ptr<ReactorT>&& reactor, std::string_view method, WorkT&& work)
+    {
+        auto r = reactor.release();
+
+        auto submitted = m_executor->trySubmit([this, context, r, work = std::forward<WorkT>(work)](Linux::ProcFs& procFs)
+        {
+            if (context->IsCancelled())
+            {
+                r->Finish(grpc::Status::CANCELLED);
+                return;
+            }
+
+            Er::Util::ExceptionLogger xcptHandler(m_log);
+            try
+            {
+                work(procFs);
+
+                r->Finish(grpc::Status::OK);
+            }
+            catch (...)
+            {
+                Er::dispatchException(std::current_exception(), xcptHandler);
+
+                r->Finish(grpc::Status(grpc::INTERNAL, xcptHandler.lastError()));
+            }
+        });
+
+        if (!submitted)
+        {
+            ErLogWarning2(m_log, "{} rejected: the collection queue is full", method);
+            r->Finish(grpc::Status(grpc::StatusCode::RESOURCE_EXHAUSTED, "Too many pending requests"));
+        }
+
+        return r;
+    }
+
+    bool collectOne(Linux::ProcFs& procFs, Pid pid, const ProcessProperties::Mask& mask, erebus::ProcessPropsReply& reply)
+    {
+        auto props = Linux::collectProcessProps(procFs, pid, mask, m_log);
+        if (!props.has_value())
+        {
+            Er::Ipc::Grpc::marshalError(props.error(), *reply.mutable_header()->mutable_exception());
+            return false;
+        }
+
+        marshalProcessProperties(props.value(), *reply.mutable_props());
+        return true;
+    }
+
+    static bool marshalSnapshotDelta(const SnapshotDelta& delta, const ProcessProperties::Mask& fields, erebus::ProcessDelta& dest)
+    {
+        dest.set_timestamp(delta.timestamp.value());
+
+        for (auto& change : delta.changed)
+        {
+            // the client only ever hears about the fields it has asked for
+            auto mask = change.added ? fields : (change.fields & fields);
+            if (!change.added && !mask.any())
+                continue;
+
+            marshalProcessProperties(*change.props, mask, *dest.add_changed());
+        }
+
+        for (auto pid : delta.removed)
+            dest.add_removed(pid);
+
+        return (dest.changed_size() > 0) || (dest.removed_size() > 0);
+    }
+
+    static void copyProcessDelta(const erebus::ProcessDelta& source, erebus::ProcessDelta& dest)
+    {
+        dest.CopyFrom(source);
+    }
+
+    static void encodeBlobs(BlobEncoder& encoder, erebus::ProcessDelta& msg)
+    {
+        for (auto& props : *msg.mutable_changed())
+            encoder.encode(props, *msg.mutable_blobs());
+    }
+
+    // the whole table goes out as a reset delta followed by more chunks of it, to keep the messages
+    // small; the last chunk comes without 'more' and is the end of the table
+    template <typename ProcessesT, typename MarshallerT>
+    static std::vector<erebus::ProcessDelta> marshalChunked(Time timestamp, const ProcessesT& processes, MarshallerT&& marshaller, BlobEncoder* blobs)
+    {
+        constexpr std::size_t ChunkSize = 256;
+
+        std::vector<erebus::ProcessDelta> result;
+        result.reserve(processes.size() / ChunkSize + 1);
+
+        for (std::size_t i = 0; (i == 0) || (i < processes.size()); i += ChunkSize)
+        {
+            auto& msg = result.emplace_back();
+            msg.set_timestamp(timestamp.value());
+            msg.set_reset(i == 0);
+
+            auto end = std::min(processes.size(), i + ChunkSize);
+            msg.set_more(end < processes.size());
+
+            for (auto j = i; j < end; ++j)
+                marshaller(processes[j], *msg.add_changed());
+
+            if (blobs)
+                encodeBlobs(*blobs, msg);
+        }
+
+        return result;
+    }
+
+    static std::vector<erebus::ProcessDelta> marshalReplay(const SnapshotRecorder::Snapshot& snapshot, const ProcessProperties::Mask& fields, BlobEncoder* blobs)
+    {
+        return marshalChunked(
+            snapshot.timestamp,
+            snapshot.processes,
+            [&fields](const ProcessProperties& props, erebus::ProcessProps& dest) { marshalProcessProperties(props, fields, dest); },
+            blobs);
+    }
+
+    static ShmPublisher::Options shmOptions(const PropertyMap& config)
+    {
+        ShmPublisher::Options options;
+
+        auto name = findProperty(config, "name", Property::Type::String);
+        if (name)
+            options.name = *name->getString();
+
+        auto capacity = findProperty(config, "capacity", Property::Type::Int64);
+        if (capacity)
+            options.capacity = static_cast<std::uint32_t>(*capacity->getInt64());
+
+        auto arenaMb = findProperty(config, "arena_mb", Property::Type::Int64);
+        if (arenaMb)
+            options.arenaSize = static_cast<std::uint64_t>(*arenaMb->getInt64()) * 1024 * 1024;
+
+        auto mode = findProperty(config, "mode", Property::Type::Int64);
+        if (mode)
+            options.mode = static_cast<unsigned>(*mode->getInt64());
+
+        auto env = findProperty(config, "env", Property::Type::Bool);
+        if (env && *env->getBool())
+            options.fields.set(ProcessProperties::Env);
+
+        return options;
+    }
+
+    static Linux::SocketIndex::Options socketIndexOptions(const PropertyMap& config)
+    {
+        Linux::SocketIndex::Options options;
+
+        auto interval = findProperty(config, "interval_ms", Property::Type::Int64);
+        if (interval)
+            options.interval = std::chrono::milliseconds(*interval->getInt64());
+
+        auto resync = findProperty(config, "resync_s", Property::Type::Int64);
+        if (resync)
+            options.resync = std::chrono::seconds(*resync->getInt64());
+
+        if (options.interval.count() <= 0)
+            throw Exception(std::source_location::current(), Error(Result::BadConfiguration, GenericError), Exception::Message("Invalid socket index interval"));
+
+        return options;
+    }
+
+    static Linux::FileIndex::Options fileIndexOptions(const PropertyMap& config)
+    {
+        Linux::FileIndex::Options options;
+
+        auto interval = findProperty(config, "interval_ms", Property::Type::Int64);
+        if (interval)
+            options.interval = std::chrono::milliseconds(*interval->getInt64());
+
+        auto resync = findProperty(config, "resync_s", Property::Type::Int64);
+        if (resync)
+            options.resync = std::chrono::seconds(*resync->getInt64());
+
+        auto budget = findProperty(config, "budget_mb", Property::Type::Int64);
+        if (budget)
+            options.budget = static_cast<std::size_t>(*budget->getInt64()) * 1024 * 1024;
+
+        if ((options.interval.count() <= 0) || !options.budget)
+            throw Exception(std::source_location::current(), Error(Result::BadConfiguration, GenericError), Exception::Message("Invalid open file index configuration"));
+
+        return options;
+    }
+
+    static SnapshotRecorder::Options recorderOptions(const PropertyMap& config)
+    {
+        SnapshotRecorder::Options options;
+
+        auto path = findProperty(config, "path", Property::Type::String);
+        if (!path)
+            throw Exception(std::source_location::current(), Error(Result::BadConfiguration, GenericError), Exception::Message("Snapshot recorder path expected"));
+
+        options.directory = *path->getString();
+
+        auto maxFileMb = findProperty(config, "max_file_mb", Property::Type::Int64);
+        if (maxFileMb)
+            options.maxFileSize = static_cast<std::uint64_t>(*maxFileMb->getInt64()) * 1024 * 1024;
+
+        auto maxFiles = findProperty(config, "max_files", Property::Type::Int64);
+        if (maxFiles)
+            options.maxFiles = static_cast<unsigned>(*maxFiles->getInt64());
+
+        auto keyframe = findProperty(config, "keyframe_s", Property::Type::Int64);
+        if (keyframe)
+            options.keyframeInterval = std::chrono::seconds(*keyframe->getInt64());
+
+        auto fsync = findProperty(config, "fsync_s", Property::Type::Int64);
+        if (fsync)
+            options.fsyncInterval = std::chrono::seconds(*fsync->getInt64());
+
+        return options;
+    }
+
+    // the io_uring reader is off unless asked for: procfs can't do non-blocking reads, so every
+    // read gets punted to an io-wq thread and the batch only pays off with spare CPUs
+    static bool useIoUring(const PropertyMap& args)
+    {
+        auto prop = findProperty(args, "io_uring", Property::Type::Bool);
+        return prop && *prop->getBool();
+    }
+
+    static std::vector<std::unique_ptr<Linux::RootWorker>> makeRoots(const PropertyMap& args, Log::ILogger* log)
+    {
+        std::vector<std::unique_ptr<Linux::RootWorker>> result;
+        auto ioUring = useIoUring(args);
+
+        auto roots = findProperty(args, "roots", Property::Type::Vector);
+        if (roots)
+        {
+            for (auto& entry : *roots->getVector())
+            {
+                auto m = entry.getMap();
+                if (!m)
+                    throw Exception(std::source_location::current(), Error(Result::BadConfiguration, GenericError), Exception::Message("procfs root entry is not an object"));
+
+                auto path = findProperty(*m, "path", Property::Type::String);
+                if (!path)
+                    throw Exception(std::source_location::current(), Error(Result::BadConfiguration, GenericError), Exception::Message("procfs root path expected"));
+
+                std::string tag = *path->getString();
+                auto tagProp = findProperty(*m, "tag", Property::Type::String);
+                if (tagProp)
+                    tag = *tagProp->getString();
+
+                // tags become property names in the scan stats
+                if (tag.empty() || (tag.length() > Property::MaxNameLength))
+                    throw Exception(std::source_location::current(), Error(Result::BadConfiguration, GenericError), Exception::Message("Invalid procfs root tag"), ExceptionProperties::ObjectName(tag));
+
+                ErLogInfo2(log, "Adding procfs root {} [{}]", *path->getString(), tag);
+                result.push_back(std::make_unique<Linux::RootWorker>(*path->getString(), tag, ioUring, log));
+            }
+        }
+
+        if (result.empty())
+            result.push_back(std::make_unique<Linux::RootWorker>("/proc", "host", ioUring, log));
+
+        return result;
+    }
+
+    Property scanStats(std::string_view name) const
+    {
+        PropertyMap roots;
+        for (auto& root : m_roots)
+        {
+            auto s = root->stats();
+
+            PropertyMap m;
+            addProperty(m, Property("path", root->root()));
+            addProperty(m, Property("scans", s.scans));
+            addProperty(m, Property("failures", s.failures));
+            addProperty(m, Property("processes", s.processes));
+            addProperty(m, Property("last_scan_us", s.lastScanUs, Semantics::Duration));
+            addProperty(m, Property("total_scan_us", s.totalScanUs, Semantics::Duration));
+
+            addProperty(roots, Property(root->tag(), std::move(m)));
+        }
+
+        return Property(name, std::move(roots));
+    }
+
+    // a single pass over /proc when the scanner has nothing suitable
+    std::optional<Error> aggregateFromProcFs(Linux::ProcFs& procFs, GroupAggregator& aggregator)
+    {
+        auto pids = procFs.enumeratePids();
+        if (!pids.has_value())
+            return pids.error();
+
+        auto mask = aggregator.required();
+        bool wantCpu = mask[ProcessProperties::CpuUsage];
+        if (wantCpu)
+        {
+            mask.set(ProcessProperties::StartTime);
+            mask.set(ProcessProperties::STime);
+            mask.set(ProcessProperties::UTime);
+        }
+
+        std::vector<ProcessProperties> processes;
+        processes.reserve(pids.value().size());
+        for (auto pid : pids.value())
+        {
+            auto props = Linux::collectProcessProps(procFs, pid, mask, m_log);
+            if (props.has_value())
+                processes.push_back(std::move(props.value()));
+        }
+
+        if (wantCpu)
+            computeCpuUsage(processes, Time::now());
+
+        for (auto& p : processes)
+            aggregator.add(p);
+
+        return std::nullopt;
+    }
+
+    // the same as the scanner does: CPU usage since the previous pass, or over the whole lifetime for
+    // the processes that pass hasn't seen
+    void computeCpuUsage(std::vector<ProcessProperties>& processes, Time::ValueType now)
+    {
+        std::unordered_map<Pid, CpuSample> samples;
+        samples.reserve(processes.size());
+
+        std::lock_guard l(m_cpuSamplesMutex);
+
+        for (auto& p : processes)
+        {
+            CpuSample current{ p.startTime.value(), p.uTime.value() + p.sTime.value(), now };
+
+            auto prevCpu = std::uint64_t(0);
+            auto since = current.startTime;
+            auto it = m_cpuSamples.find(p.pid);
+            if ((it != m_cpuSamples.end()) && (it->second.startTime == current.startTime))
+            {
+                prevCpu = it->second.cpu;
+                since = it->second.at;
+            }
+
+            double usage = 0.0;
+            if ((now > since) && (current.cpu >= prevCpu))
+                usage = double(current.cpu - prevCpu) * 100.0 / double(now - since);
+
+            ErSet(ProcessProperties, CpuUsage, p, cpuUsage, usage);
+            samples.insert({ p.pid, current });
+        }
+
+        // the processes that have gone are forgotten
+        m_cpuSamples.swap(samples);
+    }
+
+    class ProcessListReactor
+        : public grpc::ServerWriteReactor<erebus::ProcessPropsReply>
+    {
+    public:
+        ~ProcessListReactor()
+        {
+            ProctreeTrace2(m_log, "{}.ProcessListReactor::~ProcessListReactor", Er::Format::ptr(this));
+        }
+
+        ProcessListReactor(Log::ILogger* log, std::size_t roots, std::shared_ptr<BlobCache> blobs) noexcept
+            : m_log(log)
+            , m_pendingRoots(roots)
+        {
+            if (blobs)
+                m_blobs.emplace(std::move(blobs));
+
+            ProctreeTrace2(m_log, "{}.ProcessListReactor::ProcessListReactor", Er::Format::ptr(this));
+        }
+
+        bool cancelled() const noexcept
+        {
+            return m_cancelled.load(std::memory_order_relaxed);
+        }
+
+        void cancelNow()
+        {
+            m_cancelled = true;
+
+            std::lock_guard l(m_mutex);
+            finish(grpc::Status::CANCELLED);
+        }
+
+        // for when no root jobs have been submitted, so that OnDone() has nothing to wait for
+        void abandon(const grpc::Status& status)
+        {
+            m_cancelled = true;
+
+            std::lock_guard l(m_mutex);
+            m_pendingRoots = 0;
+            finish(status);
+        }
+
+        // called once per root on its worker thread
+        void deliver(const std::string& tag, std::expected<std::vector<ProcessProperties>, Error>&& result)
+        {
+            std::unique_lock l(m_mutex);
+
+            ErAssert(m_pendingRoots > 0);
+            --m_pendingRoots;
+
+            if (m_done)
+            {
+                // the RPC is over; the last root to report cleans up
+                if (m_pendingRoots == 0)
+                {
+                    l.unlock();
+                    delete this;
+                }
+
+                return;
+            }
+
+            if (!m_finished)
+            {
+                if (result.has_value())
+                    m_batches.push_back(Batch{ tag, std::move(result.value()), std::nullopt });
+                else
+                    m_batches.push_back(Batch{ tag, {}, std::move(result.error()) });
+
+                if (!m_writing)
+                    writeNext();
+            }
+        }
+
+    private:
+        struct Batch
+        {
+            std::string tag;
+            std::vector<ProcessProperties> items;
+            std::optional<Error> error;
+        };
+
+        void writeNext()
+        {
+            while (!m_batches.empty())
+            {
+                auto& batch = m_batches.front();
+
+                if (batch.error)
+                {
+                    m_reply.Clear();
+                    m_reply.set_ns(batch.tag);
+                    Er::Ipc::Grpc::marshalError(*batch.error, *m_reply.mutable_header()->mutable_exception());
+                    batch.error.reset();
+
+                    m_writing = true;
+                    StartWrite(&m_reply);
+                    return;
+                }
+
+                if (m_next < batch.items.size())
+                {
+                    m_reply.Clear();
+                    m_reply.set_ns(batch.tag);
+                    marshalProcessProperties(batch.items[m_next++], *m_reply.mutable_props());
+                    if (m_blobs)
+                        m_blobs->encode(*m_reply.mutable_props(), *m_reply.mutable_blobs());
+
+                    m_writing = true;
+                    StartWrite(&m_reply);
+                    return;
+                }
+
+                m_batches.pop_front();
+                m_next = 0;
+            }
+
+            if (m_pendingRoots == 0)
+                finish(grpc::Status::OK);
+        }
+
+        void finish(const grpc::Status& status)
+        {
+            if (m_finished)
+                return;
+
+            m_finished = true;
+            m_batches.clear();
+            Finish(status);
+        }
+
+        void OnWriteDone(bool ok) override
+        {
+            ProctreeTraceIndent2(m_log, "{}.ProcessListReactor::OnWriteDone", Er::Format::ptr(this));
+
+            std::lock_guard l(m_mutex);
+            m_writing = false;
+
+            if (!ok)
+                finish(grpc::Status(grpc::StatusCode::CANCELLED, "Operation canceled"));
+            else if (!m_finished)
+                writeNext();
+        }
+
+        void OnDone() override
+        {
+            ProctreeTraceIndent2(m_log, "{}.ProcessListReactor::OnDone", Er::Format::ptr(this));
+
+            std::unique_lock l(m_mutex);
+            m_done = true;
+            if (m_pendingRoots == 0)
+            {
+                l.unlock();
+                delete this;
+            }
+        }
+
+        void OnCancel() override
+        {
+            ProctreeTrace2(m_log, "{}.ProcessListReactor::OnCancel", Er::Format::ptr(this));
+
+            cancelNow();
+        }
+
+        Log::ILogger* m_log;
+        std::atomic<bool> m_cancelled = false;
+        std::mutex m_mutex;
+        std::size_t m_pendingRoots;
+        std::deque<Batch> m_batches;
+        std::size_t m_next = 0;
+        bool m_writing = false;
+        bool m_finished = false;
+        bool m_done = false;
+        std::optional<BlobEncoder> m_blobs;
+        erebus::ProcessPropsReply m_reply;
+    };
+
+    using PressureStreamReactor = EventStreamReactor<PressureEvent, erebus::PressureEvent>;
+    using AlertStreamReactor = EventStreamReactor<Alert, erebus::Alert>;
+    using DeltaStreamReactor = EventStreamReactor<erebus::ProcessDelta, erebus::ProcessDelta>;
+
+    class UnaryReplyReactor
+        : public grpc::ServerUnaryReactor
+    {
+    public:
+        ~UnaryReplyReactor()
+        {
+            ProctreeTrace2(m_log, "{}.UnaryReplyReactor::~UnaryReplyReactor", Er::Format::ptr(this));
+        }
+
+        UnaryReplyReactor(Log::ILogger* log) noexcept
+            : m_log(log)
+        {
+            ProctreeTrace2(m_log, "{}.UnaryReplyReactor::UnaryReplyReactor", Er::Format::ptr(this));
+        }
+
+    private:
+        void OnDone() override
+        {
+            ProctreeTraceIndent2(m_log, "{}.UnaryReplyReactor::OnDone", Er::Format::ptr(this));
+
+            delete this;
+        }
+
+        void OnCancel() override
+        {
+            ProctreeTrace2(m_log, "{}.UnaryReplyReactor::OnCancel", Er::Format::ptr(this));
+        }
+
+        Log::ILogger* m_log;
+    };
+
+    //
+    // Writes out a replayed snapshot; the executor task and gRPC share the reactor
+    // and whichever is the last to let go of it deletes it
+    //
+    class ReplayReactor
+        : public grpc::ServerWriteReactor<erebus::ProcessDelta>
+    {
+    public:
+        ~ReplayReactor()
+        {
+            ProctreeTrace2(m_log, "{}.ReplayReactor::~ReplayReactor", Er::Format::ptr(this));
+        }
+
+        ReplayReactor(Log::ILogger* log) noexcept
+            : m_log(log)
+        {
+            ProctreeTrace2(m_log, "{}.ReplayReactor::ReplayReactor", Er::Format::ptr(this));
+        }
+
+        // must be called exactly once; the reactor must not be touched afterwards
+        void deliver(std::vector<erebus::ProcessDelta>&& messages, const grpc::Status& status)
+        {
+            {
+                std::lock_guard l(m_mutex);
+                if (!m_finished)
+                {
+                    m_messages = std::move(messages);
+                    m_status = status;
+                    writeNext();
+                }
+            }
+
+            release();
+        }
+
+    private:
+        void writeNext()
+        {
+            if (m_next < m_messages.size())
+            {
+                m_writing = true;
+                StartWrite(&m_messages[m_next++]);
+                return;
+            }
+
+            m_finished = true;
+            Finish(m_status);
+        }
+
+        void OnWriteDone(bool ok) override
+        {
+            ProctreeTraceIndent2(m_log, "{}.ReplayReactor::OnWriteDone", Er::Format::ptr(this));
+
+            std::lock_guard l(m_mutex);
+            m_writing = false;
+
+            if (m_finished)
+                return;
+
+            if (!ok)
+            {
+                m_finished = true;
+                Finish(grpc::Status(grpc::StatusCode::CANCELLED, "Operation canceled"));
+                return;
+            }
+
+            writeNext();
+        }
+
+        void OnCancel() override
+        {
+            ProctreeTrace2(m_log, "{}.ReplayReactor::OnCancel", Er::Format::ptr(this));
+
+            std::lock_guard l(m_mutex);
+            if (!m_finished && !m_writing)
+            {
+                m_finished = true;
+                Finish(grpc::Status::CANCELLED);
+            }
+        }
+
+        void OnDone() override
+        {
+            ProctreeTraceIndent2(m_log, "{}.ReplayReactor::OnDone", Er::Format::ptr(this));
+
+            release();
+        }
+
+        void release() noexcept
+        {
+            if (m_refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                delete this;
+        }
+
+        Log::ILogger* m_log;
+        std::atomic<int> m_refs = 2; // gRPC + deliver()
+        std::mutex m_mutex;
+        std::vector<erebus::ProcessDelta> m_messages;
+        std::size_t m_next = 0;
+        grpc::Status m_status;
+        bool m_writing = false;
+        bool m_finished = false;
+    };
+
+    struct CpuSample
+    {
+        Time::ValueType startTime; // tells a reused PID apart
+        Time::ValueType cpu;       // utime + stime
+        Time::ValueType at;
     };
 
     Log::ILogger* m_log;
-    Linux::ProcFs m_procFs;
+    std::vector<std::unique_ptr<Linux::RootWorker>> m_roots;
+    Linux::ProcFsRootPtr m_procFsRoot; // the primary root
+    std::unique_ptr<Linux::PsiMonitor> m_psi;
+    std::unique_ptr<Linux::Scanner> m_scanner;
+    std::unique_ptr<Linux::SocketIndex> m_sockets;
+    std::unique_ptr<Linux::FileIndex> m_files;
+    std::unique_ptr<AlertMonitor> m_alerts;
+    std::shared_ptr<BlobCache> m_blobs;
+    std::unique_ptr<SnapshotRecorder> m_recorder;
+    Linux::Scanner::ListenerId m_recorderListener = 0;
+    std::unique_ptr<ShmPublisher> m_shm;
+    Linux::Scanner::ListenerId m_shmListener = 0;
+    std::mutex m_cpuSamplesMutex;
+    std::unordered_map<Pid, CpuSample> m_cpuSamples; // the previous aggregateFromProcFs() pass
+    Er::Ipc::Grpc::ArenaAllocator<erebus::ProcessPropsRequest, erebus::ProcessPropsReply> m_processPropsAllocator;
+    Er::Ipc::Grpc::ArenaAllocator<erebus::ProcessPropsBatchRequest, erebus::ProcessPropsBatchReply, 16 * 1024> m_batchAllocator;
+    Er::Ipc::Grpc::ArenaAllocator<erebus::GroupByRequest, erebus::GroupByReply, 16 * 1024> m_groupByAllocator;
+    Er::Ipc::Grpc::ArenaAllocator<erebus::BlobRequest, erebus::BlobReply, 16 * 1024> m_blobAllocator;
+    Er::Ipc::Grpc::ArenaAllocator<erebus::SocketRequest, erebus::SocketReply, 16 * 1024> m_socketAllocator;
+    Er::Ipc::Grpc::ArenaAllocator<erebus::OpenFileRequest, erebus::OpenFileReply, 16 * 1024> m_openFileAllocator;
+    std::unique_ptr<CollectionExecutor> m_executor; // goes first since its tasks use everything above
 };
 
 
 } // namespace {}
 
 
-Er::Ipc::Grpc::ServicePtr createProcessListService(Er::Log::ILogger* log)
+Er::Ipc::Grpc::ServicePtr createProcessListService(Er::Log::ILogger* log, const Er::PropertyMap& args)
 {
-    return Er::Ipc::Grpc::ServicePtr{ new ProctreeService(log) };
+    return Er::Ipc::Grpc::ServicePtr{ new ProctreeService(log, args) };
 }
 
 } // namespace Er::ProcessTree::Private {}
\ No newline at end of file
@@ -2,12 +2,13 @@
 
 #include <erebus/ipc/grpc/server/iservice.hxx>
 #include <erebus/rtl/log.hxx>
+#include <erebus/rtl/property_bag.hxx>
 
 
 namespace Er::ProcessTree::Private
 {
 
-Er::Ipc::Grpc::ServicePtr createProcessListService(Er::Log::ILogger* log);
+Er::Ipc::Grpc::ServicePtr createProcessListService(Er::Log::ILogger* log, const Er::PropertyMap& args);
 
 
 } // namespace Er::ProcessTree::Private {}
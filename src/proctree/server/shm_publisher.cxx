@@ -0,0 +1,229 @@
+#include <erebus/proctree/server/shm_publisher.hxx>
+#include <erebus/rtl/exception.hxx>
+#include <erebus/rtl/util/generic_handle.hxx>
+
+#include <limits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+namespace Er::ProcessTree
+{
+
+ProcessProperties::Mask ShmPublisher::defaultFields() noexcept
+{
+    ProcessProperties::Mask m;
+    for (unsigned f = 0; f < ProcessProperties::FieldCount; ++f)
+        m.set(f);
+
+    m.reset(ProcessProperties::Env);
+    return m;
+}
+
+ShmPublisher::~ShmPublisher()
+{
+    ErLogDebug2(m_log, "{}.ShmPublisher::~ShmPublisher()", Er::Format::ptr(this));
+
+    if (m_header)
+    {
+        // readers that still have it mapped know to reopen it
+        std::atomic_ref<std::uint64_t> sequence(m_header->sequence);
+        auto s = sequence.load(std::memory_order_relaxed);
+        sequence.store(s + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        m_header->flags |= Shm::Closed;
+        sequence.store(s + 2, std::memory_order_release);
+    }
+
+    if (m_base)
+        ::munmap(m_base, m_size);
+
+    ::shm_unlink(m_options.name.c_str());
+}
+
+ShmPublisher::ShmPublisher(Options&& options, Log::ILogger* log)
+    : m_log(log)
+    , m_options(std::move(options))
+    , m_size(Shm::segmentSize(m_options.capacity, m_options.arenaSize))
+{
+    ErLogDebug2(m_log, "{}.ShmPublisher::ShmPublisher({})", Er::Format::ptr(this), m_options.name);
+
+    if (!m_options.name.starts_with('/') || !m_options.capacity || !m_options.arenaSize || (m_options.arenaSize > std::numeric_limits<std::uint32_t>::max()))
+        throw Exception(std::source_location::current(), Error(Result::BadConfiguration, GenericError), Exception::Message("Invalid shared memory table configuration"));
+
+    // whoever has the old segment mapped keeps it; we start afresh
+    ::shm_unlink(m_options.name.c_str());
+
+    Util::FileHandle fd(::shm_open(m_options.name.c_str(), O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, m_options.mode));
+    if (!fd.valid())
+        throw Exception(std::source_location::current(), Error(errno, PosixError), Exception::Message("Failed to create a shared memory segment"), ExceptionProperties::ObjectName(m_options.name));
+
+    // shm_open() is subject to umask
+    ::fchmod(fd.get(), m_options.mode);
+
+    if (::ftruncate(fd.get(), static_cast<off_t>(m_size)) < 0)
+    {
+        auto e = errno;
+        ::shm_unlink(m_options.name.c_str());
+        throw Exception(std::source_location::current(), Error(e, PosixError), Exception::Message("Failed to size the shared memory segment"), ExceptionProperties::ObjectName(m_options.name));
+    }
+
+    auto base = ::mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd.get(), 0);
+    if (base == MAP_FAILED)
+    {
+        auto e = errno;
+        ::shm_unlink(m_options.name.c_str());
+        throw Exception(std::source_location::current(), Error(e, PosixError), Exception::Message("Failed to map the shared memory segment"), ExceptionProperties::ObjectName(m_options.name));
+    }
+
+    m_base = base;
+
+    // ftruncate() has zeroed everything
+    m_header = static_cast<Shm::Header*>(m_base);
+    m_header->magic = Shm::Magic;
+    m_header->version = Shm::Version;
+    m_header->headerSize = sizeof(Shm::Header);
+    m_header->segmentSize = m_size;
+    m_header->capacity = m_options.capacity;
+    m_header->columnCount = ProcessProperties::FieldCount + 1;
+    m_header->columns = sizeof(Shm::Header);
+    m_header->arena = sizeof(Shm::Header) + std::uint64_t(ProcessProperties::FieldCount + 1) * m_options.capacity * sizeof(std::uint64_t);
+    m_header->arenaSize = m_options.arenaSize;
+    m_header->fields = m_options.fields.pack<std::uint64_t>();
+
+    m_arena = static_cast<char*>(m_base) + m_header->arena;
+
+    ErLogInfo2(m_log, "Publishing the process table to {} ({} processes, {} KB of strings)", m_options.name, m_options.capacity, m_options.arenaSize / 1024);
+}
+
+std::uint64_t* ShmPublisher::column(std::size_t index) noexcept
+{
+    auto first = reinterpret_cast<std::uint64_t*>(static_cast<char*>(m_base) + m_header->columns);
+    return first + index * m_options.capacity;
+}
+
+void ShmPublisher::publish(const SnapshotDelta& delta)
+{
+    // a reused PID is both removed and added, so the removals go first
+    for (auto pid : delta.removed)
+        m_table.erase(pid);
+
+    for (auto& change : delta.changed)
+    {
+        if (change.added)
+            m_table[change.props->pid] = *change.props;
+        else
+            m_table[change.props->pid].merge(ProcessProperties(*change.props));
+    }
+
+    write(delta.timestamp);
+}
+
+std::uint64_t ShmPublisher::cell(const ProcessProperties& props, FieldId field, Strings& strings, bool& truncated)
+{
+    std::string_view s;
+
+    switch (field)
+    {
+    case ProcessProperties::Pid: return props.pid;
+    case ProcessProperties::PPid: return props.ppid;
+    case ProcessProperties::PGrp: return props.pgrp;
+    case ProcessProperties::Tpgid: return props.tpgid;
+    case ProcessProperties::Session: return props.session;
+    case ProcessProperties::Ruid: return props.ruid;
+    case ProcessProperties::StartTime: return static_cast<std::uint64_t>(props.startTime.value());
+    case ProcessProperties::State: return props.state;
+    case ProcessProperties::ThreadCount: return props.threadCount;
+    case ProcessProperties::STime: return static_cast<std::uint64_t>(props.sTime.value());
+    case ProcessProperties::UTime: return static_cast<std::uint64_t>(props.uTime.value());
+    case ProcessProperties::CpuUsage: return std::bit_cast<std::uint64_t>(props.cpuUsage);
+    case ProcessProperties::Tty: return static_cast<std::uint64_t>(static_cast<std::int64_t>(props.tty));
+    case ProcessProperties::Rss: return props.rss;
+
+    case ProcessProperties::Comm: s = props.comm; break;
+    case ProcessProperties::CmdLine: s = props.cmdLine.raw; break;
+    case ProcessProperties::Exe: s = props.exe; break;
+    case ProcessProperties::UserName: s = props.userName; break;
+    case ProcessProperties::Env: s = props.env.raw; break;
+
+    default:
+        ErAssert(!"Unknown field");
+        return 0;
+    }
+
+    auto it = strings.find(s);
+    if (it != strings.end())
+        return it->second;
+
+    if (m_arenaUsed + s.size() > m_options.arenaSize)
+    {
+        truncated = true;
+        return Shm::stringCell(0, 0);
+    }
+
+    auto offset = static_cast<std::uint32_t>(m_arenaUsed);
+    std::memcpy(m_arena + offset, s.data(), s.size());
+    m_arenaUsed += s.size();
+
+    auto value = Shm::stringCell(offset, static_cast<std::uint32_t>(s.size()));
+    strings.insert({ s, value });
+    return value;
+}
+
+void ShmPublisher::write(Time timestamp)
+{
+    std::atomic_ref<std::uint64_t> sequence(m_header->sequence);
+    auto s = sequence.load(std::memory_order_relaxed);
+    sequence.store(s + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    bool truncated = false;
+    m_arenaUsed = 0;
+
+    // identical strings (user names, worker command lines etc) are stored once
+    Strings strings;
+    strings.reserve(m_table.size());
+
+    auto valid = column(Shm::ValidColumn);
+    std::uint32_t row = 0;
+    for (auto& [pid, props] : m_table)
+    {
+        if (row == m_options.capacity)
+        {
+            truncated = true;
+            break;
+        }
+
+        auto mask = props.validMask() & m_options.fields;
+        mask.set(ProcessProperties::Pid);
+        valid[row] = mask.pack<std::uint64_t>();
+
+        for (FieldId f = 0; f < ProcessProperties::FieldCount; ++f)
+        {
+            if (!mask[f])
+                continue;
+
+            column(Shm::fieldColumn(f))[row] = cell(props, f, strings, truncated);
+        }
+
+        ++row;
+    }
+
+    m_header->timestamp = static_cast<std::uint64_t>(timestamp.value());
+    m_header->count = row;
+    m_header->flags = truncated ? Shm::Truncated : 0;
+    m_header->arenaUsed = m_arenaUsed;
+
+    sequence.store(s + 2, std::memory_order_release);
+
+    if (truncated && !m_truncated)
+        ErLogWarning2(m_log, "The shared memory table is too small for {} processes; some are left out", m_table.size());
+
+    m_truncated = truncated;
+}
+
+
+} // namespace Er::ProcessTree {}
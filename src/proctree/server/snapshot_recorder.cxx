@@ -0,0 +1,841 @@
+#include <erebus/proctree/server/snapshot_recorder.hxx>
+#include <erebus/rtl/exception.hxx>
+#include <erebus/rtl/format.hxx>
+#include <erebus/rtl/system/thread.hxx>
+#include <erebus/rtl/util/exception_util.hxx>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+
+namespace Er::ProcessTree
+{
+
+namespace
+{
+
+//
+// file:    Magic record*
+// record:  type:u8 timestamp:varint length:varint payload
+//
+// keyframe payload:  count:varint process*
+// delta payload:     removedCount:varint pidDelta:varint* count:varint process*
+// process:           pidDelta:varint (fields << 1 | added):varint value*
+//
+
+constexpr char Magic[8] = { 'E', 'R', 'S', 'N', 'A', 'P', '\x01', '\n' };
+constexpr std::size_t MaxRecordHeader = 1 + 10 + 10;
+constexpr std::size_t WriteBufferSize = 64 * 1024;
+
+void putVarint(std::string& out, std::uint64_t v)
+{
+    while (v >= 0x80)
+    {
+        out.push_back(static_cast<char>((v & 0x7f) | 0x80));
+        v >>= 7;
+    }
+
+    out.push_back(static_cast<char>(v));
+}
+
+constexpr std::uint64_t zigzag(std::int64_t v) noexcept
+{
+    return (static_cast<std::uint64_t>(v) << 1) ^ static_cast<std::uint64_t>(v >> 63);
+}
+
+constexpr std::int64_t unzigzag(std::uint64_t v) noexcept
+{
+    return static_cast<std::int64_t>(v >> 1) ^ -static_cast<std::int64_t>(v & 1);
+}
+
+void putDelta(std::string& out, std::int64_t current, std::int64_t previous)
+{
+    putVarint(out, zigzag(current - previous));
+}
+
+// a copy of just the fields being recorded
+ProcessProperties recordedFields(const ProcessProperties& source, const ProcessProperties::Mask& fields)
+{
+    ProcessProperties p;
+    p.pid = source.pid;
+    p.setValid(ProcessProperties::Pid);
+
+    auto copy = ProcessProperties(source);
+    for (unsigned f = 0; f < ProcessProperties::FieldCount; ++f)
+    {
+        if (!fields[f])
+            copy.setValid(f, false);
+    }
+
+    p.merge(std::move(copy));
+    return p;
+}
+
+std::int64_t cpuUsageFixed(double usage) noexcept
+{
+    return std::llround(usage * 100.0); // hundredths of a percent
+}
+
+
+class Reader final
+{
+public:
+    explicit Reader(std::string_view data) noexcept
+        : m_data(data)
+        , m_size(data.size())
+    {
+    }
+
+    bool failed() const noexcept
+    {
+        return m_failed;
+    }
+
+    void fail() noexcept
+    {
+        m_failed = true;
+    }
+
+    std::size_t position() const noexcept
+    {
+        return m_size - m_data.size();
+    }
+
+    std::uint64_t varint() noexcept
+    {
+        std::uint64_t v = 0;
+        for (unsigned shift = 0; shift < 64; shift += 7)
+        {
+            if (m_data.empty())
+                break;
+
+            auto b = static_cast<std::uint8_t>(m_data.front());
+            m_data.remove_prefix(1);
+
+            v |= std::uint64_t(b & 0x7f) << shift;
+            if (!(b & 0x80))
+                return v;
+        }
+
+        m_failed = true;
+        return 0;
+    }
+
+    std::int64_t delta(std::int64_t previous) noexcept
+    {
+        return previous + unzigzag(varint());
+    }
+
+    std::string_view bytes(std::size_t length) noexcept
+    {
+        if (length > m_data.size())
+        {
+            m_failed = true;
+            return {};
+        }
+
+        auto r = m_data.substr(0, length);
+        m_data.remove_prefix(length);
+        return r;
+    }
+
+private:
+    std::string_view m_data;
+    const std::size_t m_size;
+    bool m_failed = false;
+};
+
+
+class Decoder final
+{
+public:
+    using Table = std::unordered_map<Pid, ProcessProperties>;
+
+    explicit Decoder(Table& table) noexcept
+        : m_table(table)
+    {
+    }
+
+    bool apply(std::uint8_t type, std::string_view payload)
+    {
+        Reader r(payload);
+
+        if (type == 1)
+        {
+            m_table.clear();
+            m_strings.clear();
+        }
+        else if (type == 2)
+        {
+            // a reused PID is both removed and added, so the removals go first
+            auto removed = r.varint();
+            Pid pid = 0;
+            for (std::uint64_t i = 0; (i < removed) && !r.failed(); ++i)
+            {
+                pid += r.varint();
+                m_table.erase(pid);
+            }
+        }
+        else
+        {
+            return false;
+        }
+
+        auto count = r.varint();
+        Pid pid = 0;
+        for (std::uint64_t i = 0; (i < count) && !r.failed(); ++i)
+        {
+            pid += r.varint();
+            auto bits = r.varint();
+            bool added = (bits & 1) != 0;
+
+            auto& props = m_table[pid];
+            if (added)
+                props = ProcessProperties();
+
+            ErSet(ProcessProperties, Pid, props, pid, pid);
+            decodeFields(r, bits >> 1, props);
+        }
+
+        return !r.failed();
+    }
+
+private:
+    std::string string(Reader& r)
+    {
+        auto id = r.varint();
+        if (id > 0)
+        {
+            if (id > m_strings.size())
+            {
+                r.fail();
+                return {};
+            }
+
+            return m_strings[id - 1];
+        }
+
+        auto length = r.varint();
+        auto s = std::string(r.bytes(length));
+        m_strings.push_back(s);
+        return s;
+    }
+
+    void decodeFields(Reader& r, std::uint64_t bits, ProcessProperties& p)
+    {
+        auto has = [bits](ProcessProperties::Field f) { return (bits & (std::uint64_t(1) << f)) != 0; };
+        auto had = [&p](ProcessProperties::Field f) { return p.valid(f); };
+
+        if (has(ProcessProperties::PPid))
+            ErSet(ProcessProperties, PPid, p, ppid, r.varint());
+        if (has(ProcessProperties::PGrp))
+            ErSet(ProcessProperties, PGrp, p, pgrp, r.varint());
+        if (has(ProcessProperties::Tpgid))
+            ErSet(ProcessProperties, Tpgid, p, tpgid, r.varint());
+        if (has(ProcessProperties::Session))
+            ErSet(ProcessProperties, Session, p, session, r.varint());
+        if (has(ProcessProperties::Ruid))
+            ErSet(ProcessProperties, Ruid, p, ruid, r.varint());
+        if (has(ProcessProperties::Comm))
+            ErSet(ProcessProperties, Comm, p, comm, string(r));
+        if (has(ProcessProperties::CmdLine))
+            ErSet(ProcessProperties, CmdLine, p, cmdLine, MultiStringZ(string(r)));
+        if (has(ProcessProperties::Exe))
+            ErSet(ProcessProperties, Exe, p, exe, string(r));
+        if (has(ProcessProperties::StartTime))
+            ErSet(ProcessProperties, StartTime, p, startTime, Time(r.varint()));
+        if (has(ProcessProperties::State))
+            ErSet(ProcessProperties, State, p, state, static_cast<std::uint32_t>(r.varint()));
+        if (has(ProcessProperties::UserName))
+            ErSet(ProcessProperties, UserName, p, userName, string(r));
+        if (has(ProcessProperties::ThreadCount))
+            ErSet(ProcessProperties, ThreadCount, p, threadCount, static_cast<std::uint32_t>(r.delta(had(ProcessProperties::ThreadCount) ? p.threadCount : 0)));
+        if (has(ProcessProperties::STime))
+            ErSet(ProcessProperties, STime, p, sTime, Time(r.delta(had(ProcessProperties::STime) ? p.sTime.value() : 0)));
+        if (has(ProcessProperties::UTime))
+            ErSet(ProcessProperties, UTime, p, uTime, Time(r.delta(had(ProcessProperties::UTime) ? p.uTime.value() : 0)));
+        if (has(ProcessProperties::CpuUsage))
+            ErSet(ProcessProperties, CpuUsage, p, cpuUsage, double(r.delta(had(ProcessProperties::CpuUsage) ? cpuUsageFixed(p.cpuUsage) : 0)) / 100.0);
+        if (has(ProcessProperties::Tty))
+            ErSet(ProcessProperties, Tty, p, tty, static_cast<std::int32_t>(r.delta(had(ProcessProperties::Tty) ? p.tty : 0)));
+        if (has(ProcessProperties::Env))
+            ErSet(ProcessProperties, Env, p, env, MultiStringZ(string(r)));
+        if (has(ProcessProperties::Rss))
+            ErSet(ProcessProperties, Rss, p, rss, static_cast<std::uint64_t>(r.delta(had(ProcessProperties::Rss) ? p.rss / 1024 : 0)) * 1024);
+    }
+
+    Table& m_table;
+    std::vector<std::string> m_strings;
+};
+
+
+class Encoder final
+{
+public:
+    Encoder(std::string& out, std::unordered_map<std::string, std::uint32_t>& strings) noexcept
+        : m_out(out)
+        , m_strings(strings)
+    {
+    }
+
+    void process(Pid pidDelta, const ProcessProperties& cur, const ProcessProperties* prev, const ProcessProperties::Mask& fields, bool added)
+    {
+        putVarint(m_out, pidDelta);
+        putVarint(m_out, (fields.pack<std::uint64_t>() << 1) | (added ? 1 : 0));
+
+        // counters are stored as differences against the previously recorded value
+        auto had = [prev](ProcessProperties::Field f) { return prev && prev->valid(f); };
+
+        if (fields[ProcessProperties::PPid])
+            putVarint(m_out, cur.ppid);
+        if (fields[ProcessProperties::PGrp])
+            putVarint(m_out, cur.pgrp);
+        if (fields[ProcessProperties::Tpgid])
+            putVarint(m_out, cur.tpgid);
+        if (fields[ProcessProperties::Session])
+            putVarint(m_out, cur.session);
+        if (fields[ProcessProperties::Ruid])
+            putVarint(m_out, cur.ruid);
+        if (fields[ProcessProperties::Comm])
+            string(cur.comm);
+        if (fields[ProcessProperties::CmdLine])
+            string(cur.cmdLine.raw);
+        if (fields[ProcessProperties::Exe])
+            string(cur.exe);
+        if (fields[ProcessProperties::StartTime])
+            putVarint(m_out, cur.startTime.value());
+        if (fields[ProcessProperties::State])
+            putVarint(m_out, cur.state);
+        if (fields[ProcessProperties::UserName])
+            string(cur.userName);
+        if (fields[ProcessProperties::ThreadCount])
+            putDelta(m_out, cur.threadCount, had(ProcessProperties::ThreadCount) ? prev->threadCount : 0);
+        if (fields[ProcessProperties::STime])
+            putDelta(m_out, cur.sTime.value(), had(ProcessProperties::STime) ? prev->sTime.value() : 0);
+        if (fields[ProcessProperties::UTime])
+            putDelta(m_out, cur.uTime.value(), had(ProcessProperties::UTime) ? prev->uTime.value() : 0);
+        if (fields[ProcessProperties::CpuUsage])
+            putDelta(m_out, cpuUsageFixed(cur.cpuUsage), had(ProcessProperties::CpuUsage) ? cpuUsageFixed(prev->cpuUsage) : 0);
+        if (fields[ProcessProperties::Tty])
+            putDelta(m_out, cur.tty, had(ProcessProperties::Tty) ? prev->tty : 0);
+        if (fields[ProcessProperties::Env])
+            string(cur.env.raw);
+        if (fields[ProcessProperties::Rss])
+            putDelta(m_out, cur.rss / 1024, had(ProcessProperties::Rss) ? prev->rss / 1024 : 0);
+    }
+
+private:
+    void string(const std::string& s)
+    {
+        auto [it, inserted] = m_strings.try_emplace(s, static_cast<std::uint32_t>(m_strings.size()));
+        if (!inserted)
+        {
+            putVarint(m_out, it->second + 1);
+            return;
+        }
+
+        putVarint(m_out, 0);
+        putVarint(m_out, s.length());
+        m_out.append(s);
+    }
+
+    std::string& m_out;
+    std::unordered_map<std::string, std::uint32_t>& m_strings;
+};
+
+
+struct RecordHeader
+{
+    std::uint8_t type = 0;
+    Time timestamp;
+    std::uint64_t payloadOffset = 0;
+    std::uint64_t length = 0;
+};
+
+// nullopt at the end of the file or at a torn record
+std::optional<RecordHeader> readRecordHeader(int fd, std::uint64_t offset, std::uint64_t fileSize)
+{
+    char buffer[MaxRecordHeader];
+    auto rd = ::pread(fd, buffer, sizeof(buffer), static_cast<off_t>(offset));
+    if (rd <= 0)
+        return std::nullopt;
+
+    Reader r(std::string_view(buffer, rd));
+
+    RecordHeader h;
+    h.type = static_cast<std::uint8_t>(r.varint());
+    h.timestamp = Time(r.varint());
+    h.length = r.varint();
+    if (r.failed())
+        return std::nullopt;
+
+    h.payloadOffset = offset + r.position();
+    if (h.payloadOffset + h.length > fileSize)
+        return std::nullopt; // torn or still being written
+
+    return h;
+}
+
+} // namespace {}
+
+
+ProcessProperties::Mask SnapshotRecorder::defaultFields() noexcept
+{
+    ProcessProperties::Mask m;
+    for (unsigned f = 0; f < ProcessProperties::FieldCount; ++f)
+        m.set(f);
+
+    m.reset(ProcessProperties::Env);
+    m.reset(ProcessProperties::CpuUsage);
+    return m;
+}
+
+SnapshotRecorder::~SnapshotRecorder()
+{
+    ErLogDebug2(m_log, "{}.SnapshotRecorder::~SnapshotRecorder()", Er::Format::ptr(this));
+
+    m_writer.request_stop();
+    m_writer.join();
+}
+
+SnapshotRecorder::SnapshotRecorder(Options&& options, Log::ILogger* log)
+    : m_log(log)
+    , m_options(std::move(options))
+{
+    ErLogDebug2(m_log, "{}.SnapshotRecorder::SnapshotRecorder({})", Er::Format::ptr(this), m_options.directory);
+
+    if (m_options.directory.empty() || !m_options.maxFiles || !m_options.maxFileSize)
+        throw Exception(std::source_location::current(), Error(Result::BadConfiguration, GenericError), Exception::Message("Invalid snapshot recorder configuration"));
+
+    std::error_code ec;
+    std::filesystem::create_directories(m_options.directory, ec);
+    if (ec)
+        throw Exception(std::source_location::current(), Error(ec.value(), PosixError), Exception::Message("Failed to create the snapshot directory"), ExceptionProperties::ObjectName(m_options.directory));
+
+    loadIndex();
+
+    m_buffer.reserve(WriteBufferSize);
+    m_lastSync = std::chrono::steady_clock::now();
+    m_writer = std::jthread([this](std::stop_token stop) { run(stop); });
+}
+
+std::string SnapshotRecorder::fileName(std::uint64_t file) const
+{
+    return Er::format("{}/snapshots.{:08}.log", m_options.directory, file);
+}
+
+void SnapshotRecorder::loadIndex()
+{
+    for (auto& entry : std::filesystem::directory_iterator(m_options.directory))
+    {
+        auto name = entry.path().filename().string();
+        if (!name.starts_with("snapshots.") || !name.ends_with(".log"))
+            continue;
+
+        auto seq = std::strtoull(name.c_str() + 10, nullptr, 10);
+        if (seq)
+            m_files.push_back(seq);
+    }
+
+    std::sort(m_files.begin(), m_files.end());
+
+    for (auto file : m_files)
+        indexFile(file);
+
+    ErLogInfo2(m_log, "Found {} snapshot files with {} keyframes in {}", m_files.size(), m_keyframes.size(), m_options.directory);
+}
+
+void SnapshotRecorder::indexFile(std::uint64_t file)
+{
+    auto path = fileName(file);
+    Util::FileHandle fd(::open(path.c_str(), O_RDONLY | O_CLOEXEC));
+    if (!fd.valid())
+        return;
+
+    auto fileSize = static_cast<std::uint64_t>(::lseek(fd.get(), 0, SEEK_END));
+
+    char magic[sizeof(Magic)];
+    if ((::pread(fd.get(), magic, sizeof(magic), 0) != sizeof(magic)) || std::memcmp(magic, Magic, sizeof(Magic)))
+    {
+        ErLogWarning2(m_log, "{} is not a snapshot file", path);
+        return;
+    }
+
+    std::uint64_t offset = sizeof(Magic);
+    while (auto h = readRecordHeader(fd.get(), offset, fileSize))
+    {
+        if (h->type == static_cast<std::uint8_t>(RecordType::Keyframe))
+            m_keyframes.push_back({ h->timestamp, file, offset });
+
+        offset = h->payloadOffset + h->length;
+    }
+
+    if (offset < fileSize)
+        ErLogWarning2(m_log, "{} has a torn record at offset {}", path, offset);
+}
+
+void SnapshotRecorder::record(const SnapshotDelta& delta)
+{
+    // the scanner has not scanned anything yet; an empty table stamped 0 must not become the first keyframe
+    if (!delta.timestamp.value())
+        return;
+
+    Record r;
+    r.timestamp = delta.timestamp;
+
+    auto interval = static_cast<Time::ValueType>(std::chrono::duration_cast<std::chrono::microseconds>(m_options.keyframeInterval).count());
+    bool keyframe = !m_lastKeyframe.value() || (delta.timestamp.value() - m_lastKeyframe.value() >= interval);
+
+    // the writer has lost some records, so the deltas that follow would have nothing to apply to
+    if (m_keyframeNeeded.exchange(false, std::memory_order_acquire))
+        keyframe = true;
+
+    if (keyframe)
+    {
+        // the table has to be updated first; a reused PID is both removed and added
+        for (auto pid : delta.removed)
+            m_table.erase(pid);
+
+        for (auto& change : delta.changed)
+        {
+            auto& mine = m_table[change.props->pid];
+            if (change.added)
+                mine = ProcessProperties();
+
+            mine.merge(recordedFields(*change.props, m_options.fields));
+        }
+
+        r.type = RecordType::Keyframe;
+        encodeKeyframe(r.payload);
+        m_lastKeyframe = delta.timestamp;
+    }
+    else
+    {
+        if (delta.empty())
+            return;
+
+        r.type = RecordType::Delta;
+        encodeDelta(delta, r.payload);
+    }
+
+    {
+        std::lock_guard l(m_mutex);
+        m_queue.push_back(std::move(r));
+        ++m_pushed;
+    }
+
+    m_queued.notify_one();
+}
+
+void SnapshotRecorder::encodeKeyframe(std::string& out)
+{
+    m_strings.clear();
+
+    std::vector<const ProcessProperties*> sorted;
+    sorted.reserve(m_table.size());
+    for (auto& entry : m_table)
+        sorted.push_back(&entry.second);
+
+    std::sort(sorted.begin(), sorted.end(), [](auto a, auto b) { return a->pid < b->pid; });
+
+    Encoder e(out, m_strings);
+    putVarint(out, sorted.size());
+
+    Pid prev = 0;
+    for (auto p : sorted)
+    {
+        e.process(p->pid - prev, *p, nullptr, p->validMask() & m_options.fields, true);
+        prev = p->pid;
+    }
+}
+
+void SnapshotRecorder::encodeDelta(const SnapshotDelta& delta, std::string& out)
+{
+    // a reused PID is both removed and added, so the removals go first
+    std::vector<Pid> removed(delta.removed.begin(), delta.removed.end());
+    std::sort(removed.begin(), removed.end());
+
+    putVarint(out, removed.size());
+    Pid prevPid = 0;
+    for (auto pid : removed)
+    {
+        putVarint(out, pid - prevPid);
+        prevPid = pid;
+        m_table.erase(pid);
+    }
+
+    std::vector<const ProcessChange*> sorted;
+    sorted.reserve(delta.changed.size());
+    for (auto& change : delta.changed)
+    {
+        auto fields = (change.added ? change.props->validMask() : (change.fields & change.props->validMask())) & m_options.fields;
+        if (change.added || fields.any())
+            sorted.push_back(&change);
+    }
+
+    std::sort(sorted.begin(), sorted.end(), [](auto a, auto b) { return a->props->pid < b->props->pid; });
+
+    Encoder e(out, m_strings);
+    putVarint(out, sorted.size());
+
+    prevPid = 0;
+    for (auto change : sorted)
+    {
+        auto& cur = *change->props;
+        auto fields = (change->added ? cur.validMask() : (change->fields & cur.validMask())) & m_options.fields;
+
+        auto& mine = m_table[cur.pid];
+        if (change->added)
+            mine = ProcessProperties();
+
+        e.process(cur.pid - prevPid, cur, change->added ? nullptr : &mine, fields, change->added);
+        prevPid = cur.pid;
+
+        mine.merge(recordedFields(cur, m_options.fields));
+    }
+}
+
+void SnapshotRecorder::flush()
+{
+    std::unique_lock l(m_mutex);
+    auto target = m_pushed;
+    m_flushed.wait(l, [this, target]() { return m_written >= target; });
+}
+
+std::expected<std::optional<SnapshotRecorder::Snapshot>, Error> SnapshotRecorder::replay(Time at)
+{
+    flush();
+
+    Keyframe start;
+    {
+        std::lock_guard l(m_mutex);
+
+        auto it = std::upper_bound(m_keyframes.begin(), m_keyframes.end(), at, [](Time t, const Keyframe& k) { return t < k.timestamp; });
+        if (it == m_keyframes.begin())
+            return std::optional<Snapshot>();
+
+        start = *std::prev(it);
+    }
+
+    auto path = fileName(start.file);
+    Util::FileHandle fd(::open(path.c_str(), O_RDONLY | O_CLOEXEC));
+    if (!fd.valid())
+        return std::unexpected(Error(errno, PosixError));
+
+    auto fileSize = static_cast<std::uint64_t>(::lseek(fd.get(), 0, SEEK_END));
+
+    Decoder::Table table;
+    Decoder decoder(table);
+    Snapshot result;
+
+    std::string payload;
+    auto offset = start.offset;
+    while (auto h = readRecordHeader(fd.get(), offset, fileSize))
+    {
+        if (h->timestamp > at)
+            break;
+
+        payload.resize(h->length);
+        if (::pread(fd.get(), payload.data(), payload.size(), static_cast<off_t>(h->payloadOffset)) != static_cast<ssize_t>(payload.size()))
+            return std::unexpected(Error(errno, PosixError));
+
+        if (!decoder.apply(h->type, payload))
+            return std::unexpected(Error(Result::InvalidInput, GenericError));
+
+        result.timestamp = h->timestamp;
+        offset = h->payloadOffset + h->length;
+    }
+
+    result.processes.reserve(table.size());
+    for (auto& entry : table)
+        result.processes.push_back(std::move(entry.second));
+
+    std::sort(result.processes.begin(), result.processes.end(), [](auto& a, auto& b) { return a.pid < b.pid; });
+
+    return std::optional<Snapshot>(std::move(result));
+}
+
+void SnapshotRecorder::run(std::stop_token stop)
+{
+    System::CurrentThread::setName("proctree_rec");
+
+    for (;;)
+    {
+        std::vector<Record> batch;
+        {
+            std::unique_lock l(m_mutex);
+            m_queued.wait_for(l, stop, m_options.fsyncInterval, [this]() { return !m_queue.empty(); });
+            batch.swap(m_queue);
+        }
+
+        Er::Util::ExceptionLogger xcptHandler(m_log);
+        try
+        {
+            for (auto& r : batch)
+                write(std::move(r));
+
+            writeBuffer();
+
+            if (m_dirty && (stop.stop_requested() || (std::chrono::steady_clock::now() - m_lastSync >= m_options.fsyncInterval)))
+                sync();
+        }
+        catch (...)
+        {
+            Er::dispatchException(std::current_exception(), xcptHandler);
+        }
+
+        {
+            std::lock_guard l(m_mutex);
+            m_written += batch.size();
+        }
+
+        m_flushed.notify_all();
+
+        if (batch.empty() && stop.stop_requested())
+            break;
+    }
+}
+
+void SnapshotRecorder::write(Record&& r)
+{
+    if ((r.type == RecordType::Keyframe) && (!m_file.valid() || (m_fileSize + m_buffer.size() >= m_options.maxFileSize)))
+        rotate();
+
+    if (!m_file.valid())
+    {
+        // the file could not be created or a write has failed; nothing can be recorded until the next keyframe
+        if (!m_dropping)
+        {
+            ErLogWarning2(m_log, "Snapshot records are being dropped until the next keyframe");
+            m_dropping = true;
+        }
+
+        m_keyframeNeeded.store(true, std::memory_order_release);
+        return;
+    }
+
+    m_dropping = false;
+
+    if (r.type == RecordType::Keyframe)
+        m_unindexed.push_back({ r.timestamp, m_currentFile, m_fileSize + m_buffer.size() });
+
+    m_buffer.push_back(static_cast<char>(r.type));
+    putVarint(m_buffer, r.timestamp.value());
+    putVarint(m_buffer, r.payload.size());
+    m_buffer.append(r.payload);
+
+    if (m_buffer.size() >= WriteBufferSize)
+        writeBuffer();
+}
+
+void SnapshotRecorder::writeBuffer()
+{
+    std::string_view rest(m_buffer);
+    while (!rest.empty())
+    {
+        auto written = ::write(m_file.get(), rest.data(), rest.size());
+        if (written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+
+            // the file ends with a torn record now; close it so that the next keyframe starts a new one
+            auto e = Error(errno, PosixError);
+            ErLogError2(m_log, "Failed to write a snapshot record: {}", e.message());
+            m_buffer.clear();
+            m_unindexed.clear();
+            m_file = Util::FileHandle();
+            m_keyframeNeeded.store(true, std::memory_order_release);
+            return;
+        }
+
+        m_fileSize += written;
+        rest.remove_prefix(written);
+    }
+
+    m_dirty = m_dirty || !m_buffer.empty();
+    m_buffer.clear();
+
+    if (!m_unindexed.empty())
+    {
+        std::lock_guard l(m_mutex);
+        m_keyframes.insert(m_keyframes.end(), m_unindexed.begin(), m_unindexed.end());
+        m_unindexed.clear();
+    }
+}
+
+void SnapshotRecorder::rotate()
+{
+    if (m_file.valid())
+    {
+        writeBuffer();
+        sync();
+    }
+
+    std::uint64_t seq;
+    {
+        std::lock_guard l(m_mutex);
+        seq = m_files.empty() ? 1 : m_files.back() + 1;
+    }
+
+    auto path = fileName(seq);
+    m_file = Util::FileHandle(::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0640));
+    if (!m_file.valid())
+    {
+        auto e = Error(errno, PosixError);
+        ErLogError2(m_log, "Failed to create {}: {}", path, e.message());
+        m_keyframeNeeded.store(true, std::memory_order_release);
+        return;
+    }
+
+    ErLogInfo2(m_log, "Recording snapshots to {}", path);
+
+    m_currentFile = seq;
+    m_fileSize = 0;
+    m_buffer.append(Magic, sizeof(Magic));
+
+    std::vector<std::uint64_t> expired;
+    {
+        std::lock_guard l(m_mutex);
+        m_files.push_back(seq);
+
+        while (m_files.size() > m_options.maxFiles)
+        {
+            auto oldest = m_files.front();
+            m_files.erase(m_files.begin());
+            std::erase_if(m_keyframes, [oldest](const Keyframe& k) { return k.file == oldest; });
+            expired.push_back(oldest);
+        }
+    }
+
+    // a replay in progress keeps its file open, so it's safe to unlink it
+    for (auto file : expired)
+    {
+        auto name = fileName(file);
+        ErLogInfo2(m_log, "Deleting {}", name);
+        ::unlink(name.c_str());
+    }
+}
+
+void SnapshotRecorder::sync()
+{
+    if (!m_file.valid() || !m_dirty)
+        return;
+
+    if (::fdatasync(m_file.get()) == -1)
+    {
+        auto e = Error(errno, PosixError);
+        ErLogWarning2(m_log, "fdatasync() failed: {}", e.message());
+    }
+
+    m_dirty = false;
+    m_lastSync = std::chrono::steady_clock::now();
+}
+
+
+} // namespace Er::ProcessTree {}
@@ -0,0 +1,48 @@
+#include "common.hpp"
+
+#include "alert_monitor.hxx"
+#include "linux/scanner.hxx"
+
+#include <condition_variable>
+#include <mutex>
+
+#include <unistd.h>
+
+using namespace Er;
+using namespace Er::ProcessTree;
+
+
+TEST(AlertMonitor, HoldTimeWithoutChanges)
+{
+    auto config = loadJson(Er::format(R"([ {{ "name": "self", "when": [ {{ "field": "pid", "op": "==", "value": {} }} ], "for_ms": 300 }} ])", ::getpid()));
+
+    // a single scan; nothing arrives from the scanner after the condition starts holding
+    Linux::Scanner scanner(std::make_shared<const Linux::ProcFsRoot>(), std::chrono::hours(1), false, Log::get());
+    Private::AlertMonitor monitor(scanner, *config.getVector(), Log::get());
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::vector<Alert> alerts;
+
+    auto id = monitor.subscribe({}, [&](const Alert& a)
+    {
+        {
+            std::lock_guard l(mutex);
+            alerts.push_back(a);
+        }
+
+        cv.notify_one();
+    });
+
+    {
+        std::unique_lock l(mutex);
+        ASSERT_TRUE(cv.wait_for(l, std::chrono::seconds(10), [&]() { return !alerts.empty(); }));
+
+        EXPECT_EQ(alerts[0].state, Alert::State::Fired);
+        EXPECT_EQ(alerts[0].rule, "self");
+        EXPECT_EQ(alerts[0].pid, Pid(::getpid()));
+        EXPECT_GE(alerts[0].timestamp.value() - alerts[0].since.value(), Time::ValueType(300000));
+    }
+
+    monitor.unsubscribe(id);
+}
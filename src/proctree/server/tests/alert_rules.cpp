@@ -0,0 +1,131 @@
+#include "common.hpp"
+
+#include <erebus/proctree/server/alert_rules.hxx>
+#include <erebus/rtl/exception.hxx>
+
+using namespace Er;
+using namespace Er::ProcessTree;
+
+
+namespace
+{
+
+AlertRules makeRules(std::string_view json)
+{
+    auto config = loadJson(json);
+    return AlertRules(*config.getVector());
+}
+
+ProcessProperties makeProcess(Pid pid, char state, std::uint64_t rss)
+{
+    ProcessProperties p;
+    ErSet(ProcessProperties, Pid, p, pid, pid);
+    ErSet(ProcessProperties, Comm, p, comm, std::string("test"));
+    ErSet(ProcessProperties, State, p, state, std::uint32_t(state));
+    ErSet(ProcessProperties, Rss, p, rss, rss);
+    return p;
+}
+
+SnapshotDelta makeDelta(Time::ValueType timestamp, const ProcessProperties& p, ProcessProperties::Mask changed, bool added = false)
+{
+    SnapshotDelta d;
+    d.timestamp = timestamp;
+    d.changed.push_back(ProcessChange{ &p, changed, added });
+    return d;
+}
+
+} // namespace {}
+
+
+TEST(AlertRules, Compile)
+{
+    auto rules = makeRules(R"([
+        { "name": "rss", "when": [ { "field": "rss", "op": ">", "value": 1000 } ] },
+        { "name": "stuck", "when": [ { "field": "state", "op": "==", "value": "D" } ], "for_ms": 30000 }
+    ])");
+
+    EXPECT_EQ(rules.size(), 2);
+    EXPECT_EQ(rules.name(0), "rss");
+    EXPECT_EQ(rules.name(1), "stuck");
+
+    // only the referenced fields are required
+    auto& required = rules.requiredFields();
+    EXPECT_EQ(required.count(), 2);
+    EXPECT_TRUE(required[ProcessProperties::Rss]);
+    EXPECT_TRUE(required[ProcessProperties::State]);
+
+    EXPECT_THROW(makeRules(R"([ { "name": "bad", "when": [ { "field": "nonexistent", "op": ">", "value": 1 } ] } ])"), Exception);
+    EXPECT_THROW(makeRules(R"([ { "name": "bad", "when": [ { "field": "rss", "op": "contains", "value": 1 } ] } ])"), Exception);
+    EXPECT_THROW(makeRules(R"([ { "name": "bad", "when": [] } ])"), Exception);
+}
+
+TEST(AlertRules, FireAndResolve)
+{
+    auto rules = makeRules(R"([ { "name": "rss", "when": [ { "field": "rss", "op": ">", "value": 1000 } ] } ])");
+    std::vector<Alert> alerts;
+
+    auto p = makeProcess(10, 'S', 500);
+    rules.evaluate(makeDelta(1, p, p.validMask(), true), alerts);
+    EXPECT_TRUE(alerts.empty());
+
+    p.rss = 2000;
+    rules.evaluate(makeDelta(2, p, { ProcessProperties::Rss }), alerts);
+    ASSERT_EQ(alerts.size(), 1);
+    EXPECT_EQ(alerts[0].state, Alert::State::Fired);
+    EXPECT_EQ(alerts[0].pid, 10);
+    EXPECT_EQ(alerts[0].rule, "rss");
+    EXPECT_EQ(alerts[0].comm, "test");
+
+    // edge-triggered: no repeated alert while still matching
+    alerts.clear();
+    p.rss = 3000;
+    rules.evaluate(makeDelta(3, p, { ProcessProperties::Rss }), alerts);
+    EXPECT_TRUE(alerts.empty());
+
+    // a change in an unrelated field is not even evaluated
+    p.rss = 0;
+    rules.evaluate(makeDelta(4, p, { ProcessProperties::State }), alerts);
+    EXPECT_TRUE(alerts.empty());
+
+    rules.evaluate(makeDelta(5, p, { ProcessProperties::Rss }), alerts);
+    ASSERT_EQ(alerts.size(), 1);
+    EXPECT_EQ(alerts[0].state, Alert::State::Resolved);
+}
+
+TEST(AlertRules, HoldTime)
+{
+    auto rules = makeRules(R"([ { "name": "stuck", "when": [ { "field": "state", "op": "==", "value": "D" } ], "for_ms": 30000 } ])");
+    std::vector<Alert> alerts;
+
+    auto p = makeProcess(20, 'D', 0);
+    rules.evaluate(makeDelta(Time::fromSeconds(1).value(), p, p.validMask(), true), alerts);
+    EXPECT_TRUE(alerts.empty());
+
+    SnapshotDelta empty;
+    empty.timestamp = Time::fromSeconds(20);
+    rules.evaluate(empty, alerts);
+    EXPECT_TRUE(alerts.empty());
+
+    empty.timestamp = Time::fromSeconds(31);
+    rules.evaluate(empty, alerts);
+    ASSERT_EQ(alerts.size(), 1);
+    EXPECT_EQ(alerts[0].state, Alert::State::Fired);
+    EXPECT_EQ(alerts[0].since, Time::fromSeconds(1));
+
+    std::vector<Alert> active;
+    rules.active(active);
+    EXPECT_EQ(active.size(), 1);
+
+    // process exit resolves the alert
+    alerts.clear();
+    SnapshotDelta gone;
+    gone.timestamp = Time::fromSeconds(32);
+    gone.removed.push_back(20);
+    rules.evaluate(gone, alerts);
+    ASSERT_EQ(alerts.size(), 1);
+    EXPECT_EQ(alerts[0].state, Alert::State::Resolved);
+
+    active.clear();
+    rules.active(active);
+    EXPECT_TRUE(active.empty());
+}
@@ -0,0 +1,193 @@
+#include "common.hpp"
+
+#include <erebus/proctree/blob_cache.hxx>
+#include <erebus/proctree/protocol.hxx>
+
+using namespace Er;
+using namespace Er::ProcessTree;
+
+
+namespace
+{
+
+ProcessProperties makeWorker(Pid pid)
+{
+    ProcessProperties p;
+    ErSet(ProcessProperties, Pid, p, pid, pid);
+    ErSet(ProcessProperties, Comm, p, comm, std::string("worker"));
+    ErSet(ProcessProperties, CmdLine, p, cmdLine, std::string("/usr/bin/python3 -m worker --queue=default --concurrency=4"));
+    ErSet(ProcessProperties, Exe, p, exe, std::string("/usr/lib/python3.12/bin/python3.12"));
+    ErSet(ProcessProperties, Env, p, env, std::string(2048, 'x'));
+    return p;
+}
+
+} // namespace {}
+
+
+TEST(BlobCache, lru)
+{
+    BlobCache cache(100);
+
+    std::string a(40, 'a');
+    std::string b(40, 'b');
+    std::string c(40, 'c');
+
+    EXPECT_TRUE(cache.put(1, a));
+    EXPECT_TRUE(cache.put(2, b));
+    EXPECT_EQ(cache.bytes(), 80);
+
+    // touch 'a' so that 'b' goes first
+    ASSERT_TRUE(cache.find(1));
+    EXPECT_TRUE(cache.put(3, c));
+    EXPECT_EQ(cache.bytes(), 80);
+
+    EXPECT_FALSE(cache.find(2));
+    ASSERT_TRUE(cache.find(1));
+    EXPECT_EQ(*cache.find(1), a);
+    EXPECT_EQ(*cache.find(3), c);
+
+    // same hash, different data
+    EXPECT_TRUE(cache.put(1, a));
+    EXPECT_FALSE(cache.put(1, b));
+    EXPECT_EQ(*cache.find(1), a);
+
+    // unless it's the server's word
+    EXPECT_EQ(*cache.assign(1, b), b);
+    EXPECT_EQ(*cache.find(1), b);
+    EXPECT_EQ(cache.bytes(), 80);
+}
+
+TEST(BlobCache, roundTrip)
+{
+    auto store = std::make_shared<BlobCache>(1024 * 1024);
+    BlobEncoder encoder(store);
+
+    erebus::ProcessDelta plain;
+    erebus::ProcessDelta deduped;
+    for (Pid pid = 1; pid <= 1000; ++pid)
+    {
+        auto p = makeWorker(pid);
+        marshalProcessProperties(p, *plain.add_changed());
+
+        auto props = deduped.add_changed();
+        marshalProcessProperties(p, *props);
+        encoder.encode(*props, *deduped.mutable_blobs());
+    }
+
+    // every distinct string is sent once; comm is too short to bother
+    EXPECT_EQ(deduped.blobs_size(), 3);
+    EXPECT_TRUE(deduped.changed(0).has_comm());
+    EXPECT_FALSE(deduped.changed(0).has_env());
+    EXPECT_TRUE(deduped.changed(0).has_envref());
+
+    auto plainSize = plain.ByteSizeLong();
+    auto dedupedSize = deduped.ByteSizeLong();
+    ErLogInfo("1000 workers: {} bytes plain, {} bytes deduplicated", plainSize, dedupedSize);
+    EXPECT_LT(dedupedSize * 10, plainSize);
+
+    // the same stream doesn't send them again
+    erebus::ProcessDelta next;
+    auto props = next.add_changed();
+    marshalProcessProperties(makeWorker(1001), *props);
+    encoder.encode(*props, *next.mutable_blobs());
+    EXPECT_EQ(next.blobs_size(), 0);
+
+    // client side
+    BlobCache cache(1024 * 1024);
+    storeBlobs(cache, deduped.blobs());
+
+    std::vector<BlobCache::Hash> missing;
+    BlobResolver resolver(cache, deduped.blobs());
+    for (auto& props : *deduped.mutable_changed())
+        resolver.resolve(props, &missing);
+
+    EXPECT_TRUE(missing.empty());
+
+    auto p = unmarshalProcessProperties(deduped.changed(999));
+    auto expected = makeWorker(1000);
+    EXPECT_EQ(p.cmdLine.raw, expected.cmdLine.raw);
+    EXPECT_EQ(p.exe, expected.exe);
+    EXPECT_EQ(p.env.raw, expected.env.raw);
+
+    // a client that has lost a blob asks the server's store for it
+    BlobCache small(16);
+    BlobResolver(small, next.blobs()).resolve(*next.mutable_changed(0), &missing);
+    ASSERT_EQ(missing.size(), 3);
+    EXPECT_TRUE(next.changed(0).has_cmdlineref());
+
+    for (auto hash : missing)
+    {
+        auto data = store->find(hash);
+        ASSERT_TRUE(data);
+        cache.put(hash, *data);
+    }
+
+    BlobResolver(cache, next.blobs()).resolve(*next.mutable_changed(0), nullptr);
+    EXPECT_FALSE(next.changed(0).has_cmdlineref());
+    EXPECT_EQ(next.changed(0).env(), expected.env.raw);
+}
+
+TEST(BlobCache, resentAfterEviction)
+{
+    // room for a single blob
+    auto store = std::make_shared<BlobCache>(100);
+    BlobEncoder encoder(store);
+
+    auto encode = [&encoder](const std::string& cmdLine)
+    {
+        erebus::ProcessDelta msg;
+        auto props = msg.add_changed();
+        props->set_cmdline(cmdLine);
+        encoder.encode(*props, *msg.mutable_blobs());
+        return msg;
+    };
+
+    std::string a(64, 'a');
+    std::string b(64, 'b');
+    EXPECT_EQ(encode(a).blobs_size(), 1);
+    EXPECT_EQ(encode(a).blobs_size(), 0);
+
+    // 'a' has gone from the store, so the encoder can't be sure what the client has under its hash
+    EXPECT_EQ(encode(b).blobs_size(), 1);
+    EXPECT_EQ(encode(a).blobs_size(), 1);
+}
+
+TEST(BlobCache, resolvedFromMessage)
+{
+    auto store = std::make_shared<BlobCache>(1024 * 1024);
+    BlobEncoder encoder(store);
+
+    erebus::ProcessDelta msg;
+    for (Pid pid = 1; pid <= 2; ++pid)
+    {
+        auto props = msg.add_changed();
+        marshalProcessProperties(makeWorker(pid), *props);
+        encoder.encode(*props, *msg.mutable_blobs());
+    }
+
+    ASSERT_EQ(msg.blobs_size(), 3);
+
+    // the client's cache is too small to hold them all and has a stale blob under one of the hashes
+    BlobCache cache(64);
+    cache.put(msg.blobs(0).hash(), std::string(40, '?'));
+
+    std::vector<BlobCache::Hash> missing;
+    BlobResolver resolver(cache, msg.blobs());
+    for (auto& props : *msg.mutable_changed())
+        resolver.resolve(props, &missing);
+
+    EXPECT_TRUE(missing.empty());
+
+    auto expected = makeWorker(2);
+    auto p = unmarshalProcessProperties(msg.changed(1));
+    EXPECT_EQ(p.cmdLine.raw, expected.cmdLine.raw);
+    EXPECT_EQ(p.exe, expected.exe);
+    EXPECT_EQ(p.env.raw, expected.env.raw);
+
+    // what the server has sent replaces what the client had
+    BlobCache big(1024 * 1024);
+    big.put(msg.blobs(0).hash(), std::string(40, '?'));
+    storeBlobs(big, msg.blobs());
+    ASSERT_TRUE(big.find(msg.blobs(0).hash()));
+    EXPECT_EQ(*big.find(msg.blobs(0).hash()), msg.blobs(0).data());
+}
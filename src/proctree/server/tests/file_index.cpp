@@ -0,0 +1,176 @@
+#include "common.hpp"
+#include "temp_dir.hpp"
+
+#include <erebus/proctree/server/linux/file_index.hxx>
+#include <erebus/rtl/util/generic_handle.hxx>
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace Er;
+using namespace Er::ProcessTree;
+using namespace Er::ProcessTree::Linux;
+
+
+namespace
+{
+
+// the directories on the way are created too
+Util::FileHandle createFile(const TempDir& dir, const std::filesystem::path& relative)
+{
+    auto path = dir.path() / relative;
+    std::filesystem::create_directories(path.parent_path());
+    return Util::FileHandle(::open(path.c_str(), O_CREAT | O_RDWR | O_CLOEXEC, 0600));
+}
+
+bool heldBy(const OpenFile& f, Pid pid, int fd)
+{
+    return std::any_of(f.owners.begin(), f.owners.end(), [pid, fd](const OpenFile::Owner& o) { return (o.pid == pid) && (o.fd == fd); });
+}
+
+} // namespace {}
+
+
+TEST(FileIndex, prefix)
+{
+    TempDir dir("file-index");
+    auto a = createFile(dir, "data/a");
+    auto b = createFile(dir, "data/sub/b");
+    auto c = createFile(dir, "database/c");
+    Pid self = ::getpid();
+
+    FileIndex::Options options;
+    options.interval = std::chrono::milliseconds(0);
+    FileIndex index(std::make_shared<const ProcFsRoot>(), options, Log::get());
+    index.refresh();
+
+    auto data = (dir.path() / "data").string();
+    auto found = index.find(data, 100);
+    EXPECT_FALSE(found.truncated);
+    ASSERT_EQ(found.files.size(), 2);
+    EXPECT_EQ(found.files[0].path, data + "/a");
+    EXPECT_TRUE(heldBy(found.files[0], self, a.get()));
+    EXPECT_EQ(found.files[1].path, data + "/sub/b");
+    EXPECT_TRUE(heldBy(found.files[1], self, b.get()));
+
+    // a trailing slash doesn't matter, a file is matched by itself
+    EXPECT_EQ(index.find(data + "/", 100).files.size(), 2);
+    EXPECT_EQ(index.find((dir.path() / "database" / "c").string(), 100).files.size(), 1);
+    EXPECT_EQ(index.find(dir.path().string(), 100).files.size(), 3);
+
+    auto limited = index.find(dir.path().string(), 1);
+    EXPECT_TRUE(limited.truncated);
+    EXPECT_EQ(limited.files.size(), 1);
+
+    constexpr int Queries = 10000;
+    auto started = std::chrono::steady_clock::now();
+    for (int i = 0; i < Queries; ++i)
+        [[maybe_unused]] auto _ = index.find(data, 100);
+
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - started).count();
+    ErLogInfo("Open file lookup by prefix: {} ns; the index takes {} KB", ns / Queries, index.memoryUsage() / 1024);
+
+    // our fd count changes, so we get rescanned
+    a.reset();
+    auto d = createFile(dir, "data/d");
+    auto e = createFile(dir, "data/e");
+    index.refresh();
+
+    found = index.find(data, 100);
+    ASSERT_EQ(found.files.size(), 3);
+    EXPECT_EQ(found.files[0].path, data + "/d");
+    EXPECT_EQ(found.files[1].path, data + "/e");
+    EXPECT_EQ(found.files[2].path, data + "/sub/b");
+}
+
+TEST(FileIndex, budget)
+{
+    TempDir dir("file-index");
+    auto a = createFile(dir, "data/a");
+
+    FileIndex::Options options;
+    options.interval = std::chrono::milliseconds(0);
+    options.budget = 100; // not even a single file
+    FileIndex index(std::make_shared<const ProcFsRoot>(), options, Log::get());
+    index.refresh();
+
+    EXPECT_LE(index.memoryUsage(), options.budget);
+
+    auto found = index.find(dir.path().string(), 100);
+    EXPECT_TRUE(found.partial);
+    EXPECT_TRUE(found.files.empty());
+}
+
+TEST(FileIndex, pushedOut)
+{
+    TempDir dir("file-index");
+    constexpr int ChildFiles = 16;
+    for (int i = 0; i < ChildFiles; ++i)
+        createFile(dir, Er::format("child/{}", i));
+
+    // a younger process holding more than we are going to add
+    int ready[2];
+    int release[2];
+    ASSERT_EQ(::pipe2(ready, O_CLOEXEC), 0);
+    ASSERT_EQ(::pipe2(release, O_CLOEXEC), 0);
+
+    auto child = ::fork();
+    ASSERT_GE(child, 0);
+    if (child == 0)
+    {
+        ::close(release[1]);
+
+        for (int i = 0; i < ChildFiles; ++i)
+            ::open((dir.path() / Er::format("child/{}", i)).c_str(), O_RDONLY);
+
+        char c = 0;
+        [[maybe_unused]] auto w = ::write(ready[1], &c, 1);
+        [[maybe_unused]] auto r = ::read(release[0], &c, 1);
+        ::_exit(0);
+    }
+
+    ::close(ready[1]);
+    ::close(release[0]);
+
+    char c;
+    ASSERT_EQ(::read(ready[0], &c, 1), 1);
+
+    FileIndex::Options options;
+    options.interval = std::chrono::milliseconds(0);
+
+    // just about everything that is open right now
+    {
+        FileIndex probe(std::make_shared<const ProcFsRoot>(), options, Log::get());
+        probe.refresh();
+        options.budget = probe.memoryUsage() + 64;
+    }
+
+    FileIndex index(std::make_shared<const ProcFsRoot>(), options, Log::get());
+    index.refresh();
+
+    auto childDir = (dir.path() / "child").string();
+    auto found = index.find(childDir, 100);
+    EXPECT_FALSE(found.partial);
+    EXPECT_EQ(found.files.size(), ChildFiles);
+
+    // we are older, so our new files push the child out
+    auto a = createFile(dir, "parent/a");
+    auto b = createFile(dir, "parent/b");
+    index.refresh();
+
+    EXPECT_LE(index.memoryUsage(), options.budget);
+    EXPECT_EQ(index.find((dir.path() / "parent").string(), 100).files.size(), 2);
+
+    found = index.find(childDir, 100);
+    EXPECT_TRUE(found.partial);
+    EXPECT_TRUE(found.files.empty());
+
+    ::close(release[1]);
+    ::close(ready[0]);
+    ::waitpid(child, nullptr, 0);
+}
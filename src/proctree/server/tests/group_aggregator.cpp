@@ -0,0 +1,66 @@
+#include "common.hpp"
+
+#include <erebus/proctree/server/group_aggregator.hxx>
+
+#include <algorithm>
+
+using namespace Er;
+using namespace Er::ProcessTree;
+
+
+namespace
+{
+
+ProcessProperties makeProcess(Pid pid, std::uint64_t ruid, std::uint64_t rss, std::uint32_t threads)
+{
+    ProcessProperties p;
+    ErSet(ProcessProperties, Pid, p, pid, pid);
+    ErSet(ProcessProperties, Ruid, p, ruid, ruid);
+    ErSet(ProcessProperties, Rss, p, rss, rss);
+    ErSet(ProcessProperties, ThreadCount, p, threadCount, threads);
+    return p;
+}
+
+} // namespace {}
+
+
+TEST(GroupAggregator, ByUser)
+{
+    GroupAggregator aggregator(GroupKey::Ruid, { ProcessProperties::Rss, ProcessProperties::ThreadCount, ProcessProperties::Comm });
+
+    // non-numeric fields are not aggregated
+    auto& required = aggregator.required();
+    EXPECT_EQ(required.count(), 3);
+    EXPECT_TRUE(required[ProcessProperties::Ruid]);
+    EXPECT_FALSE(required[ProcessProperties::Comm]);
+
+    aggregator.add(makeProcess(1, 0, 100, 1));
+    aggregator.add(makeProcess(2, 1000, 300, 4));
+    aggregator.add(makeProcess(3, 1000, 500, 2));
+
+    // no key - skipped
+    ProcessProperties orphan;
+    ErSet(ProcessProperties, Pid, orphan, pid, Pid(4));
+    aggregator.add(orphan);
+
+    auto groups = aggregator.result();
+    ASSERT_EQ(groups.size(), 2);
+
+    std::sort(groups.begin(), groups.end(), [](auto& a, auto& b) { return a.key < b.key; });
+
+    EXPECT_EQ(groups[0].key, 0);
+    EXPECT_EQ(groups[0].count, 1);
+
+    auto& user = groups[1];
+    EXPECT_EQ(user.key, 1000);
+    EXPECT_EQ(user.count, 2);
+    ASSERT_EQ(user.aggregates.size(), 2);
+
+    EXPECT_EQ(user.aggregates[0].field, ProcessProperties::ThreadCount);
+    EXPECT_DOUBLE_EQ(user.aggregates[0].sum, 6.0);
+    EXPECT_DOUBLE_EQ(user.aggregates[0].max, 4.0);
+
+    EXPECT_EQ(user.aggregates[1].field, ProcessProperties::Rss);
+    EXPECT_DOUBLE_EQ(user.aggregates[1].sum, 800.0);
+    EXPECT_DOUBLE_EQ(user.aggregates[1].max, 500.0);
+}
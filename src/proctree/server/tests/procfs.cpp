@@ -3,6 +3,11 @@
 #include <erebus/proctree/server/linux/procfs.hxx>
 #include <erebus/rtl/util/string_util.hxx>
 
+#include <atomic>
+#include <thread>
+
+#include <unistd.h>
+
 using namespace Er;
 using namespace Er::ProcessTree;
 using namespace Er::ProcessTree::Linux;
@@ -112,4 +117,111 @@ TEST(ProcFs, enumeratePids)
     {
         dumpStat(pid, proc);
     }
-}
\ No newline at end of file
+}
+TEST(ProcFs, sharedRoot)
+{
+    auto root = std::make_shared<const ProcFsRoot>();
+    EXPECT_GT(root->bootTime(), 0);
+    EXPECT_GT(root->ticksPerSecond(), 0);
+    EXPECT_GT(root->cpuCount(), 0);
+
+    ProcFs reference(root);
+    auto pids_ = reference.enumeratePids();
+    ASSERT_TRUE(pids_.has_value());
+    auto& pids = pids_.value();
+
+    // the cached directory handle is rewound for every pass
+    auto again = reference.enumeratePids();
+    ASSERT_TRUE(again.has_value());
+    EXPECT_GT(again.value().size(), 1);
+
+    auto self = reference.readStat(::getpid());
+    ASSERT_TRUE(self.has_value());
+    EXPECT_EQ(self.value().pid, ::getpid());
+    EXPECT_EQ(self.value().ruid, ::getuid());
+
+    std::atomic<std::size_t> read = 0;
+    std::vector<std::jthread> workers;
+    for (int i = 0; i < 4; ++i)
+    {
+        workers.emplace_back([root, &pids, &read]()
+        {
+            ProcFs proc(root);
+            for (auto pid : pids)
+            {
+                auto stat = proc.readStat(pid);
+                if (!stat.has_value())
+                    continue; // the process has gone
+
+                EXPECT_EQ(stat.value().pid, pid);
+
+                // the buffer is reused; make sure a big read doesn't corrupt a small one
+                [[maybe_unused]] auto env = proc.readEnv(pid);
+                auto comm = proc.readComm(pid);
+                if (comm.has_value())
+                    EXPECT_EQ(comm.value().find('\n'), std::string::npos);
+
+                ++read;
+            }
+        });
+    }
+
+    workers.clear();
+
+    EXPECT_GT(read.load(), 0);
+}
+
+TEST(ProcFs, prefetch)
+{
+    auto root = std::make_shared<const ProcFsRoot>();
+    ProcFs sync(root);
+    ProcFs batched(root, true);
+    if (!batched.batched())
+    {
+        ErLogWarning("io_uring is not available; skipping");
+        return;
+    }
+
+    auto pids_ = sync.enumeratePids();
+    ASSERT_TRUE(pids_.has_value());
+
+    // a few processes are enough to tell; erebus-procfs-bench is there for the timings
+    std::span<const Pid> pids(pids_.value());
+    pids = pids.first(std::min<std::size_t>(pids.size(), 32));
+
+    const unsigned files = ProcFs::PrefetchStat | ProcFs::PrefetchOwner | ProcFs::PrefetchComm | ProcFs::PrefetchCmdLine;
+    auto capacity = batched.prefetchCapacity(files);
+    ASSERT_GT(capacity, 0);
+
+    // the prefetched data must be exactly what the synchronous reads return
+    for (auto rest = pids; !rest.empty(); )
+    {
+        auto chunk = rest.first(std::min(capacity, rest.size()));
+        batched.prefetch(chunk, files);
+
+        for (auto pid : chunk)
+        {
+            auto expected = sync.readStat(pid);
+            auto actual = batched.readStat(pid);
+            ASSERT_EQ(expected.has_value(), actual.has_value());
+            if (!expected.has_value())
+                continue;
+
+            EXPECT_EQ(expected.value().ppid, actual.value().ppid);
+            EXPECT_EQ(expected.value().ruid, actual.value().ruid);
+            EXPECT_EQ(expected.value().comm, actual.value().comm);
+            EXPECT_EQ(expected.value().startTime, actual.value().startTime);
+
+            auto comm = batched.readComm(pid);
+            if (comm.has_value())
+                EXPECT_EQ(comm.value(), expected.value().comm);
+
+            auto cmdLine = batched.readCmdLine(pid);
+            auto cmdLineSync = sync.readCmdLine(pid);
+            if (cmdLine.has_value() && cmdLineSync.has_value())
+                EXPECT_EQ(cmdLine.value().raw, cmdLineSync.value().raw);
+        }
+
+        rest = rest.subspan(chunk.size());
+    }
+}
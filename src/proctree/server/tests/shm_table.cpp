@@ -0,0 +1,253 @@
+#include "common.hpp"
+
+#include <erebus/proctree/client/shm_process_table.hxx>
+#include <erebus/proctree/server/shm_publisher.hxx>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include <unistd.h>
+
+using namespace Er;
+using namespace Er::ProcessTree;
+
+
+namespace
+{
+
+std::string segmentName()
+{
+    return Er::format("/erebus-test-{}", ::getpid());
+}
+
+ProcessProperties makeProcess(Pid pid, std::uint64_t rss)
+{
+    ProcessProperties p;
+    ErSet(ProcessProperties, Pid, p, pid, pid);
+    ErSet(ProcessProperties, PPid, p, ppid, Pid(1));
+    ErSet(ProcessProperties, Comm, p, comm, std::string(pid % 2 ? "worker" : "shell"));
+    ErSet(ProcessProperties, Rss, p, rss, rss);
+    ErSet(ProcessProperties, CpuUsage, p, cpuUsage, 12.5);
+    ErSet(ProcessProperties, Tty, p, tty, std::int32_t(-1));
+    ErSet(ProcessProperties, Env, p, env, std::string("HOME=/root"));
+    return p;
+}
+
+void publishAll(ShmPublisher& publisher, std::vector<ProcessProperties>& table, Time::ValueType timestamp)
+{
+    SnapshotDelta delta;
+    delta.timestamp = Time(timestamp);
+    for (auto& p : table)
+        delta.changed.push_back({ &p, p.validMask(), true });
+
+    publisher.publish(delta);
+}
+
+} // namespace {}
+
+
+TEST(ShmTable, publishAndRead)
+{
+    ShmPublisher::Options options;
+    options.name = segmentName();
+    options.capacity = 1024;
+    options.arenaSize = 64 * 1024;
+
+    auto publisher = std::make_unique<ShmPublisher>(std::move(options), Log::get());
+
+    std::vector<ProcessProperties> table;
+    for (Pid pid = 1000; pid > 0; pid -= 10)
+        table.push_back(makeProcess(pid, pid * 4096));
+
+    publishAll(*publisher, table, 1000);
+
+    auto opened = ShmProcessTable::open(segmentName());
+    ASSERT_TRUE(opened.has_value());
+    auto& reader = *opened.value();
+
+    EXPECT_FALSE(reader.closed());
+    EXPECT_FALSE(reader.fields()[ProcessProperties::Env]);
+
+    auto p = reader.find(500);
+    ASSERT_TRUE(p.has_value() && p.value().has_value());
+    EXPECT_EQ(p.value()->pid, 500);
+    EXPECT_EQ(p.value()->ppid, 1);
+    EXPECT_EQ(p.value()->comm, "shell");
+    EXPECT_EQ(p.value()->rss, 500 * 4096);
+    EXPECT_DOUBLE_EQ(p.value()->cpuUsage, 12.5);
+    EXPECT_EQ(p.value()->tty, -1);
+    EXPECT_FALSE(p.value()->valid(ProcessProperties::Env));
+
+    auto none = reader.find(501);
+    ASSERT_TRUE(none.has_value());
+    EXPECT_FALSE(none.value().has_value());
+
+    // updates and removals
+    SnapshotDelta delta;
+    delta.timestamp = Time(2000);
+    auto changed = makeProcess(10, 1);
+    delta.changed.push_back({ &changed, ProcessProperties::Mask{ ProcessProperties::Rss }, false });
+    delta.removed.push_back(20);
+    publisher->publish(delta);
+
+    auto all = reader.snapshot();
+    ASSERT_TRUE(all.has_value());
+    ASSERT_EQ(all.value().size(), 99);
+    EXPECT_EQ(all.value().front().pid, 10);
+    EXPECT_EQ(all.value().front().rss, 1);
+    EXPECT_EQ(all.value()[1].pid, 30);
+
+    // zero-copy access
+    std::uint64_t rss = 0;
+    Time timestamp;
+    auto r = reader.read([&rss, &timestamp](const ShmProcessTable::View& v)
+    {
+        timestamp = v.timestamp();
+        if (auto row = v.find(30))
+            rss = v.number(*row, ProcessProperties::Rss);
+    });
+
+    ASSERT_TRUE(r.has_value());
+    EXPECT_EQ(rss, 30 * 4096);
+    EXPECT_EQ(timestamp.value(), 2000);
+
+    constexpr int Lookups = 100000;
+    auto started = std::chrono::steady_clock::now();
+    for (int i = 0; i < Lookups; ++i)
+    {
+        [[maybe_unused]] auto _ = reader.read([&rss, i](const ShmProcessTable::View& v)
+        {
+            if (auto row = v.find(Pid(10 + (i % 99) * 10)))
+                rss = v.number(*row, ProcessProperties::Rss);
+        });
+    }
+
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - started).count();
+    ErLogInfo("Shared memory lookup: {} ns", ns / Lookups);
+
+    // the server goes away
+    publisher.reset();
+    EXPECT_TRUE(reader.closed());
+    EXPECT_FALSE(reader.find(30).has_value());
+    EXPECT_FALSE(ShmProcessTable::open(segmentName()).has_value());
+}
+
+TEST(ShmTable, truncated)
+{
+    ShmPublisher::Options options;
+    options.name = segmentName();
+    options.capacity = 4;
+    options.arenaSize = 4096;
+
+    ShmPublisher publisher(std::move(options), Log::get());
+
+    std::vector<ProcessProperties> table;
+    for (Pid pid = 1; pid <= 10; ++pid)
+        table.push_back(makeProcess(pid, pid));
+
+    publishAll(publisher, table, 1);
+
+    auto reader = ShmProcessTable::open(segmentName());
+    ASSERT_TRUE(reader.has_value());
+
+    bool truncated = false;
+    std::uint32_t count = 0;
+    ASSERT_TRUE(reader.value()->read([&](const ShmProcessTable::View& v) { truncated = v.truncated(); count = v.count(); }));
+    EXPECT_TRUE(truncated);
+    EXPECT_EQ(count, 4);
+}
+
+TEST(ShmTable, pidReuse)
+{
+    ShmPublisher::Options options;
+    options.name = segmentName();
+    options.capacity = 16;
+
+    ShmPublisher publisher(std::move(options), Log::get());
+
+    std::vector<ProcessProperties> table{ makeProcess(1, 100), makeProcess(7, 700) };
+    publishAll(publisher, table, 1);
+
+    // the scanner reports a reused PID as removed and added in the same delta
+    auto reused = makeProcess(7, 42);
+    reused.setValid(ProcessProperties::Tty, false);
+
+    SnapshotDelta delta;
+    delta.timestamp = Time(2);
+    delta.removed.push_back(7);
+    delta.changed.push_back({ &reused, reused.validMask(), true });
+    publisher.publish(delta);
+
+    auto reader = ShmProcessTable::open(segmentName());
+    ASSERT_TRUE(reader.has_value());
+
+    auto all = reader.value()->snapshot();
+    ASSERT_TRUE(all.has_value());
+    ASSERT_EQ(all.value().size(), 2);
+
+    auto p = reader.value()->find(7);
+    ASSERT_TRUE(p.has_value() && p.value().has_value());
+    EXPECT_EQ(p.value()->rss, 42);
+    EXPECT_FALSE(p.value()->valid(ProcessProperties::Tty)); // nothing is left from the old process
+}
+
+TEST(ShmTable, consistentUnderWrites)
+{
+    ShmPublisher::Options options;
+    options.name = segmentName();
+    options.capacity = 256;
+
+    ShmPublisher publisher(std::move(options), Log::get());
+
+    std::vector<ProcessProperties> table;
+    for (Pid pid = 1; pid <= 200; ++pid)
+        table.push_back(makeProcess(pid, 0));
+
+    publishAll(publisher, table, 1);
+
+    auto reader = ShmProcessTable::open(segmentName());
+    ASSERT_TRUE(reader.has_value());
+
+    // every generation has the same rss in every row
+    std::atomic<bool> stop = false;
+    std::jthread writer([&]()
+    {
+        for (std::uint64_t generation = 1; !stop; ++generation)
+        {
+            for (auto& p : table)
+                p.rss = generation;
+
+            publishAll(publisher, table, Time::ValueType(generation));
+        }
+    });
+
+    std::size_t torn = 0;
+    for (int i = 0; i < 500; ++i)
+    {
+        auto r = reader.value()->read([&torn](const ShmProcessTable::View& v)
+        {
+            auto first = v.number(0, ProcessProperties::Rss);
+            for (std::uint32_t row = 1; row < v.count(); ++row)
+            {
+                if (v.number(row, ProcessProperties::Rss) != first)
+                {
+                    ++torn; // fine as long as read() retries
+                    break;
+                }
+            }
+        });
+
+        ASSERT_TRUE(r.has_value());
+
+        // check what read() has accepted
+        auto all = reader.value()->snapshot();
+        ASSERT_TRUE(all.has_value());
+        ASSERT_EQ(all.value().size(), 200);
+        for (auto& p : all.value())
+            ASSERT_EQ(p.rss, all.value().front().rss);
+    }
+
+    stop = true;
+    ErLogInfo("{} torn reads retried", torn);
+}
@@ -0,0 +1,263 @@
+#include "common.hpp"
+#include "temp_dir.hpp"
+
+#include <erebus/proctree/server/snapshot_recorder.hxx>
+
+#include <algorithm>
+#include <filesystem>
+
+using namespace Er;
+using namespace Er::ProcessTree;
+
+
+namespace
+{
+
+constexpr Time::ValueType Second = 1000 * 1000;
+
+ProcessProperties makeProcess(Pid pid, std::string_view comm, std::uint64_t rssKb)
+{
+    ProcessProperties p;
+    ErSet(ProcessProperties, Pid, p, pid, pid);
+    ErSet(ProcessProperties, PPid, p, ppid, Pid(1));
+    ErSet(ProcessProperties, Comm, p, comm, std::string(comm));
+    ErSet(ProcessProperties, Rss, p, rss, rssKb * 1024); // recorded in KiB
+    ErSet(ProcessProperties, Env, p, env, std::string("HOME=/root"));
+    return p;
+}
+
+struct Recording
+{
+    std::vector<ProcessProperties> table;
+    SnapshotDelta delta;
+
+    Recording& at(Time::ValueType t)
+    {
+        delta = SnapshotDelta();
+        delta.timestamp = Time(t);
+        return *this;
+    }
+
+    Recording& add(ProcessProperties&& p)
+    {
+        table.push_back(std::move(p));
+        return *this;
+    }
+
+    Recording& remove(Pid pid)
+    {
+        delta.removed.push_back(pid);
+        return *this;
+    }
+
+    void commit(SnapshotRecorder& recorder)
+    {
+        // the scanner keeps its table alive while the delta is being delivered
+        for (auto& p : table)
+            delta.changed.push_back({ &p, p.validMask(), true });
+
+        recorder.record(delta);
+        table.clear();
+    }
+
+    void commitChanged(SnapshotRecorder& recorder, const ProcessProperties::Mask& fields)
+    {
+        for (auto& p : table)
+            delta.changed.push_back({ &p, fields, false });
+
+        recorder.record(delta);
+        table.clear();
+    }
+};
+
+const ProcessProperties* find(const SnapshotRecorder::Snapshot& s, Pid pid)
+{
+    auto it = std::find_if(s.processes.begin(), s.processes.end(), [pid](auto& p) { return p.pid == pid; });
+    return (it == s.processes.end()) ? nullptr : &*it;
+}
+
+} // namespace {}
+
+
+TEST(SnapshotRecorder, replay)
+{
+    TempDir dir("snapshots");
+
+    auto options = [&dir]()
+    {
+        SnapshotRecorder::Options o;
+        o.directory = dir.path().string();
+        o.keyframeInterval = std::chrono::seconds(10);
+        return o;
+    };
+
+    {
+        SnapshotRecorder recorder(options(), Log::get());
+
+        // the environment is not recorded by default
+        EXPECT_FALSE(recorder.fields()[ProcessProperties::Env]);
+        EXPECT_TRUE(recorder.fields()[ProcessProperties::Comm]);
+
+        Recording r;
+        r.at(1 * Second).add(makeProcess(1, "init", 1000)).add(makeProcess(2, "bash", 2000)).commit(recorder);
+        r.at(2 * Second).add(makeProcess(3, "vim", 3000)).commit(recorder);
+        r.at(3 * Second).add(makeProcess(2, "zsh", 2500)).commitChanged(recorder, { ProcessProperties::Comm, ProcessProperties::Rss });
+        r.at(4 * Second).remove(3).commit(recorder);
+
+        // a new keyframe
+        r.at(12 * Second).add(makeProcess(4, "top", 100)).commit(recorder);
+        r.at(13 * Second).remove(1).commit(recorder);
+
+        auto none = recorder.replay(Time(Second / 2));
+        ASSERT_TRUE(none.has_value());
+        EXPECT_FALSE(none.value().has_value());
+
+        auto s2 = recorder.replay(Time(2 * Second + 1));
+        ASSERT_TRUE(s2.has_value() && s2.value().has_value());
+        EXPECT_EQ(s2.value()->timestamp.value(), 2 * Second);
+        ASSERT_EQ(s2.value()->processes.size(), 3);
+
+        auto bash = find(*s2.value(), 2);
+        ASSERT_NE(bash, nullptr);
+        EXPECT_EQ(bash->comm, "bash");
+        EXPECT_EQ(bash->rss, 2000 * 1024);
+        EXPECT_EQ(bash->ppid, 1);
+        EXPECT_FALSE(bash->valid(ProcessProperties::Env));
+
+        auto s3 = recorder.replay(Time(3 * Second));
+        ASSERT_TRUE(s3.has_value() && s3.value().has_value());
+        auto zsh = find(*s3.value(), 2);
+        ASSERT_NE(zsh, nullptr);
+        EXPECT_EQ(zsh->comm, "zsh");
+        EXPECT_EQ(zsh->rss, 2500 * 1024);
+        EXPECT_NE(find(*s3.value(), 3), nullptr);
+
+        auto s4 = recorder.replay(Time(4 * Second));
+        ASSERT_TRUE(s4.has_value() && s4.value().has_value());
+        EXPECT_EQ(s4.value()->processes.size(), 2);
+        EXPECT_EQ(find(*s4.value(), 3), nullptr);
+    }
+
+    // the index is rebuilt from the files
+    SnapshotRecorder recorder(options(), Log::get());
+
+    auto s12 = recorder.replay(Time(12 * Second));
+    ASSERT_TRUE(s12.has_value() && s12.value().has_value());
+    ASSERT_EQ(s12.value()->processes.size(), 3);
+    auto top = find(*s12.value(), 4);
+    ASSERT_NE(top, nullptr);
+    EXPECT_EQ(top->comm, "top");
+    auto zsh = find(*s12.value(), 2);
+    ASSERT_NE(zsh, nullptr);
+    EXPECT_EQ(zsh->comm, "zsh");
+
+    auto last = recorder.replay(Time(100 * Second));
+    ASSERT_TRUE(last.has_value() && last.value().has_value());
+    EXPECT_EQ(last.value()->timestamp.value(), 13 * Second);
+    EXPECT_EQ(last.value()->processes.size(), 2);
+    EXPECT_EQ(find(*last.value(), 1), nullptr);
+}
+
+TEST(SnapshotRecorder, rotation)
+{
+    TempDir dir("snapshots");
+
+    SnapshotRecorder::Options options;
+    options.directory = dir.path().string();
+    options.keyframeInterval = std::chrono::seconds(1);
+    options.maxFileSize = 1; // every keyframe starts a new file
+    options.maxFiles = 2;
+
+    SnapshotRecorder recorder(std::move(options), Log::get());
+
+    Recording r;
+    for (Pid pid = 1; pid <= 5; ++pid)
+    {
+        r.at(pid * Second).add(makeProcess(pid, "sh", 1)).commit(recorder);
+        recorder.flush();
+    }
+
+    std::size_t files = 0;
+    for ([[maybe_unused]] auto& entry : std::filesystem::directory_iterator(dir.path()))
+        ++files;
+
+    EXPECT_EQ(files, 2);
+
+    // the oldest files are gone
+    auto old = recorder.replay(Time(2 * Second));
+    ASSERT_TRUE(old.has_value());
+    EXPECT_FALSE(old.value().has_value());
+
+    auto s = recorder.replay(Time(5 * Second));
+    ASSERT_TRUE(s.has_value() && s.value().has_value());
+    EXPECT_EQ(s.value()->processes.size(), 5);
+}
+
+TEST(SnapshotRecorder, pidReuse)
+{
+    TempDir dir("snapshots");
+
+    SnapshotRecorder::Options options;
+    options.directory = dir.path().string();
+    options.keyframeInterval = std::chrono::seconds(10);
+
+    SnapshotRecorder recorder(std::move(options), Log::get());
+
+    // the scanner reports a reused PID as removed and added in the same delta
+    auto reuse = [](Recording& r, Time::ValueType t, std::string_view comm)
+    {
+        auto p = makeProcess(5, comm, 10);
+        p.setValid(ProcessProperties::PPid, false);
+        r.at(t).remove(5).add(std::move(p));
+    };
+
+    Recording r;
+    r.at(1 * Second).add(makeProcess(1, "init", 1000)).add(makeProcess(5, "cron", 500)).commit(recorder);
+
+    reuse(r, 2 * Second, "sshd");
+    r.commit(recorder);
+
+    // the same within a keyframe
+    reuse(r, 11 * Second, "nginx");
+    r.commit(recorder);
+
+    auto s2 = recorder.replay(Time(2 * Second));
+    ASSERT_TRUE(s2.has_value() && s2.value().has_value());
+    EXPECT_EQ(s2.value()->processes.size(), 2);
+    auto sshd = find(*s2.value(), 5);
+    ASSERT_NE(sshd, nullptr);
+    EXPECT_EQ(sshd->comm, "sshd");
+    EXPECT_EQ(sshd->rss, 10 * 1024);
+    EXPECT_FALSE(sshd->valid(ProcessProperties::PPid)); // nothing is left from the old process
+
+    auto s11 = recorder.replay(Time(11 * Second));
+    ASSERT_TRUE(s11.has_value() && s11.value().has_value());
+    EXPECT_EQ(s11.value()->processes.size(), 2);
+    auto nginx = find(*s11.value(), 5);
+    ASSERT_NE(nginx, nullptr);
+    EXPECT_EQ(nginx->comm, "nginx");
+    EXPECT_FALSE(nginx->valid(ProcessProperties::PPid));
+}
+
+TEST(SnapshotRecorder, beforeFirstScan)
+{
+    TempDir dir("snapshots");
+
+    SnapshotRecorder::Options options;
+    options.directory = dir.path().string();
+
+    SnapshotRecorder recorder(std::move(options), Log::get());
+
+    // a listener added before the first scan gets an empty table stamped 0
+    Recording r;
+    r.at(0).commit(recorder);
+    r.at(5 * Second).add(makeProcess(1, "init", 1000)).commit(recorder);
+
+    auto early = recorder.replay(Time(1 * Second));
+    ASSERT_TRUE(early.has_value());
+    EXPECT_FALSE(early.value().has_value());
+
+    auto s5 = recorder.replay(Time(5 * Second));
+    ASSERT_TRUE(s5.has_value() && s5.value().has_value());
+    EXPECT_EQ(s5.value()->processes.size(), 1);
+}
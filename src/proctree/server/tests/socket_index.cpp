@@ -0,0 +1,169 @@
+#include "common.hpp"
+
+#include <erebus/proctree/server/linux/socket_index.hxx>
+#include <erebus/rtl/util/generic_handle.hxx>
+
+#include <algorithm>
+#include <chrono>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace Er;
+using namespace Er::ProcessTree;
+using namespace Er::ProcessTree::Linux;
+
+
+namespace
+{
+
+struct Connection
+{
+    Util::FileHandle listener;
+    Util::FileHandle client;
+    Util::FileHandle server;
+    std::uint16_t port = 0;
+};
+
+Connection connectLoopback()
+{
+    Connection c;
+
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    c.listener.reset(::socket(AF_INET, SOCK_STREAM, 0));
+    EXPECT_EQ(::bind(c.listener.get(), reinterpret_cast<sockaddr*>(&addr), sizeof(addr)), 0);
+    EXPECT_EQ(::listen(c.listener.get(), 1), 0);
+
+    socklen_t len = sizeof(addr);
+    EXPECT_EQ(::getsockname(c.listener.get(), reinterpret_cast<sockaddr*>(&addr), &len), 0);
+    c.port = ntohs(addr.sin_port);
+
+    c.client.reset(::socket(AF_INET, SOCK_STREAM, 0));
+    EXPECT_EQ(::connect(c.client.get(), reinterpret_cast<sockaddr*>(&addr), sizeof(addr)), 0);
+    c.server.reset(::accept(c.listener.get(), nullptr, nullptr));
+    EXPECT_TRUE(c.server.valid());
+
+    return c;
+}
+
+bool ownedBy(const SocketInfo& s, Pid pid, int fd)
+{
+    return std::any_of(s.owners.begin(), s.owners.end(), [pid, fd](const SocketInfo::Owner& o) { return (o.pid == pid) && (o.fd == fd); });
+}
+
+} // namespace {}
+
+
+TEST(SocketIndex, ownership)
+{
+    auto c = connectLoopback();
+    Pid self = ::getpid();
+
+    SocketIndex::Options options;
+    options.interval = std::chrono::milliseconds(0);
+    SocketIndex index(std::make_shared<const ProcFsRoot>(), options, Log::get());
+    index.refresh();
+
+    // the listener and both ends of the connection
+    auto byPort = index.find(SocketQuery::byPort(c.port));
+    ASSERT_TRUE(byPort.has_value());
+    ASSERT_EQ(byPort.value().size(), 3);
+
+    for (auto& s : byPort.value())
+    {
+        EXPECT_EQ(s.protocol, SocketProtocol::Tcp);
+        EXPECT_EQ(s.localAddress, "127.0.0.1");
+        EXPECT_NE(s.inode, 0);
+
+        if (s.remotePort == 0)
+            EXPECT_TRUE(ownedBy(s, self, c.listener.get()));
+        else if (s.localPort == c.port)
+            EXPECT_TRUE(ownedBy(s, self, c.server.get()));
+        else
+            EXPECT_TRUE(ownedBy(s, self, c.client.get()));
+    }
+
+    // the listener and the accepted end are bound to the port, the client end is connected to it
+    auto byLocalPort = index.find(SocketQuery::byLocalPort(c.port));
+    ASSERT_TRUE(byLocalPort.has_value());
+    ASSERT_EQ(byLocalPort.value().size(), 2);
+    for (auto& s : byLocalPort.value())
+        EXPECT_EQ(s.localPort, c.port);
+
+    auto byRemotePort = index.find(SocketQuery::byRemotePort(c.port));
+    ASSERT_TRUE(byRemotePort.has_value());
+    ASSERT_EQ(byRemotePort.value().size(), 1);
+    EXPECT_TRUE(ownedBy(byRemotePort.value().front(), self, c.client.get()));
+
+    auto byPid = index.find(SocketQuery::byPid(self));
+    ASSERT_TRUE(byPid.has_value());
+    EXPECT_GE(byPid.value().size(), 3);
+
+    auto byRemote = index.find(SocketQuery::byRemoteAddress("127.0.0.1"));
+    ASSERT_TRUE(byRemote.has_value());
+    EXPECT_TRUE(std::any_of(byRemote.value().begin(), byRemote.value().end(), [&c](const SocketInfo& s) { return s.remotePort == c.port; }));
+
+    EXPECT_FALSE(index.find(SocketQuery::byRemoteAddress("not an address")).has_value());
+
+    constexpr int Queries = 10000;
+    auto started = std::chrono::steady_clock::now();
+    for (int i = 0; i < Queries; ++i)
+        [[maybe_unused]] auto _ = index.find(SocketQuery::byPort(c.port));
+
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - started).count();
+    ErLogInfo("Socket lookup by port: {} ns", ns / Queries);
+
+    // closed sockets go away on the next refresh
+    c.client.reset();
+    c.server.reset();
+    index.refresh();
+
+    byPort = index.find(SocketQuery::byPort(c.port));
+    ASSERT_TRUE(byPort.has_value());
+    for (auto& s : byPort.value())
+    {
+        if (s.remotePort == 0)
+            EXPECT_TRUE(ownedBy(s, self, c.listener.get()));
+        else
+            EXPECT_TRUE(s.owners.empty()); // TIME_WAIT etc
+    }
+}
+
+TEST(SocketIndex, sameFdCount)
+{
+    SocketIndex::Options options;
+    options.interval = std::chrono::milliseconds(0);
+    options.resync = std::chrono::hours(1);
+    SocketIndex index(std::make_shared<const ProcFsRoot>(), options, Log::get());
+
+    Util::FileHandle placeholder(::open("/dev/null", O_RDONLY | O_CLOEXEC));
+    ASSERT_TRUE(placeholder.valid());
+    index.refresh();
+
+    // a socket in place of a file leaves our fd count as it was
+    placeholder.reset();
+
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    Util::FileHandle listener(::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0));
+    ASSERT_EQ(::bind(listener.get(), reinterpret_cast<sockaddr*>(&addr), sizeof(addr)), 0);
+    ASSERT_EQ(::listen(listener.get(), 1), 0);
+
+    socklen_t len = sizeof(addr);
+    ASSERT_EQ(::getsockname(listener.get(), reinterpret_cast<sockaddr*>(&addr), &len), 0);
+
+    index.refresh();
+
+    auto found = index.find(SocketQuery::byLocalPort(ntohs(addr.sin_port)));
+    ASSERT_TRUE(found.has_value());
+    ASSERT_EQ(found.value().size(), 1);
+    EXPECT_TRUE(ownedBy(found.value().front(), ::getpid(), listener.get()));
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <erebus/rtl/format.hxx>
+
+#include <filesystem>
+#include <string_view>
+
+#include <unistd.h>
+
+
+// a fresh directory under the system temp directory; removed with everything in it
+class TempDir
+{
+public:
+    ~TempDir()
+    {
+        std::error_code ec;
+        std::filesystem::remove_all(m_path, ec);
+    }
+
+    explicit TempDir(std::string_view name)
+        : m_path(std::filesystem::temp_directory_path() / Er::format("erebus-{}-{}", name, ::getpid()))
+    {
+        std::filesystem::remove_all(m_path);
+        std::filesystem::create_directories(m_path);
+    }
+
+    TempDir(const TempDir&) = delete;
+    TempDir& operator=(const TempDir&) = delete;
+
+    const std::filesystem::path& path() const noexcept
+    {
+        return m_path;
+    }
+
+private:
+    std::filesystem::path m_path;
+};
@@ -156,4 +156,23 @@ TEST(FlagsPack, Simple)
         EXPECT_EQ(f.pack<uint64_t>(), 0x0000000000008001);
     }
 
+    // bitwise ops
+    {
+        FF a({ FF::_0, FF::_20 });
+        FF b({ FF::_20, FF::_69 });
+
+        auto u = a | b;
+        EXPECT_EQ(u.count(), 3);
+        EXPECT_TRUE(u == FF({ FF::_0, FF::_20, FF::_69 }));
+
+        auto i = a & b;
+        EXPECT_EQ(i.count(), 1);
+        EXPECT_TRUE(i == FF({ FF::_20 }));
+
+        a &= FF({ FF::_1 });
+        EXPECT_TRUE(a.none());
+
+        a |= b;
+        EXPECT_TRUE(a == b);
+    }
 }
\ No newline at end of file
@@ -402,6 +402,41 @@ TEST(Reflectable, update_move)
     EXPECT_TRUE(m3.first.empty()); // moved away
 }
 
+TEST(Reflectable, merge)
+{
+    My m1;
+    ErSet(My, Zeroth, m1, zeroth, 34);
+    ErSet(My, First, m1, first, "Bye?");
+    ErSet(My, Second, m1, second, -54321);
+    auto hash = m1.hash();
+
+    // merge from empty
+    m1.merge(My{});
+    EXPECT_EQ(m1.zeroth, 34);
+    EXPECT_STREQ(m1.first.c_str(), "Bye?");
+    EXPECT_EQ(m1.second, -54321);
+    EXPECT_FALSE(m1.valid(My::Third));
+    EXPECT_EQ(hash, m1.hash());
+
+    // merge a partial object
+    My m2;
+    ErSet(My, First, m2, first, "Hello!");
+    ErSet(My, Third, m2, third, 9.99);
+
+    m1.merge(std::move(m2));
+    EXPECT_EQ(m1.zeroth, 34);
+    EXPECT_STREQ(m1.first.c_str(), "Hello!");
+    EXPECT_EQ(m1.second, -54321);
+    EXPECT_DOUBLE_EQ(m1.third, 9.99);
+    EXPECT_TRUE(m1.valid(My::Zeroth));
+    EXPECT_TRUE(m1.valid(My::First));
+    EXPECT_TRUE(m1.valid(My::Second));
+    EXPECT_TRUE(m1.valid(My::Third));
+    EXPECT_NE(hash, m1.hash());
+
+    EXPECT_EQ(m2.validMask(), My::FieldSet{});
+}
+
 struct Rich
     : public Reflectable<Rich, 7>
 {
@@ -35,7 +35,7 @@ Property osVersion(std::string_view)
     struct utsname u = {};
     if (::uname(&u) == 0)
     {
-        return Property{ Er::SystemInfo::OsType, std::string{u.release} };
+        return Property{ Er::SystemInfo::OsVersion, std::string{u.release} };
     }
 
     return {};
@@ -46,11 +46,10 @@ Property osVersion(std::string_view)
 
 void registerSources(Sources& s)
 {
-    std::unique_lock l(s.mutex);
-
-    s.map.insert({ Er::SystemInfo::ServerVersion, { serverVersion } });
-    s.map.insert({ Er::SystemInfo::OsType, { osType } });
-    s.map.insert({ Er::SystemInfo::OsVersion, { osVersion } });
+    // none of these can change while we're running
+    s.add(Er::SystemInfo::ServerVersion, serverVersion, CachePolicy::computedOnce());
+    s.add(Er::SystemInfo::OsType, osType, CachePolicy::computedOnce());
+    s.add(Er::SystemInfo::OsVersion, osVersion, CachePolicy::computedOnce());
 }
 
 } // namespace Er::Server::SystemInfo::Private {}
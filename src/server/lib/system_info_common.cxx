@@ -1,53 +1,319 @@
 #include "system_info_common.hxx"
 
+#include <erebus/rtl/format.hxx>
+#include <erebus/rtl/util/exception_util.hxx>
 #include <erebus/rtl/util/pattern.hxx>
 
+#include <optional>
+
 
 namespace Er::Server::SystemInfo
 {
 
+namespace
+{
+
+bool isPattern(std::string_view name) noexcept
+{
+    return std::find_if(name.begin(), name.end(), [](char c) { return (c == '?') || (c == '*'); }) != name.end();
+}
+
+
+// keeps the source from being unregistered while it's being called
+class CallScope final
+{
+public:
+    ~CallScope()
+    {
+        // the last one out wakes up whoever is unregistering the source
+        if ((m_entry.active.fetch_sub(1, std::memory_order_seq_cst) == 1) && m_entry.removed.load(std::memory_order_seq_cst))
+            m_entry.active.notify_all();
+    }
+
+    explicit CallScope(Private::Entry& entry) noexcept
+        : m_entry(entry)
+    {
+        // pairs with unregisterSource() setting 'removed' before looking at 'active'
+        m_entry.active.fetch_add(1, std::memory_order_seq_cst);
+        m_ok = !m_entry.removed.load(std::memory_order_seq_cst);
+    }
+
+    explicit operator bool() const noexcept
+    {
+        return m_ok;
+    }
+
+private:
+    Private::Entry& m_entry;
+    bool m_ok;
+};
+
+
+std::chrono::steady_clock::time_point expiry(const CachePolicy& policy, std::chrono::steady_clock::time_point now) noexcept
+{
+    // background-refreshed values are replaced rather than expired
+    if (policy.mode == CachePolicy::Mode::Ttl)
+        return now + policy.interval;
+
+    return std::chrono::steady_clock::time_point::max();
+}
+
+
+// nothing if the source is gone or has no value yet
+std::optional<Property> evaluateSource(Private::Entry& e)
+{
+    auto now = std::chrono::steady_clock::now();
+
+    std::shared_ptr<const Private::Cached> cached;
+    if (e.policy.mode != CachePolicy::Mode::Uncached)
+    {
+        cached = e.cached.load(std::memory_order_acquire);
+        if (cached && (cached->expires > now)) [[likely]]
+            return cached->value;
+
+        // seeded by the refresher thread; the request path never waits for it
+        if (e.policy.mode == CachePolicy::Mode::Background)
+            return std::nullopt;
+    }
+
+    CallScope scope(e);
+    if (!scope)
+        return std::nullopt;
+
+    if (e.policy.mode == CachePolicy::Mode::Uncached)
+        return e.source(e.name);
+
+    std::unique_lock l(e.computeMutex, std::defer_lock);
+    if (cached)
+    {
+        // somebody is refreshing it already; a slightly stale value will do
+        if (!l.try_lock())
+            return cached->value;
+    }
+    else
+    {
+        l.lock();
+    }
+
+    // the miss may have been served while we were waiting
+    cached = e.cached.load(std::memory_order_acquire);
+    if (cached && (cached->expires > now))
+        return cached->value;
+
+    auto value = e.source(e.name);
+    e.cached.store(std::make_shared<const Private::Cached>(value, expiry(e.policy, std::chrono::steady_clock::now())), std::memory_order_release);
+
+    return value;
+}
+
+
+void refresh(Private::Entry& e)
+{
+    CallScope scope(e);
+    if (!scope)
+        return;
+
+    std::lock_guard l(e.computeMutex);
+
+    try
+    {
+        auto value = e.source(e.name);
+        e.cached.store(std::make_shared<const Private::Cached>(std::move(value), expiry(e.policy, std::chrono::steady_clock::now())), std::memory_order_release);
+    }
+    catch (...)
+    {
+        // the previous value stays; there will be another attempt in an interval
+        if (Log::get())
+        {
+            Er::Util::ExceptionLogger xcptHandler(Log::get());
+            Er::dispatchException(std::current_exception(), xcptHandler);
+        }
+    }
+}
+
+
+void refresherThread(std::stop_token stop)
+{
+    auto& sources = Private::Sources::instance();
+
+    while (!stop.stop_requested())
+    {
+        auto registry = sources.registry.load(std::memory_order_acquire);
+        auto now = std::chrono::steady_clock::now();
+        auto next = now + std::chrono::hours(1);
+
+        for (auto& [name, e] : registry->map)
+        {
+            if (e->policy.mode != CachePolicy::Mode::Background)
+                continue;
+
+            if (e->nextRefresh <= now)
+            {
+                refresh(*e);
+
+                if (stop.stop_requested())
+                    return;
+
+                e->nextRefresh = now + e->policy.interval;
+            }
+
+            next = std::min(next, e->nextRefresh);
+        }
+
+        // drop our reference so that unregistered sources die soon
+        registry.reset();
+
+        std::unique_lock l(sources.refreshMutex);
+        sources.refreshCv.wait_until(l, stop, next, [&sources]() { return sources.refreshKicked; });
+        sources.refreshKicked = false;
+    }
+}
+
+
+// a new background source wants its first value right away
+void kickRefresher(Private::Sources& sources)
+{
+    {
+        std::lock_guard l(sources.refreshMutex);
+        sources.refreshKicked = true;
+
+        if (!sources.refresher.joinable())
+            sources.refresher = std::jthread(refresherThread);
+    }
+
+    sources.refreshCv.notify_one();
+}
+
+} // namespace {}
+
 
 ER_SERVER_EXPORT PropertyBag get(std::string_view name)
 {
     PropertyBag bag;
 
-    auto& sources = Private::Sources::instance();
-    std::shared_lock l(sources.mutex);
-    
-    auto& m = sources.map;
-    
-    
-    if (std::find_if(name.begin(), name.end(), [](char c) { return (c == '?') || (c == '*'); }) == name.end())
+    auto registry = Private::Sources::instance().registry.load(std::memory_order_acquire);
+    auto& m = registry->map;
+
+    if (!isPattern(name))
     {
         // exact name?
         auto it = m.find(name);
         if (it != m.end())
         {
-            bag.push_back((it->second)(name));
+            if (auto prop = evaluateSource(*it->second))
+                bag.push_back(std::move(*prop));
         }
     }
     else
     {
         // wildcard?
-        for (auto item : m)
+        for (auto& item : m)
         {
             if (Er::Util::matchString(std::string_view{ item.first }, name))
             {
-                bag.push_back((item.second)(item.first));
+                if (auto prop = evaluateSource(*item.second))
+                    bag.push_back(std::move(*prop));
             }
         }
     }
-    
+
     return bag;
 }
 
-ER_SERVER_EXPORT void registerSource(std::string_view name, Source&& src)
+ER_SERVER_EXPORT void registerSource(std::string_view name, Source&& src, CachePolicy policy)
+{
+    if ((policy.mode == CachePolicy::Mode::Ttl || policy.mode == CachePolicy::Mode::Background) && (policy.interval.count() <= 0))
+        throw Exception(std::source_location::current(), Error(Result::InvalidInput, GenericError), Exception::Message(Er::format("Invalid cache interval for system info source '{}'", name)));
+
+    auto& sources = Private::Sources::instance();
+
+    {
+        std::lock_guard l(sources.writeMutex);
+        sources.add(name, std::move(src), policy);
+    }
+
+    // the first value is computed on the refresher thread, too
+    if (policy.mode == CachePolicy::Mode::Background)
+        kickRefresher(sources);
+}
+
+ER_SERVER_EXPORT void unregisterSource(std::string_view name)
 {
     auto& sources = Private::Sources::instance();
-    std::unique_lock l(sources.mutex);
-    
-    auto& m = sources.map;
-    m.insert({ name, std::move(src) });
+    std::shared_ptr<Private::Entry> entry;
+
+    {
+        std::lock_guard l(sources.writeMutex);
+
+        auto current = sources.registry.load(std::memory_order_acquire);
+        auto it = current->map.find(name);
+        if (it == current->map.end())
+            return;
+
+        entry = it->second;
+
+        auto r = std::make_shared<Private::Registry>(*current);
+        r->map.erase(std::string(name));
+        sources.registry.store(std::move(r), std::memory_order_release);
+    }
+
+    // whoever is calling the source right now gets to finish; nobody gets to start
+    entry->removed.store(true, std::memory_order_seq_cst);
+    for (auto active = entry->active.load(std::memory_order_seq_cst); active != 0; active = entry->active.load(std::memory_order_seq_cst))
+        entry->active.wait(active, std::memory_order_seq_cst);
+}
+
+
+Query::Query(std::string_view pattern)
+    : m_pattern(pattern)
+{
+}
+
+void Query::resolve(std::shared_ptr<const Private::Registry>&& registry)
+{
+    auto& m = registry->map;
+
+    m_sources.clear();
+
+    if (!isPattern(m_pattern))
+    {
+        auto it = m.find(m_pattern);
+        if (it != m.end())
+            m_sources.push_back(it->second);
+    }
+    else
+    {
+        for (auto& item : m)
+        {
+            if (Er::Util::matchString(std::string_view{ item.first }, std::string_view{ m_pattern }))
+                m_sources.push_back(item.second);
+        }
+    }
+
+    m_registry = std::move(registry);
+}
+
+PropertyBag Query::evaluate()
+{
+    PropertyBag bag;
+
+    // the registry only gets replaced when sources come or go
+    auto registry = Private::Sources::instance().registry.load(std::memory_order_acquire);
+    if (registry != m_registry)
+        resolve(std::move(registry));
+
+    bag.reserve(m_sources.size());
+    for (auto& source : m_sources)
+    {
+        // unregistered since we resolved it
+        if (source->removed.load(std::memory_order_relaxed))
+            continue;
+
+        if (auto prop = evaluateSource(*source))
+            bag.push_back(std::move(*prop));
+    }
+
+    return bag;
 }
 
 
@@ -3,8 +3,11 @@
 
 #include <erebus/server/system_info.hxx>
 
+#include <atomic>
+#include <condition_variable>
+#include <map>
 #include <mutex>
-#include <shared_mutex>
+#include <thread>
 
 
 namespace Er::Server::SystemInfo::Private
@@ -15,12 +18,54 @@ struct Sources;
 void registerSources(Sources&);
 
 
+struct Cached
+{
+    Property value;
+    std::chrono::steady_clock::time_point expires;
+};
+
+
+struct Entry
+{
+    const std::string name;
+    const Source source;
+    const CachePolicy policy;
+
+    std::atomic<std::shared_ptr<const Cached>> cached;
+    std::mutex computeMutex;                                    // coalesces misses and refreshes
+    std::atomic<std::uint32_t> active = 0;                      // calls to the source in progress
+    std::atomic<bool> removed = false;
+    std::chrono::steady_clock::time_point nextRefresh = {};     // the refresher thread's own
+
+    Entry(std::string_view name, Source&& source, CachePolicy policy)
+        : name(name)
+        , source(std::move(source))
+        , policy(policy)
+    {
+    }
+};
+
+
+// immutable; replaced as a whole whenever a source comes or goes, so that readers need no lock
+struct Registry
+{
+    std::map<std::string, std::shared_ptr<Entry>, std::less<>> map;
+};
+
+
 struct Sources
 {
-    std::shared_mutex mutex;
-    std::map<std::string_view, Source> map;
+    std::mutex writeMutex;
+    std::atomic<std::shared_ptr<const Registry>> registry;
+
+    // background refreshes
+    std::mutex refreshMutex;
+    std::condition_variable_any refreshCv;
+    bool refreshKicked = false;
+    std::jthread refresher;
 
     Sources()
+        : registry(std::make_shared<const Registry>())
     {
         registerSources(*this);
     }
@@ -30,6 +75,17 @@ struct Sources
         static Sources s;
         return s;
     }
+
+    // for the platform sources at startup
+    void add(std::string_view name, Source&& src, CachePolicy policy = CachePolicy::uncached())
+    {
+        auto r = std::make_shared<Registry>();
+        if (auto current = registry.load())
+            r->map = current->map;
+
+        r->map.emplace(std::string(name), std::make_shared<Entry>(name, std::move(src), policy));
+        registry.store(std::move(r));
+    }
 };
 
 
@@ -3,6 +3,7 @@
 #include <erebus/rtl/util/exception_util.hxx>
 #include <erebus/rtl/util/file.hxx>
 
+#include <fstream>
 #include <iostream>
 
 
@@ -16,10 +17,18 @@ void ClientApplication::addCmdLineOptions(boost::program_options::options_descri
     options.add_options()
         ("connection", boost::program_options::value<std::string>(&m_cfgFile), "connection config file path")
         ("parallel,t", boost::program_options::value<unsigned>(&m_parallel)->default_value(1), "parallel thread count")
+        ("channels,c", boost::program_options::value<unsigned>(&m_channels)->default_value(1), "number of connections to spread the requests over")
         ("count,n", boost::program_options::value<unsigned>(&m_iterations)->default_value(unsigned(-1)), "request repeat count")
         ("wait,w", boost::program_options::value<bool>(&m_wait)->default_value(true), "wait for current request completion before issuing another request")
         ("ping", boost::program_options::value<unsigned>(), "ping with specified number of bytes")
         ("sysinfo", boost::program_options::value<std::string>(), "query system properties with specified name pattern")
+        ("load", boost::program_options::value<std::string>(), "open-loop load test of ping|sysinfo|props|list")
+        ("rate,r", boost::program_options::value<double>(&m_loadOptions.rate)->default_value(100.0), "load: target request rate per second, all threads together")
+        ("window", boost::program_options::value<unsigned>(&m_loadOptions.window)->default_value(64), "load: max requests in flight per thread")
+        ("duration,d", boost::program_options::value<unsigned>(&m_loadDuration)->default_value(10), "load: test duration in seconds")
+        ("payload", boost::program_options::value<unsigned>(&m_loadOptions.payloadSize)->default_value(32), "load: ping payload size")
+        ("pattern", boost::program_options::value<std::string>(&m_loadOptions.pattern)->default_value("*"), "load: system property name pattern")
+        ("json", boost::program_options::value<std::string>(&m_jsonReport), "load: write a JSON report to this file ('-' for stdout)")
         ;
 }
 
@@ -61,7 +70,8 @@ bool ClientApplication::createChannel()
     Er::Util::ExceptionLogger xcptHandler(Er::Log::get());
     try
     {
-        m_channel = Er::Ipc::Grpc::createChannel(*m_config);
+        m_pool = Er::Ipc::Grpc::createChannelPool(*m_config, std::max(m_channels, 1U));
+        m_channel = m_pool->channel(0);
     }
     catch (...)
     {
@@ -81,7 +91,11 @@ bool ClientApplication::startTasks()
         return false;
     }
 
-    if (args().contains("ping"))
+    if (args().contains("load"))
+    {
+        return startLoad();
+    }
+    else if (args().contains("ping"))
     {
         auto payloadSize = args()["ping"].as<unsigned>();
         m_pingRunner.reset(new PingRunner([this]() { exitCondition().setAndNotifyOne(true); }, m_channel, m_parallel, m_iterations, m_wait, payloadSize));
@@ -98,6 +112,46 @@ bool ClientApplication::startTasks()
     return false;
 }
 
+bool ClientApplication::startLoad()
+{
+    if (!LoadRunner::parseRpc(args()["load"].as<std::string>(), m_loadOptions.rpc))
+    {
+        ErLogError("Unsupported load test RPC {}", args()["load"].as<std::string>());
+        return false;
+    }
+
+    if ((m_loadOptions.rate <= 0) || !m_loadOptions.window || !m_loadDuration)
+    {
+        ErLogError("Rate, window and duration must be positive");
+        return false;
+    }
+
+    m_loadOptions.threads = m_parallel;
+    m_loadOptions.duration = std::chrono::seconds(m_loadDuration);
+
+    m_loadRunner.reset(new LoadRunner([this]() { exitCondition().setAndNotifyOne(true); }, m_pool, m_loadOptions));
+    return true;
+}
+
+void ClientApplication::reportLoad()
+{
+    m_loadRunner->stop();
+    m_loadRunner->report(std::cout);
+
+    if (m_jsonReport == "-")
+    {
+        m_loadRunner->reportJson(std::cout);
+    }
+    else if (!m_jsonReport.empty())
+    {
+        std::ofstream out(m_jsonReport);
+        if (out)
+            m_loadRunner->reportJson(out);
+        else
+            ErLogError("Failed to create {}", m_jsonReport);
+    }
+}
+
 int ClientApplication::run(int argc, char** argv)
 {
     if (!createChannel())
@@ -113,10 +167,17 @@ int ClientApplication::run(int argc, char** argv)
         Er::Log::warning(Er::Log::get(), "Exiting due to signal {}", signalReceived());
     }
 
+    if (m_loadRunner)
+    {
+        reportLoad();
+        m_loadRunner.reset();
+    }
+
     m_pingRunner.reset();
     m_systemInfoRunner.reset();
 
     m_channel.reset();
+    m_pool.reset();
 
     return EXIT_SUCCESS;
 }
\ No newline at end of file
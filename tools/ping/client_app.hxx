@@ -4,6 +4,7 @@
 #include <erebus/rtl/property_bag.hxx>
 #include <erebus/ipc/grpc/client/grpc_client.hxx>
 
+#include "load_runner.hxx"
 #include "ping.hxx"
 #include "system_info.hxx"
 
@@ -20,17 +21,25 @@ protected:
     std::string m_cfgFile;
     Er::Property m_configRoot;
     Er::PropertyMap const* m_config = nullptr;
+    Er::Ipc::Grpc::ChannelPoolPtr m_pool;
     Er::Ipc::Grpc::ChannelPtr m_channel;
+    unsigned m_channels = 1;
     unsigned m_parallel = 1;
     bool m_wait = true;
     unsigned m_iterations = unsigned(-1);
     std::unique_ptr<PingRunner> m_pingRunner;
     std::unique_ptr<SystemInfoRunner> m_systemInfoRunner;
+    LoadRunner::Options m_loadOptions;
+    unsigned m_loadDuration = 10;
+    std::string m_jsonReport;
+    std::unique_ptr<LoadRunner> m_loadRunner;
 
     void addCmdLineOptions(boost::program_options::options_description& options) override;
     bool loadConfiguration() override;
     bool createChannel();
     bool startTasks();
+    bool startLoad();
+    void reportLoad();
 
     int run(int argc, char** argv) override;
 };
\ No newline at end of file
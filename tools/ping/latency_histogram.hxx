@@ -0,0 +1,107 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+
+//
+// A log-linear histogram of latencies in microseconds, HdrHistogram-style:
+// values below 128 are exact, larger ones land in buckets 1/64 of their power of two wide.
+//
+
+class LatencyHistogram
+{
+public:
+    LatencyHistogram()
+        : m_counts(BucketCount, 0)
+    {
+    }
+
+    void record(std::uint64_t us) noexcept
+    {
+        ++m_counts[index(us)];
+        ++m_count;
+        m_sum += us;
+        m_max = std::max(m_max, us);
+    }
+
+    void merge(const LatencyHistogram& other) noexcept
+    {
+        for (std::size_t i = 0; i < BucketCount; ++i)
+            m_counts[i] += other.m_counts[i];
+
+        m_count += other.m_count;
+        m_sum += other.m_sum;
+        m_max = std::max(m_max, other.m_max);
+    }
+
+    std::uint64_t count() const noexcept
+    {
+        return m_count;
+    }
+
+    std::uint64_t max() const noexcept
+    {
+        return m_max;
+    }
+
+    double mean() const noexcept
+    {
+        return m_count ? double(m_sum) / double(m_count) : 0.0;
+    }
+
+    // the upper bound of the bucket holding the percentile, so never optimistic
+    std::uint64_t percentile(double p) const noexcept
+    {
+        if (!m_count)
+            return 0;
+
+        auto target = static_cast<std::uint64_t>(std::ceil(p / 100.0 * double(m_count)));
+        target = std::clamp<std::uint64_t>(target, 1, m_count);
+
+        std::uint64_t seen = 0;
+        for (std::size_t i = 0; i < BucketCount; ++i)
+        {
+            seen += m_counts[i];
+            if (seen >= target)
+                return std::min(upperBound(i), m_max);
+        }
+
+        return m_max;
+    }
+
+private:
+    static constexpr unsigned SubBucketBits = 7;
+    static constexpr std::uint64_t SubBuckets = 1ULL << SubBucketBits;
+    static constexpr std::uint64_t HalfSubBuckets = SubBuckets / 2;
+    static constexpr std::size_t BucketCount = SubBuckets + (64 - SubBucketBits) * HalfSubBuckets;
+
+    static std::size_t index(std::uint64_t v) noexcept
+    {
+        if (v < SubBuckets)
+            return static_cast<std::size_t>(v);
+
+        unsigned shift = std::bit_width(v) - SubBucketBits;
+        auto top = v >> shift; // [64, 128)
+        return static_cast<std::size_t>(SubBuckets + (shift - 1) * HalfSubBuckets + (top - HalfSubBuckets));
+    }
+
+    static std::uint64_t upperBound(std::size_t index) noexcept
+    {
+        if (index < SubBuckets)
+            return index;
+
+        auto k = index - SubBuckets;
+        unsigned shift = static_cast<unsigned>(k / HalfSubBuckets) + 1;
+        auto top = (k % HalfSubBuckets) + HalfSubBuckets;
+        return ((top + 1) << shift) - 1;
+    }
+
+    std::vector<std::uint64_t> m_counts;
+    std::uint64_t m_count = 0;
+    std::uint64_t m_sum = 0;
+    std::uint64_t m_max = 0;
+};
@@ -0,0 +1,438 @@
+#pragma once
+
+#include "latency_histogram.hxx"
+
+#include <grpcpp/grpcpp.h>
+
+#include <erebus/ipc/grpc/client/grpc_client.hxx>
+#include <erebus/ipc/grpc/client/isystem_info_client.hxx>
+#include <erebus/rtl/log.hxx>
+#include <erebus/rtl/util/exception_util.hxx>
+#include <erebus/rtl/util/unknown_base.hxx>
+
+#if !ER_WINDOWS
+    #include <erebus/proctree/client/iprocess_list_client.hxx>
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+
+//
+// Open-loop load: requests go out on a fixed schedule whether or not the earlier ones have
+// completed, up to 'window' outstanding per thread. Latency is counted from the time a request
+// was due rather than from when it actually went out, so a stalled server can't hide its
+// stalls by holding the sender back (coordinated omission).
+//
+
+class LoadRunner
+{
+public:
+    using IdleCallback = std::function<void()>;
+
+    enum class Rpc
+    {
+        Ping,
+        SystemInfo,
+        ProcessProps,
+        ListProcesses
+    };
+
+    struct Options
+    {
+        Rpc rpc = Rpc::Ping;
+        unsigned threads = 1;
+        double rate = 100.0;                        // requests per second, all threads together
+        unsigned window = 64;                       // in-flight requests per thread
+        std::chrono::seconds duration{ 10 };
+        unsigned payloadSize = 32;                  // Ping
+        std::string pattern = "*";                  // GetSystemInfo
+    };
+
+    static bool parseRpc(std::string_view name, Rpc& rpc) noexcept
+    {
+        if (name == "ping")
+            rpc = Rpc::Ping;
+        else if (name == "sysinfo")
+            rpc = Rpc::SystemInfo;
+#if !ER_WINDOWS
+        else if (name == "props")
+            rpc = Rpc::ProcessProps;
+        else if (name == "list")
+            rpc = Rpc::ListProcesses;
+#endif
+        else
+            return false;
+
+        return true;
+    }
+
+    ~LoadRunner()
+    {
+        stop();
+    }
+
+    LoadRunner(IdleCallback&& idle, Er::Ipc::Grpc::ChannelPoolPtr pool, const Options& options)
+        : m_idle(std::move(idle))
+        , m_pool(pool)
+        , m_options(options)
+        , m_workers(options.threads)
+    {
+        ErAssert(options.threads > 0);
+        ErAssert(options.rate > 0);
+        ErAssert(options.window > 0);
+
+        ErLogInfo("Running {} at {} requests/s for {} s on {} threads, up to {} in flight each, over {} channels", rpcName(), options.rate, options.duration.count(), options.threads, options.window, pool->size());
+
+        m_started = std::chrono::steady_clock::now();
+        m_running = options.threads;
+
+        m_threads.reserve(options.threads);
+        for (unsigned i = 0; i < options.threads; ++i)
+            m_threads.emplace_back([this, i](std::stop_token stop) { run(i, stop); });
+    }
+
+    // joins the workers; the results are complete after this
+    void stop()
+    {
+        for (auto& t : m_threads)
+            t.request_stop();
+
+        m_threads.clear();
+    }
+
+    void report(std::ostream& out) const
+    {
+        auto r = collect();
+
+        out << Er::format("{}: {} requests, {} completed, {} failed in {:.2f} s\n", rpcName(), r.issued, r.completed, r.failed, r.elapsed);
+        out << Er::format("Target rate {:.1f} requests/s, achieved {:.1f} requests/s\n", m_options.rate, r.qps());
+        out << Er::format("{:<28}{:>10}{:>10}{:>10}{:>10}{:>10}{:>12}\n", "", "p50", "p90", "p99", "p99.9", "max", "mean");
+        printRow(out, "latency, us (corrected)", r.latency);
+        printRow(out, "service time, us", r.service);
+    }
+
+    void reportJson(std::ostream& out) const
+    {
+        auto r = collect();
+
+        out << "{\n";
+        out << Er::format("  \"rpc\": \"{}\",\n", rpcName());
+        out << Er::format("  \"threads\": {},\n", m_options.threads);
+        out << Er::format("  \"window\": {},\n", m_options.window);
+        out << Er::format("  \"target_qps\": {:.3f},\n", m_options.rate);
+        out << Er::format("  \"achieved_qps\": {:.3f},\n", r.qps());
+        out << Er::format("  \"elapsed_s\": {:.3f},\n", r.elapsed);
+        out << Er::format("  \"requests\": {},\n", r.issued);
+        out << Er::format("  \"completed\": {},\n", r.completed);
+        out << Er::format("  \"failed\": {},\n", r.failed);
+        out << "  \"latency_us\": ";
+        printJson(out, r.latency);
+        out << ",\n  \"service_time_us\": ";
+        printJson(out, r.service);
+        out << "\n}\n";
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Worker
+    {
+        mutable std::mutex mutex;
+        std::condition_variable_any cv;
+        unsigned inFlight = 0;
+        std::uint64_t issued = 0;
+        std::uint64_t completed = 0;
+        std::uint64_t failed = 0;
+        Clock::time_point lastCompletion;
+        LatencyHistogram latency;           // since the request was due
+        LatencyHistogram service;           // since it was actually sent
+    };
+
+    struct Results
+    {
+        std::uint64_t issued = 0;
+        std::uint64_t completed = 0;
+        std::uint64_t failed = 0;
+        double elapsed = 0;
+        LatencyHistogram latency;
+        LatencyHistogram service;
+
+        double qps() const noexcept
+        {
+            return (elapsed > 0) ? double(completed) / elapsed : 0.0;
+        }
+    };
+
+    // the outcome is recorded when the client lets go of the completion, which is
+    // after the last reply message for streams too
+    template <class Interface>
+    class LoadCompletion
+        : public Er::Util::ReferenceCountedBase<Er::Util::ObjectBase<Interface>>
+    {
+    public:
+        ~LoadCompletion()
+        {
+            auto now = Clock::now();
+
+            {
+                std::lock_guard l(m_worker->mutex);
+
+                if (m_failed)
+                {
+                    ++m_worker->failed;
+                }
+                else
+                {
+                    ++m_worker->completed;
+                    m_worker->latency.record(micros(now - m_due));
+                    m_worker->service.record(micros(now - m_sent));
+                }
+
+                m_worker->lastCompletion = now;
+                --m_worker->inFlight;
+            }
+
+            m_worker->cv.notify_all();
+        }
+
+        LoadCompletion(Worker* worker, Clock::time_point due) noexcept
+            : m_worker(worker)
+            , m_due(due)
+            , m_sent(Clock::now())
+        {
+        }
+
+        void onError(grpc::Status const& status) noexcept override
+        {
+            ErLogDebug("Request failed with an error {}: {}", int(status.error_code()), status.error_message());
+            m_failed = true;
+        }
+
+        void onException(Er::Exception&& e) noexcept override
+        {
+            ErLogDebug("Request failed with an exception: {}", e.message());
+            m_failed = true;
+        }
+
+    protected:
+        static std::uint64_t micros(Clock::duration d) noexcept
+        {
+            return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(d).count());
+        }
+
+        Worker* const m_worker;
+        const Clock::time_point m_due;
+        const Clock::time_point m_sent;
+        bool m_failed = false;
+    };
+
+    class PingCompletion
+        : public LoadCompletion<Er::Ipc::Grpc::ISystemInfoClient::IPingCompletion>
+    {
+    public:
+        using LoadCompletion::LoadCompletion;
+
+        void onReply(Er::Ipc::Grpc::ISystemInfoClient::PingMessage&& ping, Er::Ipc::Grpc::ISystemInfoClient::PingMessage&& reply) override
+        {
+            if ((ping.sequence != reply.sequence) || (ping.payload != reply.payload))
+                m_failed = true;
+        }
+    };
+
+    class SystemInfoCompletion
+        : public LoadCompletion<Er::Ipc::Grpc::ISystemInfoClient::ISystemInfoCompletion>
+    {
+    public:
+        using LoadCompletion::LoadCompletion;
+
+        Er::CallbackResult onProperty(Er::Property&&) override
+        {
+            return Er::CallbackResult::Continue;
+        }
+
+        void onComplete() override
+        {
+        }
+    };
+
+#if !ER_WINDOWS
+    class ProcessPropsCompletion
+        : public LoadCompletion<Er::ProcessTree::IProcessListClient::IGetProcessPropsCompletion>
+    {
+    public:
+        using LoadCompletion::LoadCompletion;
+
+        void onReply(Er::ProcessTree::ProcessProperties&&, Er::ProcessTree::IProcessListClient::Timings) override
+        {
+        }
+    };
+
+    class ListProcessesCompletion
+        : public LoadCompletion<Er::ProcessTree::IProcessListClient::IListProcessesCompletion>
+    {
+    public:
+        using LoadCompletion::LoadCompletion;
+
+        Er::CallbackResult onProcess(std::string&&, Er::ProcessTree::ProcessProperties&&) override
+        {
+            return Er::CallbackResult::Continue;
+        }
+
+        void onRootFailed(std::string&&, Er::Exception&&) override
+        {
+            m_failed = true;
+        }
+
+        void onComplete() override
+        {
+        }
+    };
+#endif
+
+    std::string_view rpcName() const noexcept
+    {
+        switch (m_options.rpc)
+        {
+        case Rpc::Ping: return "Ping";
+        case Rpc::SystemInfo: return "GetSystemInfo";
+        case Rpc::ProcessProps: return "GetProcessProps";
+        case Rpc::ListProcesses: return "ListProcesses";
+        }
+
+        return {};
+    }
+
+    void run(unsigned index, std::stop_token stop) noexcept
+    {
+        Er::Util::ExceptionLogger xcptHandler(Er::Log::get());
+        try
+        {
+            runImpl(index, stop);
+        }
+        catch (...)
+        {
+            Er::dispatchException(std::current_exception(), xcptHandler);
+        }
+
+        if (m_running.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            m_idle();
+    }
+
+    void runImpl(unsigned index, std::stop_token stop)
+    {
+        auto& w = m_workers[index];
+
+        // each thread keeps its own client so that they don't share completion bookkeeping
+        auto sysInfo = Er::Ipc::Grpc::createSystemInfoClient(m_pool, Er::Log::global());
+#if !ER_WINDOWS
+        Er::ProcessTree::ProcessListClientOptions clientOptions;
+        clientOptions.batchWindow = std::chrono::microseconds(0); // one RPC per request
+        auto processList = Er::ProcessTree::createProcessListClient(m_pool, Er::Log::global(), clientOptions);
+        const Er::ProcessTree::ProcessProperties::Mask mask{ Er::ProcessTree::ProcessProperties::Pid, Er::ProcessTree::ProcessProperties::PPid, Er::ProcessTree::ProcessProperties::Comm, Er::ProcessTree::ProcessProperties::StartTime };
+#endif
+
+        auto period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(double(m_options.threads) / m_options.rate));
+        auto end = m_started + m_options.duration;
+        auto due = m_started + period * index / m_options.threads; // threads take turns
+        std::uint64_t sequence = 0;
+
+        std::unique_lock l(w.mutex);
+        while (!stop.stop_requested() && (due < end))
+        {
+            w.cv.wait_until(l, stop, due, []() { return false; });
+            if (stop.stop_requested())
+                break;
+
+            // falling behind doesn't change the schedule, it only shows in the latency
+            if (!w.cv.wait(l, stop, [&w, this]() { return w.inFlight < m_options.window; }))
+                break;
+
+            ++w.inFlight;
+            ++w.issued;
+            l.unlock();
+
+            switch (m_options.rpc)
+            {
+            case Rpc::Ping:
+            {
+                Er::Ipc::Grpc::ISystemInfoClient::PingMessage pm;
+                pm.payload = Er::Binary(std::string(m_options.payloadSize, 'x'));
+                pm.timestamp = Er::Time::now();
+                pm.sequence = sequence++;
+                sysInfo->ping(std::move(pm), Er::ReferenceCountedPtr<Er::Ipc::Grpc::ISystemInfoClient::IPingCompletion>{ new PingCompletion(&w, due) });
+                break;
+            }
+
+            case Rpc::SystemInfo:
+                sysInfo->getSystemInfo(m_options.pattern, Er::ReferenceCountedPtr<Er::Ipc::Grpc::ISystemInfoClient::ISystemInfoCompletion>{ new SystemInfoCompletion(&w, due) });
+                break;
+
+#if !ER_WINDOWS
+            case Rpc::ProcessProps:
+                processList->getProcessProperties(1, mask, Er::ProcessTree::IProcessListClient::GetProcessPropsCompletionPtr{ new ProcessPropsCompletion(&w, due) });
+                break;
+
+            case Rpc::ListProcesses:
+                processList->listProcesses(mask, Er::ProcessTree::IProcessListClient::ListProcessesCompletionPtr{ new ListProcessesCompletion(&w, due) });
+                break;
+#else
+            default:
+                break;
+#endif
+            }
+
+            due += period;
+            l.lock();
+        }
+
+        l.unlock();
+
+        // the clients wait for their outstanding calls when released
+    }
+
+    Results collect() const
+    {
+        Results r;
+        auto last = m_started;
+
+        for (auto& w : m_workers)
+        {
+            std::lock_guard l(w.mutex);
+
+            r.issued += w.issued;
+            r.completed += w.completed;
+            r.failed += w.failed;
+            r.latency.merge(w.latency);
+            r.service.merge(w.service);
+            last = std::max(last, w.lastCompletion);
+        }
+
+        r.elapsed = std::chrono::duration<double>(last - m_started).count();
+        return r;
+    }
+
+    static void printRow(std::ostream& out, std::string_view title, const LatencyHistogram& h)
+    {
+        out << Er::format("{:<28}{:>10}{:>10}{:>10}{:>10}{:>10}{:>12.1f}\n", title, h.percentile(50), h.percentile(90), h.percentile(99), h.percentile(99.9), h.max(), h.mean());
+    }
+
+    static void printJson(std::ostream& out, const LatencyHistogram& h)
+    {
+        out << Er::format("{{ \"p50\": {}, \"p90\": {}, \"p99\": {}, \"p99.9\": {}, \"max\": {}, \"mean\": {:.1f} }}", h.percentile(50), h.percentile(90), h.percentile(99), h.percentile(99.9), h.max(), h.mean());
+    }
+
+    IdleCallback m_idle;
+    Er::Ipc::Grpc::ChannelPoolPtr m_pool;
+    const Options m_options;
+    std::vector<Worker> m_workers;
+    Clock::time_point m_started;
+    std::atomic<unsigned> m_running = 0;
+    std::vector<std::jthread> m_threads;
+};
@@ -44,6 +44,11 @@ private:
             done();
             return Er::CallbackResult::Continue;
         }
+
+        void onComplete() override
+        {
+            done();
+        }
     };
 
     void run(std::stop_token stop) noexcept
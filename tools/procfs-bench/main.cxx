@@ -0,0 +1,144 @@
+#include <erebus/proctree/server/linux/procfs.hxx>
+#include <erebus/rtl/format.hxx>
+#include <erebus/rtl/program.hxx>
+#include <erebus/rtl/time.hxx>
+#include <erebus/rtl/util/file.hxx>
+
+#include <iostream>
+#include <span>
+
+//
+// Reads the same set of /proc files via Util::tryLoadFile, the synchronous ProcFs reader
+// and the io_uring one, and reports the time each takes per round
+//
+
+namespace
+{
+
+using Er::ProcessTree::Pid;
+using Er::ProcessTree::Linux::ProcFs;
+using Er::ProcessTree::Linux::ProcFsRoot;
+
+
+class BenchApplication
+    : public Er::Program
+{
+    using Base = Er::Program;
+
+public:
+    BenchApplication() noexcept
+        : Base(Base::SyncLogger)
+    {
+    }
+
+protected:
+    void addCmdLineOptions(boost::program_options::options_description& options) override
+    {
+        options.add_options()
+            ("rounds,n", boost::program_options::value<unsigned>(&m_rounds)->default_value(10), "how many times to read every file")
+            ;
+    }
+
+    int run(int argc, char** argv) override
+    {
+        auto root = std::make_shared<const ProcFsRoot>();
+        ProcFs sync(root);
+        ProcFs batched(root, true);
+
+        auto pids_ = sync.enumeratePids();
+        if (!pids_.has_value())
+        {
+            std::cerr << "Failed to enumerate processes: " << pids_.error().message() << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        std::span<const Pid> pids(pids_.value());
+        const unsigned rounds = std::max(m_rounds, 1U);
+        const unsigned files = ProcFs::PrefetchStat | ProcFs::PrefetchOwner | ProcFs::PrefetchComm | ProcFs::PrefetchCmdLine;
+
+        std::size_t loaded = 0;
+        auto started = Er::Time::now();
+        for (unsigned r = 0; r < rounds; ++r)
+        {
+            for (auto pid : pids)
+            {
+                auto base = Er::format("/proc/{}", pid);
+                for (auto file : { "/stat", "/comm", "/cmdline" })
+                {
+                    auto data = Er::Util::tryLoadFile(base + file);
+                    if (data.has_value())
+                        ++loaded;
+                }
+            }
+        }
+        auto tryLoadFileUs = Er::Time::now() - started;
+
+        started = Er::Time::now();
+        for (unsigned r = 0; r < rounds; ++r)
+            readAll(sync, pids, files);
+        auto syncUs = Er::Time::now() - started;
+
+        std::cout << Er::format("{} processes x {} rounds ({} files loaded)\n", pids.size(), rounds, loaded);
+        std::cout << Er::format("Util::tryLoadFile: {} us/round\n", tryLoadFileUs / rounds);
+        std::cout << Er::format("synchronous reader: {} us/round\n", syncUs / rounds);
+
+        if (!batched.batched())
+        {
+            std::cout << "io_uring reader: not available\n";
+            return EXIT_SUCCESS;
+        }
+
+        started = Er::Time::now();
+        for (unsigned r = 0; r < rounds; ++r)
+            readAll(batched, pids, files);
+        auto batchedUs = Er::Time::now() - started;
+
+        std::cout << Er::format("io_uring reader: {} us/round\n", batchedUs / rounds);
+
+        return EXIT_SUCCESS;
+    }
+
+private:
+    static void readAll(ProcFs& proc, std::span<const Pid> pids, unsigned files)
+    {
+        auto capacity = proc.prefetchCapacity(files);
+        if (!capacity)
+            capacity = pids.size();
+
+        for (auto rest = pids; !rest.empty(); )
+        {
+            auto chunk = rest.first(std::min(capacity, rest.size()));
+            proc.prefetch(chunk, files);
+
+            for (auto pid : chunk)
+            {
+                [[maybe_unused]] auto stat = proc.readStat(pid);
+                [[maybe_unused]] auto comm = proc.readComm(pid);
+                [[maybe_unused]] auto cmdLine = proc.readCmdLine(pid);
+            }
+
+            rest = rest.subspan(chunk.size());
+        }
+    }
+
+    unsigned m_rounds = 10;
+};
+
+} // namespace {}
+
+
+int main(int argc, char* argv[])
+{
+    try
+    {
+        BenchApplication app;
+
+        return app.exec(argc, argv);
+    }
+    catch (std::exception& e)
+    {
+        std::cerr << "Unexpected exception: " << e.what() << std::endl;
+    }
+
+    return EXIT_FAILURE;
+}